@@ -0,0 +1,25 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_BUFFER_SEGMENT_H
+#define TES_CORE_BUFFER_SEGMENT_H
+
+#include "CoreConfig.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tes
+{
+/// A contiguous range of bytes in a scatter-gather write - see @c TcpSocket::writev() . A message
+/// may be split across multiple segments to avoid copying it into a single buffer.
+struct BufferSegment
+{
+  /// The segment data.
+  const uint8_t *data = nullptr;
+  /// Number of bytes in @c data .
+  size_t byte_count = 0;
+};
+}  // namespace tes
+
+#endif  // TES_CORE_BUFFER_SEGMENT_H
@@ -6,12 +6,15 @@
 #include "CoreUtil.h"
 #include "Crc.h"
 #include "Endian.h"
+#include "Feature.h"
 #include "Log.h"
 #include "Maths.h"
 #include "Messages.h"
+#include "PacketReader.h"
 #include "PacketWriter.h"
 #include "Throw.h"
 
+#include "private/CollatedPacketCodec.h"
 #include "private/CollatedPacketZip.h"
 
 #include "shapes/Shape.h"
@@ -23,12 +26,19 @@ namespace tes
 {
 namespace
 {
-void writeMessageHeader(uint8_t *buffer, unsigned uncompressed_size, unsigned payload_size,
-                        bool compressed)
+/// Write the @c PacketHeader and @c CollatedPacketMessage to @p buffer .
+///
+/// An @p extended header is followed by the 32-bit payload size - see @c PFExtended - and
+/// requires @c kPacketExtendedSizeBytes more than @c CollatedPacket::InitialCursorOffset .
+void writeMessageHeader(uint8_t *buffer, bool extended, unsigned uncompressed_size,
+                        unsigned payload_size, bool compressed, uint16_t codec = CCDeflate,
+                        bool dictionary = false)
 {
   auto *header = reinterpret_cast<PacketHeader *>(buffer);
   std::memset(header, 0, sizeof(PacketHeader));
-  auto *message = reinterpret_cast<CollatedPacketMessage *>(buffer + sizeof(PacketHeader));
+  const unsigned payload_offset = (extended) ? kPacketExtendedSizeBytes : 0u;
+  auto *message =
+    reinterpret_cast<CollatedPacketMessage *>(buffer + sizeof(PacketHeader) + payload_offset);
   std::memset(message, 0, sizeof(CollatedPacketMessage));
 
   // Keep header in network byte order.
@@ -38,14 +48,27 @@ void writeMessageHeader(uint8_t *buffer, unsigned uncompressed_size, unsigned pa
   header->routing_id = MtCollatedPacket;
   networkEndianSwap(header->routing_id);
   header->message_id = 0;
-  header->payload_size = static_cast<uint16_t>(payload_size + sizeof(CollatedPacketMessage));
-  networkEndianSwap(header->payload_size);
-  header->payload_offset = 0;
-  header->flags = 0;
+  header->payload_offset = static_cast<uint8_t>(payload_offset);
+  if (extended)
+  {
+    header->payload_size = 0;
+    header->flags = PFExtended;
+    const auto extended_size =
+      networkEndianSwapValue(static_cast<uint32_t>(payload_size + sizeof(CollatedPacketMessage)));
+    std::memcpy(buffer + sizeof(PacketHeader), &extended_size, sizeof(extended_size));
+  }
+  else
+  {
+    header->payload_size = static_cast<uint16_t>(payload_size + sizeof(CollatedPacketMessage));
+    networkEndianSwap(header->payload_size);
+    header->flags = 0;
+  }
 
   message->flags = (compressed) ? CPFCompress : 0u;
+  message->flags |= (compressed && codec == CCDeflate && dictionary) ? CPFCompressDictionary : 0u;
   networkEndianSwap(message->flags);
-  message->reserved = 0;
+  message->codec = (compressed) ? codec : static_cast<uint16_t>(CCDeflate);
+  networkEndianSwap(message->codec);
   message->uncompressed_bytes = uncompressed_size;
   networkEndianSwap(message->uncompressed_bytes);
 }
@@ -87,10 +110,68 @@ int CollatedPacket::compressionLevel() const
 }
 
 
+bool CollatedPacket::compressionCodecAvailable(uint16_t codec)
+{
+  switch (codec)
+  {
+  case CCDeflate:
+    return checkFeature(TFeatureCompression);
+  case CCLz4:
+    return checkFeature(TFeatureCompressionLz4);
+  case CCZstd:
+    return checkFeature(TFeatureCompressionZstd);
+  default:
+    break;
+  }
+  return false;
+}
+
+
+bool CollatedPacket::setCompressionCodec(uint16_t codec)
+{
+  if (!compressionCodecAvailable(codec))
+  {
+    return false;
+  }
+  _compression_codec = codec;
+  return true;
+}
+
+
+uint16_t CollatedPacket::compressionCodec() const
+{
+  return _compression_codec;
+}
+
+
+void CollatedPacket::setCompressionDictionary(bool enable)
+{
+  _compression_dictionary = enable;
+}
+
+
+bool CollatedPacket::compressionDictionary() const
+{
+  return _compression_dictionary;
+}
+
+
+void CollatedPacket::setElideNestedCrc(bool enable)
+{
+  _elide_nested_crc = enable;
+}
+
+
+bool CollatedPacket::elideNestedCrc() const
+{
+  return _elide_nested_crc;
+}
+
+
 void CollatedPacket::reset()
 {
   _cursor = _final_packet_cursor = 0;
-  _finalised = false;
+  _finalised = _in_place = _contiguous = false;
 }
 
 
@@ -102,19 +183,19 @@ int CollatedPacket::add(const PacketWriter &packet)
   }
 
   const auto *packet_buffer = reinterpret_cast<const uint8_t *>(&packet.packet());
-  const uint16_t packet_bytes = packet.packetSize();
+  const unsigned packet_bytes = packet.packetSize();
   return add(packet_buffer, packet_bytes);
 }
 
 
-int CollatedPacket::add(const uint8_t *buffer, uint16_t byte_count)
+int CollatedPacket::add(const uint8_t *buffer, unsigned byte_count)
 {
   if (!_active)
   {
     return 0;
   }
 
-  if (byte_count <= 0)
+  if (byte_count == 0)
   {
     return 0;
   }
@@ -125,16 +206,32 @@ int CollatedPacket::add(const uint8_t *buffer, uint16_t byte_count)
   }
 
   // Check total size capacity.
-  if (collatedBytes() + byte_count + Overhead > _max_packet_size)
+  if (collatedBytes() + byte_count + overhead() > _max_packet_size)
   {
     // Too many bytes to collate.
     return -1;
   }
 
-  if (_buffer.size() < collatedBytes() + byte_count + Overhead)
+  if (_buffer.size() < collatedBytes() + byte_count + overhead())
   {
     // Buffer too small.
-    expand(byte_count + Overhead, _buffer, _max_packet_size);
+    expand(byte_count + overhead(), _buffer, _max_packet_size);
+  }
+
+  if (_elide_nested_crc && byte_count >= sizeof(PacketHeader) + sizeof(PacketWriter::CrcType) &&
+      byte_count >=
+        sizeof(PacketHeader) + reinterpret_cast<const PacketHeader *>(buffer)->payload_offset)
+  {
+    const PacketReader reader(reinterpret_cast<const PacketHeader *>(buffer));
+    if ((reader.flags() & PFNoCrc) == 0 && byte_count == reader.packetSize())
+    {
+      // Strip the CRC. The collated packet CRC covers this packet.
+      const auto nested_bytes = static_cast<unsigned>(byte_count - sizeof(PacketWriter::CrcType));
+      std::copy(buffer, buffer + nested_bytes, _buffer.begin() + _cursor);
+      reinterpret_cast<PacketHeader *>(_buffer.data() + _cursor)->flags |= PFNoCrc;
+      _cursor += nested_bytes;
+      return byte_count;
+    }
   }
 
   std::copy(buffer, buffer + byte_count, _buffer.begin() + _cursor);
@@ -158,46 +255,73 @@ bool CollatedPacket::finalise()
     return true;
   }
 
-  _final_buffer.resize(_buffer.size() + Overhead);
+  // Collations over the 16-bit payload limit require an extended header. This is only possible
+  // when the maxPacketSize() exceeds kMaxPacketSize.
+  const bool extended = sizeof(CollatedPacketMessage) + collatedBytes() > kPacketMaxPayloadSize;
+  _header_bytes = InitialCursorOffset + ((extended) ? kPacketExtendedSizeBytes : 0u);
+  _final_buffer.resize(_buffer.size() + Overhead + kPacketExtendedSizeBytes);
 
   // Finalise the packet. If possible, we try compress the buffer. If that is smaller then we use
   // the compressed result. Otherwise we use compressed data.
   bool compressed_data = false;
+  if (compressionEnabled() && _compression_codec != CCDeflate)
+  {
+    if (!_codec)
+    {
+      _codec = std::make_unique<CollatedPacketCodec>();
+    }
+
+    // Block codecs. The output capacity is limited to the uncompressed size as there is no point
+    // sending a larger, compressed payload.
+    const size_t compressed_bytes =
+      _codec->compress(_compression_codec, _compression_level, _buffer.data(), collatedBytes(),
+                       _final_buffer.data() + _header_bytes, collatedBytes() - 1u);
+    if (compressed_bytes > 0)
+    {
+      compressed_data = true;
+      writeMessageHeader(_final_buffer.data(), extended, collatedBytes(),
+                         static_cast<unsigned>(compressed_bytes), true, _compression_codec);
+      _final_packet_cursor = _header_bytes + static_cast<unsigned>(compressed_bytes);
+    }
+  }
 #ifdef TES_ZLIB
-  if (compressionEnabled() && collatedBytes())
+  else if (compressionEnabled())
   {
+    if (!_zip)
+    {
+      _zip = std::make_unique<CollatedPacketZip>(false);
+    }
+
     unsigned compressed_bytes = 0;
 
-    // Z_BEST_COMPRESSION
-    // params: stream,level, method, window bits, memLevel, strategy
+    // The deflate stream persists between calls and is recycled with deflateReset().
     const int gzip_compression_level = tes::kTesToGZipCompressionLevel[_compression_level];
-    deflateInit2(&_zip->stream, gzip_compression_level, Z_DEFLATED,
-                 // NOLINTNEXTLINE(hicpp-signed-bitwise)
-                 CollatedPacketZip::WindowBits | CollatedPacketZip::GZipEncoding, 8,
-                 Z_DEFAULT_STRATEGY);
-    _zip->stream.next_out = reinterpret_cast<Bytef *>(_final_buffer.data() + InitialCursorOffset);
-    _zip->stream.avail_out = static_cast<uInt>(_final_buffer.size() - Overhead);
-
-    int zip_ret = 0;
-    _zip->stream.avail_in = collatedBytes();
-    _zip->stream.next_in = reinterpret_cast<Bytef *>(_buffer.data());
-    zip_ret = deflate(&_zip->stream, Z_FINISH);
-    deflateEnd(&_zip->stream);
+    int zip_ret = Z_STREAM_ERROR;
+    if (_zip->beginDeflate(gzip_compression_level, _compression_dictionary))
+    {
+      _zip->stream.next_out =
+        reinterpret_cast<Bytef *>(_final_buffer.data() + _header_bytes);
+      _zip->stream.avail_out = static_cast<uInt>(_final_buffer.size() - _header_bytes -
+                                                 sizeof(PacketWriter::CrcType));
+      _zip->stream.avail_in = collatedBytes();
+      _zip->stream.next_in = reinterpret_cast<Bytef *>(_buffer.data());
+      zip_ret = deflate(&_zip->stream, Z_FINISH);
+    }
 
     if (zip_ret == Z_STREAM_END)
     {
       // Compressed ok. Check size.
       // Update _cursor to reflect the number of bytes to write.
       compressed_bytes = static_cast<unsigned>(_zip->stream.total_out);
-      _zip->stream.total_out = 0;
 
       if (compressed_bytes < collatedBytes())
       {
         // Compression is good. Smaller than uncompressed data.
         compressed_data = true;
         // Write uncompressed header.
-        writeMessageHeader(_final_buffer.data(), collatedBytes(), compressed_bytes, true);
-        _final_packet_cursor = InitialCursorOffset + compressed_bytes;
+        writeMessageHeader(_final_buffer.data(), extended, collatedBytes(), compressed_bytes,
+                           true, CCDeflate, _compression_dictionary);
+        _final_packet_cursor = _header_bytes + compressed_bytes;
       }
       else
       {
@@ -210,10 +334,17 @@ bool CollatedPacket::finalise()
 
   if (!compressed_data)
   {
-    // No or failed compression. Write uncompressed.
-    writeMessageHeader(_final_buffer.data(), collatedBytes(), collatedBytes(), false);
-    std::memcpy(_final_buffer.data() + InitialCursorOffset, _buffer.data(), collatedBytes());
-    _final_packet_cursor = InitialCursorOffset + collatedBytes();
+    // No or failed compression. Write the header only, leaving the collated data in _buffer to
+    // avoid a copy. The CRC continues from the header across the collated data. See segments().
+    writeMessageHeader(_final_buffer.data(), extended, collatedBytes(), collatedBytes(), false);
+    _final_crc =
+      crc16(_buffer.data(), collatedBytes(), crc16(_final_buffer.data(), _header_bytes));
+    networkEndianSwap(_final_crc);
+    _final_packet_cursor =
+      _header_bytes + collatedBytes() + static_cast<unsigned>(sizeof(_final_crc));
+    _in_place = true;
+    _finalised = true;
+    return true;
   }
 
   // Calculate the CRC
@@ -229,11 +360,39 @@ bool CollatedPacket::finalise()
 
 const uint8_t *CollatedPacket::buffer(unsigned &byte_count) const
 {
+  if (_in_place && !_contiguous)
+  {
+    // Copy the collated data and CRC after the header.
+    std::memcpy(_final_buffer.data() + _header_bytes, _buffer.data(), collatedBytes());
+    std::memcpy(_final_buffer.data() + _header_bytes + collatedBytes(), &_final_crc,
+                sizeof(_final_crc));
+    _contiguous = true;
+  }
   byte_count = _final_packet_cursor;
   return _final_buffer.data();
 }
 
 
+unsigned CollatedPacket::segments(std::array<BufferSegment, kMaxSegments> &segments) const
+{
+  if (!_finalised || _final_packet_cursor == 0)
+  {
+    return 0;
+  }
+
+  if (_in_place && !_contiguous)
+  {
+    segments[0] = { _final_buffer.data(), _header_bytes };
+    segments[1] = { _buffer.data(), collatedBytes() };
+    segments[2] = { reinterpret_cast<const uint8_t *>(&_final_crc), sizeof(_final_crc) };
+    return 3;
+  }
+
+  segments[0] = { _final_buffer.data(), _final_packet_cursor };
+  return 1;
+}
+
+
 //-----------------------------------------------------------------------------
 // Connection methods.
 //-----------------------------------------------------------------------------
@@ -429,6 +588,7 @@ int CollatedPacket::destroy(const Shape &shape)
       writer = PacketWriter(_buffer.data() + _cursor,
                             static_cast<uint16_t>(std::min<size_t>(
                               _buffer.size() - _cursor - sizeof(PacketWriter::CrcType), 0xffffu)));
+      writer.reset(MtServerInfo, 0);
     }
     else
     {
@@ -552,7 +712,7 @@ bool CollatedPacket::sendServerInfo(const ServerInfoMessage &info)
   writer.reset(MtServerInfo, 0);
   // Keep trying to write the packet while we don't have a fatal error.
   // Supports resizing the buffer.
-  while (wrote_message && written != -1)
+  while (!wrote_message && written != -1)
   {
     wrote_message = info.write(writer);
     if (wrote_message)
@@ -605,12 +765,12 @@ int CollatedPacket::send(const uint8_t *data, int byte_count, bool /*allow_colla
     return 0;
   }
 
-  if (byte_count > 0xffff)
+  if (byte_count < 0)
   {
     return -1;
   }
 
-  return add(data, static_cast<uint16_t>(byte_count));
+  return add(data, static_cast<unsigned>(byte_count));
 }
 
 
@@ -634,13 +794,7 @@ void CollatedPacket::init(bool compress, unsigned buffer_size, unsigned max_pack
   _final_buffer.clear();
   _cursor = _final_packet_cursor = 0;
   _max_packet_size = max_packet_size;
-
-#ifdef TES_ZLIB
-  if (compress)
-  {
-    _zip = std::make_unique<CollatedPacketZip>(false);
-  }
-#endif  // TES_ZLIB
+  _compress = compress;
 }
 
 
@@ -7,15 +7,18 @@
 #include "CoreConfig.h"
 
 //
+#include "BufferSegment.h"
 #include "CompressionLevel.h"
 #include "Connection.h"
 #include "PacketHeader.h"
 
+#include <array>
 #include <vector>
 
 namespace tes
 {
 struct CollatedPacketMessage;
+class CollatedPacketCodec;
 struct CollatedPacketZip;
 class PacketWriter;
 
@@ -65,6 +68,8 @@ public:
   static constexpr uint16_t kMaxPacketSize = static_cast<uint16_t>(~0u);
   /// The default buffer size.
   static constexpr uint16_t kDefaultBufferSize = 0xff00u;
+  /// The maximum number of segments in a finalised packet. See @c segments() .
+  static constexpr unsigned kMaxSegments = 3;
 
   /// Initialise a collated packet. This sets the initial packet size limited
   /// by @c kMaxPacketSize, and compression options.
@@ -89,10 +94,29 @@ public:
   /// Destructor.
   ~CollatedPacket() override;
 
-  /// Is compression enabled. Required ZLIB.
+  /// Is compression enabled. Requires compression was requested on construction and that the
+  /// @c compressionCodec() is available.
   /// @return True if compression is enabled.
   [[nodiscard]] bool compressionEnabled() const;
 
+  /// Check if a @c CompressionCodec is available in this build.
+  /// @param codec The codec to check.
+  /// @return True if @p codec can be used.
+  [[nodiscard]] static bool compressionCodecAvailable(uint16_t codec);
+
+  /// Set the @c CompressionCodec used when compression is enabled. Rejected if @p codec is not
+  /// available - see @c compressionCodecAvailable() .
+  ///
+  /// The codec is written to @c CollatedPacketMessage::codec . May be set even if compression is
+  /// not enabled, but will have no effect.
+  /// @param codec The codec to use.
+  /// @return True if the codec is accepted.
+  bool setCompressionCodec(uint16_t codec);
+
+  /// Get the @c CompressionCodec used when compression is enabled.
+  /// @return The current codec.
+  [[nodiscard]] uint16_t compressionCodec() const;
+
   /// Set the target compression level. Rejected if @p level is out of range of @c CompressionLevel.
   /// May be set even if compression is not enabled, but will have no effect.
   /// @param level The target level to set. See @c CompressionLevel.
@@ -102,6 +126,37 @@ public:
   /// @return The current compression level @c CompressionLevel.
   [[nodiscard]] int compressionLevel() const;
 
+  /// Enable priming compression with the preset collation dictionary. This improves the
+  /// compression ratio for small packets, which are dominated by repetitive @c PacketHeader and
+  /// @c ObjectAttributes data.
+  ///
+  /// Packets compressed with the dictionary set @c CPFCompressDictionary and require a decoder
+  /// which supports the dictionary. A server advertises this via @c SIFCompressionDictionary in the
+  /// @c ServerInfoMessage.
+  ///
+  /// May be set even if compression is not enabled, but will have no effect.
+  /// @param enable True to enable the dictionary.
+  void setCompressionDictionary(bool enable);
+
+  /// Check if priming compression with the preset dictionary is enabled.
+  /// @return True if the dictionary is enabled.
+  [[nodiscard]] bool compressionDictionary() const;
+
+  /// Enable eliding the CRC of packets nested in this collated packet.
+  ///
+  /// Nested packets are already protected by the CRC of the collated packet. When enabled,
+  /// @c add() strips the CRC from packets and sets @c PFNoCrc in the nested @c PacketHeader .
+  /// Packets which already have @c PFNoCrc set are added as is.
+  ///
+  /// Should not be used for transaction collation - see @c CollatedPacket(unsigned, unsigned) -
+  /// as the nested packets may be sent individually.
+  /// @param enable True to elide nested CRCs.
+  void setElideNestedCrc(bool enable);
+
+  /// Check if nested packet CRCs are elided.
+  /// @return True if eliding nested CRCs.
+  [[nodiscard]] bool elideNestedCrc() const;
+
   /// Return the capacity of the collated packet.
   ///
   /// This defaults to 64 * 1024 - 1 (the maximum for a 16-bit unsigned integer),
@@ -131,10 +186,13 @@ public:
   /// @param buffer The data to add.
   /// @param byte_count The number of bytes in @p buffer.
   /// @return The <tt>packet.packetSize()</tt> on success, or -1 on failure.
-  int add(const uint8_t *buffer, uint16_t byte_count);
+  int add(const uint8_t *buffer, unsigned byte_count);
 
   /// Finalises the collated packet for sending. This includes completing
   /// compression and calculating the CRC.
+  ///
+  /// Uncompressed packets are finalised without copying the collated data. Use @c segments() to
+  /// send the result without copying.
   /// @return True on successful finalisation, false when already finalised.
   bool finalise();
 
@@ -143,20 +201,40 @@ public:
   [[nodiscard]] bool isFinalised() const { return _finalised; }
 
   /// Access the internal buffer pointer.
+  ///
+  /// For an uncompressed packet, the first call after @c finalise() copies the collated data
+  /// into a contiguous buffer. Prefer @c segments() to avoid the copy.
   /// @param[out] byte_count Set to the number of used bytes in the collated buffer, including
   ///     the CRC when the packet has been finalised.
   /// @return The internal buffer pointer.
   [[nodiscard]] const uint8_t *buffer(unsigned &byte_count) const;
 
+  /// Access the finalised packet as a sequence of buffers for a scatter-gather write - see
+  /// @c TcpSocket::writev() .
+  ///
+  /// An uncompressed packet has three segments: the @c PacketHeader and @c CollatedPacketMessage ,
+  /// the collated data and the CRC. A compressed packet has a single segment. The segments are
+  /// valid until the packet is reset.
+  /// @param[out] segments Populated with the packet segments.
+  /// @return The number of @p segments used. Zero if the packet is not finalised or is empty.
+  unsigned segments(std::array<BufferSegment, kMaxSegments> &segments) const;
+
   /// Return the number of bytes that have been collated. This excludes the @c PacketHeader
   /// and @c CollatedPacketMessage, but will include the CRC once finalised.
   [[nodiscard]] unsigned collatedBytes() const;
 
   /// Return the number of bytes available in the collated packet. This considers @c collatedBytes()
-  /// so far and the packet @c Overhead with respect to @c maxPacketSize().
+  /// so far and the packet @c Overhead with respect to @c maxPacketSize(). The overhead includes
+  /// the extended payload size when the @c maxPacketSize() exceeds @c kMaxPacketSize - see
+  /// @c PFExtended .
   /// @return The number of byte which can be written to the packet before it is full.
   [[nodiscard]] unsigned availableBytes() const;
 
+  /// The packet @c Overhead plus the extended payload size when packets may exceed
+  /// @c kMaxPacketSize .
+  /// @return The number of bytes required beyond @c collatedBytes() .
+  [[nodiscard]] unsigned overhead() const;
+
   //-------------------------------------------
   // Connection methods.
   //-------------------------------------------
@@ -250,25 +328,42 @@ private:
   /// @param expand_by Minimum number of bytes to expand by.
   static void expand(unsigned expand_by, std::vector<uint8_t> &buffer, unsigned max_packet_size);
 
-  std::unique_ptr<CollatedPacketZip> _zip;  ///< Present and used when compression is enabled.
+  std::unique_ptr<CollatedPacketZip> _zip;  ///< Created on first use for @c CCDeflate .
+  /// Created on first use for block codecs: @c CCLz4 , @c CCZstd .
+  std::unique_ptr<CollatedPacketCodec> _codec;
   std::vector<uint8_t> _buffer;             ///< Internal buffer.
   /// Buffer used to finalise collation. Deflating may not be successful, so we can try and fail
   /// with this buffer.
-  std::vector<uint8_t> _final_buffer;
+  ///
+  /// For an uncompressed packet, this only holds the header until a contiguous @c buffer() is
+  /// requested. The collated data remain in @c _buffer .
+  mutable std::vector<uint8_t> _final_buffer;
   // unsigned _buffer_size = 0;                ///< current size of @c _buffer.
   // unsigned _final_buffer_size = 0;          ///< current size of @c _final_buffer.
   unsigned _final_packet_cursor = 0;        ///< End of data in @c _final_buffer
+  /// Bytes before the collated data in @c _final_buffer : @c InitialCursorOffset plus the extended
+  /// payload size when required.
+  unsigned _header_bytes = InitialCursorOffset;
   unsigned _cursor = 0;                     ///< Current write position in @c _buffer.
   unsigned _max_packet_size = 0;            ///< Maximum @p _buffer_size.
   uint16_t _compression_level = ClDefault;  ///< @c CompressionLevel
+  uint16_t _compression_codec = CCDefault;  ///< @c CompressionCodec
+  uint16_t _final_crc = 0;                  ///< Finalised CRC (network order) for @c _in_place .
+  bool _compress = false;                   ///< Compression requested on construction?
+  bool _compression_dictionary = false;     ///< Prime compression with the preset dictionary?
+  bool _elide_nested_crc = false;           ///< Strip CRCs from nested packets?
   bool _finalised = false;                  ///< Finalisation flag.
+  /// Finalised with the collated data left in @c _buffer ? See @c segments() .
+  bool _in_place = false;
+  /// Has the @c _in_place packet been copied to @c _final_buffer for @c buffer() ?
+  mutable bool _contiguous = false;
   bool _active = true;                      ///< For @c Connection::active().
 };
 
 
 inline bool CollatedPacket::compressionEnabled() const
 {
-  return _zip != nullptr;
+  return _compress && compressionCodecAvailable(_compression_codec);
 }
 
 
@@ -283,9 +378,16 @@ inline unsigned CollatedPacket::collatedBytes() const
   return _cursor;
 }
 
+inline unsigned CollatedPacket::overhead() const
+{
+  return static_cast<unsigned>(Overhead) +
+         ((_max_packet_size > kMaxPacketSize) ? kPacketExtendedSizeBytes : 0u);
+}
+
+
 inline unsigned CollatedPacket::availableBytes() const
 {
-  const unsigned used = collatedBytes() + static_cast<unsigned>(Overhead);
+  const unsigned used = collatedBytes() + overhead();
   return (_max_packet_size >= used) ? _max_packet_size - used : 0;
 }
 }  // namespace tes
@@ -9,6 +9,7 @@
 #include "PacketHeader.h"
 #include "PacketReader.h"
 
+#include "private/CollatedPacketCodec.h"
 #include "private/CollatedPacketZip.h"
 
 #include <vector>
@@ -43,6 +44,7 @@ struct CollatedPacketDecoderDetail
   const PacketHeader *packet = nullptr;
   const uint8_t *stream = nullptr;
   CollatedPacketZip zip = CollatedPacketZip(true);
+  CollatedPacketCodec codec;
   bool compressed = false;
   bool ok = false;
 
@@ -51,7 +53,7 @@ struct CollatedPacketDecoderDetail
     this->packet = packet;
     if (!packet)
     {
-      initStream(0, 0, nullptr, 0);
+      initStream(0, CCDeflate, 0, nullptr, 0);
       return false;
     }
 
@@ -69,15 +71,15 @@ struct CollatedPacketDecoderDetail
         return false;
       }
 
-      if (!initStream(msg.flags, msg.uncompressed_bytes, reader.payload() + reader.tell(),
-                      reader.payloadSize() - reader.tell()))
+      if (!initStream(msg.flags, msg.codec, msg.uncompressed_bytes,
+                      reader.payload() + reader.tell(), reader.payloadSize() - reader.tell()))
       {
         return false;
       }
     }
     else
     {
-      initStream(0, 0, nullptr, 0);
+      initStream(0, CCDeflate, 0, nullptr, 0);
       target_bytes = reader.payloadSize();
     }
     return true;
@@ -85,15 +87,14 @@ struct CollatedPacketDecoderDetail
 
   void finishCurrent()
   {
+    // Note: the zip stream persists and is recycled for the next packet.
     packet = nullptr;
     stream = nullptr;
-    zip.reset();
   }
 
-  bool initStream(unsigned message_flags, unsigned target_decode_bytes, const uint8_t *bytes,
-                  unsigned byte_count)
+  bool initStream(unsigned message_flags, uint16_t message_codec, unsigned target_decode_bytes,
+                  const uint8_t *bytes, unsigned byte_count)
   {
-    zip.reset();
     stream = bytes;
     stream_bytes = byte_count;
     target_bytes = target_decode_bytes;
@@ -105,18 +106,22 @@ struct CollatedPacketDecoderDetail
     }
 
     ok = false;
-    if (message_flags & CPFCompress)  // NOLINT(hicpp-signed-bitwise)
+    // NOLINTNEXTLINE(hicpp-signed-bitwise)
+    if ((message_flags & CPFCompress) && message_codec != CCDeflate)
+    {
+      // Block codecs decompress the whole payload up front. The result is then read as an
+      // uncompressed stream.
+      compressed = false;
+      ok = codec.decompress(message_codec, stream, stream_bytes, buffer.data(), target_bytes);
+      stream = buffer.data();
+      stream_bytes = target_bytes;
+    }
+    else if (message_flags & CPFCompress)  // NOLINT(hicpp-signed-bitwise)
     {
 #ifdef TES_ZLIB
-      ok = true;
       compressed = true;
-      zip.stream.zalloc = Z_NULL;
-      zip.stream.zfree = Z_NULL;
-      zip.stream.opaque = Z_NULL;
-      zip.stream.avail_in = 0;
-      zip.stream.next_in = Z_NULL;
-      ok = inflateInit2(&zip.stream,
-                        CollatedPacketZip::WindowBits | CollatedPacketZip::GZipEncoding) == Z_OK;
+      // NOLINTNEXTLINE(hicpp-signed-bitwise)
+      ok = zip.beginInflate((message_flags & CPFCompressDictionary) != 0);
       zip.stream.avail_in = stream_bytes;
       // NOLINTNEXTLINE(google-readability-casting)
       zip.stream.next_in = (z_const Bytef *)stream;
@@ -131,7 +136,7 @@ struct CollatedPacketDecoderDetail
     if (!ok)
     {
       // Failed stream.
-      initStream(0, 0, nullptr, 0);
+      initStream(0, CCDeflate, 0, nullptr, 0);
       // Initialising like this will set ok to true. Force failure.
       ok = false;
     }
@@ -170,7 +175,81 @@ struct CollatedPacketDecoderDetail
     return next_packet;
   }
 
+  /// Decode all remaining messages. See @c CollatedPacketDecoder::decodeAll() .
+  bool decodeAll(std::vector<uint8_t> &out, const uint8_t *&messages, size_t &byte_count)
+  {
+    const size_t total = target_bytes - decoded_bytes;
+    const uint8_t *bytes = stream + decoded_bytes;
+    if (compressed)
+    {
+#ifdef TES_ZLIB
+      // Inflate everything in one pass.
+      out.resize(total);
+      zip.stream.next_out = out.data();
+      zip.stream.avail_out = int_cast<uInt>(total);
+      int status = Z_OK;
+      while (status == Z_OK && zip.stream.avail_out > 0)
+      {
+        status = inflateNext();
+      }
+      if (zip.stream.avail_out != 0)
+      {
+        finishCurrent();
+        return false;
+      }
+      bytes = out.data();
+#else   // TES_ZLIB
+      finishCurrent();
+      return false;
+#endif  // TES_ZLIB
+    }
+    else if (stream == buffer.data())
+    {
+      // Block codec output. Hand over the buffer rather than copying. The data do not move.
+      out.swap(buffer);
+    }
+
+    // Validate the messages.
+    size_t offset = 0;
+    while (total - offset >= sizeof(PacketHeader))
+    {
+      const auto *header = reinterpret_cast<const PacketHeader *>(bytes + offset);
+      const size_t header_size = sizeof(PacketHeader) + header->payload_offset;
+      const unsigned packet_size =
+        (header_size <= total - offset) ? getPacketSize(bytes + offset) : 0u;
+      if (packet_size < header_size || packet_size > total - offset ||
+          (compressed && !PacketReader(header).checkCrc()))
+      {
+        break;
+      }
+      offset += packet_size;
+    }
+
+    messages = bytes;
+    byte_count = offset;
+    decoded_bytes = target_bytes;
+    finishCurrent();
+    return offset == total;
+  }
+
 private:
+#ifdef TES_ZLIB
+  /// Inflate into the current output buffer, setting the preset dictionary if required.
+  int inflateNext()
+  {
+    int status = inflate(&zip.stream, Z_NO_FLUSH);
+    if (status == Z_NEED_DICT)
+    {
+      if (!zip.setInflateDictionary())
+      {
+        return Z_DATA_ERROR;
+      }
+      status = inflate(&zip.stream, Z_NO_FLUSH);
+    }
+    return status;
+  }
+#endif  // TES_ZLIB
+
   [[nodiscard]] const PacketHeader *nextPacketCompressed()
   {
 #ifdef TES_ZLIB
@@ -179,7 +258,7 @@ private:
     // Decode just one header.
     zip.stream.avail_out = sizeof(PacketHeader);
     zip.stream.next_out = buffer.data();
-    status = inflate(&zip.stream, Z_NO_FLUSH);
+    status = inflateNext();
     if (status == Z_STREAM_ERROR || status == Z_NEED_DICT || status == Z_DATA_ERROR ||
         status == Z_MEM_ERROR)
     {
@@ -192,9 +271,23 @@ private:
       return nullptr;
     }
 
+    // Inflate the remainder of the header, which includes the extended payload size.
+    const unsigned header_size =
+      sizeof(PacketHeader) + reinterpret_cast<const PacketHeader *>(buffer.data())->payload_offset;
+    if (header_size > sizeof(PacketHeader))
+    {
+      zip.stream.avail_out = header_size - static_cast<unsigned>(sizeof(PacketHeader));
+      status = inflateNext();
+      if (status == Z_STREAM_ERROR || status == Z_NEED_DICT || status == Z_DATA_ERROR ||
+          status == Z_MEM_ERROR || zip.stream.avail_out != 0)
+      {
+        return nullptr;
+      }
+    }
+
     // Validate the header. Use a PacketReader to ensure endian swap as needed.
     const unsigned packet_size = getPacketSize(buffer.data());
-    if (packet_size == 0)
+    if (packet_size < header_size)
     {
       // Validation failed.
       return nullptr;
@@ -204,12 +297,12 @@ private:
     if (buffer.size() < packet_size)
     {
       buffer.resize(packet_size);
-      zip.stream.next_out = buffer.data() + sizeof(PacketHeader);
     }
 
     // Inflate remaining packet bytes.
-    zip.stream.avail_out = int_cast<uInt>(packet_size - sizeof(PacketHeader));
-    status = inflate(&zip.stream, Z_NO_FLUSH);
+    zip.stream.next_out = buffer.data() + header_size;
+    zip.stream.avail_out = int_cast<uInt>(packet_size - header_size);
+    status = inflateNext();
 
     if (status == Z_STREAM_ERROR || status == Z_NEED_DICT || status == Z_DATA_ERROR ||
         status == Z_MEM_ERROR)
@@ -317,4 +410,28 @@ const PacketHeader *CollatedPacketDecoder::next()
 
   return nullptr;
 }
+
+
+bool CollatedPacketDecoder::decodeAll(std::vector<uint8_t> &buffer, const uint8_t *&messages,
+                                      size_t &byte_count)
+{
+  messages = nullptr;
+  byte_count = 0;
+  if (!_detail || !_detail->packet)
+  {
+    return false;
+  }
+
+  if (_detail->stream)
+  {
+    return _detail->decodeAll(buffer, messages, byte_count);
+  }
+
+  // Not a collated packet. Pass through as is.
+  messages = reinterpret_cast<const uint8_t *>(_detail->packet);
+  byte_count = PacketReader(_detail->packet).packetSize();
+  _detail->decoded_bytes = _detail->target_bytes;
+  _detail->packet = nullptr;
+  return true;
+}
 }  // namespace tes
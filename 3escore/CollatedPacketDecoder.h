@@ -11,6 +11,7 @@
 #include "PacketHeader.h"
 
 #include <memory>
+#include <vector>
 
 namespace tes
 {
@@ -22,8 +23,8 @@ struct CollatedPacketDecoderDetail;
 ///
 /// These are packets with a message type of @c MtCollatedPacket containing a
 /// @c CollatedPacketMessage followed by a payload containing additional message packets,
-/// optionally compressed using GZip compression. Such packets may be generated using the
-/// @c CollatedPacket class.
+/// optionally compressed using one of the @c CompressionCodec values. Such packets may be
+/// generated using the @c CollatedPacket class.
 ///
 /// While the decoder supports decoding @c CollatedPacketMessage, it can handle other
 /// mesage packets by simply returning the supplied packet as is. This allows the usage
@@ -104,6 +105,23 @@ public:
   /// @return The next extracted packet or null when there are no more available.
   [[nodiscard]] const PacketHeader *next();
 
+  /// Decode all the remaining messages from the current primary packet at once, rather than one
+  /// at a time via @c next() .
+  ///
+  /// The messages are back to back. Uncompressed messages reference the primary packet in place,
+  /// as does a primary packet which is not a @c CollatedPacketMessage . Compressed messages are
+  /// decompressed into @p buffer in a single pass, avoiding the per message copy @c next()
+  /// requires. Messages are validated as for @c next() , stopping at the first invalid message.
+  ///
+  /// The primary packet is finished on return, so @c next() returns null.
+  ///
+  /// @param buffer Storage for decompressed messages. May be swapped with an internal buffer.
+  /// @param[out] messages Set to the first message.
+  /// @param[out] byte_count Set to the byte size of the valid messages.
+  /// @return True if all messages are decoded. False on a decoding failure, an invalid message or
+  ///   when there is no primary packet.
+  bool decodeAll(std::vector<uint8_t> &buffer, const uint8_t *&messages, size_t &byte_count);
+
 private:
   std::unique_ptr<CollatedPacketDecoderDetail> _detail;
 };
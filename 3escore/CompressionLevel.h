@@ -6,6 +6,8 @@
 
 #include "CoreConfig.h"
 
+#include <cstdint>
+
 namespace tes
 {
 /// Target compression levels.
@@ -21,6 +23,29 @@ enum CompressionLevel
 
   ClDefault = ClMedium
 };
+
+/// Codecs which may be used to compress collated packets. Written to
+/// @c CollatedPacketMessage::codec .
+///
+/// Codec availability depends on the libraries available when building 3escore. Use
+/// @c checkFeature() with @c TFeatureCompression , @c TFeatureCompressionLz4 or
+/// @c TFeatureCompressionZstd to check for support.
+enum CompressionCodec : uint16_t
+{
+  /// Deflate compression via zlib. The stream is in GZip format or zlib format with
+  /// @c CPFCompressDictionary .
+  CCDeflate,
+  /// LZ4 block compression. Fast compression and decompression with a lower compression ratio.
+  /// Suited to live streaming.
+  CCLz4,
+  /// Zstandard compression. Better compression ratio than @c CCDeflate with faster decompression.
+  /// Suited to recording.
+  CCZstd,
+
+  CCCount,
+
+  CCDefault = CCDeflate
+};
 }  // namespace tes
 
 #endif  // TES_CORE_COMPRESSION_LEVEL_H
@@ -6,11 +6,13 @@
 
 #include "CoreConfig.h"
 
+#include "Meta.h"
 #include "Ptr.h"
 
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace tes
 {
@@ -20,6 +22,64 @@ class Resource;
 class Shape;
 struct ServerInfoMessage;
 
+/// Statistics for a connection which sends data via an asynchronous send queue.
+struct TES_CORE_API SendQueueStats
+{
+  /// Number of bytes currently queued, awaiting sending.
+  uint64_t queued_bytes = 0;
+  /// Peak value of @c queued_bytes .
+  uint64_t peak_queued_bytes = 0;
+  /// Capacity of the send queue (bytes).
+  uint64_t capacity = 0;
+  /// Total number of bytes sent from the queue.
+  uint64_t sent_bytes = 0;
+  /// Number of bytes dropped due to the queue being full.
+  uint64_t dropped_bytes = 0;
+};
+
+/// Statistics for a file stream connection which writes via a background writer thread. See
+/// @c SFBufferedFileWrite .
+struct TES_CORE_API FileWriteStats
+{
+  /// Number of bytes buffered, awaiting writing to disk.
+  uint64_t pending_bytes = 0;
+  /// Peak value of @c pending_bytes .
+  uint64_t peak_pending_bytes = 0;
+  /// Limit on buffered bytes.
+  uint64_t buffer_limit = 0;
+  /// Total number of bytes written to disk.
+  uint64_t written_bytes = 0;
+  /// Number of bytes dropped due to the buffer limit being reached.
+  uint64_t dropped_bytes = 0;
+  /// Number of blocks written to disk.
+  uint64_t block_count = 0;
+  /// Number of times the calling thread blocked waiting for the writer thread.
+  uint64_t stall_count = 0;
+  /// Time taken to write the most recent block (microseconds).
+  uint64_t last_flush_us = 0;
+  /// Longest time taken to write a block (microseconds).
+  uint64_t max_flush_us = 0;
+  /// Total time spent writing blocks (microseconds).
+  uint64_t total_flush_us = 0;
+};
+
+/// Progress of a pending or in flight resource transfer. See @c Connection::resourceTransfers() .
+struct TES_CORE_API ResourceTransferProgress
+{
+  /// The @c Resource::uniqueKey() .
+  uint64_t resource_key = 0;
+  /// The @c Resource::estimateTransferSize() . Zero if unknown.
+  uint64_t estimated_bytes = 0;
+  /// Number of bytes sent so far, excluding the final packet.
+  uint64_t bytes_sent = 0;
+  /// Number of packets sent so far, excluding the final packet.
+  uint32_t packets_sent = 0;
+  /// The transfer priority. See @c Connection::setResourcePriority() .
+  int priority = 0;
+  /// True if the transfer is in flight, false if it has yet to start.
+  bool active = false;
+};
+
 /// Defines the interfaces for a client connection.
 class TES_CORE_API Connection
 {
@@ -84,7 +144,12 @@ public:
   /// Update any pending resource transfers (e.g., mesh transfer).
   ///
   /// Transfer may be amortised by setting a @c byte_limit or enforced by a zero byte limit.
-  /// Zero guarantees all outstanding resources are transferred.
+  /// Zero guarantees all outstanding resources are transferred unless a time budget is set - see
+  /// @c ServerSettings::transfer_time_budget_us .
+  ///
+  /// Several resources may be transferred concurrently with their packets interleaved - see
+  /// @c ServerSettings::transfer_concurrency - so small resources are not held up by large ones.
+  /// Higher priority resources are sent first. See @c setResourcePriority() .
   ///
   /// This method should generally be called once for every @c updateFrame(), normally
   /// before the frame update. This holds especially true when not amortising transfer (zero byte
@@ -123,6 +188,57 @@ public:
   /// @return The resource reference count after adjustment.
   virtual unsigned releaseResource(const ResourcePtr &resource) = 0;
 
+  /// Set the transfer priority of a referenced @p resource which has yet to finish transferring.
+  ///
+  /// Resources with higher priority are started and sent ahead of lower priority resources. The
+  /// default priority is zero, with smaller and more recently referenced resources started first
+  /// within the same priority.
+  ///
+  /// @param resource The resource to prioritise.
+  /// @param priority The priority value. Higher values are sent first.
+  /// @return True if @p resource is awaiting transfer and the priority has been set.
+  virtual bool setResourcePriority(const ResourcePtr &resource, int priority)
+  {
+    TES_UNUSED(resource);
+    TES_UNUSED(priority);
+    return false;
+  }
+
+  /// Query the progress of the pending and in flight resource transfers.
+  ///
+  /// @param[out] transfers Set to the progress of each pending and in flight transfer; in flight
+  ///   transfers first, followed by pending transfers in the order they will start.
+  /// @return True if the connection supports resource transfer and @p transfers has been set.
+  virtual bool resourceTransfers(std::vector<ResourceTransferProgress> &transfers) const
+  {
+    TES_UNUSED(transfers);
+    return false;
+  }
+
+  /// Query statistics for the connection's asynchronous send queue.
+  ///
+  /// Only connections which send from a background thread support this (see @c SFAsyncSend ).
+  ///
+  /// @param[out] stats Set to the current queue statistics on success.
+  /// @return True if the connection has an asynchronous send queue and @p stats has been set.
+  virtual bool sendQueueStats(SendQueueStats &stats) const
+  {
+    TES_UNUSED(stats);
+    return false;
+  }
+
+  /// Query statistics for the connection's background file writer.
+  ///
+  /// Only file stream connections with @c SFBufferedFileWrite support this.
+  ///
+  /// @param[out] stats Set to the current writer statistics on success.
+  /// @return True if the connection has a background file writer and @p stats has been set.
+  virtual bool fileWriteStats(FileWriteStats &stats) const
+  {
+    TES_UNUSED(stats);
+    return false;
+  }
+
   /// Send server details to the client.
   virtual bool sendServerInfo(const ServerInfoMessage &info) = 0;
 
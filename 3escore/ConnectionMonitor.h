@@ -149,6 +149,20 @@ public:
   /// @return A pointer to a @c Connection object which represents the file stream.
   virtual std::shared_ptr<Connection> openFileStream(const std::string &file_path) = 0;
 
+  /// Listen for viewers on the same host via a @c SharedMemoryRing called @p name .
+  ///
+  /// A viewer attaching to the ring becomes a new connection, detected like a TCP connection by
+  /// @c monitorConnections() or the monitor thread. A new ring is then created under the same
+  /// name for the next viewer. The ring capacity is set by
+  /// @c ServerSettings::shared_memory_size .
+  ///
+  /// Listening stops along with TCP listening - see @c stop() .
+  ///
+  /// @param name The shared memory object name.
+  /// @return True if the ring has been created. False if shared memory is not supported on this
+  ///   platform or @p name is already in use.
+  virtual bool openSharedMemory(const std::string &name) = 0;
+
   /// Sets the callback invoked for each new connection.
   ///
   /// This is invoked from @p commitConnections() for each new connection.
@@ -77,6 +77,14 @@ enum class Version : int
 /// Use ZLIB when defined.
 #cmakedefine TES_ZLIB
 
+/// @def TES_LZ4
+/// Use LZ4 when defined.
+#cmakedefine TES_LZ4
+
+/// @def TES_ZSTD
+/// Use Zstandard when defined.
+#cmakedefine TES_ZSTD
+
 // Define the local Endian and the network Endian
 #define TES_IS_BIG_ENDIAN @TES_IS_BIG_ENDIAN@ // NOLINT(modernize-macro-to-enum)
 #define TES_IS_NETWORK_ENDIAN @TES_IS_BIG_ENDIAN@ // NOLINT(modernize-macro-to-enum)
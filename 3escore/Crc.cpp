@@ -3,11 +3,16 @@
 //
 #include "Crc.h"
 
+#include <algorithm>
 #include <array>
 
 namespace tes
 {
 // Crc code taken from http://www.barrgroup.com/Embedded-Systems/How-To/CRC-Calculation-C-Code
+//
+// Extended to use slicing-by-8: additional tables hold the remainder contribution of a byte
+// followed by 1-7 zero bytes, so 8 message bytes are folded into the remainder per iteration using
+// independent table lookups.
 template <typename CRC>
 class CrcCalc
 {
@@ -15,16 +20,27 @@ public:
   CrcCalc(CRC initial_remainder, CRC final_xor_value, CRC polynomial) noexcept;
 
   CRC crc(const uint8_t *message, size_t byte_count) const;
+  /// Continue the CRC from the result for preceding bytes.
+  CRC crc(const uint8_t *message, size_t byte_count, CRC previous_crc) const;
 
   inline CRC operator()(const uint8_t *message, size_t byte_count) const
   {
     return crc(message, byte_count);
   }
 
+  inline CRC operator()(const uint8_t *message, size_t byte_count, CRC previous_crc) const
+  {
+    return crc(message, byte_count, previous_crc);
+  }
+
 private:
+  static constexpr unsigned kSlices = 8;
+
   CRC _initial_remainder;
   CRC _final_xor_value;
-  std::array<CRC, 256> _crc_table;
+  /// Slicing tables. @c _crc_table[0] is the classic byte-at-a-time table. @c _crc_table[k] is the
+  /// remainder for a byte followed by @c k zero bytes.
+  std::array<std::array<CRC, 256>, kSlices> _crc_table;
 
   void initTable(CRC polynomial) noexcept;
 
@@ -44,16 +60,46 @@ CrcCalc<CRC>::CrcCalc(CRC initial_remainder, CRC final_xor_value, CRC polynomial
 
 template <typename CRC>
 CRC CrcCalc<CRC>::crc(const uint8_t *message, size_t byte_count) const
+{
+  return crc(message, byte_count, static_cast<CRC>(_initial_remainder ^ _final_xor_value));
+}
+
+
+template <typename CRC>
+CRC CrcCalc<CRC>::crc(const uint8_t *message, size_t byte_count, CRC previous_crc) const
 {
   uint8_t data;
-  CRC remainder = _initial_remainder;
+  // Undo the final XOR to recover the remainder.
+  CRC remainder = static_cast<CRC>(previous_crc ^ _final_xor_value);
+
+  // Divide the message by the polynomial, 8 bytes at a time. The remainder is folded into the
+  // leading bytes of each block (most significant byte first).
+  std::array<uint8_t, kSlices> block;
+  while (byte_count >= kSlices)
+  {
+    std::copy(message, message + kSlices, block.begin());
+    for (unsigned i = 0; i < sizeof(CRC); ++i)
+    {
+      // NOLINTNEXTLINE(hicpp-signed-bitwise)
+      block[i] = static_cast<uint8_t>(block[i] ^ (remainder >> (kWidth - 8u * (i + 1))));
+    }
+
+    remainder = 0;
+    for (unsigned i = 0; i < kSlices; ++i)
+    {
+      remainder = static_cast<CRC>(remainder ^ _crc_table[kSlices - 1 - i][block[i]]);
+    }
+
+    message += kSlices;
+    byte_count -= kSlices;
+  }
 
-  // Divide the message by the polynomial, a byte at a time.
+  // Remaining bytes, a byte at a time.
   for (size_t byte = 0u; byte < byte_count; ++byte)
   {
     // NOLINTBEGIN(hicpp-signed-bitwise)
     data = static_cast<uint8_t>(message[byte] ^ (remainder >> (kWidth - 8u)));
-    remainder = static_cast<CRC>(_crc_table[data] ^ (remainder << 8u));
+    remainder = static_cast<CRC>(_crc_table[0][data] ^ (remainder << 8u));
     // NOLINTEND(hicpp-signed-bitwise)
   }
 
@@ -68,7 +114,7 @@ void CrcCalc<CRC>::initTable(CRC polynomial) noexcept
   CRC remainder = 0;
 
   // Compute the remainder of each possible dividend.
-  for (unsigned dividend = 0; dividend < _crc_table.size(); ++dividend)
+  for (unsigned dividend = 0; dividend < _crc_table[0].size(); ++dividend)
   {
     // Start with the dividend followed by zeros.
     remainder = static_cast<CRC>(dividend << (kWidth - 8u));
@@ -89,7 +135,20 @@ void CrcCalc<CRC>::initTable(CRC polynomial) noexcept
     }
 
     // Store the result into the table.
-    _crc_table[dividend] = remainder;
+    _crc_table[0][dividend] = remainder;
+  }
+
+  // Extend each table entry by a zero byte to generate the next slice.
+  for (unsigned slice = 1; slice < kSlices; ++slice)
+  {
+    for (unsigned dividend = 0; dividend < _crc_table[slice].size(); ++dividend)
+    {
+      remainder = _crc_table[slice - 1][dividend];
+      // NOLINTBEGIN(hicpp-signed-bitwise)
+      _crc_table[slice][dividend] = static_cast<CRC>(
+        _crc_table[0][static_cast<uint8_t>(remainder >> (kWidth - 8u))] ^ (remainder << 8u));
+      // NOLINTEND(hicpp-signed-bitwise)
+    }
   }
 }
 
@@ -111,8 +170,20 @@ uint16_t crc16(const uint8_t *message, size_t byte_count)
 }
 
 
+uint16_t crc16(const uint8_t *message, size_t byte_count, uint16_t previous_crc)
+{
+  return kCrc16(message, byte_count, previous_crc);
+}
+
+
 uint32_t crc32(const uint8_t *message, size_t byte_count)
 {
   return kCrc32(message, byte_count);
 }
+
+
+uint32_t crc32(const uint8_t *message, size_t byte_count, uint32_t previous_crc)
+{
+  return kCrc32(message, byte_count, previous_crc);
+}
 }  // namespace tes
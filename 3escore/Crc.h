@@ -22,11 +22,29 @@ uint8_t TES_CORE_API crc8(const uint8_t *message, size_t byte_count);
 /// @return An 16-bit CRC for @c message.
 uint16_t TES_CORE_API crc16(const uint8_t *message, size_t byte_count);
 
+/// Continue a 16-bit CRC calculation for a message split across multiple buffers.
+///
+/// The CRC of the whole message is calculated by passing the result for each buffer as
+/// @p previous_crc for the next buffer.
+/// @param message The next buffer of the message.
+/// @param byte_count The number of bytes in @p message.
+/// @param previous_crc The CRC calculated for the preceding buffers.
+/// @return An 16-bit CRC for the message up to and including @c message.
+uint16_t TES_CORE_API crc16(const uint8_t *message, size_t byte_count, uint16_t previous_crc);
+
 /// Calculate an 32-bit CRC value.
 /// @param message The buffer to operate on.
 /// @param byte_count The number of bytes in @p message.
 /// @return An 32-bit CRC for @c message.
 uint32_t TES_CORE_API crc32(const uint8_t *message, size_t byte_count);
+
+/// Continue a 32-bit CRC calculation for a message split across multiple buffers. See
+/// @c crc16(const uint8_t *, size_t, uint16_t) .
+/// @param message The next buffer of the message.
+/// @param byte_count The number of bytes in @p message.
+/// @param previous_crc The CRC calculated for the preceding buffers.
+/// @return An 32-bit CRC for the message up to and including @c message.
+uint32_t TES_CORE_API crc32(const uint8_t *message, size_t byte_count, uint32_t previous_crc);
 }  // namespace tes
 
 #endif  // TES_CORE_CRC_H
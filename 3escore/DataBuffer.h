@@ -18,6 +18,7 @@
 #include <array>
 #include <cinttypes>
 #include <memory>
+#include <type_traits>
 #include <utility>
 
 #define STREAM_TYPE_INFO(_type, _type_name) \
@@ -713,7 +714,8 @@ public:
   /// @param element_size The size of each data element to transfer.
   /// @param overhead Byte overhead for a single transfer packet (headers etc), which effectively
   /// reduces the @c byte_limit.
-  /// @param byte_limit Maximum number of bytes which can be transferred.
+  /// @param byte_limit Maximum number of bytes which can be transferred. Limits above
+  /// @c kPacketMaxPayloadSize assume an extended packet - see @c PFExtended .
   /// @return The maximum number of elements which can be packed into a single network packet.
   [[nodiscard]] static uint16_t estimateTransferCount(size_t element_size, unsigned overhead,
                                                       unsigned byte_limit);
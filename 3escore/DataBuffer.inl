@@ -288,6 +288,15 @@ inline const T *DataBuffer::ptrAt(size_t element_index) const
 inline uint16_t DataBuffer::estimateTransferCount(size_t element_size, unsigned overhead,
                                                   unsigned byte_limit)
 {
+  if (byte_limit > kPacketMaxPayloadSize)
+  {
+    // Only an extended packet can hold this many bytes (see PFExtended). The limit becomes the
+    // 16-bit element count.
+    const size_t count =
+      (byte_limit - (overhead + sizeof(PacketWriter::CrcType))) / element_size;
+    return static_cast<uint16_t>(std::min<size_t>(count, 0xffffu));
+  }
+
   // FIXME: Without additional overhead padding I was getting missing messages at the client with
   // no obvious error path. For this reason, we use 0xff00u, instead of 0xffffu
   //           packet header           message                 crc
@@ -398,6 +407,7 @@ uint32_t DataBufferAffordancesT<T>::writeAs(PacketWriter &packet, uint32_t offse
 
   byte_limit =
     (byte_limit) ? (byte_limit > overhead ? byte_limit - overhead : 0) : packet.bytesRemaining();
+  byte_limit = std::min(byte_limit, packet.bytesRemaining());
   uint16_t transfer_count = DataBuffer::estimateTransferCount(item_size, overhead, byte_limit);
   if (transfer_count > stream.count() - offset)
   {
@@ -431,20 +441,28 @@ uint32_t DataBufferAffordancesT<T>::writeAs(PacketWriter &packet, uint32_t offse
   }
   else
   {
-    // We have either a striding mismatch or a type mismatch. Componentwise write
+    // We have either a striding mismatch or a type mismatch. Convert componentwise into a block,
+    // then write each block as an array so the byte order is swapped in bulk.
+    constexpr size_t kBlockSize = 256;  // NOLINT(readability-magic-numbers)
+    std::array<WriteType, kBlockSize> block;
+    size_t block_count = 0;
+    size_t component_write_count = 0;
     for (unsigned i = 0; i < transfer_count; ++i)
     {
-      unsigned component_write_count = 0;
       for (unsigned j = 0; j < stream.componentCount(); ++j)
       {
         // NOLINTNEXTLINE(bugprone-signed-char-misuse)
-        const auto dst_value = static_cast<WriteType>(src[j]);
-        component_write_count +=
-          static_cast<unsigned>(packet.writeElement(dst_value) / sizeof(dst_value));
+        block[block_count++] = static_cast<WriteType>(src[j]);
+        if (block_count == block.size())
+        {
+          component_write_count += packet.writeArray(block.data(), block_count);
+          block_count = 0;
+        }
       }
-      write_count += component_write_count / stream.componentCount();
       src += stream.elementStride();
     }
+    component_write_count += packet.writeArray(block.data(), block_count);
+    write_count += static_cast<unsigned>(component_write_count / stream.componentCount());
   }
 
   if (write_count == transfer_count)
@@ -486,7 +504,8 @@ uint32_t DataBufferAffordancesT<T>::writeAsPacked(PacketWriter &packet, uint32_t
                        sizeof(quantisation_unit) +                    // quantisation_unit
                        sizeof(FloatType) * stream.componentCount());  // packet_origin
 
-  byte_limit = (byte_limit) ? byte_limit : packet.bytesRemaining();
+  byte_limit =
+    (byte_limit) ? std::min(byte_limit, packet.bytesRemaining()) : packet.bytesRemaining();
   uint16_t transfer_count = DataBuffer::estimateTransferCount(item_size, overhead, byte_limit);
   if (transfer_count > stream.count() - offset)
   {
@@ -767,20 +786,35 @@ uint32_t DataBufferAffordancesT<T>::readAs(PacketReader &packet, unsigned offset
 {
   T *dst = static_cast<T *>(*stream_ptr);
   dst += offset * component_count;
-  ReadType read_value = {};
+  const size_t total_components = static_cast<size_t>(count) * component_count;
 
-  for (unsigned i = 0; i < count; ++i)
+  if constexpr (std::is_same_v<T, ReadType>)
   {
-    for (unsigned j = 0; j < component_count; ++j)
+    // Matching types: read directly into the (densely packed) stream.
+    if (packet.readArray(dst, total_components) != total_components)
     {
-      if (packet.readElement(read_value) != sizeof(read_value))
+      return 0;
+    }
+  }
+  else
+  {
+    // Read and swap in blocks, then convert.
+    constexpr size_t kBlockSize = 256;  // NOLINT(readability-magic-numbers)
+    std::array<ReadType, kBlockSize> block;
+    for (size_t read_components = 0; read_components < total_components;)
+    {
+      const size_t block_count = std::min(block.size(), total_components - read_components);
+      if (packet.readArray(block.data(), block_count) != block_count)
       {
         return 0;
       }
-      // NOLINTNEXTLINE(bugprone-signed-char-misuse)
-      dst[j] = static_cast<T>(read_value);
+      for (size_t i = 0; i < block_count; ++i)
+      {
+        // NOLINTNEXTLINE(bugprone-signed-char-misuse)
+        dst[read_components + i] = static_cast<T>(block[i]);
+      }
+      read_components += block_count;
     }
-    dst += component_count;
   }
 
   return count;
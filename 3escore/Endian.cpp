@@ -3,6 +3,7 @@
 //
 #include "Endian.h"
 
+#include <array>
 #include <cstdlib>
 #include <cstring>
 
@@ -10,8 +11,150 @@
 #include <malloc.h>
 #endif  // WIN32
 
+// Select the byte swap kernels from the instruction sets enabled for this compilation unit.
+// MSVC does not define __SSSE3__, but /arch:AVX2 implies it.
+#if defined(__AVX2__)
+#define TES_ENDIAN_AVX2 1
+#define TES_ENDIAN_SSSE3 1
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#define TES_ENDIAN_SSSE3 1
+#include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TES_ENDIAN_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TES_ENDIAN_NEON 1
+#include <arm_neon.h>
+#endif
+
 namespace tes
 {
+namespace
+{
+/// Scalar swap for the trailing elements which do not fill a vector register.
+template <size_t ElementSize>
+void swapCopyScalar(uint8_t *dst, const uint8_t *src, size_t element_count)
+{
+  for (size_t i = 0; i < element_count; ++i, dst += ElementSize, src += ElementSize)
+  {
+    std::array<uint8_t, ElementSize> element;
+    std::memcpy(element.data(), src, ElementSize);
+    for (size_t j = 0; j < ElementSize; ++j)
+    {
+      dst[j] = element[ElementSize - 1 - j];
+    }
+  }
+}
+
+#if defined(TES_ENDIAN_SSSE3)
+/// Build the @c pshufb mask reversing each @p ElementSize byte element within a 16 byte lane.
+template <size_t ElementSize>
+__m128i shuffleMask()
+{
+  alignas(16) std::array<uint8_t, 16> mask;  // NOLINT(readability-magic-numbers)
+  for (size_t i = 0; i < mask.size(); ++i)
+  {
+    mask[i] =
+      static_cast<uint8_t>((i / ElementSize) * ElementSize + (ElementSize - 1 - i % ElementSize));
+  }
+  return _mm_load_si128(reinterpret_cast<const __m128i *>(mask.data()));
+}
+#elif defined(TES_ENDIAN_SSE2)
+/// Swap the bytes of each 16-bit word in @p v .
+inline __m128i swapWords(__m128i v)
+{
+  return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+/// SSE2 only byte swap: reorder 16-bit words with @c pshuflw / @c pshufhw then swap the bytes
+/// within each word.
+template <size_t ElementSize>
+__m128i swapVector(__m128i v);
+
+template <>
+inline __m128i swapVector<2>(__m128i v)
+{
+  return swapWords(v);
+}
+
+template <>
+inline __m128i swapVector<4>(__m128i v)
+{
+  // NOLINTNEXTLINE(hicpp-signed-bitwise)
+  v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+  return swapWords(v);
+}
+
+template <>
+inline __m128i swapVector<8>(__m128i v)
+{
+  // NOLINTNEXTLINE(hicpp-signed-bitwise)
+  v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+  return swapWords(v);
+}
+#elif defined(TES_ENDIAN_NEON)
+template <size_t ElementSize>
+uint8x16_t swapVector(uint8x16_t v);
+
+template <>
+inline uint8x16_t swapVector<2>(uint8x16_t v)
+{
+  return vrev16q_u8(v);
+}
+
+template <>
+inline uint8x16_t swapVector<4>(uint8x16_t v)
+{
+  return vrev32q_u8(v);
+}
+
+template <>
+inline uint8x16_t swapVector<8>(uint8x16_t v)
+{
+  return vrev64q_u8(v);
+}
+#endif
+
+/// Copy and swap @p element_count elements from @p src to @p dst , vectorised where possible.
+/// Each vector block is fully loaded before it is stored, so @p dst may equal @p src .
+template <size_t ElementSize>
+void swapCopy(uint8_t *dst, const uint8_t *src, size_t element_count)
+{
+  const size_t byte_count = element_count * ElementSize;
+  size_t i = 0;
+#if defined(TES_ENDIAN_SSSE3)
+  const __m128i mask = shuffleMask<ElementSize>();
+#if defined(TES_ENDIAN_AVX2)
+  const __m256i mask256 = _mm256_broadcastsi128_si256(mask);
+  for (; i + sizeof(__m256i) <= byte_count; i += sizeof(__m256i))
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(v, mask256));
+  }
+#endif  // TES_ENDIAN_AVX2
+  for (; i + sizeof(__m128i) <= byte_count; i += sizeof(__m128i))
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_shuffle_epi8(v, mask));
+  }
+#elif defined(TES_ENDIAN_SSE2)
+  for (; i + sizeof(__m128i) <= byte_count; i += sizeof(__m128i))
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), swapVector<ElementSize>(v));
+  }
+#elif defined(TES_ENDIAN_NEON)
+  for (; i + sizeof(uint8x16_t) <= byte_count; i += sizeof(uint8x16_t))
+  {
+    vst1q_u8(dst + i, swapVector<ElementSize>(vld1q_u8(src + i)));
+  }
+#endif
+  swapCopyScalar<ElementSize>(dst + i, src + i, (byte_count - i) / ElementSize);
+}
+}  // namespace
+
+
 void endianSwap(uint8_t *data, size_t size)
 {
   auto *data_copy = reinterpret_cast<uint8_t *>(alloca(size));
@@ -24,4 +167,45 @@ void endianSwap(uint8_t *data, size_t size)
     data[index_b] = data_copy[index_a];
   }
 }
+
+
+void endianSwapArray(uint8_t *data, size_t element_size, size_t element_count)
+{
+  endianSwapCopy(data, data, element_size, element_count);
+}
+
+
+void endianSwapCopy(uint8_t *dst, const uint8_t *src, size_t element_size, size_t element_count)
+{
+  switch (element_size)
+  {
+  case 0:
+    break;
+  case 1:
+    if (dst != src)
+    {
+      std::memcpy(dst, src, element_count);
+    }
+    break;
+  case 2:
+    swapCopy<2>(dst, src, element_count);
+    break;
+  case 4:
+    swapCopy<4>(dst, src, element_count);
+    break;
+  case 8:  // NOLINT(readability-magic-numbers)
+    swapCopy<8>(dst, src, element_count);  // NOLINT(readability-magic-numbers)
+    break;
+  default:
+    if (dst != src)
+    {
+      std::memcpy(dst, src, element_size * element_count);
+    }
+    for (size_t i = 0; i < element_count; ++i, dst += element_size)
+    {
+      endianSwap(dst, element_size);
+    }
+    break;
+  }
+}
 }  // namespace tes
@@ -17,6 +17,32 @@ namespace tes
 /// @param size The number of bytes in @p data.
 void TES_CORE_API endianSwap(uint8_t *data, size_t size);
 
+/// Perform an Endian swap on each element of an array of @p element_count elements, each
+/// @p element_size bytes.
+///
+/// Two, four and eight byte elements are swapped using vectorised kernels where available: AVX2 or
+/// SSSE3 byte shuffles when enabled by the compiler flags (e.g., @c -mavx2 ), SSE2 shifts and word
+/// shuffles on any x86_64 target and NEON byte reversal on ARM. Other element sizes swap
+/// each element using @c endianSwap(uint8_t*,size_t) .
+///
+/// @param data The array to modify.
+/// @param element_size The byte size of each element.
+/// @param element_count The number of elements in @p data .
+void TES_CORE_API endianSwapArray(uint8_t *data, size_t element_size, size_t element_count);
+
+/// Copy an array of @p element_count elements, each @p element_size bytes, from @p src to @p dst
+/// and reverse the byte order of each element.
+///
+/// This is equivalent to a @c memcpy() followed by @c endianSwapArray() on @p dst , but only makes
+/// a single pass over the data. @p dst and @p src may be the same, but must not otherwise overlap.
+///
+/// @param dst The destination array. Must have at least `element_size * element_count` bytes.
+/// @param src The source array.
+/// @param element_size The byte size of each element.
+/// @param element_count The number of elements to copy.
+void TES_CORE_API endianSwapCopy(uint8_t *dst, const uint8_t *src, size_t element_size,
+                                 size_t element_count);
+
 /// A 1-byte value Endian swap: noop.
 /// For completeness.
 /// @param data The 1-byte buffer.
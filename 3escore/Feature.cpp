@@ -43,6 +43,18 @@ bool checkFeatureFlag(uint64_t feature_flag)
 #endif  // TES_ZLIB
     break;
 
+  case (1ull << TFeatureCompressionLz4):
+#ifdef TES_LZ4
+    return true;
+#endif  // TES_LZ4
+    break;
+
+  case (1ull << TFeatureCompressionZstd):
+#ifdef TES_ZSTD
+    return true;
+#endif  // TES_ZSTD
+    break;
+
   default:
     break;
   }
@@ -15,8 +15,12 @@ namespace tes
 /// See @c checkFeature().
 enum Feature : unsigned
 {
-  /// Is compression is available.
+  /// Is compression is available. This is deflate compression via zlib (@c CCDeflate ).
   TFeatureCompression,
+  /// Is LZ4 compression (@c CCLz4 ) available.
+  TFeatureCompressionLz4,
+  /// Is Zstandard compression (@c CCZstd ) available.
+  TFeatureCompressionZstd,
 
   /// Notes the number of valid feature values.
   /// While @c TFeatureLimit shows the maximum possible features we can track,
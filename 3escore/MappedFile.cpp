@@ -0,0 +1,91 @@
+//
+// author: Kazys Stepanas
+//
+#include "MappedFile.h"
+
+#include <limits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TES_MAPPED_FILE_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // defined(__unix__) || defined(__APPLE__)
+
+namespace tes
+{
+MappedFile::MappedFile() = default;
+
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+
+bool MappedFile::supported()
+{
+#ifdef TES_MAPPED_FILE_POSIX
+  return true;
+#else   // TES_MAPPED_FILE_POSIX
+  return false;
+#endif  // TES_MAPPED_FILE_POSIX
+}
+
+
+bool MappedFile::open(const std::string &path)
+{
+  close();
+
+#ifdef TES_MAPPED_FILE_POSIX
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+  {
+    return false;
+  }
+
+  struct stat info = {};
+  void *mapping = MAP_FAILED;
+  uint64_t size = 0;
+  if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 &&
+      static_cast<uint64_t>(info.st_size) <= std::numeric_limits<size_t>::max())
+  {
+    size = static_cast<uint64_t>(info.st_size);
+    mapping = ::mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  // The mapping remains valid after closing the descriptor.
+  ::close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    return false;
+  }
+
+  // Playback is mostly sequential. Failure to advise is harmless.
+  ::madvise(mapping, static_cast<size_t>(size), MADV_SEQUENTIAL);
+
+  _data = static_cast<const uint8_t *>(mapping);
+  _size = size;
+  return true;
+#else   // TES_MAPPED_FILE_POSIX
+  (void)path;
+  return false;
+#endif  // TES_MAPPED_FILE_POSIX
+}
+
+
+void MappedFile::close()
+{
+  if (!_data)
+  {
+    return;
+  }
+
+#ifdef TES_MAPPED_FILE_POSIX
+  ::munmap(const_cast<uint8_t *>(_data), static_cast<size_t>(_size));
+#endif  // TES_MAPPED_FILE_POSIX
+  _data = nullptr;
+  _size = 0;
+}
+}  // namespace tes
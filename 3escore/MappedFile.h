@@ -0,0 +1,60 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_MAPPED_FILE_H
+#define TES_CORE_MAPPED_FILE_H
+
+#include "CoreConfig.h"
+
+#include <cstdint>
+#include <string>
+
+namespace tes
+{
+/// A read only memory mapping of a whole file.
+///
+/// Used to read recordings in place without copying through a stream buffer. Mapping is only
+/// supported on POSIX platforms; see @c supported() . Callers should fall back to regular file
+/// streams when @c open() fails.
+class TES_CORE_API MappedFile
+{
+public:
+  /// Constructor.
+  MappedFile();
+  /// Destructor. Calls @c close() .
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /// Check if file mapping is supported on this platform.
+  /// @return True if supported.
+  [[nodiscard]] static bool supported();
+
+  /// Map the file at @p path for reading. The mapping is advised for sequential access.
+  /// @param path The file to map.
+  /// @return True on success. Fails for empty files or when mapping is not supported.
+  bool open(const std::string &path);
+
+  /// Unmap the file. Safe to call when not open.
+  void close();
+
+  /// Check if a file is mapped.
+  /// @return True when mapped.
+  [[nodiscard]] bool isOpen() const { return _data != nullptr; }
+
+  /// Access the mapped file content.
+  /// @return The mapped bytes, or null when not open.
+  [[nodiscard]] const uint8_t *data() const { return _data; }
+
+  /// Query the mapped byte count.
+  /// @return The file size when mapped, or zero when not open.
+  [[nodiscard]] uint64_t size() const { return _size; }
+
+private:
+  const uint8_t *_data = nullptr;
+  uint64_t _size = 0;
+};
+}  // namespace tes
+
+#endif  // TES_CORE_MAPPED_FILE_H
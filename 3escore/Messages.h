@@ -36,6 +36,8 @@ enum MessageTypeIDs : unsigned
   MtCategory,
   /// Extension. NYI.
   MtMaterial,
+  /// Frame offset index appended to recorded streams. See @c FrameIndexMessageId .
+  MtFrameIndex,
 
   /// First ID for renderers.
   ShapeHandlersIDStart = 64,
@@ -87,15 +89,30 @@ enum ControlId : unsigned
   /// for internal use in playback mode. The @c value32 is used to identify the
   /// frame number to which we are resetting.
   CIdReset,
-  /// Request a keyframe. @c value32 is the frame number. This is not for remote
+  /// Marks a keyframe; a snapshot of the scene at the end of frame @c value32 .
   /// This is not for remote transmission, but supports snapping the scene in
-  /// order to improve step-back updates.transmission, but supports snapping the
-  /// scene in order to improve step-back updates.
+  /// order to improve step-back updates. In a keyframe file, @c value64 is the
+  /// recording offset immediately after the frame and the snapshot messages
+  /// follow up to a @c CIdEnd message.
   CIdKeyframe,
   /// Marks the end of the server stream. Clients may disconnect.
   CIdEnd,
 };
 
+/// Message IDs for @c MtFrameIndex routing.
+///
+/// A frame index may be appended to a recorded stream when it is finalised. It consists of one or
+/// more @c FIIdOffsets packets followed by a single @c FIIdLocator packet which is always the last
+/// packet in the stream. The locator has a fixed size so it can be read from the end of the
+/// stream, then used to find the offsets. See @c streamutil::writeFrameIndex() .
+enum FrameIndexMessageId : unsigned
+{
+  /// A block of frame offsets. See @c FrameIndexMessage .
+  FIIdOffsets,
+  /// Locates the frame index. See @c FrameIndexLocatorMessage .
+  FIIdLocator,
+};
+
 /// Message IDs for @c MtCategory routing.
 enum CategoryMessageId : unsigned
 {
@@ -194,6 +211,19 @@ enum UpdateFlag : unsigned
 enum CollatedPacketFlag : unsigned
 {
   CPFCompress = (1u << 0u),
+  /// Set with @c CPFCompress when the payload is a zlib stream primed with the preset collation
+  /// dictionary rather than a GZip stream. See @c SIFCompressionDictionary.
+  CPFCompressDictionary = (1u << 1u),
+};
+
+/// Flags for @c ServerInfoMessage::flags .
+enum ServerInfoFlag : unsigned
+{
+  /// The server may compress collated packets using the preset collation dictionary. Clients must
+  /// support @c CPFCompressDictionary to decode such packets.
+  SIFCompressionDictionary = (1u << 0u),
+  /// The server writes packet payloads in little endian byte order, marked by @c PFLittleEndian .
+  SIFLittleEndian = (1u << 1u),
 };
 
 /// Flags for various @c ControlId messages.
@@ -252,9 +282,13 @@ struct TES_CORE_API ServerInfoMessage
   ///
   /// The default is @c XYZ.
   uint8_t coordinate_frame;
+  /// @c ServerInfoFlag values advertising stream features to the client.
+  ///
+  /// The default is zero.
+  uint16_t flags;
   /// Reserved for future use. Must be zero.
   /// Aiming to pad out to a total of 64-bytes in the packet.
-  uint8_t reserved[35];  // NOLINT(readability-magic-numbers)
+  uint8_t reserved[33];  // NOLINT(readability-magic-numbers)
 
   /// Read this message from @p reader.
   /// @param reader The data source.
@@ -265,6 +299,7 @@ struct TES_CORE_API ServerInfoMessage
     ok = reader.readElement(time_unit) == sizeof(time_unit) && ok;
     ok = reader.readElement(default_frame_time) == sizeof(default_frame_time) && ok;
     ok = reader.readElement(coordinate_frame) == sizeof(coordinate_frame) && ok;
+    ok = reader.readElement(flags) == sizeof(flags) && ok;
     ok = reader.readArray(reserved, sizeof(reserved) / sizeof(reserved[0])) ==
            sizeof(reserved) / sizeof(reserved[0]) &&
          ok;
@@ -280,6 +315,7 @@ struct TES_CORE_API ServerInfoMessage
     ok = writer.writeElement(time_unit) == sizeof(time_unit) && ok;
     ok = writer.writeElement(default_frame_time) == sizeof(default_frame_time) && ok;
     ok = writer.writeElement(coordinate_frame) == sizeof(coordinate_frame) && ok;
+    ok = writer.writeElement(flags) == sizeof(flags) && ok;
     ok = writer.writeArray(reserved, sizeof(reserved) / sizeof(reserved[0])) ==
            sizeof(reserved) / sizeof(reserved[0]) &&
          ok;
@@ -326,6 +362,95 @@ struct TES_CORE_API ControlMessage
   }
 };
 
+/// Frame index offsets message header; @c FIIdOffsets .
+///
+/// The header is followed by @c offset_count @c uint64_t stream offsets. The offset for frame
+/// @c first_frame + i is the byte offset immediately after the packet containing the
+/// @c CIdFrame message which ends that frame. That is, where a reader resumes after processing
+/// that many frames. Frame numbers start at 1.
+struct TES_CORE_API FrameIndexMessage
+{
+  /// ID for this message.
+  enum : unsigned
+  {
+    MessageId = FIIdOffsets
+  };
+  /// Maximum number of offsets written in a single message.
+  static constexpr uint16_t kMaxOffsets = 4096u;
+
+  /// The frame number for the first offset.
+  uint32_t first_frame;
+  /// Number of offsets which follow.
+  uint16_t offset_count;
+  /// Reserved. Must be zero.
+  uint16_t reserved;
+
+  /// Read this message header from @p reader.
+  /// @param reader The data source.
+  /// @return True on success.
+  inline bool read(PacketReader &reader)
+  {
+    bool ok = true;
+    ok = reader.readElement(first_frame) == sizeof(first_frame) && ok;
+    ok = reader.readElement(offset_count) == sizeof(offset_count) && ok;
+    ok = reader.readElement(reserved) == sizeof(reserved) && ok;
+    return ok;
+  }
+
+  /// Write this message header to @p writer.
+  /// @param writer The target buffer.
+  /// @return True on success.
+  inline bool write(PacketWriter &writer) const
+  {
+    bool ok = true;
+    ok = writer.writeElement(first_frame) == sizeof(first_frame) && ok;
+    ok = writer.writeElement(offset_count) == sizeof(offset_count) && ok;
+    ok = writer.writeElement(reserved) == sizeof(reserved) && ok;
+    return ok;
+  }
+};
+
+/// Frame index locator message; @c FIIdLocator . Always the last packet in an indexed stream.
+struct TES_CORE_API FrameIndexLocatorMessage
+{
+  /// ID for this message.
+  enum : unsigned
+  {
+    MessageId = FIIdLocator
+  };
+
+  /// Stream offset of the first @c FIIdOffsets packet.
+  uint64_t index_offset;
+  /// Total number of indexed frames.
+  uint32_t frame_count;
+  /// Number of @c FIIdOffsets packets.
+  uint32_t packet_count;
+
+  /// Read this message from @p reader.
+  /// @param reader The data source.
+  /// @return True on success.
+  inline bool read(PacketReader &reader)
+  {
+    bool ok = true;
+    ok = reader.readElement(index_offset) == sizeof(index_offset) && ok;
+    ok = reader.readElement(frame_count) == sizeof(frame_count) && ok;
+    ok = reader.readElement(packet_count) == sizeof(packet_count) && ok;
+    return ok;
+  }
+
+  /// Write this message to @p writer.
+  /// @param writer The target buffer.
+  /// @return True on success.
+  inline bool write(PacketWriter &writer) const
+  {
+    bool ok = true;
+    ok = writer.writeElement(index_offset) == sizeof(index_offset) && ok;
+    ok = writer.writeElement(frame_count) == sizeof(frame_count) && ok;
+    ok = writer.writeElement(packet_count) == sizeof(packet_count) && ok;
+    return ok;
+  }
+};
+
 /// Category name message.
 struct TES_CORE_API CategoryNameMessage
 {
@@ -401,8 +526,9 @@ struct TES_CORE_API CollatedPacketMessage
 {
   /// Message flags. See @c CollatedPacketFlag.
   uint16_t flags;
-  /// Reserved: must be zero.
-  uint16_t reserved;
+  /// The @c CompressionCodec used with @c CPFCompress . Must be zero (@c CCDeflate ) when the
+  /// payload is not compressed.
+  uint16_t codec;
   /// Number of uncompressed bytes in the payload.
   uint32_t uncompressed_bytes;
 
@@ -413,7 +539,7 @@ struct TES_CORE_API CollatedPacketMessage
   {
     bool ok = true;
     ok = reader.readElement(flags) == sizeof(flags) && ok;
-    ok = reader.readElement(reserved) == sizeof(reserved) && ok;
+    ok = reader.readElement(codec) == sizeof(codec) && ok;
     ok = reader.readElement(uncompressed_bytes) == sizeof(uncompressed_bytes) && ok;
     return ok;
   }
@@ -425,7 +551,7 @@ struct TES_CORE_API CollatedPacketMessage
   {
     bool ok = true;
     ok = writer.writeElement(flags) == sizeof(flags) && ok;
-    ok = writer.writeElement(reserved) == sizeof(reserved) && ok;
+    ok = writer.writeElement(codec) == sizeof(codec) && ok;
     ok = writer.writeElement(uncompressed_bytes) == sizeof(uncompressed_bytes) && ok;
     return ok;
   }
@@ -9,7 +9,7 @@
 
 #include <algorithm>
 #include <cstring>
-#include <iterator>
+#include <limits>
 
 namespace tes
 {
@@ -27,38 +27,50 @@ struct MarkerBytes
 
   [[nodiscard]] uint8_t operator[](size_t idx) const { return bytes[idx]; }
   [[nodiscard]] size_t size() const { return bytes.size(); }
+  [[nodiscard]] const uint8_t *data() const { return bytes.data(); }
 };
 
-int packetMarkerPosition(const uint8_t *bytes, size_t byte_count)
+constexpr size_t kMarkerSize = sizeof(kPacketMarker);
+
+const MarkerBytes &packetMarker()
 {
-  thread_local const MarkerBytes packet_marker;
+  static const MarkerBytes packet_marker;
+  return packet_marker;
+}
 
-  for (size_t i = 0; i < byte_count; i += 4)
+/// Find the first complete packet marker in @p bytes .
+///
+/// Uses @c memchr() to find candidate marker bytes, which the standard library vectorises, then
+/// checks the remaining marker bytes.
+///
+/// @return The marker offset, or @p byte_count when not found.
+size_t packetMarkerPosition(const uint8_t *bytes, size_t byte_count)
+{
+  const auto &packet_marker = packetMarker();
+  size_t offset = 0;
+  while (offset + kMarkerSize <= byte_count)
   {
-    if (bytes[i] == packet_marker[0])
+    const auto *candidate = static_cast<const uint8_t *>(
+      std::memchr(bytes + offset, packet_marker[0], byte_count - offset - kMarkerSize + 1u));
+    if (!candidate)
     {
-      // First marker byte found. Check for the rest.
-      bool found = true;
-      for (unsigned j = 1; j < packet_marker.size(); ++j)
-      {
-        found = found && bytes[i + j] == packet_marker[j];
-      }
-
-      if (found)
-      {
-        return static_cast<int>(i);
-      }
+      break;
     }
+    offset = static_cast<size_t>(candidate - bytes);
+    if (std::memcmp(candidate, packet_marker.data(), kMarkerSize) == 0)
+    {
+      return offset;
+    }
+    ++offset;
   }
 
-  return -1;
+  return byte_count;
 }
 }  // namespace
 
 PacketBuffer::PacketBuffer(size_t capacity)
-{
-  _packet_buffer.reserve(capacity);
-}
+  : _buffer(capacity)
+{}
 
 
 PacketBuffer::~PacketBuffer() = default;
@@ -66,95 +78,261 @@ PacketBuffer::~PacketBuffer() = default;
 
 int PacketBuffer::addBytes(const uint8_t *bytes, size_t byte_count)
 {
+  consume();
+
   if (_marker_found)
   {
-    appendData(bytes, bytes + byte_count);
+    append(bytes, byte_count);
     // All bytes accepted.
     return 0;
   }
 
-  // Clear for the marker in the incoming bytes.
-  // Reject bytes not found.
-  const int marker_pos = packetMarkerPosition(bytes, byte_count);
-  if (marker_pos >= 0)
+  // Not synchronised. Up to kMarkerSize - 1 bytes of a partial marker may be retained. Check for a
+  // marker which starts in those bytes.
+  const size_t retained = _size;
+  if (retained > 0)
+  {
+    std::array<uint8_t, 2 * (kMarkerSize - 1)> join = {};
+    const size_t join_count = retained + std::min(byte_count, kMarkerSize - 1);
+    peek(0, join.data(), retained);
+    std::memcpy(join.data() + retained, bytes, join_count - retained);
+    const size_t marker_pos = packetMarkerPosition(join.data(), join_count);
+    if (marker_pos < retained)
+    {
+      discard(marker_pos);
+      _marker_found = true;
+      append(bytes, byte_count);
+      return 0;
+    }
+  }
+
+  // Search for the marker in the incoming bytes. Reject bytes before the marker.
+  const size_t marker_pos = packetMarkerPosition(bytes, byte_count);
+  if (marker_pos < byte_count)
   {
+    discard(_size);
     _marker_found = true;
-    appendData(bytes + marker_pos, bytes + byte_count - static_cast<size_t>(marker_pos));
-    return marker_pos;
+    append(bytes + marker_pos, byte_count - marker_pos);
+    return int_cast<int>(marker_pos);
   }
 
+  // No marker. Retain a possible partial marker from the end of the data.
+  const size_t keep = std::min(retained + byte_count, kMarkerSize - 1);
+  if (byte_count >= keep)
+  {
+    discard(_size);
+    append(bytes + byte_count - keep, keep);
+  }
+  else
+  {
+    discard(retained + byte_count - keep);
+    append(bytes, byte_count);
+  }
   return -1;
 }
 
 
-PacketHeader *PacketBuffer::extractPacket(std::vector<uint8_t> &buffer)
+const PacketHeader *PacketBuffer::extractPacket()
 {
-  if (_marker_found && _packet_buffer.size() >= sizeof(PacketHeader))
-  {
-    // Remember, the CRC appears after the packet payload. We have to include
-    // that in our mem copy.
-    auto *pending = reinterpret_cast<PacketHeader *>(_packet_buffer.data());
-    const PacketReader reader(pending);
-    if (sizeof(PacketHeader) + reader.payloadSize() + sizeof(PacketReader::CrcType) <=
-        _packet_buffer.size())
+  consume();
+
+  for (;;)
+  {
+    if (!_marker_found || _size < sizeof(PacketHeader))
     {
-      // We have a full packet. Allocate a copy and extract the full packet data.
-      const unsigned packet_size = reader.packetSize();
-      // FIXME(KS): why copy to a new buffer? Can't we hold a pointer in the buffer, then shift
-      // bytes on release?
-      buffer.clear();
-      std::copy(_packet_buffer.begin(), _packet_buffer.begin() + packet_size,
-                std::back_inserter(buffer));
-
-      _marker_found = false;
-      if (_packet_buffer.size() > packet_size)
-      {
-        // Find next marker beyond the packet just returned.
-        const int next_marker_pos = packetMarkerPosition(_packet_buffer.data() + packet_size,
-                                                         _packet_buffer.size() - packet_size);
-        if (next_marker_pos >= 0)
-        {
-          removeData(int_cast<size_t>(packet_size + next_marker_pos));
-          _marker_found = true;
-        }
-        else
-        {
-          // No new marker. Remove all data.
-          removeData(_packet_buffer.size());
-        }
-      }
-      else
-      {
-        removeData(packet_size);
-      }
-
-      return reinterpret_cast<PacketHeader *>(buffer.data());
+      return nullptr;
     }
+
+    // The header must be complete including any extended payload size (see PFExtended). Read it
+    // in place unless it straddles the wrap point.
+    std::array<uint8_t, sizeof(PacketHeader) + std::numeric_limits<uint8_t>::max()> header_copy;
+    const uint8_t *header_bytes = _buffer.data() + _head;
+    const size_t contiguous = contiguousSize();
+    if (contiguous < sizeof(PacketHeader))
+    {
+      peek(0, header_copy.data(), sizeof(PacketHeader));
+      header_bytes = header_copy.data();
+    }
+
+    const size_t header_size =
+      sizeof(PacketHeader) + reinterpret_cast<const PacketHeader *>(header_bytes)->payload_offset;
+    if (_size < header_size)
+    {
+      return nullptr;
+    }
+
+    if (contiguous < header_size)
+    {
+      peek(0, header_copy.data(), header_size);
+      header_bytes = header_copy.data();
+    }
+
+    const PacketReader reader(reinterpret_cast<const PacketHeader *>(header_bytes));
+    if (reader.extended() && reader.payloadSize() > _max_extended_payload_size)
+    {
+      // Corrupt header. Skip the marker and resynchronise.
+      discard(1);
+      synchronise();
+      continue;
+    }
+
+    // Remember, the CRC appears after the packet payload, so use the full packet size.
+    const size_t packet_size = reader.packetSize();
+    if (_size < packet_size)
+    {
+      return nullptr;
+    }
+
+    // Release on the next call.
+    _extracted_size = packet_size;
+
+    if (contiguous >= packet_size)
+    {
+      return reinterpret_cast<const PacketHeader *>(_buffer.data() + _head);
+    }
+
+    // The packet straddles the wrap point. Copy to make it contiguous.
+    _wrapped.resize(packet_size);
+    peek(0, _wrapped.data(), packet_size);
+    return reinterpret_cast<const PacketHeader *>(_wrapped.data());
+  }
+}
+
+
+PacketHeader *PacketBuffer::extractPacket(std::vector<uint8_t> &buffer)
+{
+  const PacketHeader *packet = extractPacket();
+  if (!packet)
+  {
+    return nullptr;
   }
 
-  return nullptr;
+  const auto *packet_bytes = reinterpret_cast<const uint8_t *>(packet);
+  buffer.assign(packet_bytes, packet_bytes + _extracted_size);
+  return reinterpret_cast<PacketHeader *>(buffer.data());
 }
 
 
-template <typename Iter>
-void PacketBuffer::appendData(const Iter &begin, const Iter &end)
+void PacketBuffer::consume()
 {
-  std::copy(begin, end, std::back_inserter(_packet_buffer));
+  if (_extracted_size == 0)
+  {
+    return;
+  }
+
+  discard(_extracted_size);
+  _extracted_size = 0;
+
+  // Synchronise on the next marker. This is normally at the start of the remaining data.
+  synchronise();
 }
 
 
-void PacketBuffer::removeData(size_t byte_count)
+void PacketBuffer::synchronise()
 {
-  if (byte_count < _packet_buffer.size())
+  const size_t marker_pos = findMarker();
+  if (marker_pos < _size)
   {
-    const size_t new_size = _packet_buffer.size() - byte_count;
-    std::memmove(_packet_buffer.data(), _packet_buffer.data() + byte_count,
-                 sizeof(*_packet_buffer.data()) * new_size);
-    _packet_buffer.resize(new_size);
+    discard(marker_pos);
+    _marker_found = true;
   }
   else
   {
-    _packet_buffer.resize(0);
+    // No new marker. Remove all data except for a possible partial marker.
+    discard(_size - std::min(_size, kMarkerSize - 1));
+    _marker_found = false;
+  }
+}
+
+
+void PacketBuffer::append(const uint8_t *bytes, size_t byte_count)
+{
+  if (byte_count == 0)
+  {
+    return;
+  }
+
+  if (_size + byte_count > _buffer.size())
+  {
+    // Grow, moving the buffered data to the start of the new buffer.
+    std::vector<uint8_t> buffer(std::max(_size + byte_count, 2 * _buffer.size()));
+    peek(0, buffer.data(), _size);
+    _buffer.swap(buffer);
+    _head = 0;
+  }
+
+  const size_t capacity = _buffer.size();
+  size_t tail = _head + _size;
+  tail = (tail >= capacity) ? tail - capacity : tail;
+  const size_t first_count = std::min(byte_count, capacity - tail);
+  std::memcpy(_buffer.data() + tail, bytes, first_count);
+  std::memcpy(_buffer.data(), bytes + first_count, byte_count - first_count);
+  _size += byte_count;
+}
+
+
+void PacketBuffer::discard(size_t byte_count)
+{
+  byte_count = std::min(byte_count, _size);
+  _size -= byte_count;
+  if (_size == 0)
+  {
+    // Restart at the beginning to maximise the contiguous space.
+    _head = 0;
+    return;
   }
+
+  _head += byte_count;
+  _head = (_head >= _buffer.size()) ? _head - _buffer.size() : _head;
+}
+
+
+void PacketBuffer::peek(size_t offset, uint8_t *dst, size_t byte_count) const
+{
+  if (byte_count == 0)
+  {
+    return;
+  }
+
+  const size_t capacity = _buffer.size();
+  size_t start = _head + offset;
+  start = (start >= capacity) ? start - capacity : start;
+  const size_t first_count = std::min(byte_count, capacity - start);
+  std::memcpy(dst, _buffer.data() + start, first_count);
+  std::memcpy(dst + first_count, _buffer.data(), byte_count - first_count);
+}
+
+
+size_t PacketBuffer::contiguousSize() const
+{
+  return std::min(_size, _buffer.size() - _head);
+}
+
+
+size_t PacketBuffer::findMarker() const
+{
+  const size_t first_count = contiguousSize();
+  const size_t marker_pos = packetMarkerPosition(_buffer.data() + _head, first_count);
+  if (marker_pos < first_count || first_count == _size)
+  {
+    return (marker_pos < first_count) ? marker_pos : _size;
+  }
+
+  // Check for a marker straddling the wrap point.
+  const auto &packet_marker = packetMarker();
+  std::array<uint8_t, kMarkerSize> candidate = {};
+  for (size_t offset = first_count - std::min(first_count, kMarkerSize - 1);
+       offset < first_count && offset + kMarkerSize <= _size; ++offset)
+  {
+    peek(offset, candidate.data(), kMarkerSize);
+    if (std::memcmp(candidate.data(), packet_marker.data(), kMarkerSize) == 0)
+    {
+      return offset;
+    }
+  }
+
+  const size_t second_count = _size - first_count;
+  const size_t wrapped_pos = packetMarkerPosition(_buffer.data(), second_count);
+  return (wrapped_pos < second_count) ? first_count + wrapped_pos : _size;
 }
 }  // namespace tes
@@ -6,26 +6,38 @@
 
 #include "CoreConfig.h"
 
+#include "PacketHeader.h"
+
 #include <array>
 #include <cinttypes>
 #include <vector>
 
 namespace tes
 {
-struct PacketHeader;
-
 /// This class accepts responsibility for collating incoming byte streams.
 ///
 /// Data is buffered until full packets have arrived, which must be extracted using
 /// @c extractPacket().
 ///
+/// Data are held in a ring buffer, which grows as required. Packets are extracted in place,
+/// referencing the ring buffer directly, except for packets which straddle the ring buffer wrap
+/// point. Those are copied into a contiguous buffer. The bytes of an extracted packet are released
+/// on the following call to @c addBytes() or @c extractPacket() .
+///
+/// The stream is synchronised on the @c PacketHeader marker. Bytes preceding a marker are
+/// discarded, while a partial marker at the end of the buffered data is retained to be completed
+/// by the next @c addBytes() call. A header with a @c PFExtended payload size larger than
+/// @c maxExtendedPayloadSize() is considered corrupt and skipped, resynchronising on the next
+/// marker.
+///
 /// @note @c PacketStreamReader is recommended over using @c PacketBuffer.
 ///
 /// @todo Deprecate this class in favour of @c PacketStreamReader.
 class TES_CORE_API PacketBuffer
 {
 public:
-  /// Constructors 2Kb buffer.
+  /// Constructor.
+  /// @param capacity The initial ring buffer capacity (bytes).
   PacketBuffer(size_t capacity = 2048u);
   /// Destructor.
   ~PacketBuffer();
@@ -33,7 +45,7 @@ public:
   /// Adds @c bytes to the buffer.
   ///
   /// Data are rejected if the marker is not present or, if present, data before the marker are
-  /// rejected.
+  /// rejected. This releases the last extracted packet.
   ///
   /// @return the index of the first accepted byte or -1 if all are rejected.
   int addBytes(const uint8_t *bytes, size_t byte_count);
@@ -48,6 +60,16 @@ public:
   /// @overload
   int addBytes(const std::vector<uint8_t> &bytes) { return addBytes(bytes.data(), bytes.size()); }
 
+  /// Extract the first valid packet in the buffer without copying. Additional packets may be left
+  /// available.
+  ///
+  /// The packet references the internal buffer, unless it straddles the ring buffer wrap point, in
+  /// which case it references an internal copy. Either way, the packet remains valid until the
+  /// next call to @c addBytes() or @c extractPacket() .
+  ///
+  /// @return A valid packet pointer if available, null if none available.
+  const PacketHeader *extractPacket();
+
   /// Extract the first valid packet in the buffer. Additional packets may be left available.
   ///
   /// The packet is extracted into the @p buffer, which is used to avoid memory allocation on each
@@ -55,23 +77,71 @@ public:
   /// entire packet, then the packet is copied into the @p buffer. The return value is the same
   /// address as @p buffer.data(), but converted to the @c PacketHeader type.
   ///
+  /// Prefer the overload which extracts in place to avoid the copy.
+  ///
   /// @param buffer A byte array to copy the packet into.
   /// @return A valid packet pointer if available, null if none available.
   PacketHeader *extractPacket(std::vector<uint8_t> &buffer);
 
+  /// Query the number of bytes currently buffered, including any extracted packet which has yet
+  /// to be released.
+  /// @return The number of buffered bytes.
+  [[nodiscard]] size_t size() const { return _size; }
+
+  /// Query the ring buffer capacity.
+  /// @return The capacity in bytes.
+  [[nodiscard]] size_t capacity() const { return _buffer.size(); }
+
+  /// Set the largest @c PFExtended payload size to accept. This bounds the memory used waiting
+  /// for a packet with a corrupt payload size.
+  /// @param max_payload_size The payload size limit (bytes).
+  void setMaxExtendedPayloadSize(uint32_t max_payload_size)
+  {
+    _max_extended_payload_size = max_payload_size;
+  }
+
+  /// Query the largest @c PFExtended payload size to accept.
+  /// @return The payload size limit (bytes). Defaults to @c kPacketDefaultMaxExtendedPayloadSize .
+  [[nodiscard]] uint32_t maxExtendedPayloadSize() const { return _max_extended_payload_size; }
+
 private:
-  /// Grow the packet buffer with @p bytes.
+  /// Release the last extracted packet, then synchronise on the following marker.
+  void consume();
+
+  /// Synchronise on the first marker in the buffered bytes, discarding preceding bytes.
+  void synchronise();
+
+  /// Append bytes to the ring buffer, growing as required.
   /// @param bytes Data to append.
   /// @param byte_count Number of bytes from @p bytes to append.
-  template <typename Iter>
-  void appendData(const Iter &begin, const Iter &end);
+  void append(const uint8_t *bytes, size_t byte_count);
 
-  /// Remove the first @p byte_count bytes from the packet buffer.
+  /// Remove the first @p byte_count bytes from the ring buffer.
   /// @param byte_count The number of bytes to remove from the buffer.
-  void removeData(size_t byte_count);
+  void discard(size_t byte_count);
+
+  /// Copy buffered bytes into @p dst , handling the wrap point.
+  /// @param offset Offset from the first buffered byte to start copying from.
+  /// @param dst The destination buffer.
+  /// @param byte_count The number of bytes to copy. Must be available.
+  void peek(size_t offset, uint8_t *dst, size_t byte_count) const;
+
+  /// Query the number of buffered bytes which are contiguous from the first buffered byte.
+  /// @return The contiguous byte count.
+  [[nodiscard]] size_t contiguousSize() const;
+
+  /// Find the first packet marker in the buffered bytes.
+  /// @return The marker offset from the first buffered byte, or @c size() when not found.
+  [[nodiscard]] size_t findMarker() const;
 
-  std::vector<uint8_t> _packet_buffer;  ///< Buffers incoming packet data.
-  bool _marker_found = false;           ///< Has the @c PacketHeader marker been found?
+  std::vector<uint8_t> _buffer;   ///< Ring buffer of incoming packet data.
+  std::vector<uint8_t> _wrapped;  ///< Copy of an extracted packet which straddles the wrap point.
+  size_t _head = 0;               ///< Ring buffer index of the first buffered byte.
+  size_t _size = 0;               ///< Number of buffered bytes.
+  size_t _extracted_size = 0;     ///< Byte size of the last extracted packet, yet to be released.
+  bool _marker_found = false;     ///< Has the @c PacketHeader marker been found?
+  /// Largest accepted @c PFExtended payload size.
+  uint32_t _max_extended_payload_size = kPacketDefaultMaxExtendedPayloadSize;
 };
 }  // namespace tes
 
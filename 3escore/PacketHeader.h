@@ -31,19 +31,38 @@ enum PacketFlag : unsigned
 {
   /// Marks a @c PacketHeader as missing its 16-bit CRC.
   PFNoCrc = (1u << 0u),
-  // /// Indicates that the platform which wrote this data was big endian. In most cases this is
-  // /// irrelevant as data items are generally written to big endian format. However, in some cases
-  // /// the write operation may not be able to change to network endian form, in which case this
-  // flag
-  // /// indicates the source data endian format.
-  // PF_PlatformBigEndian = (1u << 1u),
+  /// Marks the payload data as little endian rather than network byte order (big endian). This
+  /// allows little endian platforms to copy payload arrays without swapping bytes. The
+  /// @c PacketHeader fields and CRC remain in network byte order.
+  ///
+  /// Readers must honour this flag per packet as a stream may mix byte orders.
+  PFLittleEndian = (1u << 1u),
+  /// Marks an extended packet with a 32-bit payload size, lifting the 64KiB payload limit.
+  ///
+  /// The 16-bit @c PacketHeader::payload_size is zero and the payload size is written as a
+  /// @c uint32_t in network byte order immediately after the @c PacketHeader . The
+  /// @c PacketHeader::payload_offset is at least @c kPacketExtendedSizeBytes , so the payload
+  /// begins after the 32-bit size. The CRC covers the header, the 32-bit size and the payload.
+  PFExtended = (1u << 2u),
 };
 
+/// Number of bytes used to encode the 32-bit payload size of a @c PFExtended packet.
+constexpr unsigned kPacketExtendedSizeBytes = sizeof(uint32_t);
+/// The maximum payload size of a packet without @c PFExtended .
+constexpr uint32_t kPacketMaxPayloadSize = 0xffffu;
+/// Default limit on the payload size of a @c PFExtended packet accepted by @c PacketBuffer and
+/// @c PacketStreamReader . A larger payload size is treated as a corrupt header.
+constexpr uint32_t kPacketDefaultMaxExtendedPayloadSize = 64u * 1024u * 1024u;
+
 /// The header for an incoming 3ES data packet. All packet data, including payload
-/// bytes, must be in network endian which is big endian.
+/// bytes, must be in network endian which is big endian, except for payload bytes with
+/// @c PFLittleEndian set.
 ///
 /// A two byte CRC value is to appear immediately after the @p PacketHeader header and
 /// payload.
+///
+/// The payload begins @c payload_offset bytes after the header. @c PFExtended packets use these
+/// bytes to encode a 32-bit payload size.
 struct TES_CORE_API PacketHeader
 {
   uint32_t marker;         ///< Marker bytes. Identifies the packet start.
@@ -53,7 +72,8 @@ struct TES_CORE_API PacketHeader
   uint16_t routing_id;
   /// Identifies the message ID or message type.
   uint16_t message_id;
-  uint16_t payload_size;  ///< Size of the payload following this header.
+  /// Size of the payload following this header. Zero for @c PFExtended packets.
+  uint16_t payload_size;
   /// Offset from the end of this header to the payload.
   uint8_t payload_offset;
   /// @c PacketFlag values.
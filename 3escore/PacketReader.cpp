@@ -70,7 +70,7 @@ bool PacketReader::checkCrc()
 PacketReader::CrcType PacketReader::calculateCrc() const
 {
   const CrcType crc_val =
-    crc16(reinterpret_cast<const uint8_t *>(_packet), sizeof(PacketHeader) + payloadSize());
+    crc16(reinterpret_cast<const uint8_t *>(_packet), size_t(headerSize()) + payloadSize());
   return crc_val;
 }
 
@@ -79,9 +79,15 @@ size_t PacketReader::readElement(uint8_t *bytes, size_t element_size)
 {
   if (bytesAvailable() >= element_size)
   {
-    std::memcpy(bytes, payload() + _payload_position, element_size);
-    networkEndianSwap(bytes, element_size);
-    _payload_position = static_cast<uint16_t>(_payload_position + element_size);
+    if (payloadEndianSwap())
+    {
+      endianSwapCopy(bytes, payload() + _payload_position, element_size, 1);
+    }
+    else
+    {
+      std::memcpy(bytes, payload() + _payload_position, element_size);
+    }
+    _payload_position = static_cast<uint32_t>(_payload_position + element_size);
     return element_size;
   }
 
@@ -95,15 +101,17 @@ size_t PacketReader::readArray(uint8_t *bytes, size_t element_size, size_t eleme
   if (copy_count > 0)
   {
     copy_count = (copy_count > element_count) ? element_count : copy_count;
-    std::memcpy(bytes, payload() + _payload_position, copy_count * element_size);
-#if !TES_IS_NETWORK_ENDIAN
-    uint8_t *fix_bytes = bytes;
-    for (unsigned i = 0; i < copy_count; ++i, fix_bytes += element_size)
+    // Little endian payloads on a little endian platform are a straight copy. Otherwise swap while
+    // copying.
+    if (payloadEndianSwap() && element_size > 1)
+    {
+      endianSwapCopy(bytes, payload() + _payload_position, element_size, copy_count);
+    }
+    else
     {
-      networkEndianSwap(fix_bytes, element_size);
+      std::memcpy(bytes, payload() + _payload_position, copy_count * element_size);
     }
-#endif  // !TES_IS_NETWORK_ENDIAN
-    _payload_position = static_cast<uint16_t>(_payload_position + element_size * copy_count);
+    _payload_position = static_cast<uint32_t>(_payload_position + element_size * copy_count);
     return copy_count;
   }
 
@@ -115,7 +123,7 @@ size_t PacketReader::readRaw(uint8_t *bytes, size_t byte_count)
 {
   const size_t copy_count = (byte_count <= bytesAvailable()) ? byte_count : bytesAvailable();
   std::memcpy(bytes, payload() + _payload_position, copy_count);
-  _payload_position = static_cast<uint16_t>(_payload_position + copy_count);
+  _payload_position = static_cast<uint32_t>(_payload_position + copy_count);
   return copy_count;
 }
 
@@ -126,9 +134,9 @@ size_t PacketReader::peek(uint8_t *dst, size_t byte_count, bool allow_byte_swap)
   std::memcpy(dst, payload() + _payload_position, copy_count);
   // Do not adjust the payload position.
 
-  if (allow_byte_swap)
+  if (allow_byte_swap && payloadEndianSwap())
   {
-    networkEndianSwap(dst, byte_count);
+    endianSwap(dst, byte_count);
   }
 
   return copy_count;
@@ -14,9 +14,8 @@ namespace tes
 {
 /// A utility class for dealing with reading packets.
 ///
-/// @bug Use the payloadOffset in various calculations herein. It was added after this
-/// class was written, but is currently only supported as being zero, so it's not an issue
-/// yet.
+/// The payload is located after the @c PacketHeader::payload_offset bytes, which hold the 32-bit
+/// payload size for @c PFExtended packets.
 class TES_CORE_API PacketReader : public PacketStream<const PacketHeader>
 {
 public:
@@ -45,7 +44,7 @@ public:
 
   /// Returns the number of bytes available for writing in the payload.
   /// @return The number of bytes available for writing.
-  [[nodiscard]] uint16_t bytesAvailable() const;
+  [[nodiscard]] uint32_t bytesAvailable() const;
 
   /// Reads a single data element from the current position. This assumes that
   /// a single data element of size @p element_size is being read and may require
@@ -119,9 +118,9 @@ public:
   PacketReader &operator>>(T &val);
 };
 
-inline uint16_t PacketReader::bytesAvailable() const
+inline uint32_t PacketReader::bytesAvailable() const
 {
-  return static_cast<uint16_t>(payloadSize() - _payload_position);
+  return payloadSize() - _payload_position;
 }
 
 template <typename T>
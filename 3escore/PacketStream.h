@@ -9,6 +9,8 @@
 #include "Endian.h"
 #include "PacketHeader.h"
 
+#include <cstring>
+
 namespace tes
 {
 /// A utility class used for managing read/write operations to a @c PacketHeader payload.
@@ -65,18 +67,40 @@ public:
   {
     return networkEndianSwapValue(_packet->version_minor);
   }
-  /// Fetch the payload size bytes in local endian.
-  /// @return The @c PacketHeader::payloadSize bytes.
-  [[nodiscard]] uint16_t payloadSize() const
+  /// Fetch the payload size in local endian. This is the 32-bit size following the header for
+  /// @c PFExtended packets, or @c PacketHeader::payload_size otherwise.
+  /// @return The payload size (bytes).
+  [[nodiscard]] uint32_t payloadSize() const
   {
+    if (extended())
+    {
+      uint32_t payload_size = 0;
+      std::memcpy(&payload_size, reinterpret_cast<const uint8_t *>(_packet) + sizeof(HEADER),
+                  sizeof(payload_size));
+      return networkEndianSwapValue(payload_size);
+    }
     return networkEndianSwapValue(_packet->payload_size);
   }
+  /// Fetch the @c PacketHeader::payload_offset ; the number of bytes between the header and the
+  /// payload.
+  /// @return The payload offset (bytes).
+  [[nodiscard]] uint8_t payloadOffset() const { return _packet->payload_offset; }
+  /// Is this a @c PFExtended packet with a 32-bit payload size?
+  /// @return True for an extended packet.
+  [[nodiscard]] bool extended() const { return (_packet->flags & PFExtended) != 0; }
+  /// Returns the number of bytes preceding the payload: the @c PacketHeader and
+  /// @c payloadOffset() bytes.
+  /// @return The header size (bytes).
+  [[nodiscard]] uint32_t headerSize() const
+  {
+    return static_cast<uint32_t>(sizeof(HEADER) + payloadOffset());
+  }
   /// Returns the size of the packet plus payload, giving the full data packet size including the
   /// CRC.
   /// @return PacketHeader data size (bytes).
-  [[nodiscard]] uint16_t packetSize() const
+  [[nodiscard]] uint32_t packetSize() const
   {
-    return static_cast<uint16_t>(sizeof(HEADER) + payloadSize() +
+    return static_cast<uint32_t>(headerSize() + payloadSize() +
                                  (((packet().flags & PFNoCrc) == 0) ? sizeof(CrcType) : 0));
   }
   /// Fetch the routing ID bytes in local endian.
@@ -88,6 +112,13 @@ public:
   /// Fetch the flags bytes in local endian.
   /// @return the @c PacketHeader::flags bytes.
   [[nodiscard]] uint8_t flags() const { return networkEndianSwapValue(_packet->flags); }
+  /// Check if payload data must be endian swapped to convert to/from the local byte order. This
+  /// depends on whether @c PFLittleEndian is set and the local byte order.
+  /// @return True if payload data must be endian swapped.
+  [[nodiscard]] bool payloadEndianSwap() const
+  {
+    return ((flags() & PFLittleEndian) != 0) == (TES_IS_BIG_ENDIAN != 0);
+  }
   /// Fetch the CRC bytes in local endian.
   /// Invalid for packets with the @c PFNoCrc flag set.
   /// @return The packet's CRC value.
@@ -126,7 +157,7 @@ public:
 
   /// Tell the current stream position.
   /// @return The current position.
-  [[nodiscard]] uint16_t tell() const;
+  [[nodiscard]] uint32_t tell() const;
   /// Seek to the indicated position.
   /// @param offset Seek offset from @p pos.
   /// @param pos The seek reference position.
@@ -138,7 +169,7 @@ public:
 protected:
   HEADER *_packet = nullptr;        ///< Packet header and buffer start address.
   uint16_t _status = Ok;            ///< @c Status bits.
-  uint16_t _payload_position = 0u;  ///< Payload cursor.
+  uint32_t _payload_position = 0u;  ///< Payload cursor.
 
   /// Type traits: is @c T const?
   template <class T>
@@ -179,26 +210,26 @@ bool PacketStream<HEADER>::seek(int offset, SeekPos pos)
   switch (pos)
   {
   case Begin:
-    if (offset <= payloadSize())
+    if (offset >= 0 && static_cast<uint32_t>(offset) <= payloadSize())
     {
-      _payload_position = static_cast<uint16_t>(offset);
+      _payload_position = static_cast<uint32_t>(offset);
       return true;
     }
     break;
 
   case Current:
-    if (offset >= 0 && offset + _payload_position <= payloadSize() ||
-        offset < 0 && _payload_position >= -offset)
+    if (offset >= 0 && static_cast<uint64_t>(offset) + _payload_position <= payloadSize() ||
+        offset < 0 && _payload_position >= static_cast<uint32_t>(-static_cast<int64_t>(offset)))
     {
-      _payload_position = static_cast<uint16_t>(_payload_position + offset);
+      _payload_position = static_cast<uint32_t>(static_cast<int64_t>(_payload_position) + offset);
       return true;
     }
     break;
 
   case End:
-    if (offset < payloadSize())
+    if (offset >= 0 && static_cast<uint32_t>(offset) < payloadSize())
     {
-      _payload_position = static_cast<uint16_t>(_packet->payload_size - 1 - offset);
+      _payload_position = payloadSize() - 1u - static_cast<uint32_t>(offset);
       return true;
     }
     break;
@@ -217,7 +248,7 @@ typename PacketStream<HEADER>::CrcType *PacketStream<HEADER>::crcPtr()
   // CRC appears after the payload.
   // TODO(KS): fix the const correctness of this.
   uint8_t *pos = const_cast<uint8_t *>(reinterpret_cast<const uint8_t *>(_packet)) +
-                 sizeof(HEADER) + payloadSize();
+                 headerSize() + payloadSize();
   return reinterpret_cast<CrcType *>(pos);
 }
 
@@ -226,7 +257,7 @@ template <class HEADER>
 const typename PacketStream<HEADER>::CrcType *PacketStream<HEADER>::crcPtr() const
 {
   // CRC appears after the payload.
-  const uint8_t *pos = reinterpret_cast<const uint8_t *>(_packet) + sizeof(HEADER) + payloadSize();
+  const uint8_t *pos = reinterpret_cast<const uint8_t *>(_packet) + headerSize() + payloadSize();
   return reinterpret_cast<const CrcType *>(pos);
 }
 
@@ -244,7 +275,7 @@ inline HEADER &PacketStream<HEADER>::packet() const
 }
 
 template <class HEADER>
-inline uint16_t PacketStream<HEADER>::tell() const
+inline uint32_t PacketStream<HEADER>::tell() const
 {
   return _payload_position;
 }
@@ -252,7 +283,7 @@ inline uint16_t PacketStream<HEADER>::tell() const
 template <class HEADER>
 inline const uint8_t *PacketStream<HEADER>::payload() const
 {
-  return reinterpret_cast<const uint8_t *>(_packet) + sizeof(HEADER);
+  return reinterpret_cast<const uint8_t *>(_packet) + headerSize();
 }
 }  // namespace tes
 
@@ -4,12 +4,87 @@
 #include "PacketStreamReader.h"
 
 #include "CoreUtil.h"
+#include "MappedFile.h"
 #include "PacketReader.h"
+#include "StreamUtil.h"
 
+#include <algorithm>
 #include <cstring>
+#include <fstream>
+#include <streambuf>
 
 namespace tes
 {
+namespace
+{
+/// A read only, seekable @c std::streambuf over a @c MappedFile .
+class MappedFileBuf : public std::streambuf
+{
+public:
+  MappedFileBuf(std::shared_ptr<const MappedFile> file)
+    : _file(std::move(file))
+  {
+    // The get area is never written, so the const cast is safe.
+    auto *begin = const_cast<char *>(reinterpret_cast<const char *>(_file->data()));
+    setg(begin, begin, begin + _file->size());
+  }
+
+protected:
+  pos_type seekoff(off_type offset, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override
+  {
+    if (!(which & std::ios_base::in))
+    {
+      return pos_type(off_type(-1));
+    }
+
+    off_type base = 0;
+    if (dir == std::ios_base::cur)
+    {
+      base = gptr() - eback();
+    }
+    else if (dir == std::ios_base::end)
+    {
+      base = egptr() - eback();
+    }
+
+    const off_type target = base + offset;
+    if (target < 0 || target > egptr() - eback())
+    {
+      return pos_type(off_type(-1));
+    }
+
+    setg(eback(), eback() + target, egptr());
+    return pos_type(target);
+  }
+
+  pos_type seekpos(pos_type position, std::ios_base::openmode which) override
+  {
+    return seekoff(off_type(position), std::ios_base::beg, which);
+  }
+
+private:
+  std::shared_ptr<const MappedFile> _file;
+};
+
+
+/// A @c std::istream which owns a @c MappedFileBuf .
+class MappedFileStream : public std::istream
+{
+public:
+  MappedFileStream(std::shared_ptr<const MappedFile> file)
+    : std::istream(nullptr)
+    , _buf(std::move(file))
+  {
+    rdbuf(&_buf);
+  }
+
+private:
+  MappedFileBuf _buf;
+};
+}  // namespace
+
+
 PacketStreamReader::PacketStreamReader()
 {
   const auto packet_marker = networkEndianSwapValue(tes::kPacketMarker);
@@ -27,10 +102,55 @@ PacketStreamReader::PacketStreamReader(std::shared_ptr<std::istream> stream)
 PacketStreamReader::~PacketStreamReader() = default;
 
 
+bool PacketStreamReader::isEof() const
+{
+  if (!_stream)
+  {
+    return true;
+  }
+
+  if (_mapped)
+  {
+    return position() >= _mapped->size();
+  }
+
+  // Packets may remain in the buffer after the stream end.
+  return _stream->eof() && _head + _extracted_size >= _buffer.size();
+}
+
+
+bool PacketStreamReader::open(const std::string &path)
+{
+  auto mapped = std::make_shared<MappedFile>();
+  if (mapped->open(path))
+  {
+    setStream(std::make_shared<MappedFileStream>(mapped));
+    _mapped = std::move(mapped);
+    return true;
+  }
+
+  auto file = std::make_shared<std::ifstream>(path, std::ios::binary);
+  if (!file->is_open())
+  {
+    setStream(nullptr);
+    return false;
+  }
+
+  setStream(std::move(file));
+  return true;
+}
+
+
 void PacketStreamReader::setStream(std::shared_ptr<std::istream> stream)
 {
   std::swap(stream, _stream);
+  _mapped = nullptr;
   _buffer.clear();
+  _head = 0;
+  _buffer_offset = 0;
+  _extracted_size = 0;
+  _frame_offsets.clear();
+  _have_frame_index = false;
 }
 
 
@@ -42,69 +162,150 @@ const PacketHeader *PacketStreamReader::extractPacket()
   }
 
   consume();
+  return (_mapped) ? extractMapped() : extractBuffered();
+}
+
+
+void PacketStreamReader::seek(std::istream::pos_type position)
+{
+  _buffer.clear();
+  _head = 0;
+  _buffer_offset = static_cast<uint64_t>(std::streamoff(position));
+  _extracted_size = 0;
+  if (_stream && !_mapped)
+  {
+    _stream->clear();
+    _stream->seekg(position);
+  }
+}
+
+
+bool PacketStreamReader::loadFrameIndex()
+{
+  _have_frame_index = _stream && streamutil::readFrameIndex(*_stream, _frame_offsets);
+  return _have_frame_index;
+}
+
+
+bool PacketStreamReader::seekFrame(uint32_t frame)
+{
+  if (frame == 0)
+  {
+    seek(0);
+    return true;
+  }
+
+  if (frame > _frame_offsets.size())
+  {
+    return false;
+  }
 
-  // Read a chunk from the stream.
-  if (_buffer.empty())
+  seek(static_cast<std::streamoff>(_frame_offsets[frame - 1u]));
+  return true;
+}
+
+
+const PacketHeader *PacketStreamReader::extractMapped()
+{
+  const uint8_t *data = _mapped->data();
+  const uint64_t size = _mapped->size();
+
+  while (_buffer_offset < size)
   {
-    if (readMore(_chunk_size - _buffer.size()) == 0)
+    // Skip to the next marker.
+    const auto available = static_cast<size_t>(size - _buffer_offset);
+    _buffer_offset += findMarker(data + _buffer_offset, available);
+    if (_buffer_offset >= size)
     {
-      // We have no data to read more.
-      return nullptr;
+      break;
+    }
+
+    const auto *header = reinterpret_cast<const PacketHeader *>(data + _buffer_offset);
+    const auto remaining = static_cast<size_t>(size - _buffer_offset);
+    if (remaining < sizeof(PacketHeader) || remaining < calcHeaderSize(header))
+    {
+      break;
     }
+
+    if (!validSize(header))
+    {
+      // Corrupt header. Skip the marker and resynchronise.
+      ++_buffer_offset;
+      continue;
+    }
+
+    const auto packet_size = calcExpectedSize(header);
+    if (remaining < packet_size)
+    {
+      break;
+    }
+
+    // Mark to consume on next call.
+    _extracted_size = packet_size;
+    return header;
   }
 
-  // Scan for the buffer start.
-  for (size_t i = 0; i < _buffer.size(); ++i)
+  // No marker or an incomplete packet. Nothing more can be extracted.
+  _buffer_offset = std::max(_buffer_offset, size);
+  return nullptr;
+}
+
+
+const PacketHeader *PacketStreamReader::extractBuffered()
+{
+  const auto head = [this] {
+    return reinterpret_cast<const PacketHeader *>(_buffer.data() + _head);
+  };
+
+  for (;;)
   {
-    if (checkMarker(_buffer, i))
+    for (;;)
     {
-      // Marker found. Shift down to comsume trash at the start of the buffer.
-      if (i > 0)
-      {
-        std::memmove(_buffer.data(), _buffer.data() + i, _buffer.size() - i);
-        _buffer.resize(_buffer.size() - i);
-      }
-
-      if (_buffer.size() < sizeof(PacketHeader))
+      const size_t available = _buffer.size() - _head;
+      const size_t marker_pos = findMarker(_buffer.data() + _head, available);
+      if (marker_pos < available)
       {
-        readMore(sizeof(PacketHeader) - _buffer.size());
-        if (_buffer.size() < sizeof(PacketHeader))
-        {
-          // Can't read sufficient bytes. Abort.
-          return nullptr;
-        }
+        // Marker found. Consume trash at the start of the buffer.
+        discard(marker_pos);
+        break;
       }
 
-      // Check the packet size and work out how much more to read.
-      const auto target_size = calcExpectedSize();
-      // Read the full payload.
-      if (_buffer.size() < target_size)
+      // No marker. Discard all but a possible partial marker at the end, then read more.
+      discard(available - std::min(available, _marker_bytes.size() - 1u));
+      if (readMore(_chunk_size) == 0)
       {
-        readMore(target_size - _buffer.size());
-        if (_buffer.size() < target_size)
+        if (_stream->eof())
         {
-          // Failed to read enough.
-          return nullptr;
+          discard(_buffer.size() - _head);
         }
+        return nullptr;
       }
+    }
 
-      // We have our packet.
-      // Mark to consume on next call.
-      return reinterpret_cast<const PacketHeader *>(_buffer.data());
+    // Read the header, then the remainder of the header; payload_offset bytes, which includes the
+    // extended payload size. Then the full payload.
+    if (!ensureBuffered(sizeof(PacketHeader)) || !ensureBuffered(calcHeaderSize(head())))
+    {
+      return nullptr;
     }
-  }
 
-  return nullptr;
-}
+    if (!validSize(head()))
+    {
+      // Corrupt header. Skip the marker and resynchronise rather than buffering the bogus size.
+      discard(1);
+      continue;
+    }
 
+    const auto target_size = calcExpectedSize(head());
+    if (!ensureBuffered(target_size))
+    {
+      return nullptr;
+    }
 
-void PacketStreamReader::seek(std::istream::pos_type position)
-{
-  _buffer.clear();
-  if (_stream)
-  {
-    _stream->clear();
-    _stream->seekg(position);
+    // We have our packet.
+    // Mark to consume on next call.
+    _extracted_size = target_size;
+    return head();
   }
 }
 
@@ -112,30 +313,47 @@ void PacketStreamReader::seek(std::istream::pos_type position)
 size_t PacketStreamReader::readMore(size_t more_count)
 {
   static_assert(sizeof(*_buffer.data()) == sizeof(char));
-  if (isEof())
+  if (!_stream || _stream->eof())
   {
     return 0;
   }
 
+  // Compact once the consumed bytes at least match the remaining bytes. Compaction then moves
+  // fewer bytes than have been consumed, rather than moving the buffer on every packet.
+  const size_t remaining = _buffer.size() - _head;
+  if (_head > 0 && _head >= remaining)
+  {
+    std::memmove(_buffer.data(), _buffer.data() + _head, remaining);
+    _buffer.resize(remaining);
+    _head = 0;
+  }
+
   auto have_count = _buffer.size();
   _buffer.resize(have_count + more_count);
   // Note(KS): I was using readsome() because that returns the count read, but it was also not
-  // working as expected. Using read() and with tellg() will do.
-  const auto start_pos = _stream->tellg();
+  // working as expected. Use read() with gcount(); tellg() fails once read() reaches the end of
+  // the stream.
   _stream->read(reinterpret_cast<char *>(_buffer.data()) + have_count,
-                int_cast<unsigned>(more_count));
-  const auto read_count = _stream->tellg() - start_pos;
+                int_cast<std::streamsize>(more_count));
+  const auto read_count = static_cast<size_t>(_stream->gcount());
   _buffer.resize(have_count + read_count);
   return read_count;
 }
 
 
-bool PacketStreamReader::checkMarker(std::vector<uint8_t> &buffer, size_t i)
+bool PacketStreamReader::ensureBuffered(size_t byte_count)
 {
-  for (size_t j = 0; j < _marker_bytes.size() && i + j < buffer.size(); ++j)
+  const size_t available = _buffer.size() - _head;
+  if (available < byte_count)
   {
-    if (_buffer[i + j] != _marker_bytes[j])
+    readMore(byte_count - available);
+    if (_buffer.size() - _head < byte_count)
     {
+      if (_stream->eof())
+      {
+        // Incomplete packet at the stream end.
+        discard(_buffer.size() - _head);
+      }
       return false;
     }
   }
@@ -143,37 +361,72 @@ bool PacketStreamReader::checkMarker(std::vector<uint8_t> &buffer, size_t i)
 }
 
 
-void PacketStreamReader::consume()
+void PacketStreamReader::discard(size_t byte_count)
 {
-  if (_buffer.size() < sizeof(PacketHeader))
+  _head += byte_count;
+  _buffer_offset += byte_count;
+  if (_head == _buffer.size())
   {
-    // Not possible. Too small.
-    return;
+    _buffer.clear();
+    _head = 0;
   }
+}
 
-  if (!checkMarker(_buffer, 0))
-  {
-    // Not at a valid packet.
-    return;
-  }
 
-  auto target_size = calcExpectedSize();
-  if (_buffer.size() >= target_size)
+size_t PacketStreamReader::findMarker(const uint8_t *data, size_t byte_count) const
+{
+  const size_t marker_size = _marker_bytes.size();
+  size_t offset = 0;
+  while (offset + marker_size <= byte_count)
   {
-    // Consume.
-    std::memmove(_buffer.data(), _buffer.data() + target_size, _buffer.size() - target_size);
-    _buffer.resize(_buffer.size() - target_size);
+    // Find the first marker byte, then check the remaining marker bytes.
+    const auto *candidate = static_cast<const uint8_t *>(
+      std::memchr(data + offset, _marker_bytes[0], byte_count - offset - marker_size + 1u));
+    if (!candidate)
+    {
+      break;
+    }
+    offset = static_cast<size_t>(candidate - data);
+    if (std::memcmp(candidate, _marker_bytes.data(), marker_size) == 0)
+    {
+      return offset;
+    }
+    ++offset;
   }
+  return byte_count;
 }
 
-size_t PacketStreamReader::calcExpectedSize()
+
+void PacketStreamReader::consume()
 {
-  const auto *header = reinterpret_cast<const PacketHeader *>(_buffer.data());
-  auto payload_size = networkEndianSwapValue(header->payload_size);
-  if ((networkEndianSwapValue(header->flags) & PFNoCrc) == 0)
+  if (_mapped)
   {
-    payload_size += sizeof(PacketReader::CrcType);
+    _buffer_offset += _extracted_size;
   }
-  return sizeof(PacketHeader) + payload_size;
+  else
+  {
+    discard(_extracted_size);
+  }
+  _extracted_size = 0;
+}
+
+
+bool PacketStreamReader::validSize(const PacketHeader *header) const
+{
+  const PacketReader reader(header);
+  return !reader.extended() || reader.payloadSize() <= _max_extended_payload_size;
+}
+
+
+size_t PacketStreamReader::calcHeaderSize(const PacketHeader *header)
+{
+  return sizeof(PacketHeader) + header->payload_offset;
+}
+
+
+size_t PacketStreamReader::calcExpectedSize(const PacketHeader *header)
+{
+  const PacketReader reader(header);
+  return reader.packetSize();
 }
 }  // namespace tes
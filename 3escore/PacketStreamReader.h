@@ -12,18 +12,26 @@
 #include <cinttypes>
 #include <istream>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace tes
 {
+class MappedFile;
 struct PacketHeader;
 
-/// A utility class which reads packets from a std::istream .
+/// A utility class which reads packets from a std::istream or a memory mapped file.
 ///
 /// This collects bytes until a full packet is collected whenever
 /// @c extractPacket() is called, provided there are sufficient bytes available.
 /// A @c PacketReader is still required to decode the contents of the resulting
 /// @c PacketHeader data.
+///
+/// Files opened via @c open() are memory mapped where supported - see @c MappedFile - in which
+/// case @c extractPacket() returns pointers directly into the mapping without copying. Otherwise,
+/// bytes are read from the stream into a buffer. Extracted packets are consumed by advancing
+/// through the buffer, which is only compacted once the consumed bytes outnumber the remaining
+/// bytes, so each byte is moved at most once on average. This supports non-seekable streams.
 class TES_CORE_API PacketStreamReader
 {
 public:
@@ -34,18 +42,40 @@ public:
   PacketStreamReader(std::shared_ptr<std::istream> stream);
   ~PacketStreamReader();
 
-  /// Check if the stream is ok for more reading.
+  /// Check if the stream is ok for more reading. Reaching the end of the stream is not an error.
   /// @return True if ok to read on.
-  [[nodiscard]] bool isOk() const { return _stream && _stream->good(); }
+  [[nodiscard]] bool isOk() const
+  {
+    return _stream && !_stream->bad() && (!_stream->fail() || _stream->eof());
+  }
 
-  /// Check if the stream is at the end of file.
+  /// Check if the stream is at the end of file and there are no more packets to extract.
   /// @return True if at end of file.
-  [[nodiscard]] bool isEof() const { return !_stream || _stream->eof(); }
+  [[nodiscard]] bool isEof() const;
+
+  /// Open the file at @p path for reading, memory mapping the file if possible.
+  ///
+  /// Falls back to reading via a @c std::ifstream when mapping is not supported or fails.
+  /// @param path The file to read.
+  /// @return True if the file has been opened.
+  bool open(const std::string &path);
+
+  /// Check if reading from a memory mapped file. See @c open() .
+  /// @return True when memory mapped.
+  [[nodiscard]] bool isMapped() const { return _mapped != nullptr; }
+
+  /// Access the memory mapped file when @c isMapped() . Packets from @c extractPacket() reference
+  /// this mapping, so holding the pointer keeps them valid beyond the next extraction.
+  /// @return The mapped file, or null when not mapped.
+  [[nodiscard]] std::shared_ptr<const MappedFile> mappedFile() const { return _mapped; }
 
   /// (Re)set the stream to read from.
   /// @param stream The stream to read from.
   void setStream(std::shared_ptr<std::istream> stream);
   /// Get the stream in use.
+  ///
+  /// For a memory mapped file, this is a seekable stream over the mapped bytes. It is not used to
+  /// extract packets.
   /// @return The current stream - may be null.
   [[nodiscard]] std::shared_ptr<std::istream> stream() const { return _stream; }
 
@@ -53,9 +83,26 @@ public:
   /// valid until the next call to @c extractPacket(). This object retains the
   /// ownership.
   ///
+  /// Bytes preceding a packet marker are skipped. Incomplete data at the end of the stream is
+  /// discarded. A header with a @c PFExtended payload size larger than
+  /// @c maxExtendedPayloadSize() is considered corrupt and skipped, resynchronising on the next
+  /// marker.
+  ///
   /// @return The next packet or null on failure. Check status on failure.
   const PacketHeader *extractPacket();
 
+  /// Set the largest @c PFExtended payload size to accept. This bounds the memory used to buffer
+  /// a packet with a corrupt payload size.
+  /// @param max_payload_size The payload size limit (bytes).
+  void setMaxExtendedPayloadSize(uint32_t max_payload_size)
+  {
+    _max_extended_payload_size = max_payload_size;
+  }
+
+  /// Query the largest @c PFExtended payload size to accept.
+  /// @return The payload size limit (bytes). Defaults to @c kPacketDefaultMaxExtendedPayloadSize .
+  [[nodiscard]] uint32_t maxExtendedPayloadSize() const { return _max_extended_payload_size; }
+
   /// Seek to the given stream position.
   ///
   /// This clears the current data buffer, invalidating results from @c extractPacket().
@@ -63,22 +110,104 @@ public:
   /// @param position The stream byte offset to seek to.
   void seek(std::istream::pos_type position);
 
+  /// Load the frame index from the end of the stream, if present. The current read position is
+  /// preserved. See @c streamutil::readFrameIndex() .
+  ///
+  /// Streams without a frame index are still readable, but @c seekFrame() is limited to the
+  /// stream start.
+  ///
+  /// @return True if the stream has a frame index.
+  bool loadFrameIndex();
+
+  /// Check if a frame index has been loaded via @c loadFrameIndex() .
+  /// @return True if a frame index is available.
+  [[nodiscard]] bool hasFrameIndex() const { return _have_frame_index; }
+
+  /// Query the number of frames in the frame index.
+  /// @return The number of indexed frames. Zero without a frame index.
+  [[nodiscard]] uint32_t indexedFrameCount() const
+  {
+    return static_cast<uint32_t>(_frame_offsets.size());
+  }
+
+  /// Seek to the end of @p frame using the frame index, so the next packet extracted follows the
+  /// @c CIdFrame message which ends @p frame . Frame zero is the stream start.
+  ///
+  /// As for @c seek() , this clears the current data buffer. Note that the scene state at
+  /// @p frame must be restored separately; this only positions the stream.
+  ///
+  /// @param frame The frame number to seek to.
+  /// @return True on success, false if @p frame is not in the frame index.
+  bool seekFrame(uint32_t frame);
+
+  /// Query the stream byte offset immediately following the last packet returned by
+  /// @c extractPacket() . This is where the next packet is read from, and is suitable for use with
+  /// @c seek() .
+  ///
+  /// Offsets are relative to the stream position on @c setStream() , which is generally the
+  /// stream start.
+  /// @return The stream offset after the last extracted packet.
+  [[nodiscard]] uint64_t position() const { return _buffer_offset + _extracted_size; }
+
 private:
+  /// Extract the next packet from the mapped file.
+  const PacketHeader *extractMapped();
+  /// Extract the next packet from the stream buffer.
+  const PacketHeader *extractBuffered();
+
+  /// Read at least @p more_count bytes into the buffer, compacting the buffer first if required.
+  /// @return The number of bytes read.
   size_t readMore(size_t more_count);
-  bool checkMarker(std::vector<uint8_t> &buffer, size_t i);
-  /// Consume the packet at the head of the buffer (if valid and able).
+  /// Ensure at least @p byte_count unconsumed bytes are buffered, reading more as required.
+  /// @return True if @p byte_count bytes are available.
+  bool ensureBuffered(size_t byte_count);
+  /// Discard @p byte_count unconsumed bytes from the buffer head.
+  void discard(size_t byte_count);
+
+  /// Find the first packet marker in @p data .
+  /// @return The marker byte offset, or @p byte_count when not found.
+  size_t findMarker(const uint8_t *data, size_t byte_count) const;
+
+  /// Consume the packet last returned by @c extractPacket() .
   void consume();
 
-  /// Calculate the expected packet size for the packet at the head of the buffer.
+  /// Check the payload size of @p header is within the @c maxExtendedPayloadSize() .
+  ///
+  /// Only valid to call when the full header is available - see @c calcHeaderSize() .
+  /// @return True if the size is acceptable.
+  [[nodiscard]] bool validSize(const PacketHeader *header) const;
+
+  /// Calculate the full header size for @p header , including the extended payload size where
+  /// present. See @c PFExtended .
+  ///
+  /// Only valid to call when there is at least a full @c PacketHeader .
+  /// @return The header size plus @c PacketHeader::payload_offset .
+  static size_t calcHeaderSize(const PacketHeader *header);
+
+  /// Calculate the expected packet size for @p header .
   ///
-  /// Only valid to call when we have a verified header at the _buffer start.
+  /// Only valid to call when the full header is available - see @c calcHeaderSize() .
   /// @return The expected packet size including payload as indicated by the packet header.
-  size_t calcExpectedSize();
+  static size_t calcExpectedSize(const PacketHeader *header);
 
   std::shared_ptr<std::istream> _stream;
+  /// The memory mapped file when reading via @c open() . Shared with the @c _stream .
+  std::shared_ptr<const MappedFile> _mapped;
   std::array<uint8_t, sizeof(tes::kPacketMarker)> _marker_bytes;
+  /// Stream bytes read, but not yet consumed from @c _head onwards. Unused when mapped.
   std::vector<uint8_t> _buffer;
+  /// Index of the first unconsumed byte in @c _buffer .
+  size_t _head = 0;
+  /// Frame offsets loaded by @c loadFrameIndex() .
+  std::vector<uint64_t> _frame_offsets;
+  /// Stream offset of the first unconsumed byte. This is @c _buffer[_head] when buffered.
+  uint64_t _buffer_offset = 0;
+  /// Size of the packet last returned by @c extractPacket() , which is yet to be consumed.
+  size_t _extracted_size = 0;
   size_t _chunk_size = 1024u;
+  /// Largest accepted @c PFExtended payload size.
+  uint32_t _max_extended_payload_size = kPacketDefaultMaxExtendedPayloadSize;
+  bool _have_frame_index = false;
 };
 }  // namespace tes
 
@@ -6,6 +6,7 @@
 #include "Crc.h"
 #include "Endian.h"
 
+#include <algorithm>
 #include <cstring>
 #include <utility>
 
@@ -14,7 +15,7 @@ namespace tes
 PacketWriter::PacketWriter(PacketHeader *packet, uint16_t max_payload_size, uint16_t routing_id,
                            uint16_t message_id)
   : PacketStream<PacketHeader>(packet)
-  , _buffer_size(static_cast<uint16_t>(max_payload_size + sizeof(PacketHeader)))
+  , _buffer_size(static_cast<uint32_t>(max_payload_size + sizeof(PacketHeader)))
 {
   _packet->marker = kPacketMarker;
   _packet->version_major = kPacketVersionMajor;
@@ -27,7 +28,7 @@ PacketWriter::PacketWriter(PacketHeader *packet, uint16_t max_payload_size, uint
 }
 
 
-PacketWriter::PacketWriter(uint8_t *buffer, uint16_t buffer_size, uint16_t routing_id,
+PacketWriter::PacketWriter(uint8_t *buffer, uint32_t buffer_size, uint16_t routing_id,
                            uint16_t message_id)
   : PacketStream<PacketHeader>(reinterpret_cast<PacketHeader *>(buffer))
 {
@@ -54,6 +55,8 @@ PacketWriter::PacketWriter(uint8_t *buffer, uint16_t buffer_size, uint16_t routi
 PacketWriter::PacketWriter(const PacketWriter &other)
   : PacketStream<PacketHeader>(reinterpret_cast<PacketHeader *>(other._packet))
   , _buffer_size(other._buffer_size)
+  , _little_endian(other._little_endian)
+  , _extended(other._extended)
 {
   _status = other._status;
   _payload_position = other._payload_position;
@@ -67,6 +70,8 @@ PacketWriter::PacketWriter(PacketWriter &&other) noexcept
   _status = std::exchange(other._status, Ok);
   _payload_position = std::exchange(other._payload_position, 0);
   _buffer_size = std::exchange(other._buffer_size, 0);
+  _little_endian = std::exchange(other._little_endian, false);
+  _extended = std::exchange(other._extended, false);
 }
 
 
@@ -83,6 +88,8 @@ void PacketWriter::swap(PacketWriter &other)
   std::swap(_status, other._status);
   std::swap(_payload_position, other._payload_position);
   std::swap(_buffer_size, other._buffer_size);
+  std::swap(_little_endian, other._little_endian);
+  std::swap(_extended, other._extended);
 }
 
 
@@ -93,9 +100,8 @@ void PacketWriter::reset(uint16_t routing_id, uint16_t message_id)
   {
     _packet->routing_id = networkEndianSwapValue(routing_id);
     _packet->message_id = networkEndianSwapValue(message_id);
-    _packet->payload_size = 0u;
-    _packet->payload_offset = 0u;
-    _packet->flags = 0u;
+    _packet->flags = (_little_endian) ? static_cast<uint8_t>(PFLittleEndian) : 0u;
+    initPayload();
     _payload_position = 0;
   }
   else
@@ -105,15 +111,45 @@ void PacketWriter::reset(uint16_t routing_id, uint16_t message_id)
 }
 
 
-uint16_t PacketWriter::bytesRemaining() const
+void PacketWriter::setLittleEndian(bool little_endian)
+{
+  _little_endian = little_endian;
+  if (!isFail())
+  {
+    _packet->flags = (little_endian) ? static_cast<uint8_t>(_packet->flags | PFLittleEndian) :
+                                       static_cast<uint8_t>(_packet->flags & ~PFLittleEndian);
+    invalidateCrc();
+  }
+}
+
+
+void PacketWriter::setExtended(bool extended)
+{
+  _extended = extended;
+  if (!isFail())
+  {
+    initPayload();
+    _payload_position = 0;
+    invalidateCrc();
+  }
+}
+
+
+uint32_t PacketWriter::bytesRemaining() const
 {
-  return static_cast<uint16_t>(maxPayloadSize() - payloadSize());
+  return maxPayloadSize() - payloadSize();
 }
 
 
-uint16_t PacketWriter::maxPayloadSize() const
+uint32_t PacketWriter::maxPayloadSize() const
 {
-  return (!isFail()) ? static_cast<uint16_t>(_buffer_size - sizeof(PacketHeader)) : 0u;
+  if (isFail() || _buffer_size < headerSize())
+  {
+    return 0u;
+  }
+
+  const uint32_t available = _buffer_size - headerSize();
+  return (extended()) ? available : std::min(available, kPacketMaxPayloadSize);
 }
 
 
@@ -158,7 +194,7 @@ PacketWriter::CrcType PacketWriter::calculateCrc()
   }
 
   const CrcType crc_val =
-    crc16(reinterpret_cast<const uint8_t *>(_packet), sizeof(PacketHeader) + payloadSize());
+    crc16(reinterpret_cast<const uint8_t *>(_packet), size_t(headerSize()) + payloadSize());
   *crc_pos = networkEndianSwapValue(crc_val);
   _status |= CrcValid;
   return *crc_pos;
@@ -169,9 +205,15 @@ size_t PacketWriter::writeElement(const uint8_t *bytes, size_t element_size)
 {
   if (bytesRemaining() >= element_size)
   {
-    memcpy(payloadWritePtr(), bytes, element_size);
-    networkEndianSwap(payloadWritePtr(), element_size);
-    _payload_position = static_cast<uint16_t>(_payload_position + element_size);
+    if (payloadEndianSwap())
+    {
+      endianSwapCopy(payloadWritePtr(), bytes, element_size, 1);
+    }
+    else
+    {
+      memcpy(payloadWritePtr(), bytes, element_size);
+    }
+    _payload_position = static_cast<uint32_t>(_payload_position + element_size);
     incrementPayloadSize(element_size);
     return element_size;
   }
@@ -186,16 +228,18 @@ size_t PacketWriter::writeArray(const uint8_t *bytes, size_t element_size, size_
   if (copy_count > 0)
   {
     copy_count = (copy_count > element_count) ? element_count : copy_count;
-    memcpy(payloadWritePtr(), bytes, copy_count * element_size);
-#if !TES_IS_NETWORK_ENDIAN
-    uint8_t *fix_bytes = payloadWritePtr();
-    for (unsigned i = 0; i < copy_count; ++i, fix_bytes += element_size)
+    // Little endian payloads on a little endian platform are a straight copy. Otherwise swap while
+    // copying.
+    if (payloadEndianSwap() && element_size > 1)
+    {
+      endianSwapCopy(payloadWritePtr(), bytes, element_size, copy_count);
+    }
+    else
     {
-      networkEndianSwap(fix_bytes, element_size);
+      memcpy(payloadWritePtr(), bytes, copy_count * element_size);
     }
-#endif  // !TES_IS_NETWORK_ENDIAN
     incrementPayloadSize(element_size * copy_count);
-    _payload_position = static_cast<uint16_t>(_payload_position + element_size * copy_count);
+    _payload_position = static_cast<uint32_t>(_payload_position + element_size * copy_count);
     return copy_count;
   }
 
@@ -208,15 +252,47 @@ size_t PacketWriter::writeRaw(const uint8_t *bytes, size_t byte_count)
   const size_t copy_count = (byte_count <= bytesRemaining()) ? byte_count : bytesRemaining();
   memcpy(payloadWritePtr(), bytes, copy_count);
   incrementPayloadSize(copy_count);
-  _payload_position = static_cast<uint16_t>(_payload_position + copy_count);
+  _payload_position = static_cast<uint32_t>(_payload_position + copy_count);
   return copy_count;
 }
 
 
 void PacketWriter::incrementPayloadSize(size_t inc)
 {
-  _packet->payload_size = static_cast<uint16_t>(payloadSize() + inc);
-  networkEndianSwap(_packet->payload_size);
+  setPayloadSize(static_cast<uint32_t>(payloadSize() + inc));
   invalidateCrc();
 }
+
+
+void PacketWriter::setPayloadSize(uint32_t payload_size)
+{
+  if (extended())
+  {
+    _packet->payload_size = 0u;
+    const uint32_t network_size = networkEndianSwapValue(payload_size);
+    std::memcpy(reinterpret_cast<uint8_t *>(_packet) + sizeof(PacketHeader), &network_size,
+                sizeof(network_size));
+  }
+  else
+  {
+    _packet->payload_size = networkEndianSwapValue(static_cast<uint16_t>(payload_size));
+  }
+}
+
+
+void PacketWriter::initPayload()
+{
+  // The 32-bit size must fit in the buffer along with the header.
+  if (_extended && _buffer_size >= sizeof(PacketHeader) + kPacketExtendedSizeBytes)
+  {
+    _packet->flags = static_cast<uint8_t>(_packet->flags | PFExtended);
+    _packet->payload_offset = static_cast<uint8_t>(kPacketExtendedSizeBytes);
+  }
+  else
+  {
+    _packet->flags = static_cast<uint8_t>(_packet->flags & ~PFExtended);
+    _packet->payload_offset = 0u;
+  }
+  setPayloadSize(0u);
+}
 }  // namespace tes
@@ -28,9 +28,9 @@ namespace tes
 /// The buffer size must be large enough for the @ PacketHeader. Remaining space is available
 /// for the payload.
 ///
-/// @bug Use the payloadOffset in various calculations herein. It was added after this
-/// class was written, but is currently only supported as being zero, so it's not an issue
-/// yet.
+/// Payloads are limited to @c kPacketMaxPayloadSize bytes unless @c setExtended() is used to
+/// write @c PFExtended packets with a 32-bit payload size. Extended packets require a buffer
+/// larger than 64KiB to be of use.
 class TES_CORE_API PacketWriter : public PacketStream<PacketHeader>
 {
 public:
@@ -60,9 +60,9 @@ public:
   /// @param buffer The packet data buffer.
   /// @param buffer_size The total number of bytes available for the @c PacketHeader
   ///   and its paylaod. Must be at least @c sizeof(PacketHeader), or all writing
-  ///   will fail.
+  ///   will fail. Only @c setExtended() packets may use more than 64KiB.
   /// @param routing_id Optionlly sets the @c routing_id member of the packet.
-  PacketWriter(uint8_t *buffer, uint16_t buffer_size, uint16_t routing_id = 0,
+  PacketWriter(uint8_t *buffer, uint32_t buffer_size, uint16_t routing_id = 0,
                uint16_t message_id = 0);
 
   /// Copy constructor. Simple as neither writer owns the underlying memory.
@@ -95,6 +95,27 @@ public:
   /// @overload
   inline void reset() { reset(0, 0); }
 
+  /// Select the payload byte order. With @p little_endian , @c PFLittleEndian is set and payload
+  /// data are written in little endian byte order. Otherwise network byte order is used.
+  ///
+  /// The byte order persists across @c reset() calls. This should only be changed before writing
+  /// payload data, but takes effect immediately.
+  /// @param little_endian True to write little endian payloads.
+  void setLittleEndian(bool little_endian);
+
+  /// Query the payload byte order. See @c setLittleEndian() .
+  /// @return True if writing little endian payloads.
+  [[nodiscard]] bool littleEndian() const { return _little_endian; }
+
+  /// Select @c PFExtended packets with a 32-bit payload size. This allows the payload to use the
+  /// full buffer, beyond @c kPacketMaxPayloadSize bytes, at a cost of @c kPacketExtendedSizeBytes
+  /// bytes per packet.
+  ///
+  /// The setting persists across @c reset() calls. This must be changed before writing payload
+  /// data; the payload is cleared.
+  /// @param extended True to write extended packets.
+  void setExtended(bool extended);
+
   void setRoutingId(uint16_t routing_id);
   [[nodiscard]] PacketHeader &packet() const;
 
@@ -107,12 +128,12 @@ public:
   /// Returns the number of bytes remaining available in the payload.
   /// This is calculated as the @c maxPayloadSize() - @c payloadSize().
   /// @return Number of bytes remaining available for write.
-  [[nodiscard]] uint16_t bytesRemaining() const;
+  [[nodiscard]] uint32_t bytesRemaining() const;
 
   /// Returns the size of the payload buffer. This is the maximum number of bytes
   /// which can be written to the payload.
   /// @return The payload buffer size (bytes).
-  [[nodiscard]] uint16_t maxPayloadSize() const;
+  [[nodiscard]] uint32_t maxPayloadSize() const;
 
   /// Finalises the packet for sending, calculating the CRC.
   /// @return True if the packet is valid and ready for sending.
@@ -181,7 +202,15 @@ protected:
   uint8_t *payloadWritePtr();
   void incrementPayloadSize(size_t inc);
 
-  uint16_t _buffer_size = 0;
+  /// Write the payload size, to @c PacketHeader::payload_size or after the header for
+  /// @c PFExtended packets.
+  void setPayloadSize(uint32_t payload_size);
+  /// Initialise the @c PacketHeader flags, payload offset and size for an empty payload.
+  void initPayload();
+
+  uint32_t _buffer_size = 0;
+  bool _little_endian = false;  ///< Write payloads in little endian with @c PFLittleEndian ?
+  bool _extended = false;       ///< Write @c PFExtended packets?
 };
 
 inline void PacketWriter::setRoutingId(uint16_t routing_id)
@@ -201,7 +230,7 @@ inline const uint8_t *PacketWriter::data() const
 
 inline uint8_t *PacketWriter::payload()
 {
-  return reinterpret_cast<uint8_t *>(_packet) + sizeof(PacketHeader);
+  return reinterpret_cast<uint8_t *>(_packet) + headerSize();
 }
 
 template <typename T>
@@ -6,4 +6,10 @@
 namespace tes
 {
 Resource::~Resource() = default;
+
+
+uint64_t Resource::estimateTransferSize() const
+{
+  return 0;
+}
 }  // namespace tes
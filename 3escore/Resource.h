@@ -104,6 +104,13 @@ public:
   virtual int transfer(PacketWriter &packet, unsigned byte_limit,
                        TransferProgress &progress) const = 0;
 
+  /// Estimate the number of bytes @c transfer() will write in total. Used to schedule transfers
+  /// so that small resources are sent ahead of large ones.
+  ///
+  /// The default implementation returns zero.
+  /// @return The approximate number of data bytes to transfer, or zero if unknown.
+  [[nodiscard]] virtual uint64_t estimateTransferSize() const;
+
   /// Read the @c OIdCreate message for this resource.
   ///
   /// This reads what the @c create() function writes.
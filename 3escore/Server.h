@@ -30,9 +30,85 @@ enum ServerFlag : uint32_t
   SFNakedFrameMessage = (1u << 0u),
   /// Set to collate outgoing messages into larger packets.
   SFCollate = (1u << 1u),
-  /// Set to compress collated outgoing packets using GZip compression.
+  /// Set to compress collated outgoing packets using the @c ServerSettings::compression_codec .
   /// Has no effect if @c SFCollate is not set or if the library is not built against ZLib.
   SFCompress = (1u << 2u),
+  /// Send data to TCP connections from a dedicated thread per connection.
+  ///
+  /// Outgoing bytes are pushed into a bounded ring buffer for each connection and drained to the
+  /// socket on a sender thread. This isolates the calling thread from slow clients. Behaviour when
+  /// the ring buffer is full is controlled by @c ServerSettings::send_overflow .
+  SFAsyncSend = (1u << 3u),
+  /// Prime collated packet compression using the preset collation dictionary. This improves the
+  /// compression of small packets. Advertised to clients by setting @c SIFCompressionDictionary in
+  /// the @c ServerInfoMessage . Has no effect without @c SFCompress .
+  SFCompressionDictionary = (1u << 4u),
+  /// Elide the CRC of packets nested in a collated packet, setting @c PFNoCrc instead. The
+  /// collated packet CRC already covers the nested packets, so this avoids checksumming each byte
+  /// twice and saves two bytes per nested packet. Has no effect without @c SFCollate .
+  SFNestedNoCrc = (1u << 5u),
+  /// Write packet payloads in little endian byte order, setting @c PFLittleEndian . This avoids
+  /// per element byte swapping of payload arrays on little endian platforms. Advertised to clients
+  /// by setting @c SIFLittleEndian in the @c ServerInfoMessage . Clients must support
+  /// @c PFLittleEndian .
+  SFLittleEndian = (1u << 6u),
+  /// Support concurrent shape @c create() , @c update() and @c destroy() calls from multiple
+  /// threads without serialising on the server lock.
+  ///
+  /// Shape messages are encoded on the calling thread into a thread local staging buffer and
+  /// delivered to the connections during the next @c updateFrame() call. Message order is
+  /// preserved for each calling thread, and all messages submitted before @c updateFrame() are
+  /// delivered in that frame. Messages from different threads may be interleaved. Other messages,
+  /// such as those sent via @c send() , are sent immediately so are not ordered with respect to the
+  /// deferred shape messages.
+  ///
+  /// Shape calls return the number of bytes encoded rather than the number of bytes sent.
+  SFMultiProducer = (1u << 7u),
+  /// Retain the state of live persistent shapes and their resources to initialise late joining
+  /// connections.
+  ///
+  /// The server caches the encoded create message and subsequent updates for each persistent
+  /// shape along with the resources referenced by shapes or via @c referenceResource() . New
+  /// connections are sent this snapshot immediately after the server info, before the connection
+  /// callback is invoked. Cache memory is bounded by @c ServerSettings::retained_state_limit ;
+  /// see @c RetainedStateStats .
+  SFRetainState = (1u << 8u),
+  /// Cork TCP connections between frames so each frame is sent in as few TCP segments as
+  /// possible.
+  ///
+  /// Without corking, each socket write may be sent as a partially filled segment. With corking,
+  /// partial segments are held back until the end of the frame - the @c CIdFrame message - when
+  /// the connection is uncorked to push out the remaining data. Full segments are sent as usual.
+  /// Messages sent with @c allow_collation false - such as @c CIdEnd - are also flushed.
+  /// Uses @c TCP_CORK where available ( @c TCP_NOPUSH on BSD platforms ) and has no effect
+  /// elsewhere. Note the operating system may limit how long data are held back; Linux sends
+  /// corked data after 200ms.
+  SFCorkFrames = (1u << 9u),
+  /// Transfer resources - mesh and point cloud data - using extended packets which may exceed the
+  /// 64KiB packet size limit. See @c PFExtended .
+  ///
+  /// Each resource transfer packet may hold up to @c ServerSettings::extended_buffer_size bytes,
+  /// so large resources are sent in fewer, larger packets. Packets too large to collate are sent
+  /// individually. Each data message still carries at most 65535 elements. Clients must support
+  /// @c PFExtended packets.
+  SFExtendedPackets = (1u << 10u),
+  /// Share encoded resource transfers across connections.
+  ///
+  /// The server caches the packets generated by the first connection to transfer a resource. Other
+  /// connections - including later connections - replay the cached packets rather than encoding
+  /// the resource again. Connections which start the transfer before the first completes encode
+  /// the resource themselves. An entry is evicted once no connection or retained state references
+  /// the resource. Cache memory is bounded by @c ServerSettings::resource_cache_limit ; see
+  /// @c ResourceCacheStats .
+  SFResourceCache = (1u << 11u),
+  /// Write file stream connections from a dedicated thread per connection.
+  ///
+  /// Outgoing bytes are copied into large blocks - see @c ServerSettings::file_block_size - which
+  /// are written to disk on a writer thread once full. This isolates the calling thread from slow
+  /// storage. Buffered memory is bounded by @c ServerSettings::file_buffer_limit with the
+  /// @c ServerSettings::file_overflow policy applied when the limit is reached. See
+  /// @c Connection::fileWriteStats() .
+  SFBufferedFileWrite = (1u << 12u),
 
   /// The combination of @c SFCollate and @c SFCompress
   SFCollateAndCompress = SFCollate | SFCompress,
@@ -44,6 +120,62 @@ enum ServerFlag : uint32_t
   SFDefaultNoCompression = (SFDefault & ~SFCompress),
 };
 
+/// Policy applied when an asynchronous connection send buffer is full. See @c SFAsyncSend and
+/// @c SFBufferedFileWrite .
+enum SendOverflow : uint16_t
+{
+  /// Block the calling thread until there is space in the send buffer.
+  SOBlock,
+  /// Drop create messages for transient shapes when the send buffer is full, blocking for other
+  /// messages. Transient shapes are only valid for one frame so may be skipped without corrupting
+  /// the client state.
+  SODropTransient,
+  /// Disconnect the client when the send buffer overflows.
+  SODisconnect,
+};
+
+/// Statistics for the server's retained scene state. See @c SFRetainState .
+struct TES_CORE_API RetainedStateStats
+{
+  /// Number of shapes currently retained.
+  uint64_t shape_count = 0;
+  /// Number of resources currently retained.
+  uint64_t resource_count = 0;
+  /// Number of bytes of encoded shape messages retained. Retained resources are not counted. With
+  /// @c SFResourceCache , their encoded transfers are bounded by
+  /// @c ServerSettings::resource_cache_limit instead.
+  uint64_t byte_count = 0;
+  /// Peak value of @c byte_count .
+  uint64_t peak_byte_count = 0;
+  /// The configured limit on @c byte_count . See @c ServerSettings::retained_state_limit .
+  uint64_t byte_limit = 0;
+  /// Number of shapes which could not be retained - or were evicted - due to the @c byte_limit .
+  /// Late joining connections will not see these shapes.
+  uint64_t dropped_shapes = 0;
+  /// Number of snapshots sent to new connections.
+  uint64_t snapshot_count = 0;
+  /// Total number of shape message bytes sent in snapshots.
+  uint64_t snapshot_bytes = 0;
+};
+
+/// Statistics for the server's encoded resource cache. See @c SFResourceCache .
+struct TES_CORE_API ResourceCacheStats
+{
+  /// Number of resources currently cached.
+  uint64_t resource_count = 0;
+  /// Number of encoded bytes cached.
+  uint64_t byte_count = 0;
+  /// The configured limit on @c byte_count . See @c ServerSettings::resource_cache_limit .
+  uint64_t byte_limit = 0;
+  /// Number of transfers which replayed cached packets.
+  uint64_t hits = 0;
+  /// Number of transfers which recorded a resource into the cache - or attempted to.
+  uint64_t misses = 0;
+  /// Number of transfers which bypassed the cache because the resource was too large to cache or
+  /// was still being recorded by another connection.
+  uint64_t uncached = 0;
+};
+
 /// Settings used to create the server.
 struct TES_CORE_API ServerSettings
 {
@@ -52,6 +184,22 @@ struct TES_CORE_API ServerSettings
   /// Default server buffer size per client.
   static constexpr uint16_t kDefaultBufferSize = 0xffe0u;
   static constexpr uint32_t kDefaultAsyncTimeoutMs = 5000u;
+  /// Default size of the per connection send buffer with @c SFAsyncSend .
+  static constexpr uint32_t kDefaultAsyncSendBufferSize = 4u * 1024u * 1024u;
+  /// Default limit on the retained scene state with @c SFRetainState .
+  static constexpr uint64_t kDefaultRetainedStateLimit = 64u * 1024u * 1024u;
+  /// Default resource transfer buffer size with @c SFExtendedPackets .
+  static constexpr uint32_t kDefaultExtendedBufferSize = 1024u * 1024u;
+  /// Default number of concurrent resource transfers per connection.
+  static constexpr uint16_t kDefaultTransferConcurrency = 4u;
+  /// Default limit on the encoded resource cache with @c SFResourceCache .
+  static constexpr uint64_t kDefaultResourceCacheLimit = 256u * 1024u * 1024u;
+  /// Default ring buffer size for shared memory connections.
+  static constexpr uint32_t kDefaultSharedMemorySize = 8u * 1024u * 1024u;
+  /// Default block size for @c SFBufferedFileWrite .
+  static constexpr uint32_t kDefaultFileBlockSize = 4u * 1024u * 1024u;
+  /// Default buffered memory limit for @c SFBufferedFileWrite .
+  static constexpr uint64_t kDefaultFileBufferLimit = 32u * 1024u * 1024u;
 
   /// First port to try listening on.
   uint16_t listen_port = kDefaultPort;
@@ -66,6 +214,48 @@ struct TES_CORE_API ServerSettings
   uint16_t client_buffer_size = kDefaultBufferSize;
   /// Compression level to use if enabled. See @c CompressionLevel.
   uint16_t compression_level = ClDefault;
+  /// Codec used to compress collated packets with @c SFCompress . See @c CompressionCodec . Falls
+  /// back to @c CCDeflate if the codec is not available in this build. Clients must support the
+  /// codec to decode the stream; see @c TFeatureCompressionLz4 and @c TFeatureCompressionZstd .
+  uint16_t compression_codec = CCDefault;
+  /// Size of the per connection send buffer (bytes) with @c SFAsyncSend . This is raised as
+  /// required to hold at least two @c client_buffer_size packets.
+  uint32_t async_send_buffer_size = kDefaultAsyncSendBufferSize;
+  /// @c SendOverflow policy used with @c SFAsyncSend .
+  uint16_t send_overflow = SOBlock;
+  /// Number of worker threads used to finalise - compress and CRC - collated packets off the
+  /// calling thread. The workers are shared by all connections and each connection forwards its
+  /// packets in order. Zero finalises collated packets on the calling thread. Only used with
+  /// @c SFCollate .
+  uint16_t compression_threads = 0;
+  /// Limit on the number of bytes of encoded shape messages retained with @c SFRetainState .
+  uint64_t retained_state_limit = kDefaultRetainedStateLimit;
+  /// Size of the per connection resource transfer buffer (bytes) with @c SFExtendedPackets . This
+  /// bounds the size of each resource transfer packet.
+  uint32_t extended_buffer_size = kDefaultExtendedBufferSize;
+  /// Maximum number of resources each connection transfers concurrently at the same priority. A
+  /// higher priority resource may start beyond this limit, up to twice the limit. See
+  /// @c Connection::updateTransfers() .
+  uint16_t transfer_concurrency = kDefaultTransferConcurrency;
+  /// Wall clock budget for each @c Connection::updateTransfers() call per connection
+  /// (microseconds). A call stops sending resource data once the budget is spent, even with a zero
+  /// byte limit. Zero for no time limit.
+  uint32_t transfer_time_budget_us = 0;
+  /// Limit on the number of bytes of encoded resource packets cached with @c SFResourceCache .
+  uint64_t resource_cache_limit = kDefaultResourceCacheLimit;
+  /// Ring buffer size (bytes) for each shared memory connection. See
+  /// @c ConnectionMonitor::openSharedMemory() .
+  uint32_t shared_memory_size = kDefaultSharedMemorySize;
+  /// Size of the blocks written to disk by file stream connections with @c SFBufferedFileWrite
+  /// (bytes).
+  uint32_t file_block_size = kDefaultFileBlockSize;
+  /// Limit on the memory each file stream connection may use to buffer blocks with
+  /// @c SFBufferedFileWrite (bytes). This is raised as required to hold at least two blocks so
+  /// one block may be filled while another is written.
+  uint64_t file_buffer_limit = kDefaultFileBufferLimit;
+  /// @c SendOverflow policy used with @c SFBufferedFileWrite once @c file_buffer_limit is reached.
+  /// @c SODisconnect stops recording, closing the file stream.
+  uint16_t file_overflow = SOBlock;
 
   ServerSettings() = default;
   ServerSettings(uint32_t flags, uint16_t port = kDefaultPort,
@@ -125,6 +315,27 @@ public:
 
   /// @overload
   [[nodiscard]] virtual std::shared_ptr<const Connection> connection(unsigned index) const = 0;
+
+  /// Query statistics for the retained scene state used to initialise late joining connections.
+  ///
+  /// @param[out] stats Set to the current statistics on success.
+  /// @return True if the server retains state (see @c SFRetainState ) and @p stats has been set.
+  virtual bool retainedStateStats(RetainedStateStats &stats) const
+  {
+    TES_UNUSED(stats);
+    return false;
+  }
+
+  /// Query statistics for the encoded resource cache shared by connections.
+  ///
+  /// @param[out] stats Set to the current statistics on success.
+  /// @return True if the server caches resources (see @c SFResourceCache ) and @p stats has been
+  ///   set.
+  virtual bool resourceCacheStats(ResourceCacheStats &stats) const
+  {
+    TES_UNUSED(stats);
+    return false;
+  }
 };
 }  // namespace tes
 
@@ -0,0 +1,161 @@
+//
+// author: Kazys Stepanas
+//
+#include "SharedMemoryReader.h"
+
+#include "PacketReader.h"
+#include "SharedMemoryRing.h"
+
+#include <algorithm>
+
+namespace tes
+{
+SharedMemoryReader::SharedMemoryReader(SharedMemoryRing &ring)
+  : _ring(ring)
+{}
+
+
+SharedMemoryReader::~SharedMemoryReader()
+{
+  _ring.releaseRead(_release);
+}
+
+
+const PacketHeader *SharedMemoryReader::extractPacket(unsigned timeout_ms)
+{
+  // Release the last packet.
+  _ring.releaseRead(_release);
+  _release = 0;
+  if (!_copying)
+  {
+    _wrapped.clear();
+  }
+
+  while (_ok && !_eof)
+  {
+    if (_copying)
+    {
+      return copyPacket(timeout_ms);
+    }
+
+    const uint8_t *data = nullptr;
+    const size_t available = _ring.acquireRead(data, _required, timeout_ms);
+    if (available == 0)
+    {
+      _eof = _ring.writerClosed() && _ring.readableBytes() == 0;
+      return nullptr;
+    }
+
+    const size_t packet_size = packetSize(data, available);
+    if (packet_size == 0)
+    {
+      _ok = false;
+      return nullptr;
+    }
+
+    if (packet_size <= available)
+    {
+      // Complete in place.
+      _release = packet_size;
+      _required = 1;
+      return reinterpret_cast<const PacketHeader *>(data);
+    }
+
+    const size_t readable = _ring.readableBytes();
+    if (readable >= packet_size || packet_size > _ring.capacity())
+    {
+      // The packet wraps the end of the ring or can never fit in the ring. Copy it out.
+      _copying = true;
+      _required = 1;
+      continue;
+    }
+
+    if (_ring.writerClosed())
+    {
+      // Incomplete data at the end of the stream.
+      _eof = true;
+      return nullptr;
+    }
+
+    // Wait for the rest of the packet.
+    _required = packet_size;
+  }
+
+  return nullptr;
+}
+
+
+size_t SharedMemoryReader::packetSize(const uint8_t *bytes, size_t byte_count) const
+{
+  if (byte_count < sizeof(PacketHeader))
+  {
+    return sizeof(PacketHeader);
+  }
+
+  const auto *header = reinterpret_cast<const PacketHeader *>(bytes);
+  const PacketReader reader(header);
+  if (reader.marker() != kPacketMarker)
+  {
+    return 0;
+  }
+
+  const size_t header_size = sizeof(PacketHeader) + header->payload_offset;
+  if (byte_count < header_size)
+  {
+    return header_size;
+  }
+
+  if (reader.extended() && reader.payloadSize() > _max_extended_payload_size)
+  {
+    return 0;
+  }
+
+  return reader.packetSize();
+}
+
+
+const PacketHeader *SharedMemoryReader::copyPacket(unsigned timeout_ms)
+{
+  for (;;)
+  {
+    const uint8_t *data = nullptr;
+    const size_t available = _ring.acquireRead(data, timeout_ms);
+    if (available == 0)
+    {
+      if (_ring.writerClosed() && _ring.readableBytes() == 0)
+      {
+        // Incomplete data at the end of the stream.
+        _eof = true;
+        _copying = false;
+      }
+      return nullptr;
+    }
+
+    // Copy only the bytes of this packet. The size is known once the header has been copied.
+    size_t consumed = 0;
+    size_t packet_size = packetSize(_wrapped.data(), _wrapped.size());
+    while (packet_size > _wrapped.size() && consumed < available)
+    {
+      const size_t count = std::min(packet_size - _wrapped.size(), available - consumed);
+      _wrapped.insert(_wrapped.end(), data + consumed, data + consumed + count);
+      consumed += count;
+      packet_size = packetSize(_wrapped.data(), _wrapped.size());
+    }
+    _ring.releaseRead(consumed);
+    _copied_bytes += consumed;
+
+    if (packet_size == 0)
+    {
+      _ok = false;
+      _copying = false;
+      return nullptr;
+    }
+
+    if (packet_size <= _wrapped.size())
+    {
+      _copying = false;
+      return reinterpret_cast<const PacketHeader *>(_wrapped.data());
+    }
+  }
+}
+}  // namespace tes
@@ -0,0 +1,101 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_SHARED_MEMORY_READER_H
+#define TES_CORE_SHARED_MEMORY_READER_H
+
+#include "CoreConfig.h"
+
+#include "PacketHeader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tes
+{
+class SharedMemoryRing;
+
+/// Extracts packets from the reading end of a @c SharedMemoryRing without copying.
+///
+/// Packets are returned as pointers directly into the shared memory ring, except for packets which
+/// wrap the end of the ring or are larger than the ring capacity. Only those packets are copied
+/// into an internal buffer. Either way, an extracted packet remains valid until the next call to
+/// @c extractPacket() , which releases the packet bytes back to the writer.
+///
+/// The ring carries a well formed stream from a local server, so there is no resynchronisation.
+/// Data which do not start with a packet marker, or a @c PFExtended payload size larger than
+/// @c maxExtendedPayloadSize() , end reading - see @c isOk() .
+class TES_CORE_API SharedMemoryReader
+{
+public:
+  /// Constructor.
+  /// @param ring The ring to read from. Must be open for reading and outlive this object.
+  explicit SharedMemoryReader(SharedMemoryRing &ring);
+  /// Destructor. Releases the last extracted packet.
+  ~SharedMemoryReader();
+
+  SharedMemoryReader(const SharedMemoryReader &) = delete;
+  SharedMemoryReader &operator=(const SharedMemoryReader &) = delete;
+
+  /// Extract the next packet, waiting up to @p timeout_ms for data.
+  ///
+  /// @param timeout_ms Maximum time to wait for each read from the ring (milliseconds).
+  /// @return The next packet, or null on timeout, at the end of the stream or on error. Check
+  ///   @c isEof() and @c isOk() .
+  const PacketHeader *extractPacket(unsigned timeout_ms);
+
+  /// Check if the writer has closed the ring and all complete packets have been extracted.
+  /// @return True at the end of the stream.
+  [[nodiscard]] bool isEof() const { return _eof; }
+
+  /// Check if the stream is valid. False once invalid packet data have been read.
+  /// @return True if ok to read on.
+  [[nodiscard]] bool isOk() const { return _ok; }
+
+  /// Query the number of bytes copied for packets which could not be extracted in place.
+  /// @return The copied byte count.
+  [[nodiscard]] uint64_t copiedBytes() const { return _copied_bytes; }
+
+  /// Set the largest @c PFExtended payload size to accept.
+  /// @param max_payload_size The payload size limit (bytes).
+  void setMaxExtendedPayloadSize(uint32_t max_payload_size)
+  {
+    _max_extended_payload_size = max_payload_size;
+  }
+
+  /// Query the largest @c PFExtended payload size to accept.
+  /// @return The payload size limit (bytes). Defaults to @c kPacketDefaultMaxExtendedPayloadSize .
+  [[nodiscard]] uint32_t maxExtendedPayloadSize() const { return _max_extended_payload_size; }
+
+private:
+  /// Determine the size of the packet starting at @p bytes .
+  /// @param bytes The packet bytes.
+  /// @param byte_count The number of bytes available.
+  /// @return The packet size, or the number of bytes required to determine the size when
+  ///   @p byte_count is insufficient. Zero if the data are not a valid packet.
+  [[nodiscard]] size_t packetSize(const uint8_t *bytes, size_t byte_count) const;
+
+  /// Copy a packet which cannot be extracted in place into @c _wrapped .
+  /// @param timeout_ms Maximum time to wait for each read from the ring (milliseconds).
+  /// @return The packet once complete, or null if incomplete on timeout, end of stream or error.
+  const PacketHeader *copyPacket(unsigned timeout_ms);
+
+  SharedMemoryRing &_ring;
+  /// Copy of a packet which could not be extracted in place.
+  std::vector<uint8_t> _wrapped;
+  /// Number of ring bytes to release on the next @c extractPacket() .
+  size_t _release = 0;
+  /// Number of readable bytes required to extract the next packet in place.
+  size_t _required = 1;
+  uint64_t _copied_bytes = 0;
+  /// Largest accepted @c PFExtended payload size.
+  uint32_t _max_extended_payload_size = kPacketDefaultMaxExtendedPayloadSize;
+  /// Set while copying a packet into @c _wrapped .
+  bool _copying = false;
+  bool _eof = false;
+  bool _ok = true;
+};
+}  // namespace tes
+
+#endif  // TES_CORE_SHARED_MEMORY_READER_H
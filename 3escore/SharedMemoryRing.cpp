@@ -0,0 +1,502 @@
+//
+// author: Kazys Stepanas
+//
+#include "SharedMemoryRing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TES_SHM_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#define TES_SHM_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif  // __linux__
+#endif  // defined(__unix__) || defined(__APPLE__)
+
+namespace tes
+{
+namespace
+{
+/// Identifies an initialised ring: "3esR".
+constexpr uint32_t kRingMagic = 0x33657352u;
+constexpr uint32_t kRingVersion = 1u;
+
+/// Values for @c RingHeader::reader_state .
+enum ReaderState : uint32_t
+{
+  RsNone,
+  RsAttached,
+  RsDetached
+};
+
+/// The ring header at the start of the shared memory object, followed by the ring data.
+///
+/// Read and write positions increase monotonically, wrapping the data by the capacity. The
+/// sequence numbers are incremented on each change to wake a waiting futex, and the waiting flags
+/// avoid the wake system call when nothing is waiting.
+struct alignas(64) RingHeader
+{
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+  uint64_t capacity;
+
+  alignas(64) std::atomic<uint64_t> write_pos;
+  std::atomic<uint32_t> data_seq;
+  std::atomic<uint32_t> reader_waiting;
+
+  alignas(64) std::atomic<uint64_t> read_pos;
+  std::atomic<uint32_t> space_seq;
+  std::atomic<uint32_t> writer_waiting;
+
+  alignas(64) std::atomic<uint32_t> reader_state;
+  std::atomic<uint32_t> writer_closed;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Shared memory ring requires lock free 64-bit atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free && sizeof(std::atomic<uint32_t>) == 4,
+              "Shared memory ring requires lock free 32-bit atomics");
+
+using Clock = std::chrono::steady_clock;
+
+/// Milliseconds remaining until @p deadline , or zero once passed.
+unsigned remainingMs(Clock::time_point deadline)
+{
+  const auto now = Clock::now();
+  if (now >= deadline)
+  {
+    return 0;
+  }
+  const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+  return static_cast<unsigned>(
+    std::min<decltype(remaining)>(remaining, std::numeric_limits<unsigned>::max()));
+}
+
+/// Wait up to @p timeout_ms for @p word to change from @p expected .
+void waitOn(std::atomic<uint32_t> &word, uint32_t expected, unsigned timeout_ms)
+{
+#ifdef TES_SHM_FUTEX
+  timespec timeout = {};
+  timeout.tv_sec = static_cast<time_t>(timeout_ms / 1000u);
+  timeout.tv_nsec = static_cast<long>(timeout_ms % 1000u) * 1000000L;
+  ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, expected, &timeout,
+            nullptr, 0);
+#else   // TES_SHM_FUTEX
+  (void)expected;
+  if (word.load() == expected)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(std::min(timeout_ms, 1u)));
+  }
+#endif  // TES_SHM_FUTEX
+}
+
+/// Wake all waiters on @p word .
+void wakeAll(std::atomic<uint32_t> &word)
+{
+#ifdef TES_SHM_FUTEX
+  ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr,
+            0);
+#else   // TES_SHM_FUTEX
+  (void)word;
+#endif  // TES_SHM_FUTEX
+}
+
+/// Signal a change on @p seq , waking the other party if it is @p waiting .
+void signal(std::atomic<uint32_t> &seq, const std::atomic<uint32_t> &waiting)
+{
+  seq.fetch_add(1u);
+  if (waiting.load())
+  {
+    wakeAll(seq);
+  }
+}
+}  // namespace
+
+
+struct SharedMemoryRingDetail
+{
+  std::string name;
+  RingHeader *header = nullptr;
+  uint8_t *data = nullptr;
+  size_t mapped_size = 0;
+  bool writer = false;
+  bool unlinked = false;
+};
+
+
+SharedMemoryRing::SharedMemoryRing()
+  : _detail(std::make_unique<SharedMemoryRingDetail>())
+{}
+
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+  close();
+}
+
+
+bool SharedMemoryRing::supported()
+{
+#ifdef TES_SHM_POSIX
+  return true;
+#else   // TES_SHM_POSIX
+  return false;
+#endif  // TES_SHM_POSIX
+}
+
+
+bool SharedMemoryRing::create(const std::string &name, size_t capacity)
+{
+  close();
+  if (capacity == 0)
+  {
+    return false;
+  }
+
+#ifdef TES_SHM_POSIX
+  _detail->name = (!name.empty() && name[0] == '/') ? name : "/" + name;
+  const int fd = ::shm_open(_detail->name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+  if (fd == -1)
+  {
+    return false;
+  }
+
+  const size_t mapped_size = sizeof(RingHeader) + capacity;
+  void *mapping = MAP_FAILED;
+  if (::ftruncate(fd, static_cast<off_t>(mapped_size)) == 0)
+  {
+    mapping = ::mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    ::shm_unlink(_detail->name.c_str());
+    return false;
+  }
+
+  // The object is zero initialised. Publish the magic number last to mark it as ready.
+  auto *header = new (mapping) RingHeader;
+  header->version = kRingVersion;
+  header->capacity = capacity;
+  header->magic.store(kRingMagic);
+
+  _detail->header = header;
+  _detail->data = static_cast<uint8_t *>(mapping) + sizeof(RingHeader);
+  _detail->mapped_size = mapped_size;
+  _detail->writer = true;
+  _detail->unlinked = false;
+  return true;
+#else   // TES_SHM_POSIX
+  (void)name;
+  return false;
+#endif  // TES_SHM_POSIX
+}
+
+
+bool SharedMemoryRing::open(const std::string &name)
+{
+  close();
+
+#ifdef TES_SHM_POSIX
+  _detail->name = (!name.empty() && name[0] == '/') ? name : "/" + name;
+  const int fd = ::shm_open(_detail->name.c_str(), O_RDWR, 0);
+  if (fd == -1)
+  {
+    return false;
+  }
+
+  struct stat info = {};
+  void *mapping = MAP_FAILED;
+  size_t mapped_size = 0;
+  if (::fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) > sizeof(RingHeader))
+  {
+    mapped_size = static_cast<size_t>(info.st_size);
+    mapping = ::mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    return false;
+  }
+
+  auto *header = static_cast<RingHeader *>(mapping);
+  uint32_t expected_state = RsNone;
+  if (header->magic.load() != kRingMagic || header->version != kRingVersion ||
+      header->capacity + sizeof(RingHeader) > mapped_size ||
+      !header->reader_state.compare_exchange_strong(expected_state, RsAttached))
+  {
+    // Not ready, incompatible or already has a reader.
+    ::munmap(mapping, mapped_size);
+    return false;
+  }
+
+  _detail->header = header;
+  _detail->data = static_cast<uint8_t *>(mapping) + sizeof(RingHeader);
+  _detail->mapped_size = mapped_size;
+  _detail->writer = false;
+  _detail->unlinked = true;
+  return true;
+#else   // TES_SHM_POSIX
+  (void)name;
+  return false;
+#endif  // TES_SHM_POSIX
+}
+
+
+void SharedMemoryRing::close()
+{
+  RingHeader *header = _detail->header;
+  if (!header)
+  {
+    return;
+  }
+
+  if (_detail->writer)
+  {
+    header->writer_closed.store(1u);
+    signal(header->data_seq, header->reader_waiting);
+    unlink();
+  }
+  else
+  {
+    header->reader_state.store(RsDetached);
+    signal(header->space_seq, header->writer_waiting);
+  }
+
+#ifdef TES_SHM_POSIX
+  ::munmap(header, _detail->mapped_size);
+#endif  // TES_SHM_POSIX
+  _detail->header = nullptr;
+  _detail->data = nullptr;
+  _detail->mapped_size = 0;
+}
+
+
+void SharedMemoryRing::unlink()
+{
+  if (_detail->header && _detail->writer && !_detail->unlinked)
+  {
+#ifdef TES_SHM_POSIX
+    ::shm_unlink(_detail->name.c_str());
+#endif  // TES_SHM_POSIX
+    _detail->unlinked = true;
+  }
+}
+
+
+bool SharedMemoryRing::isOpen() const
+{
+  return _detail->header != nullptr;
+}
+
+
+bool SharedMemoryRing::isWriter() const
+{
+  return _detail->writer;
+}
+
+
+const std::string &SharedMemoryRing::name() const
+{
+  return _detail->name;
+}
+
+
+size_t SharedMemoryRing::capacity() const
+{
+  return (_detail->header) ? static_cast<size_t>(_detail->header->capacity) : 0u;
+}
+
+
+bool SharedMemoryRing::readerAttached() const
+{
+  return _detail->header && _detail->header->reader_state.load() == RsAttached;
+}
+
+
+bool SharedMemoryRing::readerDetached() const
+{
+  return _detail->header && _detail->header->reader_state.load() == RsDetached;
+}
+
+
+bool SharedMemoryRing::writerClosed() const
+{
+  return _detail->header && _detail->header->writer_closed.load() != 0;
+}
+
+
+int SharedMemoryRing::write(const uint8_t *data, size_t byte_count, unsigned timeout_ms)
+{
+  RingHeader *header = _detail->header;
+  if (!header || !_detail->writer || byte_count > size_t(std::numeric_limits<int>::max()))
+  {
+    return -1;
+  }
+
+  const auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+  const uint64_t capacity = header->capacity;
+  size_t written = 0;
+  while (written < byte_count)
+  {
+    if (header->reader_state.load() == RsDetached)
+    {
+      return -1;
+    }
+
+    const uint64_t write_pos = header->write_pos.load(std::memory_order_relaxed);
+    const uint64_t read_pos = header->read_pos.load(std::memory_order_acquire);
+    const auto space = static_cast<size_t>(capacity - (write_pos - read_pos));
+    if (space == 0)
+    {
+      // Full. Flag we are waiting, then check again before sleeping so a release is not missed.
+      header->writer_waiting.store(1u);
+      const uint32_t seq = header->space_seq.load();
+      if (header->read_pos.load() == read_pos && header->reader_state.load() != RsDetached)
+      {
+        const unsigned wait_ms = remainingMs(deadline);
+        if (wait_ms == 0)
+        {
+          header->writer_waiting.store(0u);
+          return -1;
+        }
+        waitOn(header->space_seq, seq, wait_ms);
+      }
+      header->writer_waiting.store(0u);
+      continue;
+    }
+
+    const size_t count = std::min(space, byte_count - written);
+    const auto offset = static_cast<size_t>(write_pos % capacity);
+    const size_t first = std::min(count, static_cast<size_t>(capacity) - offset);
+    std::memcpy(_detail->data + offset, data + written, first);
+    std::memcpy(_detail->data, data + written + first, count - first);
+    header->write_pos.store(write_pos + count, std::memory_order_release);
+    signal(header->data_seq, header->reader_waiting);
+    written += count;
+  }
+
+  return static_cast<int>(written);
+}
+
+
+size_t SharedMemoryRing::acquireRead(const uint8_t *&data, unsigned timeout_ms)
+{
+  return acquireRead(data, 1u, timeout_ms);
+}
+
+
+size_t SharedMemoryRing::acquireRead(const uint8_t *&data, size_t min_bytes, unsigned timeout_ms)
+{
+  RingHeader *header = _detail->header;
+  data = nullptr;
+  if (!header || _detail->writer)
+  {
+    return 0;
+  }
+
+  const auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+  const uint64_t capacity = header->capacity;
+  min_bytes = std::max<size_t>(std::min<size_t>(min_bytes, capacity), 1u);
+  for (;;)
+  {
+    const uint64_t read_pos = header->read_pos.load(std::memory_order_relaxed);
+    const uint64_t write_pos = header->write_pos.load(std::memory_order_acquire);
+    if (write_pos - read_pos >= min_bytes ||
+        (write_pos != read_pos && header->writer_closed.load()))
+    {
+      const auto offset = static_cast<size_t>(read_pos % capacity);
+      data = _detail->data + offset;
+      return std::min(static_cast<size_t>(write_pos - read_pos),
+                      static_cast<size_t>(capacity) - offset);
+    }
+
+    if (header->writer_closed.load())
+    {
+      // Check for data written before closing.
+      if (header->write_pos.load() != read_pos)
+      {
+        continue;
+      }
+      return 0;
+    }
+
+    // Insufficient data. Flag we are waiting, then check again before sleeping so a write is not
+    // missed.
+    header->reader_waiting.store(1u);
+    const uint32_t seq = header->data_seq.load();
+    if (header->write_pos.load() - read_pos < min_bytes && !header->writer_closed.load())
+    {
+      const unsigned wait_ms = remainingMs(deadline);
+      if (wait_ms == 0)
+      {
+        header->reader_waiting.store(0u);
+        return 0;
+      }
+      waitOn(header->data_seq, seq, wait_ms);
+    }
+    header->reader_waiting.store(0u);
+  }
+}
+
+
+size_t SharedMemoryRing::readableBytes() const
+{
+  const RingHeader *header = _detail->header;
+  if (!header || _detail->writer)
+  {
+    return 0;
+  }
+
+  return static_cast<size_t>(header->write_pos.load(std::memory_order_acquire) -
+                             header->read_pos.load(std::memory_order_relaxed));
+}
+
+
+void SharedMemoryRing::releaseRead(size_t byte_count)
+{
+  RingHeader *header = _detail->header;
+  if (!header || _detail->writer || byte_count == 0)
+  {
+    return;
+  }
+
+  const uint64_t read_pos = header->read_pos.load(std::memory_order_relaxed);
+  header->read_pos.store(read_pos + byte_count, std::memory_order_release);
+  signal(header->space_seq, header->writer_waiting);
+}
+
+
+size_t SharedMemoryRing::read(uint8_t *buffer, size_t buffer_size, unsigned timeout_ms)
+{
+  size_t total_read = 0;
+  const uint8_t *data = nullptr;
+  // Wait only for the first chunk, then take whatever else is immediately available. This covers
+  // data which wraps the end of the ring.
+  size_t available = acquireRead(data, timeout_ms);
+  while (available && total_read < buffer_size)
+  {
+    const size_t count = std::min(available, buffer_size - total_read);
+    std::memcpy(buffer + total_read, data, count);
+    releaseRead(count);
+    total_read += count;
+    available = (total_read < buffer_size) ? acquireRead(data, 0) : 0;
+  }
+  return total_read;
+}
+}  // namespace tes
@@ -0,0 +1,149 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_SHARED_MEMORY_RING_H
+#define TES_CORE_SHARED_MEMORY_RING_H
+
+#include "CoreConfig.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace tes
+{
+struct SharedMemoryRingDetail;
+
+/// A single producer, single consumer byte ring buffer in named shared memory, used to stream
+/// between a server and a viewer on the same host without going through the network stack.
+///
+/// The server creates the ring with @c create() and writes the 3es byte stream with @c write() .
+/// A viewer attaches with @c open() and consumes the stream in place with @c acquireRead() and
+/// @c releaseRead() . Only one reader may attach to a ring.
+///
+/// Blocked readers and writers are woken via a futex on Linux. Other POSIX platforms poll with a
+/// short sleep. Shared memory is not supported on other platforms; see @c supported() .
+class TES_CORE_API SharedMemoryRing
+{
+public:
+  /// Default ring capacity (bytes).
+  static constexpr size_t kDefaultCapacity = 8u * 1024u * 1024u;
+
+  /// Constructor.
+  SharedMemoryRing();
+  /// Destructor. Calls @c close() .
+  ~SharedMemoryRing();
+
+  SharedMemoryRing(const SharedMemoryRing &) = delete;
+  SharedMemoryRing &operator=(const SharedMemoryRing &) = delete;
+
+  /// Check if shared memory rings are supported on this platform.
+  /// @return True if supported.
+  [[nodiscard]] static bool supported();
+
+  /// Create a new ring as the writer.
+  ///
+  /// Fails if a shared memory object called @p name already exists.
+  ///
+  /// @param name The shared memory object name. A leading '/' is added if missing.
+  /// @param capacity The ring buffer capacity in bytes.
+  /// @return True on success.
+  bool create(const std::string &name, size_t capacity = kDefaultCapacity);
+
+  /// Attach to an existing ring as the reader.
+  /// @param name The shared memory object name given to @c create() .
+  /// @return True on success. Fails if the ring does not exist or already has a reader.
+  bool open(const std::string &name);
+
+  /// Close the ring. The writer marks the stream as ended and unlinks the name, while the reader
+  /// marks itself as detached. Safe to call when not open.
+  void close();
+
+  /// Remove the shared memory name, without affecting the mapping. Only valid for the writer. A
+  /// new ring may then be created with the same name while this one remains in use.
+  void unlink();
+
+  /// Check if the ring is open.
+  /// @return True if open for reading or writing.
+  [[nodiscard]] bool isOpen() const;
+
+  /// Check if this is the writing end of the ring.
+  /// @return True if created via @c create() .
+  [[nodiscard]] bool isWriter() const;
+
+  /// Query the shared memory object name.
+  /// @return The name, including the leading '/'.
+  [[nodiscard]] const std::string &name() const;
+
+  /// Query the ring buffer capacity.
+  /// @return The capacity in bytes.
+  [[nodiscard]] size_t capacity() const;
+
+  /// Check if a reader has attached to the ring.
+  /// @return True if a reader is attached and has not detached.
+  [[nodiscard]] bool readerAttached() const;
+
+  /// Check if the reader has detached from the ring.
+  /// @return True if a reader attached then detached.
+  [[nodiscard]] bool readerDetached() const;
+
+  /// Check if the writer has closed the ring. Data may remain to be read.
+  /// @return True if the writer has closed.
+  [[nodiscard]] bool writerClosed() const;
+
+  /// Write @p byte_count bytes to the ring, blocking while the ring is full.
+  ///
+  /// @param data The bytes to write.
+  /// @param byte_count Number of bytes to write.
+  /// @param timeout_ms Maximum time to wait for space (milliseconds).
+  /// @return The number of bytes written - @p byte_count - or -1 if the ring is not open for
+  ///   writing, the reader detaches or the timeout expires. Some bytes may have been written on
+  ///   failure.
+  int write(const uint8_t *data, size_t byte_count, unsigned timeout_ms);
+
+  /// Access the next contiguous readable bytes in the ring, waiting for data if empty.
+  ///
+  /// The bytes remain valid until @c releaseRead() . Readable data may wrap the end of the ring,
+  /// in which case only the bytes before the wrap are given.
+  ///
+  /// @param[out] data Set to the first readable byte.
+  /// @param timeout_ms Maximum time to wait for data (milliseconds).
+  /// @return The number of contiguous readable bytes. Zero on timeout, or once the writer has
+  ///   closed and all data have been read - see @c writerClosed() .
+  size_t acquireRead(const uint8_t *&data, unsigned timeout_ms);
+
+  /// @overload
+  ///
+  /// Waits until at least @p min_bytes are readable - limited to the @c capacity() - or the writer
+  /// closes. The contiguous byte count may still be less than @p min_bytes when the readable data
+  /// wrap the end of the ring.
+  ///
+  /// @param[out] data Set to the first readable byte.
+  /// @param min_bytes The minimum number of readable bytes to wait for.
+  /// @param timeout_ms Maximum time to wait for data (milliseconds).
+  /// @return The number of contiguous readable bytes. Zero on timeout, or once the writer has
+  ///   closed and all data have been read.
+  size_t acquireRead(const uint8_t *&data, size_t min_bytes, unsigned timeout_ms);
+
+  /// Query the number of readable bytes, including those which wrap the end of the ring.
+  /// @return The readable byte count. Zero for the writer.
+  [[nodiscard]] size_t readableBytes() const;
+
+  /// Release @p byte_count bytes from @c acquireRead() , making space for the writer.
+  /// @param byte_count The number of bytes consumed. Must not exceed the acquired count.
+  void releaseRead(size_t byte_count);
+
+  /// Copy up to @p buffer_size bytes from the ring to @p buffer , waiting for data if empty.
+  /// @param buffer The buffer to read into.
+  /// @param buffer_size The size of @p buffer .
+  /// @param timeout_ms Maximum time to wait for data (milliseconds).
+  /// @return The number of bytes read. See @c acquireRead() .
+  size_t read(uint8_t *buffer, size_t buffer_size, unsigned timeout_ms);
+
+private:
+  std::unique_ptr<SharedMemoryRingDetail> _detail;
+};
+}  // namespace tes
+
+#endif  // TES_CORE_SHARED_MEMORY_RING_H
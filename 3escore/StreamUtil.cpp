@@ -6,8 +6,10 @@
 #include "CoreUtil.h"
 #include "Endian.h"
 #include "Messages.h"
+#include "PacketReader.h"
 #include "PacketWriter.h"
 
+#include <algorithm>
 #include <array>
 #include <iostream>
 #include <type_traits>
@@ -261,6 +263,128 @@ void finaliseFrameCount(std::iostream &stream, uint32_t frame_count,
   stream.write(reinterpret_cast<const char *>(header_buffer.data()), packet.packetSize());
   stream.flush();
 }
+
+/// Calculate the packet size of an encoded @c FrameIndexLocatorMessage . The locator has a fixed
+/// size so it may be read from the end of the stream.
+/// @return The locator packet size (bytes).
+size_t frameIndexLocatorSize()
+{
+  std::array<uint8_t, 256> buffer = {};
+  PacketWriter packet(buffer.data(), int_cast<uint32_t>(buffer.size()), MtFrameIndex,
+                      FrameIndexLocatorMessage::MessageId);
+  FrameIndexLocatorMessage locator = {};
+  locator.write(packet);
+  packet.finalise();
+  return packet.packetSize();
+}
+
+/// Read a packet from the current position in @p stream into @p buffer and validate it.
+/// @param stream The stream to read from.
+/// @param buffer The buffer to read into. Resized as required.
+/// @return True if a complete packet with a valid marker and CRC was read.
+bool readPacket(std::istream &stream, std::vector<uint8_t> &buffer)
+{
+  const size_t header_size = sizeof(PacketHeader) + kPacketExtendedSizeBytes;
+  if (buffer.size() < header_size)
+  {
+    buffer.resize(header_size);
+  }
+
+  stream.read(reinterpret_cast<char *>(buffer.data()), sizeof(PacketHeader));
+  if (static_cast<size_t>(stream.gcount()) != sizeof(PacketHeader))
+  {
+    return false;
+  }
+
+  const auto *header = reinterpret_cast<const PacketHeader *>(buffer.data());
+  if (networkEndianSwapValue(header->marker) != kPacketMarker ||
+      header->payload_offset > kPacketExtendedSizeBytes)
+  {
+    return false;
+  }
+
+  // Read the remaining header bytes, then the packet size is known.
+  if (header->payload_offset)
+  {
+    stream.read(reinterpret_cast<char *>(buffer.data()) + sizeof(PacketHeader),
+                header->payload_offset);
+  }
+
+  const size_t read_size = sizeof(PacketHeader) + header->payload_offset;
+  const size_t packet_size = PacketReader(header).packetSize();
+  if (packet_size < read_size)
+  {
+    return false;
+  }
+
+  buffer.resize(std::max(buffer.size(), packet_size));
+  header = reinterpret_cast<const PacketHeader *>(buffer.data());
+  stream.read(reinterpret_cast<char *>(buffer.data()) + read_size,
+              int_cast<std::streamsize>(packet_size - read_size));
+  if (static_cast<size_t>(stream.gcount()) != packet_size - read_size)
+  {
+    return false;
+  }
+
+  PacketReader reader(header);
+  return reader.checkCrc();
+}
+
+/// Implementation for @c readFrameIndex() . Leaves the stream position undefined.
+bool readFrameIndexAt(std::istream &stream, std::vector<uint64_t> &frame_offsets,
+                      std::vector<uint8_t> &buffer)
+{
+  const auto locator_size = static_cast<std::streamoff>(frameIndexLocatorSize());
+  stream.clear();
+  stream.seekg(0, std::ios_base::end);
+  const std::streamoff stream_end = stream.tellg();
+  if (stream_end < locator_size)
+  {
+    return false;
+  }
+
+  // Read the locator from the stream end.
+  const std::streamoff locator_pos = stream_end - locator_size;
+  stream.seekg(locator_pos);
+  if (!readPacket(stream, buffer))
+  {
+    return false;
+  }
+
+  PacketReader reader(reinterpret_cast<const PacketHeader *>(buffer.data()));
+  FrameIndexLocatorMessage locator = {};
+  if (reader.routingId() != MtFrameIndex || reader.messageId() != FIIdLocator ||
+      !locator.read(reader) || locator.index_offset >= static_cast<uint64_t>(locator_pos))
+  {
+    return false;
+  }
+
+  // Read the offset blocks.
+  frame_offsets.resize(locator.frame_count);
+  stream.seekg(static_cast<std::streamoff>(locator.index_offset));
+  size_t frames_read = 0;
+  for (uint32_t i = 0; i < locator.packet_count; ++i)
+  {
+    if (!readPacket(stream, buffer))
+    {
+      return false;
+    }
+
+    reader = PacketReader(reinterpret_cast<const PacketHeader *>(buffer.data()));
+    FrameIndexMessage msg = {};
+    if (reader.routingId() != MtFrameIndex || reader.messageId() != FIIdOffsets ||
+        !msg.read(reader) || msg.first_frame != frames_read + 1u ||
+        frames_read + msg.offset_count > frame_offsets.size() ||
+        reader.readArray(frame_offsets.data() + frames_read, msg.offset_count) !=
+          msg.offset_count)
+    {
+      return false;
+    }
+    frames_read += msg.offset_count;
+  }
+
+  return frames_read == frame_offsets.size();
+}
 }  // namespace
 
 bool initialiseStream(std::ostream &stream, const ServerInfoMessage *server_info)
@@ -347,4 +471,76 @@ bool finaliseStream(std::iostream &stream, uint32_t frame_count,
 
   return stream.good() && found;
 }
+
+
+bool writeFrameIndex(std::ostream &stream, const std::vector<uint64_t> &frame_offsets)
+{
+  const auto index_offset = stream.tellp();
+  if (index_offset < 0)
+  {
+    return false;
+  }
+
+  std::vector<uint8_t> buffer(sizeof(PacketHeader) + sizeof(FrameIndexMessage) +
+                              FrameIndexMessage::kMaxOffsets * sizeof(uint64_t) +
+                              sizeof(PacketWriter::CrcType));
+  PacketWriter packet(buffer.data(), int_cast<uint32_t>(buffer.size()));
+
+  uint32_t packet_count = 0;
+  for (size_t i = 0; i < frame_offsets.size(); i += FrameIndexMessage::kMaxOffsets)
+  {
+    FrameIndexMessage msg = {};
+    msg.first_frame = int_cast<uint32_t>(i + 1u);
+    msg.offset_count = static_cast<uint16_t>(
+      std::min<size_t>(frame_offsets.size() - i, FrameIndexMessage::kMaxOffsets));
+    msg.reserved = 0;
+
+    packet.reset(MtFrameIndex, FrameIndexMessage::MessageId);
+    if (!msg.write(packet) ||
+        packet.writeArray(frame_offsets.data() + i, msg.offset_count) != msg.offset_count ||
+        !packet.finalise())
+    {
+      return false;
+    }
+    stream.write(reinterpret_cast<const char *>(packet.data()), packet.packetSize());
+    ++packet_count;
+  }
+
+  FrameIndexLocatorMessage locator = {};
+  locator.index_offset = static_cast<uint64_t>(index_offset);
+  locator.frame_count = int_cast<uint32_t>(frame_offsets.size());
+  locator.packet_count = packet_count;
+  packet.reset(MtFrameIndex, FrameIndexLocatorMessage::MessageId);
+  if (!locator.write(packet) || !packet.finalise())
+  {
+    return false;
+  }
+  stream.write(reinterpret_cast<const char *>(packet.data()), packet.packetSize());
+
+  return stream.good();
+}
+
+
+bool readFrameIndex(std::istream &stream, std::vector<uint64_t> &frame_offsets)
+{
+  frame_offsets.clear();
+  stream.clear();
+  const auto restore_pos = stream.tellg();
+  if (restore_pos < 0)
+  {
+    // Not seekable.
+    return false;
+  }
+
+  std::vector<uint8_t> buffer(1024);
+  const bool ok = readFrameIndexAt(stream, frame_offsets, buffer);
+  if (!ok)
+  {
+    frame_offsets.clear();
+  }
+
+  stream.clear();
+  stream.seekg(restore_pos);
+  return ok;
+}
 }  // namespace tes::streamutil
@@ -8,6 +8,7 @@
 
 #include <cinttypes>
 #include <iosfwd>
+#include <vector>
 
 namespace tes
 {
@@ -44,6 +45,27 @@ bool TES_CORE_API initialiseStream(std::ostream &stream,
 /// @return True on success, false due to any failure.
 bool TES_CORE_API finaliseStream(std::iostream &stream, uint32_t frame_count,
                                  const ServerInfoMessage *server_info = nullptr);
+
+/// Append a frame offset index to @p stream at the current write position. See @c MtFrameIndex .
+///
+/// This should be the last data written to the stream, before calling @c finaliseStream() , so the
+/// @c FIIdLocator packet ends the stream.
+///
+/// @param stream The stream to write to.
+/// @param frame_offsets The stream offsets for each frame. See @c FrameIndexMessage .
+/// @return True on success, false due to any failure.
+bool TES_CORE_API writeFrameIndex(std::ostream &stream, const std::vector<uint64_t> &frame_offsets);
+
+/// Read the frame offset index from the end of @p stream , if present.
+///
+/// The @p stream must be seekable. The read position is restored before returning. Streams
+/// without a frame index, such as those recorded by older versions, fail without error.
+///
+/// @param stream The stream to read from.
+/// @param[out] frame_offsets Set to the stream offsets for each frame. See
+/// @c FrameIndexMessage . Cleared on failure.
+/// @return True if a valid frame index was read.
+bool TES_CORE_API readFrameIndex(std::istream &stream, std::vector<uint64_t> &frame_offsets);
 }  // namespace streamutil
 }  // namespace tes
 
@@ -55,6 +55,8 @@ public:
   std::shared_ptr<TcpSocket> accept(unsigned timeout_ms = 0);
 
 private:
+  friend class TcpPoller;
+
   std::unique_ptr<TcpListenSocketDetail> _detail;  ///< Implementation detail.
 };
 
@@ -0,0 +1,94 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_TCP_POLLER_H
+#define TES_CORE_TCP_POLLER_H
+
+#include "CoreConfig.h"
+
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+
+namespace tes
+{
+class TcpListenSocket;
+class TcpSocket;
+struct TcpPollerDetail;
+
+/// Waits for connection events on a @c TcpListenSocket and a set of connected @c TcpSocket
+/// objects.
+///
+/// The poller reports pending connections on the listen socket and tracks the liveness of the
+/// watched sockets. A watched socket which is closed by the remote peer or which encounters an
+/// error is flagged as disconnected by @c wait(), after which @c TcpSocket::isConnected() returns
+/// @c false without making any system calls. This allows a connection monitor to sleep in
+/// @c wait() rather than polling each socket in turn.
+///
+/// Event notification uses @c epoll on Linux. Other platforms fall back to a timed @c select() on
+/// the listen socket, while @c TcpSocket::isConnected() retains its polling behaviour. See
+/// @c eventDriven() .
+///
+/// A watched socket is released once it is flagged as disconnected, or once it is closed locally.
+/// With the exception of @c wake(), the poller is not thread safe.
+class TES_CORE_API TcpPoller
+{
+public:
+  /// Flags returned from @c wait() .
+  enum PollEvent : unsigned
+  {
+    /// No events: timed out.
+    PENone = 0u,
+    /// The listen socket has pending connections to @c TcpListenSocket::accept() .
+    PEConnection = (1u << 0u),
+    /// At least one watched socket has been flagged as disconnected.
+    PEHangup = (1u << 1u),
+    /// Woken by @c wake() .
+    PEWake = (1u << 2u)
+  };
+
+  /// Constructor.
+  TcpPoller();
+  /// Destructor.
+  ~TcpPoller();
+
+  TcpPoller(const TcpPoller &) = delete;
+  TcpPoller &operator=(const TcpPoller &) = delete;
+
+  /// Check if socket events are delivered by the operating system. When @c false, @c wait()
+  /// reports @c PEConnection on timeout and watched sockets are not flagged on disconnection.
+  /// @return True if events are delivered by the operating system.
+  [[nodiscard]] bool eventDriven() const;
+
+  /// Set the socket to wait on for new connections.
+  /// @param socket The listen socket. Must be listening. Null to clear. Must outlive the poller
+  ///   or be cleared before destruction.
+  /// @return True on success.
+  bool setListenSocket(const TcpListenSocket *socket);
+
+  /// Watch @p socket for disconnection. The poller retains a reference to @p socket until it is
+  /// flagged as disconnected or closed.
+  /// @param socket The socket to watch. Must be connected.
+  /// @return True if disconnection is event driven for @p socket , false if @p socket cannot be
+  ///   watched.
+  bool watch(const std::shared_ptr<TcpSocket> &socket);
+
+  /// Query the number of sockets being watched.
+  /// @return The number of watched sockets.
+  [[nodiscard]] size_t watchCount() const;
+
+  /// Wait up to @p timeout_ms for an event.
+  /// @param timeout_ms The maximum time to wait (milliseconds). Zero to poll.
+  /// @return A combination of @c PollEvent flags, or @c PENone on timeout.
+  unsigned wait(unsigned timeout_ms);
+
+  /// Wake a thread blocked in @c wait() . May be called from any thread. The next @c wait()
+  /// returns immediately if no thread is currently waiting.
+  void wake();
+
+private:
+  std::unique_ptr<TcpPollerDetail> _detail;  ///< Implementation detail.
+};
+}  // namespace tes
+
+#endif  // TES_CORE_TCP_POLLER_H
@@ -6,6 +6,8 @@
 
 #include "CoreConfig.h"
 
+#include "BufferSegment.h"
+
 #include <cinttypes>
 #include <cstddef>
 #include <memory>
@@ -38,6 +40,9 @@ public:
   void close();
 
   /// Checks the connected state.
+  ///
+  /// While the socket is watched by an event driven @c TcpPoller this checks a flag set by the
+  /// poller. Otherwise the socket is polled.
   /// @bug This is not reliable for a client socket. It only works when
   /// the @c TcpSocket was created from a @c TcpListenSocket.
   /// @return @c true if the socket is currently connected.
@@ -51,6 +56,18 @@ public:
   /// @return True if Nagle's algorithm is disabled.
   [[nodiscard]] bool noDelay() const;
 
+  /// Cork the socket, holding back partially filled TCP segments until uncorked.
+  ///
+  /// While corked, only full segments are sent. Uncorking sends any pending partial segment.
+  /// Toggling the cork off then on again flushes pending data while remaining corked. Uses
+  /// @c TCP_CORK or @c TCP_NOPUSH where available. Has no effect on other platforms.
+  /// @param cork True to cork the socket, false to uncork.
+  void setCork(bool cork);
+
+  /// Check if the socket is corked. See @c setCork() .
+  /// @return True if the socket is corked.
+  [[nodiscard]] bool cork() const;
+
   /// Sets the blocking timeout on calls to @c read().
   /// All calls to @c read() either until there are data
   /// available or this time elapses. Set to zero for non-blocking
@@ -84,7 +101,7 @@ public:
   void setIndefiniteWriteTimeout();
 
   /// Sets the read buffer size (bytes).
-  /// @param buffer_size The new buffer size. Max is 2^16 - 1.
+  /// @param buffer_size The new buffer size. The operating system may clamp the size.
   void setReadBufferSize(int buffer_size);
 
   /// Gets the current read buffer size (bytes).
@@ -125,6 +142,16 @@ public:
     return readAvailable(reinterpret_cast<char *>(buffer), buffer_length);
   }
 
+  /// Waits until data are available to read, or the timeout elapses.
+  ///
+  /// This allows a reader to sleep until data arrive, then drain the socket with
+  /// @c readAvailable() . The socket is also reported as readable when the connection has been
+  /// closed or on error, so @c readAvailable() must be used to distinguish these cases.
+  ///
+  /// @param timeout_ms The maximum time to wait (milliseconds). Zero to poll.
+  /// @return True if a call to @c readAvailable() will not block.
+  [[nodiscard]] bool waitReadable(unsigned timeout_ms) const;
+
   /// Attempts to write data from the socket. This may block for the set write
   /// timeout.
   /// @param buffer The data buffer to send.
@@ -138,9 +165,19 @@ public:
     return write(reinterpret_cast<const char *>(buffer), buffer_length);
   }
 
+  /// Write multiple buffers as a single, ordered write without first copying them to a contiguous
+  /// buffer (scatter-gather). Uses @c sendmsg() or @c WSASend() where available. This may block
+  /// for the set write timeout.
+  /// @param segments The buffers to send, in order.
+  /// @param segment_count The number of @p segments .
+  /// @return The number of bytes sent, or -1 on error.
+  int writev(const BufferSegment *segments, unsigned segment_count) const;
+
   [[nodiscard]] uint16_t port() const;
 
 private:
+  friend class TcpPoller;
+
   std::unique_ptr<TcpSocketDetail> _detail;  ///< Implementation detail.
 };
 }  // namespace tes
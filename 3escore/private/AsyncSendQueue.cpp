@@ -0,0 +1,217 @@
+//
+// author: Kazys Stepanas
+//
+#include "AsyncSendQueue.h"
+
+#include <3escore/Log.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace tes
+{
+AsyncSendQueue::AsyncSendQueue(size_t capacity, SendOverflow overflow, WriteFunction write,
+                               FlushFunction flush)
+  : _buffer(std::max<size_t>(capacity, 1u))
+  , _write(std::move(write))
+  , _flush(std::move(flush))
+  , _overflow(overflow)
+{
+  _thread = std::thread([this]() { run(); });
+}
+
+
+AsyncSendQueue::~AsyncSendQueue()
+{
+  stop();
+}
+
+
+size_t AsyncSendQueue::queuedBytes() const
+{
+  return static_cast<size_t>(_head - _tail);
+}
+
+
+int AsyncSendQueue::push(const uint8_t *data, int byte_count)
+{
+  if (_failed || _quit)
+  {
+    return -1;
+  }
+
+  if (byte_count <= 0)
+  {
+    return 0;
+  }
+
+  auto remaining = static_cast<size_t>(byte_count);
+  if (_overflow == SODisconnect && freeBytes() < remaining)
+  {
+    log::error("Send queue overflow: ", queuedBytes(), " bytes queued, capacity ", _buffer.size(),
+               ". Disconnecting.");
+    recordDropped(remaining);
+    _failed = true;
+    const std::lock_guard<std::mutex> guard(_wait_lock);
+    _data_ready.notify_all();
+    return -1;
+  }
+
+  const uint8_t *src = data;
+  while (remaining)
+  {
+    const size_t available = freeBytes();
+    if (available == 0)
+    {
+      waitForSpace();
+      if (_failed)
+      {
+        return -1;
+      }
+      continue;
+    }
+
+    // Copy what we can up to the end of the ring buffer.
+    const uint64_t head = _head.load(std::memory_order_relaxed);
+    const auto offset = static_cast<size_t>(head % _buffer.size());
+    const size_t count = std::min({ remaining, available, _buffer.size() - offset });
+    std::memcpy(_buffer.data() + offset, src, count);
+    _head.store(head + count);
+
+    if (_sender_waiting)
+    {
+      const std::lock_guard<std::mutex> guard(_wait_lock);
+      _data_ready.notify_one();
+    }
+
+    src += count;
+    remaining -= count;
+  }
+
+  const uint64_t queued = queuedBytes();
+  uint64_t peak = _peak_queued.load(std::memory_order_relaxed);
+  while (queued > peak && !_peak_queued.compare_exchange_weak(peak, queued))
+  {
+  }
+
+  return byte_count;
+}
+
+
+void AsyncSendQueue::flush()
+{
+  if (!_flush || _failed || _quit)
+  {
+    return;
+  }
+
+  _flush_mark.store(_head.load());
+  if (_sender_waiting)
+  {
+    const std::lock_guard<std::mutex> guard(_wait_lock);
+    _data_ready.notify_one();
+  }
+}
+
+
+void AsyncSendQueue::recordDropped(size_t byte_count)
+{
+  _dropped += byte_count;
+}
+
+
+void AsyncSendQueue::stats(SendQueueStats &stats) const
+{
+  stats.queued_bytes = queuedBytes();
+  stats.peak_queued_bytes = _peak_queued;
+  stats.capacity = _buffer.size();
+  stats.sent_bytes = _tail;
+  stats.dropped_bytes = _dropped;
+}
+
+
+void AsyncSendQueue::stop()
+{
+  if (_thread.joinable())
+  {
+    _quit = true;
+    {
+      const std::lock_guard<std::mutex> guard(_wait_lock);
+      _data_ready.notify_all();
+    }
+    _thread.join();
+  }
+}
+
+
+void AsyncSendQueue::run()
+{
+  while (!_failed)
+  {
+    const uint64_t tail = _tail.load(std::memory_order_relaxed);
+    const uint64_t flush_mark = _flush_mark.load();
+    if (flush_mark != _flushed_mark.load(std::memory_order_relaxed) && tail >= flush_mark)
+    {
+      // All data up to the flush request have been written.
+      _flush();
+      _flushed_mark.store(flush_mark);
+    }
+
+    const uint64_t head = _head.load();
+    if (head == tail)
+    {
+      if (_quit)
+      {
+        break;
+      }
+      waitForData();
+      continue;
+    }
+
+    // Write up to the end of the ring buffer.
+    const auto offset = static_cast<size_t>(tail % _buffer.size());
+    const size_t count =
+      std::min({ static_cast<size_t>(head - tail), _buffer.size() - offset,
+                 static_cast<size_t>(std::numeric_limits<int>::max()) });
+    const int wrote = _write(_buffer.data() + offset, static_cast<int>(count));
+    if (wrote < 0)
+    {
+      _failed = true;
+      break;
+    }
+
+    _tail.store(tail + static_cast<uint64_t>(wrote));
+
+    if (_producer_waiting)
+    {
+      const std::lock_guard<std::mutex> guard(_wait_lock);
+      _space_ready.notify_all();
+    }
+  }
+
+  // Release any blocked producer.
+  const std::lock_guard<std::mutex> guard(_wait_lock);
+  _space_ready.notify_all();
+}
+
+
+void AsyncSendQueue::waitForData()
+{
+  std::unique_lock<std::mutex> lock(_wait_lock);
+  _sender_waiting = true;
+  _data_ready.wait(lock, [this]() {
+    return _head != _tail || _flush_mark != _flushed_mark || _quit || _failed;
+  });
+  _sender_waiting = false;
+}
+
+
+void AsyncSendQueue::waitForSpace()
+{
+  std::unique_lock<std::mutex> lock(_wait_lock);
+  _producer_waiting = true;
+  _space_ready.wait(lock, [this]() { return freeBytes() > 0 || _failed; });
+  _producer_waiting = false;
+}
+}  // namespace tes
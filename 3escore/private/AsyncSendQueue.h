@@ -0,0 +1,126 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_PRIVATE_ASYNC_SEND_QUEUE_H
+#define TES_CORE_PRIVATE_ASYNC_SEND_QUEUE_H
+
+#include "../Server.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tes
+{
+/// A bounded byte queue drained by a dedicated sender thread.
+///
+/// Bytes are pushed into a single producer, single consumer, lock-free ring buffer by the
+/// connection and written out by the sender thread using a @c WriteFunction . The producer side
+/// must be externally serialised - @c BaseConnection does so via its @c _send_lock .
+///
+/// The mutex and condition variables are only used to sleep the sender thread while the queue is
+/// empty and to block the producer under the @c SOBlock policy while the queue is full.
+///
+/// The @c SendOverflow policy is applied in @c push() for @c SOBlock and @c SODisconnect. The
+/// @c SODropTransient policy requires the caller to check @c freeBytes() before pushing data
+/// which may be dropped, while other data blocks as for @c SOBlock .
+class AsyncSendQueue
+{
+public:
+  /// Function used to write data from the sender thread. Returns the number of bytes written or -1
+  /// on error.
+  using WriteFunction = std::function<int(const uint8_t *, int)>;
+  /// Function called from the sender thread once all data pushed before a @c flush() call have
+  /// been written.
+  using FlushFunction = std::function<void()>;
+
+  /// Create a send queue and start the sender thread.
+  /// @param capacity The ring buffer capacity in bytes.
+  /// @param overflow The @c SendOverflow policy.
+  /// @param write Function used to write data from the sender thread.
+  /// @param flush Optional function invoked for @c flush() requests.
+  AsyncSendQueue(size_t capacity, SendOverflow overflow, WriteFunction write,
+                 FlushFunction flush = {});
+  /// Destructor. Calls @c stop() .
+  ~AsyncSendQueue();
+
+  AsyncSendQueue(const AsyncSendQueue &) = delete;
+  AsyncSendQueue &operator=(const AsyncSendQueue &) = delete;
+
+  /// Query the overflow policy.
+  /// @return The @c SendOverflow policy.
+  [[nodiscard]] SendOverflow overflow() const { return _overflow; }
+
+  /// Check if the queue has failed, either on a write error or on overflow with @c SODisconnect .
+  /// @return True on failure. No further data will be sent.
+  [[nodiscard]] bool failed() const { return _failed; }
+
+  /// Query the number of bytes currently queued.
+  /// @return The queue depth in bytes.
+  [[nodiscard]] size_t queuedBytes() const;
+
+  /// Query the number of bytes which may be pushed without blocking.
+  /// @return The available space in bytes.
+  [[nodiscard]] size_t freeBytes() const { return _buffer.size() - queuedBytes(); }
+
+  /// Push @p byte_count bytes from @p data onto the queue, applying the overflow policy if full.
+  /// @param data The data to queue.
+  /// @param byte_count Number of bytes in @p data .
+  /// @return @p byte_count on success, -1 on failure.
+  int push(const uint8_t *data, int byte_count);
+
+  /// Request a call to the @c FlushFunction once all data pushed so far have been written. Used to
+  /// mark the end of a frame. Multiple requests made before the sender thread catches up result in
+  /// a single call.
+  void flush();
+
+  /// Record that @p byte_count bytes have been dropped rather than pushed.
+  /// @param byte_count Number of bytes dropped.
+  void recordDropped(size_t byte_count);
+
+  /// Populate @p stats with the current queue statistics.
+  /// @param[out] stats The structure to populate.
+  void stats(SendQueueStats &stats) const;
+
+  /// Stop the sender thread after it has sent all queued data or failed. Blocks until the thread
+  /// exits. Further pushes fail.
+  void stop();
+
+private:
+  void run();
+
+  /// Sleep the sender thread until data is available or we are quitting.
+  void waitForData();
+  /// Sleep the producer until there is space in the queue or the queue fails.
+  void waitForSpace();
+
+  std::vector<uint8_t> _buffer;
+  WriteFunction _write;
+  FlushFunction _flush;
+  SendOverflow _overflow = SOBlock;
+  /// Total bytes pushed. Written by the producer only.
+  std::atomic_uint64_t _head = { 0 };
+  /// Total bytes sent. Written by the sender thread only.
+  std::atomic_uint64_t _tail = { 0 };
+  /// The @c _head value at the last @c flush() request. Written by the producer only.
+  std::atomic_uint64_t _flush_mark = { 0 };
+  /// The @c _flush_mark value at the last @c FlushFunction call. Written by the sender thread only.
+  std::atomic_uint64_t _flushed_mark = { 0 };
+  std::atomic_uint64_t _peak_queued = { 0 };
+  std::atomic_uint64_t _dropped = { 0 };
+  std::atomic_bool _sender_waiting = { false };
+  std::atomic_bool _producer_waiting = { false };
+  std::atomic_bool _quit = { false };
+  std::atomic_bool _failed = { false };
+  std::mutex _wait_lock;
+  std::condition_variable _data_ready;
+  std::condition_variable _space_ready;
+  std::thread _thread;
+};
+}  // namespace tes
+
+#endif  // TES_CORE_PRIVATE_ASYNC_SEND_QUEUE_H
@@ -3,44 +3,88 @@
 //
 #include "BaseConnection.h"
 
+#include "CompressionPool.h"
+#include "ResourceCache.h"
+#include "ResourceScheduler.h"
+#include "ShapeSubmitQueue.h"
+
 #include <3escore/CollatedPacket.h>
 #include <3escore/CoreUtil.h>
 #include <3escore/Debug.h>
 #include <3escore/Endian.h>
 #include <3escore/Log.h>
+#include <3escore/PacketReader.h>
 #include <3escore/Resource.h>
-#include <3escore/ResourcePacker.h>
 #include <3escore/Rotation.h>
 #include <3escore/TcpSocket.h>
 
 #include <3escore/shapes/Shape.h>
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <limits>
 
 namespace tes
 {
 namespace
 {
 constexpr float kSecondsToMicroseconds = 1e6;
+/// Maximum number of collated packets awaiting compression per connection. The producer blocks
+/// when this is reached.
+constexpr size_t kMaxPendingCollations = 8;
 }  // namespace
 
-BaseConnection::BaseConnection(const ServerSettings &settings)
-  : _current_resource(std::make_unique<ResourcePacker>())
+BaseConnection::BaseConnection(const ServerSettings &settings,
+                               std::shared_ptr<CompressionPool> compression_pool,
+                               std::shared_ptr<ResourceCache> resource_cache)
+  : _transfer_scheduler(std::make_unique<ResourceScheduler>(
+      settings.transfer_concurrency, resource_cache,
+      [this](PacketWriter &packet) { return finalisePacket(packet, true); }))
+  , _resource_cache(std::move(resource_cache))
+  , _transfer_time_budget_us(settings.transfer_time_budget_us)
   , _server_flags(settings.flags)
   , _collation(std::make_unique<CollatedPacket>((settings.flags & SFCompress) != 0))
+  , _compression_pool((settings.flags & SFCollate) ? std::move(compression_pool) : nullptr)
 {
   _packet_buffer.resize(settings.client_buffer_size);
   _packet = std::make_unique<PacketWriter>(_packet_buffer.data(),
                                            int_cast<uint16_t>(_packet_buffer.size()));
+  _packet->setLittleEndian((settings.flags & SFLittleEndian) != 0);
+  if ((settings.flags & SFExtendedPackets) &&
+      settings.extended_buffer_size > settings.client_buffer_size)
+  {
+    _transfer_buffer.resize(settings.extended_buffer_size);
+    _transfer_packet =
+      std::make_unique<PacketWriter>(_transfer_buffer.data(), settings.extended_buffer_size);
+    _transfer_packet->setLittleEndian((settings.flags & SFLittleEndian) != 0);
+    _transfer_packet->setExtended(true);
+  }
   initDefaultServerInfo(&_server_info);
   _seconds_to_time_unit =
     kSecondsToMicroseconds /
     (_server_info.time_unit ? static_cast<float>(_server_info.time_unit) : 1.0f);
   _collation->setCompressionLevel(settings.compression_level);
+  if (!_collation->setCompressionCodec(settings.compression_codec))
+  {
+    log::warn("Compression codec ", settings.compression_codec,
+              " is not available. Using default compression.");
+  }
+  _collation->setCompressionDictionary((settings.flags & SFCompressionDictionary) != 0);
+  _collation->setElideNestedCrc((settings.flags & SFNestedNoCrc) != 0);
 }
 
 
-BaseConnection::~BaseConnection() = default;
+BaseConnection::~BaseConnection()
+{
+  if (_resource_cache)
+  {
+    for (const auto &[resource_id, info] : _resources)
+    {
+      _resource_cache->release(resource_id);
+    }
+  }
+}
 
 
 void BaseConnection::setActive(bool enable)
@@ -77,7 +121,7 @@ bool BaseConnection::sendServerInfo(const ServerInfoMessage &info)
       {
         const std::lock_guard<Lock> send_guard(_send_lock);
         // Do not use collation buffer or compression for this message.
-        writeBytes(_packet_buffer.data(), _packet->packetSize());
+        writeOrdered(_packet_buffer.data(), _packet->packetSize());
         return true;
       }
     }
@@ -117,32 +161,27 @@ int BaseConnection::send(const CollatedPacket &collated)
 
   // Use the packet lock to prevent other sends until the collated packet is flushed.
   const std::lock_guard<Lock> guard(_packet_lock);
-  // Extract each packet in turn.
-  // Cycle each message and send.
-  const auto *packet = reinterpret_cast<const PacketHeader *>(bytes);
-  unsigned processed_bytes = CollatedPacket::InitialCursorOffset;
-  unsigned packet_size = 0;
-  uint16_t payload_size = 0;
-  bool crc_present = false;
-  if (!(packet->flags & PFNoCrc))
-  {
-    processed_bytes -= static_cast<unsigned>(sizeof(PacketWriter::CrcType));
-  }
-  packet = reinterpret_cast<const PacketHeader *>(bytes + processed_bytes);
-  while (processed_bytes + sizeof(PacketHeader) < collated_bytes)
+  // Extract each packet in turn. The collated header may be extended (see PFExtended).
+  const PacketReader collated_reader(reinterpret_cast<const PacketHeader *>(bytes));
+  unsigned processed_bytes =
+    collated_reader.headerSize() + static_cast<unsigned>(sizeof(CollatedPacketMessage));
+  // Exclude the collated packet CRC.
+  const unsigned crc_bytes = ((collated_reader.flags() & PFNoCrc) == 0) ?
+                               static_cast<unsigned>(sizeof(PacketWriter::CrcType)) :
+                               0u;
+  const unsigned end_bytes = collated_bytes - crc_bytes;
+  while (processed_bytes + sizeof(PacketHeader) <= end_bytes)
   {
     // Determine current packet size.
-    // Get payload size.
-    payload_size = packet->payload_size;
-    networkEndianSwap(payload_size);
-    // Add header size.
-    packet_size = payload_size + static_cast<unsigned>(sizeof(PacketHeader));
-    // Add Crc Size.
-    crc_present = (packet->flags & PFNoCrc) == 0;
-    packet_size += !!crc_present * static_cast<unsigned>(sizeof(PacketWriter::CrcType));
+    const auto *packet = reinterpret_cast<const PacketHeader *>(bytes + processed_bytes);
+    if (processed_bytes + sizeof(PacketHeader) + packet->payload_offset > end_bytes)
+    {
+      return -1;
+    }
+    const unsigned packet_size = PacketReader(packet).packetSize();
 
     // Send packet.
-    if (packet_size + processed_bytes > collated_bytes)
+    if (packet_size + processed_bytes > end_bytes)
     {
       return -1;
     }
@@ -150,7 +189,6 @@ int BaseConnection::send(const CollatedPacket &collated)
 
     // Next packet.
     processed_bytes += packet_size;
-    packet = reinterpret_cast<const PacketHeader *>(bytes + processed_bytes);
   }
 
   return int_cast<int>(processed_bytes);
@@ -164,7 +202,18 @@ int BaseConnection::send(const uint8_t *data, int byte_count, bool allow_collati
     return 0;
   }
 
-  return writePacket(data, int_cast<uint16_t>(byte_count), allow_collation);
+  if (byte_count < 0)
+  {
+    return -1;
+  }
+
+  const int wrote = writePacket(data, static_cast<unsigned>(byte_count), allow_collation);
+  if (!allow_collation)
+  {
+    // Uncollated messages are generally control messages which should not be held back.
+    flushOrdered();
+  }
+  return wrote;
 }
 
 
@@ -179,8 +228,15 @@ int BaseConnection::create(const Shape &shape)
   const std::lock_guard<Lock> guard(_packet_lock);
   if (shape.writeCreate(*_packet))
   {
+    finalisePacket();
+
+    // Transient shapes may be dropped under load.
+    if (shape.isTransient() && !admitTransient(_packet->packetSize()))
+    {
+      return 0;
+    }
+
     // Send the create message.
-    _packet->finalise();
     writePacket(_packet_buffer.data(), _packet->packetSize(), true);
     int64_t total_bytes_written = _packet->packetSize();
 
@@ -238,7 +294,7 @@ int BaseConnection::destroy(const Shape &shape)
 
   if (shape.writeDestroy(*_packet))
   {
-    _packet->finalise();
+    finalisePacket();
     writePacket(_packet_buffer.data(), _packet->packetSize(), true);
     return _packet->packetSize();
   }
@@ -256,7 +312,7 @@ int BaseConnection::update(const Shape &shape)
   const std::lock_guard<Lock> guard(_packet_lock);
   if (shape.writeUpdate(*_packet))
   {
-    _packet->finalise();
+    finalisePacket();
 
     writePacket(_packet_buffer.data(), _packet->packetSize(), true);
     return _packet->packetSize();
@@ -265,59 +321,213 @@ int BaseConnection::update(const Shape &shape)
 }
 
 
-int BaseConnection::updateTransfers(unsigned byte_limit)
+int BaseConnection::create(const Shape &shape, const SharedPacketBufferPtr &encoded)
 {
   if (!_active)
   {
     return 0;
   }
 
+  // Transient shapes may be dropped under load.
+  if (shape.isTransient() && !admitTransient(encoded->byteCount()))
+  {
+    return 0;
+  }
+
   const std::lock_guard<Lock> guard(_packet_lock);
-  const std::lock_guard<Lock> resource_guard(_resource_lock);
-  unsigned transferred = 0;
+  const int wrote = writeEncoded(*encoded);
+  if (wrote < 0)
+  {
+    return -1;
+  }
+
+  if (!shape.skipResources())
+  {
+    queueResources(shape);
+  }
+
+  return wrote;
+}
+
+
+int BaseConnection::destroy(const Shape &shape, const SharedPacketBufferPtr &encoded)
+{
+  if (!_active)
+  {
+    return 0;
+  }
+
+  const std::lock_guard<Lock> guard(_packet_lock);
+
+  // Release resources before the destroy message as per destroy(const Shape &).
+  if (shape.id() && !shape.skipResources())
+  {
+    _resource_buffer.clear();
+    shape.enumerateResources(_resource_buffer);
+    for (const auto &resource : _resource_buffer)
+    {
+      releaseResource(resource->uniqueKey());
+    }
+    // clear buffer to avoid holding references.
+    _resource_buffer.clear();
+  }
+
+  return writeEncoded(*encoded);
+}
+
+
+int BaseConnection::update(const SharedPacketBufferPtr &encoded)
+{
+  if (!_active)
+  {
+    return 0;
+  }
+
+  const std::lock_guard<Lock> guard(_packet_lock);
+  return writeEncoded(*encoded);
+}
+
+
+int BaseConnection::sendEncoded(const SharedPacketBuffer &encoded)
+{
+  if (!_active)
+  {
+    return 0;
+  }
+
+  const std::lock_guard<Lock> guard(_packet_lock);
+  return writeEncoded(encoded);
+}
+
+
+int BaseConnection::submit(const SubmitBatch &batch, const SubmittedMessage &message)
+{
+  if (!_active)
+  {
+    return 0;
+  }
 
-  while ((!byte_limit || transferred < byte_limit) &&
-         (_current_resource->isValid() || !_resource_queue.empty()))
+  const ResourcePtr *resources = batch.resources.data() + message.first_resource;
+  switch (message.type)
   {
-    if (!_current_resource->isValid())
+  case SubmittedMessage::Create: {
+    // Transient shapes may be dropped under load.
+    if (message.transient &&
+        !admitTransient(batch.packets.byteCount(message.first_packet, message.packet_count)))
+    {
+      return 0;
+    }
+
+    const std::lock_guard<Lock> guard(_packet_lock);
+    const int wrote = writeEncoded(batch.packets, message.first_packet, message.packet_count);
+    if (wrote < 0)
+    {
+      return -1;
+    }
+
+    if (!message.skip_resources)
     {
-      if (!_resource_queue.empty())  // Should never be empty. Loop check this.
+      if (message.transient)
+      {
+        checkResources(message.routing_id, message.shape_id, resources, message.resource_count);
+      }
+      else
       {
-        // Start the next resource transfer.
-        const uint64_t next_resource = _resource_queue.front();
-        _resource_queue.pop_front();
-        auto resource_info = _resources.find(next_resource);
-        if (resource_info != _resources.end())
+        for (unsigned i = 0; i < message.resource_count; ++i)
         {
-          auto &resource = resource_info->second.resource;
-          resource_info->second.started = true;
-          _current_resource->transfer(resource);
+          referenceResource(resources[i]);
         }
       }
-      continue;
     }
+    return wrote;
+  }
 
-    if (_current_resource->nextPacket(*_packet, byte_limit ? byte_limit - transferred : 0))
+  case SubmittedMessage::Destroy: {
+    const std::lock_guard<Lock> guard(_packet_lock);
+    // Release resources before the destroy message as per destroy(const Shape &).
+    for (unsigned i = 0; i < message.resource_count; ++i)
     {
-      _packet->finalise();
-      writePacket(_packet->data(), _packet->packetSize(), true);
-      transferred += _packet->packetSize();
+      releaseResource(resources[i]->uniqueKey());
     }
+    return writeEncoded(batch.packets, message.first_packet, message.packet_count);
+  }
+
+  case SubmittedMessage::Update:
+  default: {
+    const std::lock_guard<Lock> guard(_packet_lock);
+    return writeEncoded(batch.packets, message.first_packet, message.packet_count);
+  }
+  }
+}
 
-    // Check completion.
-    if (!_current_resource->isValid())
+
+int BaseConnection::updateTransfers(unsigned byte_limit)
+{
+  if (!_active)
+  {
+    return 0;
+  }
+
+  const std::lock_guard<Lock> guard(_packet_lock);
+  const std::lock_guard<Lock> resource_guard(_resource_lock);
+  using Clock = std::chrono::steady_clock;
+  const auto deadline = Clock::now() + std::chrono::microseconds(_transfer_time_budget_us);
+  unsigned transferred = 0;
+
+  while ((!byte_limit || transferred < byte_limit) && !_transfer_scheduler->empty())
+  {
+    PacketWriter &packet = (_transfer_packet) ? *_transfer_packet : *_packet;
+    ResourceScheduler::ScheduledPacket scheduled;
+    // Use the full byte limit for each packet. A resource fails to transfer if the limit is too
+    // small for a single data element, so the last packet may overshoot the limit instead.
+    const bool have_packet = _transfer_scheduler->nextPacket(packet, byte_limit, scheduled);
+
+    auto resource_info = _resources.find(scheduled.resource_key);
+    if (have_packet)
     {
-      // Have completed
-      const uint64_t completed_id = _current_resource->lastCompletedId();
-      auto resource_info = _resources.find(completed_id);
+      unsigned packet_size = 0;
+      if (scheduled.cached)
+      {
+        // Already finalised.
+        const uint8_t *cached = scheduled.cached->packet(scheduled.cached_index, packet_size);
+        writePacket(cached, packet_size, true);
+      }
+      else
+      {
+        if (!scheduled.finalised)
+        {
+          finalisePacket(packet, true);
+        }
+        packet_size = packet.packetSize();
+        writePacket(packet.data(), packet_size, true);
+      }
+      transferred += packet_size;
+      _transfer_scheduler->recordSent(scheduled.resource_key, packet_size);
       if (resource_info != _resources.end())
       {
-        resource_info->second.sent = true;
+        resource_info->second.started = true;
       }
     }
+
+    if (scheduled.completed && resource_info != _resources.end())
+    {
+      resource_info->second.sent = true;
+    }
+
+    if (!have_packet && !scheduled.completed)
+    {
+      // Nothing fits the remaining byte limit.
+      break;
+    }
+
+    // Checked after sending so each call makes progress.
+    if (_transfer_time_budget_us && Clock::now() >= deadline)
+    {
+      break;
+    }
   }
 
-  return 0;
+  return static_cast<int>(std::min<unsigned>(transferred, std::numeric_limits<int>::max()));
 }
 
 
@@ -340,11 +550,12 @@ int BaseConnection::updateFrame(float dt, bool flush)
   _packet->reset(MtControl, CIdFrame);
   if (msg.write(*_packet))
   {
-    _packet->finalise();
-    wrote = writePacket(_packet_buffer.data(), _packet->packetSize(),
-                        !(_server_flags & SFNakedFrameMessage));
+    const bool allow_collation = !(_server_flags & SFNakedFrameMessage);
+    finalisePacket(allow_collation);
+    wrote = writePacket(_packet_buffer.data(), _packet->packetSize(), allow_collation);
   }
   flushCollatedPacket();
+  flushOrdered(true);
   return wrote;
 }
 
@@ -363,11 +574,17 @@ unsigned BaseConnection::referenceResource(const ResourcePtr &resource)
   if (existing != _resources.end())
   {
     ref_count = ++existing->second.reference_count;
+    // Recently referenced resources move ahead of others pending.
+    _transfer_scheduler->touch(resource_id);
   }
   else
   {
     _resources.emplace(std::make_pair(resource_id, ResourceInfo(resource)));
-    _resource_queue.push_back(resource_id);
+    _transfer_scheduler->enqueue(resource);
+    if (_resource_cache)
+    {
+      _resource_cache->reference(resource_id);
+    }
     ref_count = 1;
   }
 
@@ -387,6 +604,21 @@ unsigned BaseConnection::releaseResource(const ResourcePtr &resource)
 }
 
 
+bool BaseConnection::setResourcePriority(const ResourcePtr &resource, int priority)
+{
+  const std::lock_guard<Lock> resource_guard(_resource_lock);
+  return _transfer_scheduler->setPriority(resource->uniqueKey(), priority);
+}
+
+
+bool BaseConnection::resourceTransfers(std::vector<ResourceTransferProgress> &transfers) const
+{
+  const std::lock_guard<Lock> resource_guard(_resource_lock);
+  _transfer_scheduler->progress(transfers);
+  return true;
+}
+
+
 int BaseConnection::sendShapeData(const Shape &shape)
 {
   TES_ASSERT(shape.isComplex());
@@ -395,7 +627,7 @@ int BaseConnection::sendShapeData(const Shape &shape)
   int total_bytes_written = 0;
   while ((status = shape.writeData(*_packet, progress)) >= 0)
   {
-    if (!_packet->finalise())
+    if (!finalisePacket())
     {
       return -1;
     }
@@ -447,26 +679,65 @@ unsigned BaseConnection::queueResources(const Shape &shape)
 
 bool BaseConnection::checkResources(const Shape &shape)
 {
-  bool all_present = true;
   _resource_buffer.clear();
   shape.enumerateResources(_resource_buffer);
-  for (const auto &resource : _resource_buffer)
+  const bool all_present = checkResources(shape.routingId(), shape.id(), _resource_buffer.data(),
+                                          _resource_buffer.size());
+  // clear buffer to avoid holding references.
+  _resource_buffer.clear();
+
+  return all_present;
+}
+
+
+bool BaseConnection::checkResources(uint16_t routing_id, uint32_t shape_id,
+                                    const ResourcePtr *resources, size_t resource_count)
+{
+  bool all_present = true;
+  for (size_t i = 0; i < resource_count; ++i)
   {
+    const auto &resource = resources[i];
     const auto search = _resources.find(resource->uniqueKey());
     if (search == _resources.end())
     {
       all_present = false;
-      log::warn("Shape ", shape.routingId(), ":", shape.id(), " missing resource ",
-                resource->typeId(), ":", resource->id());
+      log::warn("Shape ", routing_id, ":", shape_id, " missing resource ", resource->typeId(), ":",
+                resource->id());
     }
   }
-  // clear buffer to avoid holding references.
-  _resource_buffer.clear();
 
   return all_present;
 }
 
 
+bool BaseConnection::admitTransient(size_t byte_count)
+{
+  size_t free_bytes = 0;
+  if (!transientBufferSpace(free_bytes))
+  {
+    return true;
+  }
+
+  // Pending collated data will be written ahead of the transient shape.
+  size_t required = byte_count;
+  {
+    const std::lock_guard<Lock> guard(_send_lock);
+    if (_collation->collatedBytes())
+    {
+      required += _collation->collatedBytes() + _collation->overhead();
+    }
+  }
+
+  if (free_bytes >= required)
+  {
+    return true;
+  }
+
+  recordDroppedTransient(byte_count);
+  return false;
+}
+
+
 unsigned BaseConnection::releaseResource(uint64_t resource_id)
 {
   unsigned reference_count = 0;
@@ -480,22 +751,22 @@ unsigned BaseConnection::releaseResource(uint64_t resource_id)
     }
     else
     {
-      if (_current_resource->resource() &&
-          _current_resource->resource()->uniqueKey() == resource_id)
-      {
-        _current_resource->cancel();
-      }
+      _transfer_scheduler->remove(resource_id);
 
       if (existing->second.started || existing->second.sent)
       {
         // Send destroy message.
         _packet->reset();
         existing->second.resource->destroy(*_packet);
-        _packet->finalise();
+        finalisePacket();
         writePacket(_packet_buffer.data(), _packet->packetSize(), true);
       }
 
       _resources.erase(existing);
+      if (_resource_cache)
+      {
+        _resource_cache->release(resource_id);
+      }
     }
   }
 
@@ -512,21 +783,113 @@ void BaseConnection::flushCollatedPacket()
 
 void BaseConnection::flushCollatedPacketUnguarded()
 {
+  if (_collation->collatedBytes() && _compression_pool)
+  {
+    // Hand the collated packet to the compression pool and start a new one.
+    auto pending = std::make_unique<PendingPacket>();
+    PendingPacket *item = pending.get();
+    {
+      std::unique_lock<Lock> pending_guard(_pending_lock);
+      _pending_changed.wait(pending_guard,
+                            [this]() { return _pending.size() < kMaxPendingCollations; });
+      const bool compress = _collation->compressionEnabled();
+      const int compression_level = _collation->compressionLevel();
+      const uint16_t compression_codec = _collation->compressionCodec();
+      const bool compression_dictionary = _collation->compressionDictionary();
+      const bool elide_nested_crc = _collation->elideNestedCrc();
+      item->collation = std::move(_collation);
+      if (!_spare_collations.empty())
+      {
+        _collation = std::move(_spare_collations.back());
+        _spare_collations.pop_back();
+      }
+      else
+      {
+        _collation = std::make_unique<CollatedPacket>(compress);
+        _collation->setCompressionLevel(compression_level);
+        _collation->setCompressionCodec(compression_codec);
+        _collation->setCompressionDictionary(compression_dictionary);
+        _collation->setElideNestedCrc(elide_nested_crc);
+      }
+      _pending.emplace_back(std::move(pending));
+      ++_pending_jobs;
+    }
+
+    _compression_pool->submit([this, item]() {
+      item->collation->finalise();
+      {
+        const std::lock_guard<Lock> pending_guard(_pending_lock);
+        item->ready = true;
+      }
+      forwardPending();
+      // Releasing the job must be the last access to this: drainPending() may then return and
+      // the connection be destroyed.
+      const std::lock_guard<Lock> pending_guard(_pending_lock);
+      --_pending_jobs;
+      _pending_changed.notify_all();
+    });
+    return;
+  }
+
   if (_collation->collatedBytes())
   {
     _collation->finalise();
-    unsigned byte_count = 0;
-    const uint8_t *bytes = _collation->buffer(byte_count);
-    if (bytes && byte_count)
+    writeCollated(*_collation);
+    _collation->reset();
+  }
+}
+
+
+int BaseConnection::writeEncoded(const SharedPacketBuffer &encoded)
+{
+  return writeEncoded(encoded, 0, encoded.packetCount());
+}
+
+
+int BaseConnection::writeEncoded(const SharedPacketBuffer &encoded, unsigned first_packet,
+                                 unsigned packet_count)
+{
+  int64_t total_bytes_written = 0;
+  for (unsigned i = first_packet; i < first_packet + packet_count; ++i)
+  {
+    unsigned packet_size = 0;
+    const uint8_t *packet = encoded.packet(i, packet_size);
+    if (writePacket(packet, packet_size, true) < 0)
     {
-      writeBytes(bytes, int_cast<int>((byte_count)));
+      return -1;
     }
-    _collation->reset();
+    total_bytes_written += packet_size;
+  }
+
+  if (total_bytes_written > std::numeric_limits<int>::max())
+  {
+    log::warn("Large byte data transfer - ", total_bytes_written);
+    total_bytes_written = std::numeric_limits<int>::max();
   }
+
+  return static_cast<int>(total_bytes_written);
 }
 
 
-int BaseConnection::writePacket(const uint8_t *buffer, uint16_t byte_count, bool allow_collation)
+bool BaseConnection::finalisePacket(bool allow_collation)
+{
+  return finalisePacket(*_packet, allow_collation);
+}
+
+
+bool BaseConnection::finalisePacket(PacketWriter &packet, bool allow_collation)
+{
+  if (allow_collation && (_server_flags & SFCollate) && (_server_flags & SFNestedNoCrc) &&
+      packet.packetSize() + CollatedPacket::Overhead <= CollatedPacket::kMaxPacketSize)
+  {
+    // The packet will be nested in a collated packet with its own CRC.
+    packet.packet().flags |= PFNoCrc;
+  }
+  return packet.finalise();
+}
+
+
+int BaseConnection::writePacket(const uint8_t *buffer, unsigned byte_count, bool allow_collation)
 {
   const std::unique_lock<Lock> guard(_send_lock);
 
@@ -537,7 +900,7 @@ int BaseConnection::writePacket(const uint8_t *buffer, uint16_t byte_count, bool
 
   if ((SFCollate & _server_flags) == 0 || !allow_collation)
   {
-    return writeBytes(buffer, byte_count);
+    return writeOrdered(buffer, byte_count);
   }
 
   // Add to the collection buffer.
@@ -552,13 +915,191 @@ int BaseConnection::writePacket(const uint8_t *buffer, uint16_t byte_count, bool
     // Failed to collate. Packet may be too big to collated (due to collation overhead).
     // Flush the buffer, then send without collation.
     flushCollatedPacketUnguarded();
-    send_count = writeBytes(buffer, byte_count);
+    send_count = writeOrdered(buffer, byte_count);
   }
 
   return send_count;
 }
 
 
+int BaseConnection::writeOrdered(const uint8_t *data, int byte_count)
+{
+  if (!_compression_pool)
+  {
+    return writeBytes(data, byte_count);
+  }
+
+  if (_forward_failed)
+  {
+    return -1;
+  }
+
+  bool queued = false;
+  {
+    const std::lock_guard<Lock> pending_guard(_pending_lock);
+    if (!_pending.empty())
+    {
+      // Queue behind the pending collated packets.
+      auto pending = std::make_unique<PendingPacket>();
+      pending->bytes.assign(data, data + byte_count);
+      pending->ready = true;
+      _pending.emplace_back(std::move(pending));
+      queued = true;
+    }
+  }
+
+  if (queued)
+  {
+    forwardPending();
+    return byte_count;
+  }
+
+  // Nothing pending. Only this thread adds pending items, so we can write directly once any in
+  // flight forwarding completes.
+  const std::lock_guard<Lock> forward_guard(_forward_lock);
+  return writeBytes(data, byte_count);
+}
+
+
+int BaseConnection::writeSegments(const BufferSegment *segments, unsigned segment_count)
+{
+  int64_t total_bytes_written = 0;
+  for (unsigned i = 0; i < segment_count; ++i)
+  {
+    const int wrote = writeBytes(segments[i].data, int_cast<int>(segments[i].byte_count));
+    if (wrote < 0)
+    {
+      return -1;
+    }
+    total_bytes_written += wrote;
+  }
+  return static_cast<int>(
+    std::min<int64_t>(total_bytes_written, std::numeric_limits<int>::max()));
+}
+
+
+int BaseConnection::writeCollated(const CollatedPacket &collation)
+{
+  std::array<BufferSegment, CollatedPacket::kMaxSegments> segments;
+  const unsigned segment_count = collation.segments(segments);
+  return (segment_count) ? writeSegments(segments.data(), segment_count) : 0;
+}
+
+
+void BaseConnection::flushOrdered(bool end_frame)
+{
+  const std::lock_guard<Lock> guard(_send_lock);
+  if (_compression_pool)
+  {
+    bool queued = false;
+    {
+      const std::lock_guard<Lock> pending_guard(_pending_lock);
+      if (!_pending.empty())
+      {
+        // Flush once the pending collated packets have been written.
+        auto pending = std::make_unique<PendingPacket>();
+        pending->flush = true;
+        pending->end_frame = end_frame;
+        pending->ready = true;
+        _pending.emplace_back(std::move(pending));
+        queued = true;
+      }
+    }
+
+    if (queued)
+    {
+      forwardPending();
+      return;
+    }
+
+    // As for writeOrdered(), wait for any in flight forwarding to complete.
+    const std::lock_guard<Lock> forward_guard(_forward_lock);
+    flushWrites();
+    if (end_frame)
+    {
+      frameWritten();
+    }
+    return;
+  }
+
+  flushWrites();
+  if (end_frame)
+  {
+    frameWritten();
+  }
+}
+
+
+void BaseConnection::forwardPending()
+{
+  const std::lock_guard<Lock> forward_guard(_forward_lock);
+  while (true)
+  {
+    std::unique_ptr<PendingPacket> item;
+    {
+      const std::lock_guard<Lock> pending_guard(_pending_lock);
+      if (_pending.empty() || !_pending.front()->ready)
+      {
+        break;
+      }
+      item = std::move(_pending.front());
+      _pending.pop_front();
+    }
+
+    int wrote = 0;
+    if (item->flush)
+    {
+      flushWrites();
+      if (item->end_frame)
+      {
+        frameWritten();
+      }
+    }
+    else if (item->collation)
+    {
+      wrote = writeCollated(*item->collation);
+    }
+    else
+    {
+      wrote = writeBytes(item->bytes.data(), int_cast<int>(item->bytes.size()));
+    }
+
+    if (wrote < 0)
+    {
+      _forward_failed = true;
+    }
+
+    {
+      const std::lock_guard<Lock> pending_guard(_pending_lock);
+      if (item->collation)
+      {
+        item->collation->reset();
+        _spare_collations.emplace_back(std::move(item->collation));
+      }
+    }
+    _pending_changed.notify_all();
+  }
+}
+
+
+void BaseConnection::drainPending()
+{
+  if (!_compression_pool)
+  {
+    return;
+  }
+
+  // Wait for the compression jobs as well as the queue. Another thread may write and pop an item
+  // before the job which completed it returns from forwardPending().
+  std::unique_lock<Lock> pending_guard(_pending_lock);
+  _pending_changed.wait(pending_guard,
+                        [this]() { return _pending.empty() && _pending_jobs == 0; });
+  pending_guard.unlock();
+  // Wait for the last item to finish writing.
+  const std::lock_guard<Lock> forward_guard(_forward_lock);
+}
+
+
 void BaseConnection::ensurePacketBufferCapacity(size_t size)
 {
   if (_packet_buffer.capacity() < size)
@@ -567,6 +1108,7 @@ void BaseConnection::ensurePacketBufferCapacity(size_t size)
     _packet_buffer.resize(size);
     _packet = std::make_unique<PacketWriter>(_packet_buffer.data(),
                                              int_cast<uint16_t>(_packet_buffer.size()));
+    _packet->setLittleEndian((_server_flags & SFLittleEndian) != 0);
   }
   else if (_packet_buffer.size() < size)
   {
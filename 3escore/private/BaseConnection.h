@@ -6,11 +6,16 @@
 
 #include "../Server.h"
 
+#include "SharedPacketBuffer.h"
+
+#include <3escore/BufferSegment.h>
 #include <3escore/Connection.h>
 #include <3escore/Messages.h>
 #include <3escore/PacketWriter.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <list>
 #include <memory>
 #include <mutex>
@@ -20,8 +25,12 @@
 namespace tes
 {
 class CollatedPacket;
+class CompressionPool;
 class Resource;
-class ResourcePacker;
+class ResourceCache;
+class ResourceScheduler;
+struct SubmitBatch;
+struct SubmittedMessage;
 class TcpSocket;
 
 
@@ -40,7 +49,13 @@ public:
   /// Create a new connection using the given @p clientSocket.
   /// @param clientSocket The socket to communicate on.
   /// @param settings Various server settings to initialise with.
-  BaseConnection(const ServerSettings &settings);
+  /// @param compression_pool Optional worker pool used to finalise collated packets off the
+  ///   calling thread. Only used with @c SFCollate .
+  /// @param resource_cache Optional encoded resource cache shared by the server's connections. See
+  ///   @c SFResourceCache .
+  BaseConnection(const ServerSettings &settings,
+                 std::shared_ptr<CompressionPool> compression_pool = {},
+                 std::shared_ptr<ResourceCache> resource_cache = {});
   ~BaseConnection() override;
 
   /// Activate/deactivate the connection. Messages are ignored while inactive.
@@ -62,6 +77,42 @@ public:
   int destroy(const Shape &shape) override;
   int update(const Shape &shape) override;
 
+  /// Send a create message for @p shape which has already been encoded to @p encoded .
+  ///
+  /// This supports the @c TcpServer encoding a shape once for all connections. The @p encoded
+  /// packets must have been generated by @c SharedPacketBuffer::encodeCreate() for @p shape .
+  /// The @p shape is still required for resource book keeping.
+  ///
+  /// @param shape The shape being created.
+  /// @param encoded The encoded create and data packets for @p shape .
+  /// @return The number of bytes written on success (possibly zero), -1 on failure.
+  int create(const Shape &shape, const SharedPacketBufferPtr &encoded);
+  /// Send a destroy message for @p shape which has already been encoded to @p encoded .
+  /// @param shape The shape being destroyed.
+  /// @param encoded The encoded destroy packet for @p shape .
+  /// @return The number of bytes written on success (possibly zero), -1 on failure.
+  int destroy(const Shape &shape, const SharedPacketBufferPtr &encoded);
+  /// Send an update message which has already been encoded to @p encoded .
+  /// @param encoded The encoded update packet.
+  /// @return The number of bytes written on success (possibly zero), -1 on failure.
+  int update(const SharedPacketBufferPtr &encoded);
+
+  /// Send pre-encoded packets allowing collation. Used to send retained state to late joining
+  /// connections with @c SFRetainState . No resource book keeping is performed.
+  /// @param encoded The encoded packets to send.
+  /// @return The number of bytes written on success (possibly zero), -1 on failure.
+  int sendEncoded(const SharedPacketBuffer &encoded);
+
+  /// Deliver a shape message submitted via the @c ShapeSubmitQueue with @c SFMultiProducer .
+  ///
+  /// This handles resource book keeping using the resources captured in @p batch as per the
+  /// equivalent @c create() , @c update() or @c destroy() call.
+  ///
+  /// @param batch The batch containing @p message .
+  /// @param message The message to deliver.
+  /// @return The number of bytes written on success (possibly zero), -1 on failure.
+  int submit(const SubmitBatch &batch, const SubmittedMessage &message);
+
   int updateTransfers(unsigned byte_limit) override;
   int updateFrame(float dt, bool flush) override;
   using Connection::updateFrame;
@@ -69,9 +120,52 @@ public:
   unsigned referenceResource(const ResourcePtr &resource) override;
   unsigned releaseResource(const ResourcePtr &resource) override;
 
+  bool setResourcePriority(const ResourcePtr &resource, int priority) override;
+  bool resourceTransfers(std::vector<ResourceTransferProgress> &transfers) const override;
+
 protected:
   virtual int writeBytes(const uint8_t *data, int byte_count) = 0;
 
+  /// Write @p segment_count buffers in order as if they were a single contiguous buffer. Used to
+  /// write finalised collated packets without copying - see @c CollatedPacket::segments() .
+  ///
+  /// The default implementation calls @c writeBytes() for each segment.
+  /// @param segments The buffers to write.
+  /// @param segment_count The number of @p segments .
+  /// @return The number of bytes written on success, -1 on failure.
+  virtual int writeSegments(const BufferSegment *segments, unsigned segment_count);
+
+  /// Called once all the data for a frame have been written, ordered with respect to
+  /// @c writeBytes() and @c writeSegments() calls. Derivations which hold back written data
+  /// should flush it. See @c SFCorkFrames .
+  ///
+  /// The default implementation does nothing.
+  virtual void flushWrites() {}
+
+  /// Called once all the data for a frame, up to and including the @c CIdFrame message, have been
+  /// written, ordered with respect to @c writeBytes() and @c writeSegments() calls. Follows the
+  /// @c flushWrites() call for the frame.
+  ///
+  /// The default implementation does nothing.
+  virtual void frameWritten() {}
+
+  /// Query the free space in the connection's bounded write buffer for @c admitTransient() .
+  ///
+  /// The default implementation has no bounded buffer.
+  ///
+  /// @param[out] free_bytes Set to the free buffer space (bytes) when returning true.
+  /// @return True if the buffer uses the @c SODropTransient policy.
+  virtual bool transientBufferSpace(size_t &free_bytes) const
+  {
+    TES_UNUSED(free_bytes);
+    return false;
+  }
+
+  /// Record a transient shape dropped by @c admitTransient() . Only called when
+  /// @c transientBufferSpace() returns true.
+  /// @param byte_count The number of bytes dropped.
+  virtual void recordDroppedTransient(size_t byte_count) { TES_UNUSED(byte_count); }
+
   /// Internal structure for managing a resource.
   struct ResourceInfo
   {
@@ -90,6 +184,17 @@ protected:
     {}
   };
 
+  /// Called before sending a create message for a transient shape, allowing the connection to shed
+  /// load by dropping the shape. Transient shapes only persist for a single frame so may be dropped
+  /// without corrupting the client state.
+  ///
+  /// The shape is dropped when @c transientBufferSpace() cannot fit it along with any pending
+  /// collated data, which is written ahead of the shape.
+  ///
+  /// @param byte_count The number of bytes required for the shape's create message.
+  /// @return True to send the shape, false to drop it.
+  bool admitTransient(size_t byte_count);
+
   /// Decrement references count to the indicated @c resource_id, removing if necessary.
   ///
   /// @note The @c _packet_lock must be locked before calling this function.
@@ -127,31 +232,115 @@ protected:
   /// @return True if all resources are present in the known resource set for this connection.
   bool checkResources(const Shape &shape);
 
+  /// Check if all @p resources are present in the resource set, logging warnings for missing
+  /// resources.
+  /// @param routing_id The routing id of the shape using the resources - for logging.
+  /// @param shape_id The id of the shape using the resources - for logging.
+  /// @param resources The resources to check.
+  /// @param resource_count The number of items in @p resources .
+  /// @return True if all resources are present in the known resource set for this connection.
+  bool checkResources(uint16_t routing_id, uint32_t shape_id, const ResourcePtr *resources,
+                      size_t resource_count);
+
   /// Send pending collated/compressed data.
   ///
   /// Note: the @c _lock must be locked before calling this function.
   void flushCollatedPacket();
 
   /// Send pending collated/compressed data without using the threadding guard.
+  ///
+  /// With a @c CompressionPool, the collated packet is handed to the pool for finalisation and
+  /// is forwarded to @c writeBytes() once complete and all preceeding data have been written.
   void flushCollatedPacketUnguarded();
 
+  /// Write bytes via @c writeBytes() preserving order with respect to collated packets pending
+  /// in the @c CompressionPool. The bytes are queued behind any such pending packets.
+  ///
+  /// Note: the @c _send_lock must be locked before calling this function.
+  /// @param data The data to write.
+  /// @param byte_count Number of bytes in @p data .
+  /// @return The number of bytes written or queued on success, -1 on failure.
+  int writeOrdered(const uint8_t *data, int byte_count);
+
+  /// Write a finalised @p collation via @c writeSegments() .
+  /// @param collation The finalised collated packet.
+  /// @return The number of bytes written on success, -1 on failure.
+  int writeCollated(const CollatedPacket &collation);
+
+  /// Call @c flushWrites() once all preceeding data have been written, including collated packets
+  /// pending in the @c CompressionPool .
+  /// @param end_frame True to also call @c frameWritten() .
+  void flushOrdered(bool end_frame = false);
+
+  /// Write completed items from the front of @c _pending in order. Called from the
+  /// @c CompressionPool workers and @c writeOrdered() .
+  void forwardPending();
+
+  /// Block until all packets pending in the @c CompressionPool have been written and their
+  /// compression jobs have completed.
+  ///
+  /// Derivations must call this from @c close() before releasing their write resources.
+  void drainPending();
+
+  /// Write each packet in @p encoded via @c writePacket() allowing collation.
+  ///
+  /// Note: the @c _packet_lock must be locked before calling this function.
+  /// @param encoded The encoded packets to write.
+  /// @return The number of bytes written on success (possibly zero), -1 on failure.
+  int writeEncoded(const SharedPacketBuffer &encoded);
+
+  /// Write a range of packets from @p encoded via @c writePacket() allowing collation.
+  ///
+  /// Note: the @c _packet_lock must be locked before calling this function.
+  /// @param encoded The encoded packets to write.
+  /// @param first_packet Index of the first packet to write.
+  /// @param packet_count Number of packets to write.
+  /// @return The number of bytes written on success (possibly zero), -1 on failure.
+  int writeEncoded(const SharedPacketBuffer &encoded, unsigned first_packet,
+                   unsigned packet_count);
+
+  /// Finalise @c _packet ready for @c writePacket() .
+  ///
+  /// With @c SFNestedNoCrc , @c PFNoCrc is set on packets which will be nested in a collated
+  /// packet so no CRC is calculated.
+  ///
+  /// Note: the @c _packet_lock must be locked before calling this function.
+  /// @param allow_collation The @c allow_collation value to be passed to @c writePacket() .
+  /// @return True on success.
+  bool finalisePacket(bool allow_collation = true);
+
+  /// Finalise @p packet ready for @c writePacket() as per @c finalisePacket(bool) .
+  /// @param packet The packet to finalise. Either @c _packet or @c _transfer_packet .
+  /// @param allow_collation The @c allow_collation value to be passed to @c writePacket() .
+  /// @return True on success.
+  bool finalisePacket(PacketWriter &packet, bool allow_collation);
+
   /// Write data to the client. Handles collation and compression if enabled.
   ///
   /// Note: the @c _lock must be locked before calling this function.
   /// @param buffer The data buffer to send from.
   /// @param byte_count Number of bytes from @p buffer to send.
   /// @param True to allow collation and compression for this packet.
-  int writePacket(const uint8_t *buffer, uint16_t byte_count, bool allow_collation);
+  int writePacket(const uint8_t *buffer, unsigned byte_count, bool allow_collation);
 
   void ensurePacketBufferCapacity(size_t size);
 
   Lock _packet_lock;    ///< Lock for using @c _packet
   Lock _send_lock;      ///< Lock for @c writePacket() and @c flushCollatedPacket()
-  Lock _resource_lock;  ///< Lock for @c _resources
+  mutable Lock _resource_lock;  ///< Lock for @c _resources and @c _transfer_scheduler
   std::unique_ptr<PacketWriter> _packet;
   std::vector<uint8_t> _packet_buffer;
-  std::unique_ptr<ResourcePacker> _current_resource;  ///< Current resource being transmitted.
-  std::list<uint64_t> _resource_queue;
+  /// Extended packet used for resource transfers with @c SFExtendedPackets . Null otherwise. Uses
+  /// the @c _packet_lock .
+  std::unique_ptr<PacketWriter> _transfer_packet;
+  std::vector<uint8_t> _transfer_buffer;  ///< Buffer for @c _transfer_packet .
+  /// Schedules the resources awaiting transfer.
+  std::unique_ptr<ResourceScheduler> _transfer_scheduler;
+  /// Encoded resource cache shared with other connections. Holds a reference for each entry in
+  /// @c _resources .
+  std::shared_ptr<ResourceCache> _resource_cache;
+  /// See @c ServerSettings::transfer_time_budget_us .
+  uint32_t _transfer_time_budget_us = 0;
   std::unordered_map<uint64_t, ResourceInfo> _resources;
   /// Buffer used when calling @c Shape::enumerateResources() . Use is transient.
   std::vector<ResourcePtr> _resource_buffer;
@@ -159,6 +348,35 @@ protected:
   float _seconds_to_time_unit = 0;
   unsigned _server_flags = 0;
   std::unique_ptr<CollatedPacket> _collation;
+
+  /// An item pending compression and/or forwarding to @c writeBytes() when using a
+  /// @c CompressionPool.
+  struct PendingPacket
+  {
+    /// Collated packet to finalise and write. Null for @c bytes items.
+    std::unique_ptr<CollatedPacket> collation;
+    /// Raw bytes to write when @c collation is null.
+    std::vector<uint8_t> bytes;
+    /// Call @c flushWrites() rather than writing data.
+    bool flush = false;
+    /// Also call @c frameWritten() with @c flush .
+    bool end_frame = false;
+    /// True once ready to write. Access guarded by @c _pending_lock .
+    bool ready = false;
+  };
+
+  std::shared_ptr<CompressionPool> _compression_pool;
+  Lock _pending_lock;  ///< Lock for @c _pending and @c _spare_collations
+  Lock _forward_lock;  ///< Serialises @c writeBytes() calls from @c forwardPending()
+  std::condition_variable _pending_changed;
+  /// Items awaiting compression or forwarding, in send order.
+  std::deque<std::unique_ptr<PendingPacket>> _pending;
+  /// Number of jobs submitted to the @c CompressionPool which have yet to complete. Access guarded
+  /// by @c _pending_lock .
+  unsigned _pending_jobs = 0;
+  /// Recycled @c CollatedPacket objects for use as @c _collation .
+  std::vector<std::unique_ptr<CollatedPacket>> _spare_collations;
+  std::atomic_bool _forward_failed = { false };
   std::atomic_bool _active = { true };
 };
 }  // namespace tes
@@ -0,0 +1,236 @@
+//
+// author: Kazys Stepanas
+//
+#include "BufferedFileWriter.h"
+
+#include <3escore/Log.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace tes
+{
+BufferedFileWriter::BufferedFileWriter(size_t block_size, uint64_t buffer_limit,
+                                       SendOverflow overflow, WriteFunction write)
+  : _block_size(std::max<size_t>(block_size, 1u))
+  , _max_blocks(static_cast<size_t>(std::max<uint64_t>(buffer_limit / _block_size, 2u)))
+  , _write(std::move(write))
+  , _overflow(overflow)
+{
+  _stats.buffer_limit = static_cast<uint64_t>(_max_blocks) * _block_size;
+  _thread = std::thread([this]() { run(); });
+}
+
+
+BufferedFileWriter::~BufferedFileWriter()
+{
+  stop();
+}
+
+
+bool BufferedFileWriter::failed() const
+{
+  const std::lock_guard<std::mutex> guard(_lock);
+  return _failed;
+}
+
+
+size_t BufferedFileWriter::freeBytes() const
+{
+  const std::lock_guard<std::mutex> guard(_lock);
+  return freeBytesUnguarded();
+}
+
+
+int BufferedFileWriter::push(const uint8_t *data, int byte_count)
+{
+  std::unique_lock<std::mutex> lock(_lock);
+  if (_failed || _quit)
+  {
+    return -1;
+  }
+
+  if (byte_count <= 0)
+  {
+    return 0;
+  }
+
+  auto remaining = static_cast<size_t>(byte_count);
+  if (_overflow == SODisconnect)
+  {
+    // Fail rather than block if the data will not fit.
+    if (freeBytesUnguarded() < remaining)
+    {
+      log::error("File write buffer overflow: ", _stats.pending_bytes, " bytes pending, limit ",
+                 _stats.buffer_limit, ". Closing file stream.");
+      _stats.dropped_bytes += remaining;
+      _failed = true;
+      return -1;
+    }
+  }
+
+  const uint8_t *src = data;
+  while (remaining)
+  {
+    if (!_current && !acquireBlock(lock))
+    {
+      return -1;
+    }
+
+    const size_t count = std::min(remaining, _block_size - _current->used);
+    std::memcpy(_current->bytes.data() + _current->used, src, count);
+    _current->used += count;
+    _stats.pending_bytes += count;
+    src += count;
+    remaining -= count;
+
+    if (_current->used == _block_size)
+    {
+      submitUnguarded();
+    }
+  }
+
+  _stats.peak_pending_bytes = std::max(_stats.peak_pending_bytes, _stats.pending_bytes);
+  return byte_count;
+}
+
+
+bool BufferedFileWriter::sync()
+{
+  std::unique_lock<std::mutex> lock(_lock);
+  submitUnguarded();
+  _space_ready.wait(lock, [this]() { return (_queue.empty() && !_writing) || _failed; });
+  return !_failed;
+}
+
+
+void BufferedFileWriter::recordDropped(size_t byte_count)
+{
+  const std::lock_guard<std::mutex> guard(_lock);
+  _stats.dropped_bytes += byte_count;
+}
+
+
+void BufferedFileWriter::stats(FileWriteStats &stats) const
+{
+  const std::lock_guard<std::mutex> guard(_lock);
+  stats = _stats;
+}
+
+
+void BufferedFileWriter::stop()
+{
+  if (_thread.joinable())
+  {
+    {
+      const std::lock_guard<std::mutex> guard(_lock);
+      submitUnguarded();
+      _quit = true;
+      _data_ready.notify_all();
+    }
+    _thread.join();
+  }
+}
+
+
+void BufferedFileWriter::run()
+{
+  std::unique_lock<std::mutex> lock(_lock);
+  while (true)
+  {
+    _data_ready.wait(lock, [this]() { return !_queue.empty() || _quit; });
+    if (_queue.empty())
+    {
+      // Quitting with all data written.
+      break;
+    }
+
+    std::unique_ptr<Block> block = std::move(_queue.front());
+    _queue.pop_front();
+    _writing = true;
+    const bool skip = _failed;
+    lock.unlock();
+
+    bool ok = false;
+    uint64_t elapsed_us = 0;
+    if (!skip)
+    {
+      const auto start_time = std::chrono::steady_clock::now();
+      ok = _write(block->bytes.data(), block->used);
+      elapsed_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                           std::chrono::steady_clock::now() - start_time)
+                                           .count());
+    }
+
+    lock.lock();
+    _stats.pending_bytes -= std::min<uint64_t>(_stats.pending_bytes, block->used);
+    if (ok)
+    {
+      _stats.written_bytes += block->used;
+      ++_stats.block_count;
+      _stats.last_flush_us = elapsed_us;
+      _stats.max_flush_us = std::max(_stats.max_flush_us, elapsed_us);
+      _stats.total_flush_us += elapsed_us;
+    }
+    else
+    {
+      // Discard data once a write fails. The stream is incomplete.
+      _failed = true;
+    }
+    block->used = 0;
+    _spare.emplace_back(std::move(block));
+    _writing = false;
+    _space_ready.notify_all();
+  }
+}
+
+
+size_t BufferedFileWriter::freeBytesUnguarded() const
+{
+  const size_t busy_blocks = _queue.size() + (_writing ? 1u : 0u) + (_current ? 1u : 0u);
+  const size_t free_blocks = _max_blocks - std::min(busy_blocks, _max_blocks);
+  return free_blocks * _block_size + ((_current) ? _block_size - _current->used : 0u);
+}
+
+
+void BufferedFileWriter::submitUnguarded()
+{
+  if (_current && _current->used)
+  {
+    _queue.emplace_back(std::move(_current));
+    _data_ready.notify_one();
+  }
+}
+
+
+bool BufferedFileWriter::acquireBlock(std::unique_lock<std::mutex> &lock)
+{
+  while (!_current)
+  {
+    if (_failed)
+    {
+      return false;
+    }
+
+    if (!_spare.empty())
+    {
+      _current = std::move(_spare.back());
+      _spare.pop_back();
+    }
+    else if (_block_count < _max_blocks)
+    {
+      _current = std::make_unique<Block>();
+      _current->bytes.resize(_block_size);
+      ++_block_count;
+    }
+    else
+    {
+      // Buffer limit reached. Wait for the writer thread to release a block.
+      ++_stats.stall_count;
+      _space_ready.wait(lock, [this]() { return !_spare.empty() || _failed; });
+    }
+  }
+  return true;
+}
+}  // namespace tes
@@ -0,0 +1,132 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_PRIVATE_BUFFERED_FILE_WRITER_H
+#define TES_CORE_PRIVATE_BUFFERED_FILE_WRITER_H
+
+#include "../Server.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tes
+{
+/// Buffers bytes into large blocks which are written out by a dedicated writer thread. See
+/// @c SFBufferedFileWrite .
+///
+/// The producer copies data into the current block. Full blocks are queued for the writer thread
+/// which hands them back for reuse once written, so at least two blocks double buffer the stream.
+/// Only full blocks are written until @c sync() or @c stop() , keeping disk writes large.
+///
+/// Memory is bounded by the buffer limit. The @c SendOverflow policy is applied when no block is
+/// available: @c SOBlock waits for the writer thread, @c SODisconnect fails the writer, while
+/// @c SODropTransient requires the caller to check @c freeBytes() before pushing data which may be
+/// dropped, as for @c AsyncSendQueue .
+///
+/// The lock is never held while writing, so the producer only stalls when the buffer limit is
+/// reached.
+class BufferedFileWriter
+{
+public:
+  /// Function used to write a block from the writer thread. Returns false on error.
+  using WriteFunction = std::function<bool(const uint8_t *, size_t)>;
+
+  /// Create the writer and start the writer thread.
+  /// @param block_size The size of each block (bytes).
+  /// @param buffer_limit Limit on the total block memory (bytes). Raised to at least two blocks.
+  /// @param overflow The @c SendOverflow policy.
+  /// @param write Function used to write blocks from the writer thread.
+  BufferedFileWriter(size_t block_size, uint64_t buffer_limit, SendOverflow overflow,
+                     WriteFunction write);
+  /// Destructor. Calls @c stop() .
+  ~BufferedFileWriter();
+
+  BufferedFileWriter(const BufferedFileWriter &) = delete;
+  BufferedFileWriter &operator=(const BufferedFileWriter &) = delete;
+
+  /// Query the overflow policy.
+  /// @return The @c SendOverflow policy.
+  [[nodiscard]] SendOverflow overflow() const { return _overflow; }
+
+  /// Check if the writer has failed, either on a write error or on overflow with
+  /// @c SODisconnect .
+  /// @return True on failure. No further data will be written.
+  [[nodiscard]] bool failed() const;
+
+  /// Query the number of bytes which may be pushed without blocking.
+  /// @return The available buffer space in bytes.
+  [[nodiscard]] size_t freeBytes() const;
+
+  /// Push @p byte_count bytes from @p data , applying the overflow policy if the buffer limit is
+  /// reached.
+  /// @param data The data to write.
+  /// @param byte_count Number of bytes in @p data .
+  /// @return @p byte_count on success, -1 on failure.
+  int push(const uint8_t *data, int byte_count);
+
+  /// Queue the current partial block and wait until all data pushed so far have been written.
+  /// @return True on success, false if the writer has failed.
+  bool sync();
+
+  /// Record that @p byte_count bytes have been dropped rather than pushed.
+  /// @param byte_count Number of bytes dropped.
+  void recordDropped(size_t byte_count);
+
+  /// Populate @p stats with the current writer statistics.
+  /// @param[out] stats The structure to populate.
+  void stats(FileWriteStats &stats) const;
+
+  /// Write all pushed data and stop the writer thread. Blocks until the thread exits. Further
+  /// pushes fail.
+  void stop();
+
+private:
+  /// A buffered block.
+  struct Block
+  {
+    std::vector<uint8_t> bytes;
+    /// Number of bytes used in @c bytes .
+    size_t used = 0;
+  };
+
+  void run();
+
+  /// Implementation of @c freeBytes() . Requires the @c _lock .
+  [[nodiscard]] size_t freeBytesUnguarded() const;
+  /// Queue the current block for writing. Requires the @c _lock .
+  void submitUnguarded();
+  /// Make a block current, applying the overflow policy if none are available. Requires the
+  /// @c _lock , which may be released while blocking.
+  /// @return True on success.
+  bool acquireBlock(std::unique_lock<std::mutex> &lock);
+
+  size_t _block_size = 0;
+  size_t _max_blocks = 0;
+  WriteFunction _write;
+  SendOverflow _overflow = SOBlock;
+  std::unique_ptr<Block> _current;
+  /// Full blocks awaiting the writer thread.
+  std::deque<std::unique_ptr<Block>> _queue;
+  /// Written blocks available for reuse.
+  std::vector<std::unique_ptr<Block>> _spare;
+  /// Number of blocks allocated.
+  size_t _block_count = 0;
+  /// True while the writer thread is writing a block.
+  bool _writing = false;
+  bool _quit = false;
+  bool _failed = false;
+  FileWriteStats _stats;
+  mutable std::mutex _lock;
+  std::condition_variable _data_ready;
+  std::condition_variable _space_ready;
+  std::thread _thread;
+};
+}  // namespace tes
+
+#endif  // TES_CORE_PRIVATE_BUFFERED_FILE_WRITER_H
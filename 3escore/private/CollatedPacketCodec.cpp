@@ -0,0 +1,171 @@
+//
+// author: Kazys Stepanas
+//
+#include "CollatedPacketCodec.h"
+
+#include <3escore/CoreUtil.h>
+#include <3escore/Meta.h>
+
+#include <algorithm>
+#include <array>
+
+#ifdef TES_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif  // TES_LZ4
+
+#ifdef TES_ZSTD
+#include <zstd.h>
+#endif  // TES_ZSTD
+
+namespace tes
+{
+namespace
+{
+#ifdef TES_LZ4
+/// Maps @c CompressionLevel to LZ4 settings. Positive values are the acceleration factor for
+/// @c LZ4_compress_fast() . Negative values are the negated LZ4HC level.
+const std::array<int, ClLevels> kTesToLz4CompressionLevel = {
+  64,   // ClNone,
+  8,    // ClLow,
+  1,    // ClMedium
+  -9,   // ClHigh,
+  -12,  // ClVeryHigh
+};
+#endif  // TES_LZ4
+
+#ifdef TES_ZSTD
+const std::array<int, ClLevels> kTesToZstdCompressionLevel = {
+  -5,  // ClNone,
+  1,   // ClLow,
+  3,   // ClMedium
+  9,   // ClHigh,
+  19,  // ClVeryHigh
+};
+#endif  // TES_ZSTD
+}  // namespace
+
+CollatedPacketCodec::~CollatedPacketCodec()
+{
+#ifdef TES_ZSTD
+  ZSTD_freeCCtx(_zstd_compress);
+  ZSTD_freeDCtx(_zstd_decompress);
+#endif  // TES_ZSTD
+}
+
+
+bool CollatedPacketCodec::available(uint16_t codec)
+{
+  switch (codec)
+  {
+#ifdef TES_LZ4
+  case CCLz4:
+    return true;
+#endif  // TES_LZ4
+#ifdef TES_ZSTD
+  case CCZstd:
+    return true;
+#endif  // TES_ZSTD
+  default:
+    break;
+  }
+  return false;
+}
+
+
+size_t CollatedPacketCodec::compress(uint16_t codec, int level, const uint8_t *src,
+                                     size_t src_size, uint8_t *dst, size_t dst_capacity)
+{
+  level = std::max(static_cast<int>(ClNone), std::min(level, static_cast<int>(ClLevels) - 1));
+  switch (codec)
+  {
+#ifdef TES_LZ4
+  case CCLz4: {
+    const int lz4_level = kTesToLz4CompressionLevel[level];
+    const auto state_size = static_cast<size_t>(std::max(LZ4_sizeofState(), LZ4_sizeofStateHC()));
+    if (_lz4_state.size() < state_size)
+    {
+      _lz4_state.resize(state_size);
+    }
+
+    const auto *lz4_src = reinterpret_cast<const char *>(src);
+    auto *lz4_dst = reinterpret_cast<char *>(dst);
+    const int src_bytes = int_cast<int>(src_size);
+    const int dst_bytes = int_cast<int>(std::min<size_t>(dst_capacity, 0x7fffffffu));
+    const int compressed =
+      (lz4_level > 0) ?
+        LZ4_compress_fast_extState(_lz4_state.data(), lz4_src, lz4_dst, src_bytes, dst_bytes,
+                                   lz4_level) :
+        LZ4_compress_HC_extStateHC(_lz4_state.data(), lz4_src, lz4_dst, src_bytes, dst_bytes,
+                                   -lz4_level);
+    return (compressed > 0) ? static_cast<size_t>(compressed) : 0u;
+  }
+#endif  // TES_LZ4
+#ifdef TES_ZSTD
+  case CCZstd: {
+    if (!_zstd_compress)
+    {
+      _zstd_compress = ZSTD_createCCtx();
+      if (!_zstd_compress)
+      {
+        return 0;
+      }
+    }
+
+    const size_t compressed = ZSTD_compressCCtx(_zstd_compress, dst, dst_capacity, src, src_size,
+                                                kTesToZstdCompressionLevel[level]);
+    return (!ZSTD_isError(compressed)) ? compressed : 0u;
+  }
+#endif  // TES_ZSTD
+  default:
+    TES_UNUSED(src);
+    TES_UNUSED(src_size);
+    TES_UNUSED(dst);
+    TES_UNUSED(dst_capacity);
+    break;
+  }
+
+  return 0;
+}
+
+
+bool CollatedPacketCodec::decompress(uint16_t codec, const uint8_t *src, size_t src_size,
+                                     uint8_t *dst, size_t dst_size)
+{
+  switch (codec)
+  {
+#ifdef TES_LZ4
+  case CCLz4: {
+    const int decompressed =
+      LZ4_decompress_safe(reinterpret_cast<const char *>(src), reinterpret_cast<char *>(dst),
+                          int_cast<int>(src_size), int_cast<int>(dst_size));
+    return decompressed >= 0 && static_cast<size_t>(decompressed) == dst_size;
+  }
+#endif  // TES_LZ4
+#ifdef TES_ZSTD
+  case CCZstd: {
+    if (!_zstd_decompress)
+    {
+      _zstd_decompress = ZSTD_createDCtx();
+      if (!_zstd_decompress)
+      {
+        return false;
+      }
+    }
+
+    const size_t decompressed =
+      ZSTD_decompressDCtx(_zstd_decompress, dst, dst_size, src, src_size);
+    return !ZSTD_isError(decompressed) && decompressed == dst_size;
+  }
+#endif  // TES_ZSTD
+  default:
+    TES_UNUSED(src);
+    TES_UNUSED(src_size);
+    TES_UNUSED(dst);
+    TES_UNUSED(dst_size);
+    break;
+  }
+
+  return false;
+}
+}  // namespace tes
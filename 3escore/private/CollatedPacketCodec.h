@@ -0,0 +1,75 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_PRIVATE_COLLATED_PACKET_CODEC_H
+#define TES_CORE_PRIVATE_COLLATED_PACKET_CODEC_H
+
+#include <3escore/CoreConfig.h>
+
+#include <3escore/CompressionLevel.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef TES_ZSTD
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+#endif  // TES_ZSTD
+
+namespace tes
+{
+/// Compression state for the block codecs - @c CCLz4 and @c CCZstd - used for collated packets.
+///
+/// Deflate is handled by @c CollatedPacketZip as it is decoded incrementally. The block codecs
+/// compress and decompress the entire collated payload in one call. Codec contexts are created on
+/// first use and recycled for subsequent packets.
+class CollatedPacketCodec
+{
+public:
+  CollatedPacketCodec() = default;
+  ~CollatedPacketCodec();
+
+  CollatedPacketCodec(const CollatedPacketCodec &) = delete;
+  CollatedPacketCodec &operator=(const CollatedPacketCodec &) = delete;
+
+  /// Check if @p codec is a block codec available in this build.
+  /// @param codec The @c CompressionCodec to check.
+  /// @return True if @p codec is @c CCLz4 or @c CCZstd and is available.
+  static bool available(uint16_t codec);
+
+  /// Compress @p src into @p dst .
+  /// @param codec The @c CompressionCodec to use.
+  /// @param level The @c CompressionLevel to map to a codec specific level.
+  /// @param src The bytes to compress.
+  /// @param src_size Number of bytes in @p src .
+  /// @param dst The output buffer.
+  /// @param dst_capacity Number of bytes available in @p dst .
+  /// @return The number of compressed bytes written to @p dst or zero on failure, including when
+  /// the compressed data will not fit in @p dst_capacity .
+  size_t compress(uint16_t codec, int level, const uint8_t *src, size_t src_size, uint8_t *dst,
+                  size_t dst_capacity);
+
+  /// Decompress @p src into @p dst , which must be exactly the original, uncompressed size.
+  /// @param codec The @c CompressionCodec used to compress @p src .
+  /// @param src The compressed bytes.
+  /// @param src_size Number of bytes in @p src .
+  /// @param dst The output buffer.
+  /// @param dst_size The expected number of uncompressed bytes.
+  /// @return True on success.
+  bool decompress(uint16_t codec, const uint8_t *src, size_t src_size, uint8_t *dst,
+                  size_t dst_size);
+
+private:
+#ifdef TES_LZ4
+  /// State buffer for LZ4 compression. Sized for either fast or HC compression as required.
+  std::vector<uint8_t> _lz4_state;
+#endif  // TES_LZ4
+#ifdef TES_ZSTD
+  ZSTD_CCtx_s *_zstd_compress = nullptr;
+  ZSTD_DCtx_s *_zstd_decompress = nullptr;
+#endif  // TES_ZSTD
+};
+}  // namespace tes
+
+#endif  // TES_CORE_PRIVATE_COLLATED_PACKET_CODEC_H
@@ -1,5 +1,7 @@
 #include "CollatedPacketZip.h"
 
+#include <3escore/Messages.h>
+
 namespace tes
 {
 const std::array<int, ClLevels> kTesToGZipCompressionLevel = {
@@ -17,4 +19,200 @@ const std::array<int, ClLevels> kTesToGZipCompressionLevel = {
 #ifdef TES_ZLIB
 const int CollatedPacketZip::DefaultCompressionLevel = tes::kTesToGZipCompressionLevel[ClDefault];
 #endif  // TES_ZLIB
+
+namespace
+{
+/// The preset dictionary for @c CPFCompressDictionary . The bytes are frozen as the dictionary is
+/// not transmitted: changing it breaks decoding of existing streams.
+///
+/// The dictionary was generated from identity @c ObjectAttributesd , the @c PacketHeader for
+/// server info, category name and mesh messages, create/update/destroy/data headers for each
+/// built in shape, then the frame control header and identity @c ObjectAttributesf . Zlib favours
+/// matches towards the end of the dictionary, so the most common patterns are last. Header bytes
+/// are network endian with the payload size and flags zeroed.
+// clang-format off
+const std::array<uint8_t, 1216> kCollationDictionary = {
+  0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x3f, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3f, 0xf0, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x3f, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3f, 0xf0, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x01, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x06, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x05,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x06,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x07,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x08,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x09,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x40, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x40, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x40, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x40, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x41, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x41, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x41, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x41, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x42, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x42, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x42, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x42, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x43, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x43, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x43, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x43, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x44, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x44, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x44, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x44, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x45, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x45, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x45, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x45, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x46, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x46, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x46, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x46, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x47, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x47, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x47, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x47, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x48, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x48, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x48, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x48, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x49, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x49, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x49, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x49, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4a, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4a, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4a, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4a, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4b, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4b, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4b, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4b, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4c, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4c, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4c, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4c, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4d, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4d, 0x00, 0x02,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4d, 0x00, 0x03,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4d, 0x00, 0x04,
+  0x00, 0x00, 0x00, 0x00, 0x03, 0xe5, 0x5e, 0x30, 0x00, 0x00, 0x00, 0x04, 0x00, 0x02, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x3f, 0x80, 0x00, 0x00, 0x3f, 0x80, 0x00, 0x00, 0x3f, 0x80, 0x00, 0x00, 0x3f, 0x80, 0x00, 0x00,
+};
+// clang-format on
+}  // namespace
+
+const std::vector<uint8_t> &collationDictionary()
+{
+  static const std::vector<uint8_t> dictionary(kCollationDictionary.begin(),
+                                               kCollationDictionary.end());
+  return dictionary;
+}
+
+#ifdef TES_ZLIB
+bool CollatedPacketZip::beginDeflate(int gzip_level, bool use_dictionary)
+{
+  // NOLINTNEXTLINE(hicpp-signed-bitwise)
+  const int target_window_bits = (use_dictionary) ? WindowBits : WindowBits | GZipEncoding;
+  if (initialised && (level != gzip_level || window_bits != target_window_bits))
+  {
+    reset();
+  }
+
+  if (!initialised)
+  {
+    // params: stream,level, method, window bits, memLevel, strategy
+    if (deflateInit2(&stream, gzip_level, Z_DEFLATED, target_window_bits, 8, Z_DEFAULT_STRATEGY) !=
+        Z_OK)
+    {
+      return false;
+    }
+    initialised = true;
+    level = gzip_level;
+    window_bits = target_window_bits;
+  }
+  else if (deflateReset(&stream) != Z_OK)
+  {
+    reset();
+    return false;
+  }
+
+  if (use_dictionary)
+  {
+    const auto &dictionary = collationDictionary();
+    if (deflateSetDictionary(&stream, dictionary.data(), static_cast<uInt>(dictionary.size())) !=
+        Z_OK)
+    {
+      reset();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool CollatedPacketZip::beginInflate(bool use_dictionary)
+{
+  // NOLINTNEXTLINE(hicpp-signed-bitwise)
+  const int target_window_bits = (use_dictionary) ? WindowBits : WindowBits | GZipEncoding;
+  if (!initialised)
+  {
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.avail_in = 0;
+    stream.next_in = Z_NULL;
+    if (inflateInit2(&stream, target_window_bits) != Z_OK)
+    {
+      return false;
+    }
+    initialised = true;
+  }
+  else if (inflateReset2(&stream, target_window_bits) != Z_OK)
+  {
+    reset();
+    return false;
+  }
+  window_bits = target_window_bits;
+
+  return true;
+}
+
+
+bool CollatedPacketZip::setInflateDictionary()
+{
+  const auto &dictionary = collationDictionary();
+  return inflateSetDictionary(&stream, dictionary.data(), static_cast<uInt>(dictionary.size())) ==
+         Z_OK;
+}
+
+
+void CollatedPacketZip::reset()
+{
+  if (initialised)
+  {
+    if (!inflate_mode)
+    {
+      deflateEnd(&stream);
+    }
+    else
+    {
+      inflateEnd(&stream);
+    }
+  }
+  memset(&stream, 0, sizeof(stream));
+  initialised = false;
+}
+#endif  // TES_ZLIB
 }  // namespace tes
@@ -7,6 +7,8 @@
 #include <3escore/CompressionLevel.h>
 
 #include <array>
+#include <cstdint>
+#include <vector>
 
 #ifdef TES_ZLIB
 #include <cstring>
@@ -18,6 +20,15 @@ namespace tes
 {
 extern const std::array<int, ClLevels> kTesToGZipCompressionLevel;
 
+/// Access the preset dictionary used to prime compression of collated packets when
+/// @c CPFCompressDictionary is set.
+///
+/// The dictionary contains common @c PacketHeader and @c ObjectAttributes byte patterns. It is a
+/// frozen byte table rather than generated from the current encoding as it is not transmitted and
+/// must remain unchanged for existing streams to decode.
+/// @return The dictionary bytes.
+const std::vector<uint8_t> &collationDictionary();
+
 struct CollatedPacketZip
 {
 #ifdef TES_ZLIB
@@ -28,6 +39,12 @@ struct CollatedPacketZip
   /// ZLib stream.
   z_stream stream = {};
   bool inflate_mode = false;
+  /// True once @c stream has been initialised and requires an end call.
+  bool initialised = false;
+  /// Compression level @c stream was initialised with (deflate only).
+  int level = 0;
+  /// Window bits @c stream was initialised with.
+  int window_bits = 0;
 
   inline CollatedPacketZip(bool inflate)
   {
@@ -37,27 +54,34 @@ struct CollatedPacketZip
 
   inline ~CollatedPacketZip() { reset(); }
 
-  inline void reset()
-  {
-    // Ensure clean up
-    if (!inflate_mode)
-    {
-      if (stream.total_out)
-      {
-        deflate(&stream, Z_FINISH);
-        deflateEnd(&stream);
-      }
-    }
-    else
-    {
-      if (stream.total_in)
-      {
-        inflate(&stream, Z_FINISH);
-        inflateEnd(&stream);
-      }
-    }
-    memset(&stream, 0, sizeof(stream));
-  }
+  /// Prepare @c stream to deflate a new block.
+  ///
+  /// The stream is initialised on first use, then recycled using @c deflateReset() so long as the
+  /// @p gzip_level and @p use_dictionary are unchanged. With @p use_dictionary, the stream uses
+  /// the zlib format primed with the @c collationDictionary() (GZip does not support preset
+  /// dictionaries). Otherwise GZip format is used.
+  ///
+  /// @param gzip_level The zlib compression level.
+  /// @param use_dictionary True to prime with the @c collationDictionary() .
+  /// @return True on success.
+  bool beginDeflate(int gzip_level, bool use_dictionary);
+
+  /// Prepare @c stream to inflate a new block. The stream is initialised on first use then
+  /// recycled using @c inflateReset2() .
+  ///
+  /// @param use_dictionary True if the block has been compressed with the @c collationDictionary()
+  /// , in which case @c inflate() will report @c Z_NEED_DICT and @c setInflateDictionary() must be
+  /// called.
+  /// @return True on success.
+  bool beginInflate(bool use_dictionary);
+
+  /// Set the @c collationDictionary() on an inflate stream after @c inflate() reports
+  /// @c Z_NEED_DICT .
+  /// @return True on success.
+  bool setInflateDictionary();
+
+  /// Release the stream.
+  void reset();
 #else   // TES_ZLIB
   inline CollatedPacketZip(bool) {}
   inline void reset() {}
@@ -0,0 +1,66 @@
+//
+// author: Kazys Stepanas
+//
+#include "CompressionPool.h"
+
+#include <algorithm>
+
+namespace tes
+{
+CompressionPool::CompressionPool(unsigned thread_count)
+{
+  thread_count = std::max(thread_count, 1u);
+  _threads.reserve(thread_count);
+  for (unsigned i = 0; i < thread_count; ++i)
+  {
+    _threads.emplace_back([this]() { run(); });
+  }
+}
+
+
+CompressionPool::~CompressionPool()
+{
+  {
+    const std::lock_guard<std::mutex> guard(_lock);
+    _quit = true;
+  }
+  _jobs_available.notify_all();
+
+  for (auto &thread : _threads)
+  {
+    thread.join();
+  }
+}
+
+
+void CompressionPool::submit(Job job)
+{
+  {
+    const std::lock_guard<std::mutex> guard(_lock);
+    _jobs.emplace_back(std::move(job));
+  }
+  _jobs_available.notify_one();
+}
+
+
+void CompressionPool::run()
+{
+  std::unique_lock<std::mutex> lock(_lock);
+  while (true)
+  {
+    _jobs_available.wait(lock, [this]() { return _quit || !_jobs.empty(); });
+
+    if (_jobs.empty())
+    {
+      // Quitting with no outstanding work.
+      break;
+    }
+
+    Job job = std::move(_jobs.front());
+    _jobs.pop_front();
+    lock.unlock();
+    job();
+    lock.lock();
+  }
+}
+}  // namespace tes
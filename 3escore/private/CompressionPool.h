@@ -0,0 +1,59 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_PRIVATE_COMPRESSION_POOL_H
+#define TES_CORE_PRIVATE_COMPRESSION_POOL_H
+
+#include <3escore/CoreConfig.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tes
+{
+/// A small pool of worker threads used to finalise - compress and CRC - @c CollatedPacket data off
+/// the calling thread.
+///
+/// The pool is shared by all connections of a @c TcpServer (see
+/// @c ServerSettings::compression_threads ). Jobs are executed in submission order, but may
+/// complete in any order. Each @c BaseConnection is responsible for forwarding the results in
+/// order.
+class CompressionPool
+{
+public:
+  /// Job function type.
+  using Job = std::function<void()>;
+
+  /// Create a pool with @p thread_count workers.
+  /// @param thread_count The number of worker threads. Must be at least 1.
+  explicit CompressionPool(unsigned thread_count);
+  /// Destructor. Completes outstanding jobs, then joins the worker threads.
+  ~CompressionPool();
+
+  CompressionPool(const CompressionPool &) = delete;
+  CompressionPool &operator=(const CompressionPool &) = delete;
+
+  /// Query the number of worker threads.
+  /// @return The worker count.
+  [[nodiscard]] unsigned threadCount() const { return static_cast<unsigned>(_threads.size()); }
+
+  /// Submit a job for execution on a worker thread.
+  /// @param job The job to run.
+  void submit(Job job);
+
+private:
+  void run();
+
+  std::mutex _lock;
+  std::condition_variable _jobs_available;
+  std::deque<Job> _jobs;
+  std::vector<std::thread> _threads;
+  bool _quit = false;
+};
+}  // namespace tes
+
+#endif  // TES_CORE_PRIVATE_COMPRESSION_POOL_H
@@ -3,18 +3,37 @@
 //
 #include "FileConnection.h"
 
+#include "BufferedFileWriter.h"
+
+#include <3escore/CollatedPacket.h>
 #include <3escore/StreamUtil.h>
 
+#include <algorithm>
 #include <mutex>
 
 namespace tes
 {
-FileConnection::FileConnection(const std::string &filename, const ServerSettings &settings)
-  : BaseConnection(settings)
+FileConnection::FileConnection(const std::string &filename, const ServerSettings &settings,
+                               std::shared_ptr<CompressionPool> compression_pool,
+                               std::shared_ptr<ResourceCache> resource_cache)
+  : BaseConnection(settings, std::move(compression_pool), std::move(resource_cache))
   // NOLINTNEXTLINE(hicpp-signed-bitwise)
   , _out_file(filename, std::ios::binary | std::ios::out | std::ios::in | std::ios::trunc)
   , _filename(filename)
-{}
+{
+  if ((settings.flags & SFBufferedFileWrite) && _out_file.is_open())
+  {
+    _writer = std::make_unique<BufferedFileWriter>(
+      settings.file_block_size, settings.file_buffer_limit,
+      static_cast<SendOverflow>(settings.file_overflow),
+      [this](const uint8_t *data, size_t byte_count) {
+        const std::lock_guard<Lock> guard(_file_lock);
+        _out_file.write(reinterpret_cast<const char *>(data),
+                        static_cast<std::streamsize>(byte_count));
+        return !_out_file.fail();
+      });
+  }
+}
 
 
 // TODO(KS): What's the correct way to handle the potential for close() throwing an exception?
@@ -31,10 +50,20 @@ FileConnection::~FileConnection()
 
 void FileConnection::close()
 {
+  drainPending();
+
+  if (_writer)
+  {
+    // Write buffered data before finalising.
+    _writer->stop();
+  }
+
   const std::lock_guard<Lock> guard(_file_lock);
   if (_out_file.is_open())
   {
     _out_file.flush();
+    _out_file.seekp(0, std::ios_base::end);
+    streamutil::writeFrameIndex(_out_file, _frame_offsets);
     streamutil::finaliseStream(_out_file, _frame_count);
     _out_file.close();
   }
@@ -62,7 +91,18 @@ uint16_t FileConnection::port() const
 bool FileConnection::isConnected() const
 {
   const std::lock_guard<Lock> guard(_file_lock);
-  return _out_file.is_open();
+  return _out_file.is_open() && !(_writer && _writer->failed());
+}
+
+
+bool FileConnection::fileWriteStats(FileWriteStats &stats) const
+{
+  if (_writer)
+  {
+    _writer->stats(stats);
+    return true;
+  }
+  return false;
 }
 
 
@@ -73,8 +113,17 @@ bool FileConnection::sendServerInfo(const ServerInfoMessage &info)
     return false;
   }
 
+  if (_writer && !_writer->sync())
+  {
+    return false;
+  }
+
   // Server info already written. No need to write it again.
-  return streamutil::initialiseStream(_out_file, nullptr);
+  const std::lock_guard<Lock> guard(_file_lock);
+  const bool ok = streamutil::initialiseStream(_out_file, nullptr);
+  // Frame offsets follow on from the initialisation messages.
+  _write_offset = static_cast<uint64_t>(std::max<std::streamoff>(_out_file.tellp(), 0));
+  return ok;
 }
 
 
@@ -87,12 +136,45 @@ int FileConnection::updateFrame(float dt, bool flush)
 
 int FileConnection::writeBytes(const uint8_t *data, int byte_count)
 {
-  _out_file.write(reinterpret_cast<const char *>(data), byte_count);
-  if (!_out_file.fail())
+  int wrote = -1;
+  if (_writer)
   {
-    return byte_count;
+    wrote = _writer->push(data, byte_count);
   }
+  else
+  {
+    _out_file.write(reinterpret_cast<const char *>(data), byte_count);
+    wrote = (!_out_file.fail()) ? byte_count : -1;
+  }
+
+  if (wrote > 0)
+  {
+    _write_offset += static_cast<uint64_t>(wrote);
+  }
+  return wrote;
+}
+
+
+void FileConnection::frameWritten()
+{
+  _frame_offsets.emplace_back(_write_offset);
+}
 
-  return -1;
+
+bool FileConnection::transientBufferSpace(size_t &free_bytes) const
+{
+  if (!_writer || _writer->overflow() != SODropTransient)
+  {
+    return false;
+  }
+
+  free_bytes = _writer->freeBytes();
+  return true;
+}
+
+
+void FileConnection::recordDroppedTransient(size_t byte_count)
+{
+  _writer->recordDropped(byte_count);
 }
 }  // namespace tes
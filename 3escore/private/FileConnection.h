@@ -9,18 +9,32 @@
 #include "BaseConnection.h"
 
 #include <fstream>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace tes
 {
+class BufferedFileWriter;
+
 /// A file stream implementation of a 3es @c Connection.
+///
+/// The byte offset of each frame is recorded and written as a frame index when the connection is
+/// closed. See @c streamutil::writeFrameIndex() .
+///
+/// With @c SFBufferedFileWrite , data are written to disk from a @c BufferedFileWriter thread.
+/// Otherwise data are written on the calling thread.
 class FileConnection final : public BaseConnection
 {
 public:
   /// Create a new connection using the given @p clientSocket.
   /// @param filename Path to the file to write to.
   /// @param settings Various server settings to initialise with.
-  FileConnection(const std::string &filename, const ServerSettings &settings);
+  /// @param compression_pool Optional worker pool used to finalise collated packets.
+  /// @param resource_cache Optional encoded resource cache shared by the server's connections.
+  FileConnection(const std::string &filename, const ServerSettings &settings,
+                 std::shared_ptr<CompressionPool> compression_pool = {},
+                 std::shared_ptr<ResourceCache> resource_cache = {});
 
   // See cpp file for details on disabling bugprone-exception-escape
   ~FileConnection() final;  // NOLINT(bugprone-exception-escape)
@@ -35,17 +49,27 @@ public:
   uint16_t port() const override;
   bool isConnected() const override;
 
+  bool fileWriteStats(FileWriteStats &stats) const final;
+
   bool sendServerInfo(const ServerInfoMessage &info) final;
 
   int updateFrame(float dt, bool flush) final;
 
 protected:
   int writeBytes(const uint8_t *data, int byte_count) final;
+  bool transientBufferSpace(size_t &free_bytes) const final;
+  void recordDroppedTransient(size_t byte_count) final;
+  void frameWritten() final;
 
 private:
   mutable Lock _file_lock;  ///< Lock for @c _out_file() operations
   std::fstream _out_file;
   std::string _filename;
+  std::unique_ptr<BufferedFileWriter> _writer;
+  /// Stream offset for the next @c writeBytes() call. Only accessed from ordered writes.
+  uint64_t _write_offset = 0;
+  /// Offsets recorded by @c frameWritten() for the frame index.
+  std::vector<uint64_t> _frame_offsets;
   unsigned _frame_count = 0;
 };
 }  // namespace tes
@@ -0,0 +1,113 @@
+//
+// author: Kazys Stepanas
+//
+#include "ResourceCache.h"
+
+namespace tes
+{
+ResourceCache::ResourceCache(uint64_t byte_limit)
+{
+  _stats.byte_limit = byte_limit;
+}
+
+
+void ResourceCache::reference(uint64_t resource_key)
+{
+  const std::lock_guard<std::mutex> guard(_lock);
+  ++_entries[resource_key].reference_count;
+}
+
+
+void ResourceCache::release(uint64_t resource_key)
+{
+  const std::lock_guard<std::mutex> guard(_lock);
+  auto iter = _entries.find(resource_key);
+  if (iter == _entries.end() || --iter->second.reference_count > 0)
+  {
+    return;
+  }
+
+  if (iter->second.packets)
+  {
+    _stats.byte_count -= std::min<uint64_t>(_stats.byte_count, iter->second.packets->byteCount());
+    --_stats.resource_count;
+    // Space has been freed. Resources which did not fit may now fit.
+    ++_eviction_count;
+  }
+  _entries.erase(iter);
+}
+
+
+SharedPacketBufferPtr ResourceCache::acquire(const ResourcePtr &resource, bool &record)
+{
+  record = false;
+  const std::lock_guard<std::mutex> guard(_lock);
+  auto iter = _entries.find(resource->uniqueKey());
+  if (iter == _entries.end() || iter->second.recording || uncacheable(iter->second))
+  {
+    ++_stats.uncached;
+    return nullptr;
+  }
+
+  Entry &entry = iter->second;
+  if (entry.packets)
+  {
+    ++_stats.hits;
+    return entry.packets;
+  }
+
+  // Record the transfer unless it is clearly too large.
+  if (resource->estimateTransferSize() > available())
+  {
+    entry.uncacheable_at = _eviction_count;
+    ++_stats.uncached;
+    return nullptr;
+  }
+
+  ++_stats.misses;
+  entry.recording = true;
+  record = true;
+  return nullptr;
+}
+
+
+void ResourceCache::publish(uint64_t resource_key, SharedPacketBufferPtr packets)
+{
+  const std::lock_guard<std::mutex> guard(_lock);
+  auto iter = _entries.find(resource_key);
+  if (iter == _entries.end() || !iter->second.recording)
+  {
+    return;
+  }
+
+  Entry &entry = iter->second;
+  entry.recording = false;
+  if (!packets || packets->byteCount() > available())
+  {
+    entry.uncacheable_at = _eviction_count;
+    return;
+  }
+
+  _stats.byte_count += packets->byteCount();
+  ++_stats.resource_count;
+  entry.packets = std::move(packets);
+}
+
+
+void ResourceCache::abandon(uint64_t resource_key)
+{
+  const std::lock_guard<std::mutex> guard(_lock);
+  auto iter = _entries.find(resource_key);
+  if (iter != _entries.end())
+  {
+    iter->second.recording = false;
+  }
+}
+
+
+void ResourceCache::stats(ResourceCacheStats &stats) const
+{
+  const std::lock_guard<std::mutex> guard(_lock);
+  stats = _stats;
+}
+}  // namespace tes
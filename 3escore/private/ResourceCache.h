@@ -0,0 +1,120 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_PRIVATE_RESOURCE_CACHE_H
+#define TES_CORE_PRIVATE_RESOURCE_CACHE_H
+
+#include "../Server.h"
+
+#include "SharedPacketBuffer.h"
+
+#include <3escore/Ptr.h>
+#include <3escore/Resource.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+namespace tes
+{
+/// A server level cache of encoded resource transfers shared by all connections. See
+/// @c SFResourceCache .
+///
+/// The first connection to transfer a resource records the full packet sequence - create message
+/// through to the finalisation message - into a @c SharedPacketBuffer as it sends the packets,
+/// then publishes the completed sequence. Later connections replay the same packets instead of
+/// encoding the resource again. Connections which start a transfer while the resource is still
+/// being recorded bypass the cache.
+///
+/// Entries are keyed by @c Resource::uniqueKey() and live only while the resource is referenced
+/// by a connection or by the retained scene state ( @c SFRetainState ). Resource content is
+/// assumed to be immutable while referenced, as is already required for transfer. Releasing the
+/// last reference evicts the entry, so a resource re-created with the same key is re-encoded.
+///
+/// The total encoded byte count is bounded. Resources which would exceed the limit are not
+/// cached and are encoded per connection as usual. Such a resource is reconsidered once other
+/// entries are evicted.
+///
+/// The cache is thread safe.
+class ResourceCache
+{
+public:
+  using ResourcePtr = Ptr<const Resource>;
+
+  /// Constructor.
+  /// @param byte_limit Limit on cached bytes. See @c ServerSettings::resource_cache_limit .
+  explicit ResourceCache(uint64_t byte_limit);
+
+  /// Add a reference to the resource with @p resource_key , pinning any cache entry.
+  /// @param resource_key The @c Resource::uniqueKey() .
+  void reference(uint64_t resource_key);
+
+  /// Release a reference to the resource with @p resource_key . The cache entry is evicted on
+  /// releasing the last reference.
+  /// @param resource_key The @c Resource::uniqueKey() .
+  void release(uint64_t resource_key);
+
+  /// Acquire the encoded transfer packets for @p resource .
+  ///
+  /// Returns null if @p resource is not cached, in which case the caller should transfer the
+  /// resource itself. On a cache miss, @p record is set to nominate the caller to record the
+  /// finalised packets it sends, then either @c publish() or @c abandon() the recording. The cache
+  /// lock is not held while recording.
+  ///
+  /// @param resource The resource to acquire packets for.
+  /// @param[out] record Set when the caller is to record the resource packets.
+  /// @return The encoded packets, or null if the resource is not cached.
+  SharedPacketBufferPtr acquire(const ResourcePtr &resource, bool &record);
+
+  /// Publish the packets recorded after @c acquire() set @c record . The packets are discarded
+  /// if they no longer fit the cache.
+  /// @param resource_key The @c Resource::uniqueKey() .
+  /// @param packets The complete packet sequence for the resource.
+  void publish(uint64_t resource_key, SharedPacketBufferPtr packets);
+
+  /// Abandon recording after @c acquire() set @c record , such as when the transfer is cancelled.
+  /// A later transfer may record the resource instead.
+  /// @param resource_key The @c Resource::uniqueKey() .
+  void abandon(uint64_t resource_key);
+
+  /// Populate the cache statistics.
+  /// @param[out] stats The stats object to populate.
+  void stats(ResourceCacheStats &stats) const;
+
+private:
+  /// A cache entry.
+  struct Entry
+  {
+    /// The encoded packets. Null until first acquired.
+    SharedPacketBufferPtr packets;
+    /// Number of references from connections and the retained state.
+    unsigned reference_count = 0;
+    /// The @c _eviction_count when the resource was found not to fit the cache. Zero if it may
+    /// fit. Avoids repeated recording attempts until other entries are evicted.
+    uint64_t uncacheable_at = 0;
+    /// Set while a connection records the packets.
+    bool recording = false;
+  };
+
+  /// Check if @p entry is known not to fit the cache.
+  [[nodiscard]] bool uncacheable(const Entry &entry) const
+  {
+    return entry.uncacheable_at && entry.uncacheable_at == _eviction_count;
+  }
+
+  /// Query the bytes available below the byte limit.
+  [[nodiscard]] uint64_t available() const
+  {
+    return _stats.byte_limit - std::min(_stats.byte_limit, _stats.byte_count);
+  }
+
+  mutable std::mutex _lock;
+  std::unordered_map<uint64_t, Entry> _entries;
+  /// Incremented whenever a cached entry is evicted, freeing space. Starts at one.
+  uint64_t _eviction_count = 1;
+  ResourceCacheStats _stats;
+};
+}  // namespace tes
+
+#endif  // TES_CORE_PRIVATE_RESOURCE_CACHE_H
@@ -0,0 +1,358 @@
+//
+// author: Kazys Stepanas
+//
+#include "ResourceScheduler.h"
+
+#include <3escore/ResourcePacker.h>
+
+#include <algorithm>
+
+namespace tes
+{
+namespace
+{
+/// Byte size of the smallest size class. See @c ResourceScheduler .
+constexpr uint64_t kSizeClassBytes = 4096u;
+}  // namespace
+
+/// Transfer state for a scheduled resource.
+struct ResourceScheduler::Transfer
+{
+  ResourcePtr resource;
+  /// Packer for the transfer. Only set while active.
+  std::unique_ptr<ResourcePacker> packer;
+  /// Cached packets to replay instead of using the @c packer .
+  SharedPacketBufferPtr cached;
+  /// Index of the next @c cached packet.
+  unsigned next_cached = 0;
+  /// Packets recorded for the @c ResourceCache on a cache miss.
+  std::shared_ptr<SharedPacketBuffer> recording;
+  /// Set once the @c ResourceCache has been checked.
+  bool cache_checked = false;
+  uint64_t estimated_bytes = 0;
+  uint64_t bytes_sent = 0;
+  /// Queue sequence number from @c enqueue() .
+  uint64_t sequence = 0;
+  uint32_t packets_sent = 0;
+  int priority = 0;
+  /// Set once @c touch() has moved the transfer ahead.
+  bool touched = false;
+};
+
+
+bool ResourceScheduler::PendingKey::operator<(const PendingKey &other) const
+{
+  if (priority != other.priority)
+  {
+    return priority > other.priority;
+  }
+  if (size_class != other.size_class)
+  {
+    return size_class < other.size_class;
+  }
+  if (sequence != other.sequence)
+  {
+    return sequence < other.sequence;
+  }
+  return resource_key < other.resource_key;
+}
+
+
+ResourceScheduler::ResourceScheduler(unsigned max_active, std::shared_ptr<ResourceCache> cache,
+                                     FinaliseFunction finalise)
+  : _max_active(std::max(max_active, 1u))
+  , _cache(std::move(cache))
+  , _finalise(std::move(finalise))
+{}
+
+
+ResourceScheduler::~ResourceScheduler()
+{
+  for (const auto &[resource_key, transfer] : _transfers)
+  {
+    if (transfer->recording)
+    {
+      _cache->abandon(resource_key);
+    }
+  }
+}
+
+
+void ResourceScheduler::enqueue(const ResourcePtr &resource)
+{
+  const uint64_t resource_key = resource->uniqueKey();
+  if (_transfers.find(resource_key) != _transfers.end())
+  {
+    touch(resource_key);
+    return;
+  }
+
+  auto transfer = std::make_unique<Transfer>();
+  transfer->resource = resource;
+  transfer->estimated_bytes = resource->estimateTransferSize();
+  transfer->sequence = _next_sequence++;
+  _pending.insert(pendingKey(*transfer));
+  _transfers.emplace(resource_key, std::move(transfer));
+}
+
+
+void ResourceScheduler::touch(uint64_t resource_key)
+{
+  auto iter = _transfers.find(resource_key);
+  if (iter == _transfers.end() || iter->second->packer)
+  {
+    return;
+  }
+
+  Transfer &transfer = *iter->second;
+  if (transfer.touched)
+  {
+    return;
+  }
+
+  _pending.erase(pendingKey(transfer));
+  transfer.touched = true;
+  _pending.insert(pendingKey(transfer));
+}
+
+
+bool ResourceScheduler::setPriority(uint64_t resource_key, int priority)
+{
+  auto iter = _transfers.find(resource_key);
+  if (iter == _transfers.end())
+  {
+    return false;
+  }
+
+  Transfer &transfer = *iter->second;
+  if (transfer.packer)
+  {
+    transfer.priority = priority;
+    return true;
+  }
+
+  _pending.erase(pendingKey(transfer));
+  transfer.priority = priority;
+  _pending.insert(pendingKey(transfer));
+  return true;
+}
+
+
+void ResourceScheduler::remove(uint64_t resource_key)
+{
+  auto iter = _transfers.find(resource_key);
+  if (iter == _transfers.end())
+  {
+    return;
+  }
+
+  Transfer &transfer = *iter->second;
+  if (transfer.recording)
+  {
+    _cache->abandon(resource_key);
+  }
+
+  if (transfer.packer)
+  {
+    transfer.packer->cancel();
+    _spare_packers.emplace_back(std::move(transfer.packer));
+    deactivate(resource_key);
+  }
+  else
+  {
+    _pending.erase(pendingKey(transfer));
+  }
+
+  _transfers.erase(iter);
+}
+
+
+bool ResourceScheduler::nextPacket(PacketWriter &packet, unsigned byte_limit,
+                                   ScheduledPacket &scheduled)
+{
+  scheduled = ScheduledPacket();
+  admit();
+  Transfer *transfer = selectActive();
+  if (!transfer)
+  {
+    return false;
+  }
+
+  scheduled.resource_key = transfer->resource->uniqueKey();
+  if (_cache && !transfer->cache_checked)
+  {
+    bool record = false;
+    transfer->cache_checked = true;
+    transfer->cached = _cache->acquire(transfer->resource, record);
+    if (record)
+    {
+      transfer->recording = std::make_shared<SharedPacketBuffer>();
+    }
+  }
+
+  bool prepared = false;
+  bool done = false;
+  if (transfer->cached)
+  {
+    scheduled.cached = transfer->cached;
+    scheduled.cached_index = transfer->next_cached++;
+    prepared = true;
+    done = transfer->next_cached >= transfer->cached->packetCount();
+  }
+  else
+  {
+    prepared = transfer->packer->nextPacket(packet, byte_limit);
+    done = !transfer->packer->isValid();
+    if (transfer->recording && prepared)
+    {
+      scheduled.finalised = true;
+      if (_finalise(packet))
+      {
+        transfer->recording->append(packet);
+      }
+      else
+      {
+        _cache->abandon(scheduled.resource_key);
+        transfer->recording.reset();
+      }
+    }
+
+    if (transfer->recording && done && prepared)
+    {
+      // Completed. A failed transfer is abandoned on removal below.
+      _cache->publish(scheduled.resource_key, std::move(transfer->recording));
+      transfer->recording.reset();
+    }
+  }
+
+  if (done)
+  {
+    // Completed or failed.
+    scheduled.completed = true;
+    remove(scheduled.resource_key);
+  }
+
+  return prepared;
+}
+
+
+void ResourceScheduler::recordSent(uint64_t resource_key, unsigned byte_count)
+{
+  // The transfer may have completed with this packet.
+  auto iter = _transfers.find(resource_key);
+  if (iter != _transfers.end())
+  {
+    iter->second->bytes_sent += byte_count;
+    ++iter->second->packets_sent;
+  }
+}
+
+
+void ResourceScheduler::progress(std::vector<ResourceTransferProgress> &transfers) const
+{
+  transfers.clear();
+  transfers.reserve(_transfers.size());
+
+  const auto add_progress = [&transfers](const Transfer &transfer) {
+    ResourceTransferProgress progress;
+    progress.resource_key = transfer.resource->uniqueKey();
+    progress.estimated_bytes = transfer.estimated_bytes;
+    progress.bytes_sent = transfer.bytes_sent;
+    progress.packets_sent = transfer.packets_sent;
+    progress.priority = transfer.priority;
+    progress.active = transfer.packer != nullptr;
+    transfers.emplace_back(progress);
+  };
+
+  // Active transfers, then pending transfers in start order.
+  for (const uint64_t resource_key : _active)
+  {
+    add_progress(*_transfers.at(resource_key));
+  }
+  for (const auto &key : _pending)
+  {
+    add_progress(*_transfers.at(key.resource_key));
+  }
+}
+
+
+void ResourceScheduler::admit()
+{
+  while (!_pending.empty())
+  {
+    const PendingKey next = *_pending.begin();
+    if (_active.size() >= _max_active)
+    {
+      // Only start a transfer which will take precedence over all active transfers, and then only
+      // up to twice the concurrency limit.
+      if (_active.size() >= 2u * _max_active)
+      {
+        break;
+      }
+      const bool preempt =
+        std::all_of(_active.begin(), _active.end(), [this, &next](uint64_t resource_key) {
+          return _transfers.at(resource_key)->priority < next.priority;
+        });
+      if (!preempt)
+      {
+        break;
+      }
+    }
+
+    _pending.erase(_pending.begin());
+    Transfer &transfer = *_transfers.at(next.resource_key);
+    if (!_spare_packers.empty())
+    {
+      transfer.packer = std::move(_spare_packers.back());
+      _spare_packers.pop_back();
+    }
+    else
+    {
+      transfer.packer = std::make_unique<ResourcePacker>();
+    }
+    transfer.packer->transfer(transfer.resource);
+    _active.emplace_back(next.resource_key);
+  }
+}
+
+
+ResourceScheduler::Transfer *ResourceScheduler::selectActive()
+{
+  Transfer *selected = nullptr;
+  for (const uint64_t resource_key : _active)
+  {
+    Transfer *transfer = _transfers.at(resource_key).get();
+    if (!selected || transfer->priority > selected->priority ||
+        (transfer->priority == selected->priority && transfer->bytes_sent < selected->bytes_sent))
+    {
+      selected = transfer;
+    }
+  }
+  return selected;
+}
+
+
+void ResourceScheduler::deactivate(uint64_t resource_key)
+{
+  const auto iter = std::find(_active.begin(), _active.end(), resource_key);
+  if (iter != _active.end())
+  {
+    _active.erase(iter);
+  }
+}
+
+
+ResourceScheduler::PendingKey ResourceScheduler::pendingKey(const Transfer &transfer)
+{
+  PendingKey key;
+  key.priority = transfer.priority;
+  for (uint64_t size = transfer.estimated_bytes / kSizeClassBytes; size; size >>= 1u)
+  {
+    ++key.size_class;
+  }
+  // Sequence numbers start at kTouchAdvance so this cannot underflow.
+  key.sequence = transfer.sequence - (transfer.touched ? kTouchAdvance : 0u);
+  key.resource_key = transfer.resource->uniqueKey();
+  return key;
+}
+}  // namespace tes
@@ -0,0 +1,181 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_PRIVATE_RESOURCE_SCHEDULER_H
+#define TES_CORE_PRIVATE_RESOURCE_SCHEDULER_H
+
+#include "ResourceCache.h"
+#include "SharedPacketBuffer.h"
+
+#include <3escore/Connection.h>
+#include <3escore/Ptr.h>
+#include <3escore/Resource.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace tes
+{
+class PacketWriter;
+class ResourcePacker;
+
+/// Schedules the packets of multiple resource transfers for a @c BaseConnection .
+///
+/// Up to @c maxActive() resources are transferred concurrently, interleaving their packets so a
+/// large resource does not hold up those queued behind it. Each packet goes to the active transfer
+/// with the highest priority, and amongst equal priorities to the transfer which has sent the
+/// fewest bytes. Small resources thereby complete promptly while large resources progress at an
+/// even rate.
+///
+/// Pending resources are started in order of:
+/// -# Priority, highest first. See @c setPriority() .
+/// -# Size class - the power of two bucket of @c Resource::estimateTransferSize() - smallest
+///   first.
+/// -# Queue order, oldest first. @c touch() moves a pending resource ahead by at most
+///   @c kTouchAdvance places, so later references cannot starve an older resource.
+///
+/// A pending resource with a higher priority than every active transfer is started even when
+/// @c maxActive() transfers are in flight, up to a total of twice @c maxActive() transfers.
+///
+/// With a @c ResourceCache , each transfer first tries to acquire the cached packets for its
+/// resource, replaying those rather than encoding the resource. Cached packets are whole packets,
+/// so may exceed the @c nextPacket() byte limit. On a cache miss, the transfer encodes as usual,
+/// finalising and recording each packet, then publishes the recording to the cache on completion.
+///
+/// The scheduler is not thread safe.
+class ResourceScheduler
+{
+public:
+  using ResourcePtr = Ptr<const Resource>;
+  /// Function used to finalise each packet recorded for the cache. See
+  /// @c BaseConnection::finalisePacket() .
+  using FinaliseFunction = std::function<bool(PacketWriter &)>;
+
+  /// Default value for @c maxActive() .
+  static constexpr unsigned kDefaultMaxActive = 4;
+  /// The number of places @c touch() moves a pending resource ahead in its size class.
+  static constexpr uint64_t kTouchAdvance = 16;
+
+  /// Details of the packet prepared by @c nextPacket() .
+  struct ScheduledPacket
+  {
+    /// The @c Resource::uniqueKey() of the scheduled resource.
+    uint64_t resource_key = 0;
+    /// The cached packets to send from, or null if the packet has been written to the
+    /// @c PacketWriter .
+    SharedPacketBufferPtr cached;
+    /// Index of the packet to send from @c cached .
+    unsigned cached_index = 0;
+    /// Set when a packet written to the @c PacketWriter has already been finalised.
+    bool finalised = false;
+    /// Set when the resource transfer has completed or failed.
+    bool completed = false;
+  };
+
+  /// Constructor.
+  /// @param max_active The maximum number of concurrent transfers at equal priority.
+  /// @param cache Optional encoded resource cache shared with other connections.
+  /// @param finalise Function used to finalise packets encoded into the @p cache .
+  explicit ResourceScheduler(unsigned max_active = kDefaultMaxActive,
+                             std::shared_ptr<ResourceCache> cache = {},
+                             FinaliseFunction finalise = {});
+  /// Destructor.
+  ~ResourceScheduler();
+
+  ResourceScheduler(const ResourceScheduler &) = delete;
+  ResourceScheduler &operator=(const ResourceScheduler &) = delete;
+
+  /// Query the maximum number of concurrent transfers at equal priority.
+  /// @return The concurrent transfer limit.
+  [[nodiscard]] unsigned maxActive() const { return _max_active; }
+
+  /// Check if there are any pending or active transfers.
+  /// @return True if there is nothing to transfer.
+  [[nodiscard]] bool empty() const { return _transfers.empty(); }
+
+  /// Queue @p resource for transfer. Does nothing if the resource is already queued.
+  /// @param resource The resource to transfer.
+  void enqueue(const ResourcePtr &resource);
+
+  /// Mark a pending resource as recently referenced, moving it up to @c kTouchAdvance places ahead
+  /// of pending resources with the same priority and size class. Only the first touch has an
+  /// effect. Ignored for active or unknown resources.
+  /// @param resource_key The @c Resource::uniqueKey() .
+  void touch(uint64_t resource_key);
+
+  /// Set the priority for a queued resource. Higher priorities are transferred first.
+  /// @param resource_key The @c Resource::uniqueKey() .
+  /// @param priority The priority to set. Zero by default.
+  /// @return True if the resource is queued or in flight.
+  bool setPriority(uint64_t resource_key, int priority);
+
+  /// Remove a resource, cancelling any transfer in progress.
+  /// @param resource_key The @c Resource::uniqueKey() .
+  void remove(uint64_t resource_key);
+
+  /// Prepare the next packet for the scheduled resource.
+  ///
+  /// The packet is either written to @p packet or identified in @c ScheduledPacket::cached , in
+  /// which case it is already finalised. Either way, @c recordSent() must be called with the
+  /// packet size. @c ScheduledPacket::completed is set for the last packet of the resource, after
+  /// which the resource is removed from the scheduler. A failed transfer is also removed, with
+  /// @c ScheduledPacket::completed set and no packet prepared. A packet written to @p packet must
+  /// be finalised unless @c ScheduledPacket::finalised is set.
+  ///
+  /// @param packet The packet to write to.
+  /// @param byte_limit The @c ResourcePacker::nextPacket() byte limit.
+  /// @param[out] scheduled Details of the prepared packet.
+  /// @return True if a packet has been prepared. False if there is nothing to transfer or the
+  ///   transfer failed.
+  bool nextPacket(PacketWriter &packet, unsigned byte_limit, ScheduledPacket &scheduled);
+
+  /// Record the number of bytes sent for the last packet from @c nextPacket() .
+  /// @param resource_key The @c Resource::uniqueKey() from @c nextPacket() .
+  /// @param byte_count The number of bytes sent.
+  void recordSent(uint64_t resource_key, unsigned byte_count);
+
+  /// Report the progress of each pending and active transfer.
+  /// @param[out] transfers Populated with the transfer progress. Cleared first.
+  void progress(std::vector<ResourceTransferProgress> &transfers) const;
+
+private:
+  struct Transfer;
+
+  /// Ordering key for pending transfers.
+  struct PendingKey
+  {
+    int priority = 0;
+    unsigned size_class = 0;
+    uint64_t sequence = 0;  ///< Queue sequence number; lower starts first.
+    uint64_t resource_key = 0;
+
+    bool operator<(const PendingKey &other) const;
+  };
+
+  /// Start pending transfers as slots allow.
+  void admit();
+  /// Select the active transfer for the next packet.
+  /// @return The selected transfer, or null if there are no active transfers.
+  Transfer *selectActive();
+  /// Remove @p resource_key from @c _active .
+  void deactivate(uint64_t resource_key);
+  /// Build the @c PendingKey for @p transfer .
+  [[nodiscard]] static PendingKey pendingKey(const Transfer &transfer);
+
+  std::unordered_map<uint64_t, std::unique_ptr<Transfer>> _transfers;
+  std::set<PendingKey> _pending;  ///< Transfers yet to start, in start order.
+  std::vector<uint64_t> _active;  ///< Keys of the transfers in flight.
+  /// Spare packers for reuse. Avoids reallocating the progress trackers.
+  std::vector<std::unique_ptr<ResourcePacker>> _spare_packers;
+  uint64_t _next_sequence = kTouchAdvance;  ///< Next queue sequence number.
+  unsigned _max_active = kDefaultMaxActive;
+  std::shared_ptr<ResourceCache> _cache;
+  FinaliseFunction _finalise;
+};
+}  // namespace tes
+
+#endif  // TES_CORE_PRIVATE_RESOURCE_SCHEDULER_H
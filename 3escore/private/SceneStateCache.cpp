@@ -0,0 +1,249 @@
+//
+// author: Kazys Stepanas
+//
+#include "SceneStateCache.h"
+
+#include "BaseConnection.h"
+#include "ResourceCache.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace tes
+{
+SceneStateCache::SceneStateCache(uint64_t byte_limit,
+                                 std::shared_ptr<ResourceCache> resource_cache)
+  : _resource_cache(std::move(resource_cache))
+{
+  _stats.byte_limit = byte_limit;
+}
+
+
+SceneStateCache::~SceneStateCache()
+{
+  if (_resource_cache)
+  {
+    for (const auto &[key, resource] : _resources)
+    {
+      _resource_cache->release(key);
+    }
+  }
+}
+
+
+void SceneStateCache::create(uint16_t routing_id, uint32_t shape_id,
+                             const SharedPacketBuffer &packets, unsigned first_packet,
+                             unsigned packet_count, const ResourcePtr *resources,
+                             size_t resource_count)
+{
+  if (shape_id == 0)
+  {
+    // Transient.
+    return;
+  }
+
+  // Replace any existing shape with the same id, as would the client.
+  const uint64_t key = shapeKey(routing_id, shape_id);
+  auto existing = _shapes.find(key);
+  if (existing != _shapes.end())
+  {
+    erase(existing);
+  }
+
+  const size_t byte_count = packets.byteCount(first_packet, packet_count);
+  if (_stats.byte_count + byte_count > _stats.byte_limit)
+  {
+    ++_stats.dropped_shapes;
+    return;
+  }
+
+  ShapeState &shape = _shapes[key];
+  shape.create.append(packets, first_packet, packet_count);
+  shape.sequence = _next_sequence++;
+  for (size_t i = 0; i < resource_count; ++i)
+  {
+    shape.resources.emplace_back(resources[i]->uniqueKey());
+    addResourceReference(resources[i]);
+  }
+
+  _stats.byte_count += byte_count;
+  _stats.peak_byte_count = std::max(_stats.peak_byte_count, _stats.byte_count);
+}
+
+
+void SceneStateCache::update(uint16_t routing_id, uint32_t shape_id, unsigned flags,
+                             const SharedPacketBuffer &packets, unsigned first_packet,
+                             unsigned packet_count)
+{
+  auto iter = _shapes.find(shapeKey(routing_id, shape_id));
+  if (iter == _shapes.end())
+  {
+    return;
+  }
+
+  ShapeState &shape = iter->second;
+  const uint64_t previous_bytes = shapeBytes(shape);
+  const bool partial = (flags & UFUpdateMode) != 0;
+  const unsigned attributes = flags & UFPosRotScaleColour;
+  if (!partial)
+  {
+    // A full update supersedes all previous updates.
+    shape.update.reset();
+    shape.partial_updates.clear();
+  }
+  else
+  {
+    // A partial update supersedes earlier partial updates of the same or fewer attributes.
+    shape.partial_updates.erase(
+      std::remove_if(shape.partial_updates.begin(), shape.partial_updates.end(),
+                     [attributes](const PartialUpdate &earlier) {
+                       return (earlier.attributes & ~attributes) == 0;
+                     }),
+      shape.partial_updates.end());
+  }
+
+  const uint64_t byte_count = packets.byteCount(first_packet, packet_count);
+  const uint64_t updated_bytes = _stats.byte_count - previous_bytes + shapeBytes(shape);
+  if (updated_bytes + byte_count > _stats.byte_limit)
+  {
+    // The retained shape state would be stale. Evict it.
+    _stats.byte_count = updated_bytes;
+    erase(iter);
+    ++_stats.dropped_shapes;
+    return;
+  }
+
+  if (partial)
+  {
+    PartialUpdate &update = shape.partial_updates.emplace_back();
+    update.attributes = attributes;
+    update.packets.append(packets, first_packet, packet_count);
+  }
+  else
+  {
+    shape.update.append(packets, first_packet, packet_count);
+  }
+  _stats.byte_count = updated_bytes + byte_count;
+  _stats.peak_byte_count = std::max(_stats.peak_byte_count, _stats.byte_count);
+}
+
+
+void SceneStateCache::destroy(uint16_t routing_id, uint32_t shape_id)
+{
+  auto iter = _shapes.find(shapeKey(routing_id, shape_id));
+  if (iter != _shapes.end())
+  {
+    erase(iter);
+  }
+}
+
+
+void SceneStateCache::referenceResource(const ResourcePtr &resource)
+{
+  addResourceReference(resource);
+}
+
+
+void SceneStateCache::releaseResource(const ResourcePtr &resource)
+{
+  releaseResourceReference(resource->uniqueKey());
+}
+
+
+int SceneStateCache::snapshot(BaseConnection &connection)
+{
+  // Reference resources first, matching the connection reference counts to ours so later
+  // releases balance.
+  for (const auto &[key, resource] : _resources)
+  {
+    for (unsigned i = 0; i < resource.reference_count; ++i)
+    {
+      connection.referenceResource(resource.resource);
+    }
+  }
+
+  std::vector<const ShapeState *> shapes;
+  shapes.reserve(_shapes.size());
+  for (const auto &[key, shape] : _shapes)
+  {
+    shapes.emplace_back(&shape);
+  }
+  std::sort(shapes.begin(), shapes.end(), [](const ShapeState *a, const ShapeState *b) {
+    return a->sequence < b->sequence;
+  });
+
+  int64_t total_bytes_written = 0;
+  for (const ShapeState *shape : shapes)
+  {
+    const int create_bytes = connection.sendEncoded(shape->create);
+    const int update_bytes = connection.sendEncoded(shape->update);
+    if (create_bytes < 0 || update_bytes < 0)
+    {
+      return -1;
+    }
+    total_bytes_written += create_bytes + update_bytes;
+    for (const auto &partial : shape->partial_updates)
+    {
+      const int partial_bytes = connection.sendEncoded(partial.packets);
+      if (partial_bytes < 0)
+      {
+        return -1;
+      }
+      total_bytes_written += partial_bytes;
+    }
+  }
+
+  ++_stats.snapshot_count;
+  _stats.snapshot_bytes += static_cast<uint64_t>(total_bytes_written);
+  return static_cast<int>(
+    std::min<int64_t>(total_bytes_written, std::numeric_limits<int>::max()));
+}
+
+
+void SceneStateCache::stats(RetainedStateStats &stats) const
+{
+  stats = _stats;
+  stats.shape_count = _shapes.size();
+  stats.resource_count = _resources.size();
+}
+
+
+void SceneStateCache::addResourceReference(const ResourcePtr &resource)
+{
+  ResourceState &state = _resources[resource->uniqueKey()];
+  if (state.reference_count == 0)
+  {
+    state.resource = resource;
+    if (_resource_cache)
+    {
+      _resource_cache->reference(resource->uniqueKey());
+    }
+  }
+  ++state.reference_count;
+}
+
+
+void SceneStateCache::releaseResourceReference(uint64_t resource_key)
+{
+  auto iter = _resources.find(resource_key);
+  if (iter != _resources.end() && --iter->second.reference_count == 0)
+  {
+    _resources.erase(iter);
+    if (_resource_cache)
+    {
+      _resource_cache->release(resource_key);
+    }
+  }
+}
+
+
+void SceneStateCache::erase(std::unordered_map<uint64_t, ShapeState>::iterator iter)
+{
+  for (const uint64_t resource_key : iter->second.resources)
+  {
+    releaseResourceReference(resource_key);
+  }
+  _stats.byte_count -= std::min(_stats.byte_count, shapeBytes(iter->second));
+  _shapes.erase(iter);
+}
+}  // namespace tes
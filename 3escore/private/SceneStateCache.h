@@ -0,0 +1,171 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_PRIVATE_SCENE_STATE_CACHE_H
+#define TES_CORE_PRIVATE_SCENE_STATE_CACHE_H
+
+#include "../Server.h"
+
+#include "SharedPacketBuffer.h"
+
+#include <3escore/Ptr.h>
+#include <3escore/Resource.h>
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace tes
+{
+class BaseConnection;
+class ResourceCache;
+
+/// Retains the encoded state of live persistent shapes and the resources they use, for
+/// initialising late joining connections. See @c SFRetainState .
+///
+/// For each persistent shape, the cache holds the encoded create message - including data
+/// messages for complex shapes - followed by the last full update and the partial updates since.
+/// A full update - without @c UFUpdateMode - replaces earlier updates. A partial update replaces
+/// earlier partial updates for the same or fewer attributes - see @c UFPosRotScaleColour - so a
+/// shape retains at most one partial update per attribute set, however often it is updated.
+/// Resources are reference counted as per @c BaseConnection , including explicit
+/// @c referenceResource() calls.
+///
+/// The encoded byte count is bounded. A create which would exceed the limit is not retained,
+/// while an update which would exceed the limit evicts the shape. Both are counted as
+/// @c RetainedStateStats::dropped_shapes .
+///
+/// Retained resources are not counted against the byte limit. The cache only holds references to
+/// them, and their encoded transfers are bounded by the optional @c ResourceCache , in which the
+/// cache holds a reference to keep them available for late joining connections.
+///
+/// The cache is not thread safe. The @c TcpServer only accesses it with its lock held.
+class SceneStateCache
+{
+public:
+  using ResourcePtr = Ptr<const Resource>;
+
+  /// Constructor.
+  /// @param byte_limit The limit on retained bytes. See @c ServerSettings::retained_state_limit .
+  /// @param resource_cache Optional encoded resource cache. See @c SFResourceCache .
+  explicit SceneStateCache(uint64_t byte_limit,
+                           std::shared_ptr<ResourceCache> resource_cache = {});
+  /// Destructor. Releases references in the @c ResourceCache .
+  ~SceneStateCache();
+
+  SceneStateCache(const SceneStateCache &) = delete;
+  SceneStateCache &operator=(const SceneStateCache &) = delete;
+
+  /// Retain a shape create message.
+  /// @param routing_id The shape routing id.
+  /// @param shape_id The shape id. Transient shapes - zero id - are ignored.
+  /// @param packets The encoded packets containing the create and data messages.
+  /// @param first_packet The first packet of the create message in @p packets .
+  /// @param packet_count The number of packets for the create message.
+  /// @param resources The resources used by the shape, or null if resources are skipped.
+  /// @param resource_count The number of @p resources .
+  void create(uint16_t routing_id, uint32_t shape_id, const SharedPacketBuffer &packets,
+              unsigned first_packet, unsigned packet_count, const ResourcePtr *resources,
+              size_t resource_count);
+
+  /// Retain a shape update message.
+  /// @param routing_id The shape routing id.
+  /// @param shape_id The shape id.
+  /// @param flags The update message flags. @c UFUpdateMode marks a partial update of the
+  ///   @c UFPosRotScaleColour attributes set.
+  /// @param packets The encoded packets containing the update message.
+  /// @param first_packet The first packet of the update message in @p packets .
+  /// @param packet_count The number of packets for the update message.
+  void update(uint16_t routing_id, uint32_t shape_id, unsigned flags,
+              const SharedPacketBuffer &packets, unsigned first_packet, unsigned packet_count);
+
+  /// Release a destroyed shape.
+  /// @param routing_id The shape routing id.
+  /// @param shape_id The shape id.
+  void destroy(uint16_t routing_id, uint32_t shape_id);
+
+  /// Add an explicit reference to @p resource . See @c Connection::referenceResource() .
+  /// @param resource The resource to reference.
+  void referenceResource(const ResourcePtr &resource);
+  /// Release an explicit reference to @p resource . See @c Connection::releaseResource() .
+  /// @param resource The resource to release.
+  void releaseResource(const ResourcePtr &resource);
+
+  /// Send the retained state to a new @p connection .
+  ///
+  /// Resources are referenced on the connection, queuing their transfer, then the shape messages
+  /// are sent in their original creation order.
+  ///
+  /// @param connection The connection to initialise.
+  /// @return The number of shape message bytes written on success, -1 on failure.
+  int snapshot(BaseConnection &connection);
+
+  /// Query cache statistics.
+  /// @param[out] stats Set to the current statistics.
+  void stats(RetainedStateStats &stats) const;
+
+private:
+  /// A retained partial update.
+  struct PartialUpdate
+  {
+    /// The @c UFPosRotScaleColour attributes updated.
+    unsigned attributes = 0;
+    /// The update message.
+    SharedPacketBuffer packets;
+  };
+
+  /// A retained shape.
+  struct ShapeState
+  {
+    /// Create message and data messages.
+    SharedPacketBuffer create;
+    /// The last full update, if any.
+    SharedPacketBuffer update;
+    /// Partial updates since the last full update, in order. Attribute sets are unique, and no
+    /// entry updates a subset of the attributes of a later entry.
+    std::vector<PartialUpdate> partial_updates;
+    /// Resources referenced by the shape.
+    std::vector<uint64_t> resources;
+    /// Creation sequence number used to order the snapshot.
+    uint64_t sequence = 0;
+  };
+
+  /// A retained resource.
+  struct ResourceState
+  {
+    ResourcePtr resource;
+    /// References from shapes and explicit @c referenceResource() calls.
+    unsigned reference_count = 0;
+  };
+
+  static uint64_t shapeKey(uint16_t routing_id, uint32_t shape_id)
+  {
+    return (static_cast<uint64_t>(routing_id) << 32u) | shape_id;
+  }
+
+  /// Bytes attributed to @p shape .
+  static uint64_t shapeBytes(const ShapeState &shape)
+  {
+    uint64_t byte_count = shape.create.byteCount() + shape.update.byteCount();
+    for (const auto &partial : shape.partial_updates)
+    {
+      byte_count += partial.packets.byteCount();
+    }
+    return byte_count;
+  }
+
+  void addResourceReference(const ResourcePtr &resource);
+  void releaseResourceReference(uint64_t resource_key);
+  /// Remove the shape at @p iter , releasing its resources.
+  void erase(std::unordered_map<uint64_t, ShapeState>::iterator iter);
+
+  std::unordered_map<uint64_t, ShapeState> _shapes;
+  std::unordered_map<uint64_t, ResourceState> _resources;
+  RetainedStateStats _stats;
+  uint64_t _next_sequence = 0;
+  std::shared_ptr<ResourceCache> _resource_cache;
+};
+}  // namespace tes
+
+#endif  // TES_CORE_PRIVATE_SCENE_STATE_CACHE_H
@@ -0,0 +1,303 @@
+//
+// author: Kazys Stepanas
+//
+#include "ShapeSubmitQueue.h"
+
+#include <3escore/CoreUtil.h>
+#include <3escore/PacketWriter.h>
+
+#include <3escore/shapes/Shape.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace tes
+{
+/// Per thread encoding state for a @c ShapeSubmitQueue .
+struct ShapeSubmitQueue::Producer
+{
+  /// Guards @c batch against @c ShapeSubmitQueue::collect() .
+  std::mutex lock;
+  /// The batch currently being populated. May be null.
+  std::unique_ptr<SubmitBatch> batch;
+  /// Buffer for @c encoder .
+  std::vector<uint8_t> encode_buffer;
+  /// Scratch writer used to encode each packet.
+  std::unique_ptr<PacketWriter> encoder;
+  /// Scratch buffer for @c Shape::enumerateResources() .
+  std::vector<Ptr<const Resource>> resource_buffer;
+  /// Set when the owning thread exits. The producer is removed once its last batch is collected.
+  std::atomic_bool exhausted = { false };
+};
+
+namespace
+{
+/// Thread local lookup of a @c ShapeSubmitQueue::Producer by queue key.
+///
+/// The @c producer pointer remains valid while the queue exists as the queue retains the producer
+/// until the owning thread exits. Queue keys are never reused, so stale slots never match a live
+/// queue. The @c expiry pointer is used to prune stale slots and to mark the producer as exhausted
+/// on thread exit.
+template <typename Producer>
+struct ProducerSlot
+{
+  uint64_t key = 0;
+  Producer *producer = nullptr;
+  std::weak_ptr<Producer> expiry;
+};
+
+/// Thread local owner of the calling thread's @c ProducerSlot entries. Marks each live producer as
+/// exhausted when the thread exits so the queue can release it.
+template <typename Producer>
+struct ProducerSlots
+{
+  std::vector<ProducerSlot<Producer>> slots;
+
+  ProducerSlots() = default;
+  ProducerSlots(const ProducerSlots &) = delete;
+  ProducerSlots &operator=(const ProducerSlots &) = delete;
+
+  ~ProducerSlots()
+  {
+    for (const auto &slot : slots)
+    {
+      if (auto producer = slot.expiry.lock())
+      {
+        producer->exhausted.store(true, std::memory_order_release);
+      }
+    }
+  }
+};
+
+std::atomic<uint64_t> g_next_queue_key = { 1 };
+}  // namespace
+
+
+void SubmitBatch::reset()
+{
+  packets.reset();
+  messages.clear();
+  resources.clear();
+  next = nullptr;
+}
+
+
+ShapeSubmitQueue::ShapeSubmitQueue(uint16_t packet_buffer_size, bool little_endian)
+  : _key(g_next_queue_key++)
+  , _packet_buffer_size(packet_buffer_size)
+  , _little_endian(little_endian)
+{}
+
+
+ShapeSubmitQueue::~ShapeSubmitQueue()
+{
+  SubmitBatch *batch = _head.exchange(nullptr);
+  while (batch)
+  {
+    SubmitBatch *next = batch->next;
+    delete batch;
+    batch = next;
+  }
+}
+
+
+int ShapeSubmitQueue::create(const Shape &shape)
+{
+  return submit(SubmittedMessage::Create, shape);
+}
+
+
+int ShapeSubmitQueue::destroy(const Shape &shape)
+{
+  return submit(SubmittedMessage::Destroy, shape);
+}
+
+
+int ShapeSubmitQueue::update(const Shape &shape)
+{
+  return submit(SubmittedMessage::Update, shape);
+}
+
+
+void ShapeSubmitQueue::collect(std::vector<std::unique_ptr<SubmitBatch>> &batches)
+{
+  // Push partial batches. Each producer's pushes are serialised by its lock, so the push order
+  // preserves the producer's message order.
+  {
+    const std::lock_guard<std::mutex> guard(_producers_lock);
+    for (auto &producer : _producers)
+    {
+      // Check for thread exit before taking the batch so we cannot miss a final submission.
+      const bool exhausted = producer->exhausted.load(std::memory_order_acquire);
+      {
+        const std::lock_guard<std::mutex> producer_guard(producer->lock);
+        if (producer->batch && !producer->batch->empty())
+        {
+          push(std::move(producer->batch));
+        }
+      }
+
+      if (exhausted)
+      {
+        // The thread has exited and its last batch has been pushed. Release the producer.
+        producer.reset();
+      }
+    }
+    _producers.erase(std::remove(_producers.begin(), _producers.end(), nullptr),
+                     _producers.end());
+  }
+
+  // Take the queue. It is a stack, so reverse to restore the push order.
+  SubmitBatch *batch = _head.exchange(nullptr, std::memory_order_acquire);
+  const size_t first = batches.size();
+  while (batch)
+  {
+    SubmitBatch *next = batch->next;
+    batch->next = nullptr;
+    batches.emplace_back(batch);
+    batch = next;
+  }
+  std::reverse(batches.begin() + static_cast<std::ptrdiff_t>(first), batches.end());
+}
+
+
+void ShapeSubmitQueue::recycle(std::vector<std::unique_ptr<SubmitBatch>> &batches)
+{
+  const std::lock_guard<std::mutex> guard(_spare_lock);
+  for (auto &batch : batches)
+  {
+    batch->reset();
+    _spare_batches.emplace_back(std::move(batch));
+  }
+  batches.clear();
+}
+
+
+ShapeSubmitQueue::Producer &ShapeSubmitQueue::producer()
+{
+  thread_local ProducerSlots<Producer> thread_slots;
+  auto &producers = thread_slots.slots;
+  for (const auto &slot : producers)
+  {
+    if (slot.key == _key)
+    {
+      return *slot.producer;
+    }
+  }
+
+  // First use from this thread. Prune slots for expired queues.
+  producers.erase(std::remove_if(producers.begin(), producers.end(),
+                                 [](const ProducerSlot<Producer> &slot) {
+                                   return slot.expiry.expired();
+                                 }),
+                  producers.end());
+
+  auto producer = std::make_shared<Producer>();
+  producer->encode_buffer.resize(_packet_buffer_size);
+  producer->encoder = std::make_unique<PacketWriter>(producer->encode_buffer.data(),
+                                                     _packet_buffer_size);
+  producer->encoder->setLittleEndian(_little_endian);
+
+  {
+    const std::lock_guard<std::mutex> guard(_producers_lock);
+    _producers.emplace_back(producer);
+  }
+
+  producers.emplace_back(ProducerSlot<Producer>{ _key, producer.get(), producer });
+  return *producer;
+}
+
+
+int ShapeSubmitQueue::submit(SubmittedMessage::Type type, const Shape &shape)
+{
+  Producer *producer = &this->producer();
+  const std::lock_guard<std::mutex> guard(producer->lock);
+  if (!producer->batch)
+  {
+    producer->batch = acquireBatch();
+  }
+
+  SubmitBatch &batch = *producer->batch;
+  SubmittedMessage message;
+  message.type = type;
+  message.transient = shape.isTransient();
+  message.skip_resources = shape.skipResources();
+  message.routing_id = shape.routingId();
+  message.shape_id = shape.id();
+  message.shape_flags = shape.flags();
+  message.first_packet = batch.packets.packetCount();
+  message.first_resource = static_cast<unsigned>(batch.resources.size());
+
+  bool ok = false;
+  switch (type)
+  {
+  case SubmittedMessage::Create:
+    ok = batch.packets.appendCreate(shape, *producer->encoder);
+    break;
+  case SubmittedMessage::Update:
+    ok = batch.packets.appendUpdate(shape, *producer->encoder);
+    break;
+  case SubmittedMessage::Destroy:
+    ok = batch.packets.appendDestroy(shape, *producer->encoder);
+    break;
+  }
+
+  if (!ok)
+  {
+    batch.packets.truncate(message.first_packet);
+    return -1;
+  }
+
+  message.packet_count = batch.packets.packetCount() - message.first_packet;
+
+  // Capture resources now as the shape may not survive until delivery. Destroy only needs the
+  // resources of persistent shapes; see BaseConnection::destroy().
+  if (type != SubmittedMessage::Update && !message.skip_resources &&
+      (type == SubmittedMessage::Create || shape.id()))
+  {
+    producer->resource_buffer.clear();
+    shape.enumerateResources(producer->resource_buffer);
+    batch.resources.insert(batch.resources.end(), producer->resource_buffer.begin(),
+                           producer->resource_buffer.end());
+    producer->resource_buffer.clear();
+    message.resource_count =
+      static_cast<unsigned>(batch.resources.size()) - message.first_resource;
+  }
+
+  batch.messages.emplace_back(message);
+
+  const size_t byte_count = batch.packets.byteCount(message.first_packet, message.packet_count);
+  if (batch.packets.byteCount() >= kBatchBytes)
+  {
+    push(std::move(producer->batch));
+  }
+
+  return static_cast<int>(std::min<size_t>(byte_count, std::numeric_limits<int>::max()));
+}
+
+
+void ShapeSubmitQueue::push(std::unique_ptr<SubmitBatch> batch)
+{
+  SubmitBatch *node = batch.release();
+  node->next = _head.load(std::memory_order_relaxed);
+  while (!_head.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                      std::memory_order_relaxed))
+  {
+  }
+}
+
+
+std::unique_ptr<SubmitBatch> ShapeSubmitQueue::acquireBatch()
+{
+  {
+    const std::lock_guard<std::mutex> guard(_spare_lock);
+    if (!_spare_batches.empty())
+    {
+      auto batch = std::move(_spare_batches.back());
+      _spare_batches.pop_back();
+      return batch;
+    }
+  }
+  return std::make_unique<SubmitBatch>();
+}
+}  // namespace tes
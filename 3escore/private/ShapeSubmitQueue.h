@@ -0,0 +1,161 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_PRIVATE_SHAPE_SUBMIT_QUEUE_H
+#define TES_CORE_PRIVATE_SHAPE_SUBMIT_QUEUE_H
+
+#include <3escore/CoreConfig.h>
+
+#include "SharedPacketBuffer.h"
+
+#include <3escore/Ptr.h>
+#include <3escore/Resource.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tes
+{
+class Shape;
+
+/// A shape message encoded by a producer thread for deferred delivery to connections.
+struct SubmittedMessage
+{
+  /// Message types.
+  enum Type : uint8_t
+  {
+    Create,
+    Update,
+    Destroy
+  };
+
+  /// The message type.
+  Type type = Create;
+  /// Was the shape transient? See @c Shape::isTransient() .
+  bool transient = false;
+  /// Did the shape skip resource book keeping? See @c Shape::skipResources() .
+  bool skip_resources = false;
+  /// The shape routing id.
+  uint16_t routing_id = 0;
+  /// The shape id.
+  uint32_t shape_id = 0;
+  /// The shape flags. See @c Shape::flags() .
+  uint16_t shape_flags = 0;
+  /// Index of the first packet in @c SubmitBatch::packets .
+  unsigned first_packet = 0;
+  /// Number of packets for this message.
+  unsigned packet_count = 0;
+  /// Index of the first resource in @c SubmitBatch::resources .
+  unsigned first_resource = 0;
+  /// Number of resources used by the shape.
+  unsigned resource_count = 0;
+};
+
+/// A batch of shape messages from a single producer thread, in submission order.
+struct SubmitBatch
+{
+  /// Encoded packets for all @c messages .
+  SharedPacketBuffer packets;
+  /// Messages in submission order.
+  std::vector<SubmittedMessage> messages;
+  /// Resources used by the @c messages , captured on submission as the shapes may not outlive the
+  /// submission call.
+  std::vector<Ptr<const Resource>> resources;
+  /// Link used by the @c ShapeSubmitQueue .
+  SubmitBatch *next = nullptr;
+
+  /// Clear the batch, retaining allocated memory.
+  void reset();
+  /// Check if the batch has no messages.
+  [[nodiscard]] bool empty() const { return messages.empty(); }
+};
+
+/// Supports concurrent @c Shape create, update and destroy calls for the @c TcpServer with
+/// @c SFMultiProducer .
+///
+/// Each calling thread is given a thread local @c PacketWriter and a @c SubmitBatch staging
+/// buffer. Messages are encoded on the calling thread without touching any server or connection
+/// locks. Full batches are pushed to a lock free, multi-producer queue. The consumer - the
+/// @c TcpServer in @c updateFrame() - calls @c collect() to push any partial batches and take
+/// all the queued batches in push order.
+///
+/// Message order is preserved for each producer thread. Messages from different threads may be
+/// interleaved, but all messages submitted before @c collect() are delivered in the same frame.
+///
+/// A producer thread's staging batch is guarded by a per thread mutex. This is only contended
+/// while @c collect() steals the partial batch at the frame boundary. Producers are released by
+/// the first @c collect() after their thread exits.
+class ShapeSubmitQueue
+{
+public:
+  /// Create a submission queue.
+  /// @param packet_buffer_size Size of each producer's encoding buffer. See
+  ///   @c ServerSettings::client_buffer_size .
+  /// @param little_endian True to encode payloads with @c PFLittleEndian .
+  ShapeSubmitQueue(uint16_t packet_buffer_size, bool little_endian);
+  ~ShapeSubmitQueue();
+
+  ShapeSubmitQueue(const ShapeSubmitQueue &) = delete;
+  ShapeSubmitQueue &operator=(const ShapeSubmitQueue &) = delete;
+
+  /// Encode a create message for @p shape , including data messages for complex shapes.
+  /// @param shape The shape to create.
+  /// @return The number of bytes encoded, or -1 on failure.
+  int create(const Shape &shape);
+  /// Encode a destroy message for @p shape .
+  /// @param shape The shape to destroy.
+  /// @return The number of bytes encoded, or -1 on failure.
+  int destroy(const Shape &shape);
+  /// Encode an update message for @p shape .
+  /// @param shape The shape to update.
+  /// @return The number of bytes encoded, or -1 on failure.
+  int update(const Shape &shape);
+
+  /// Collect all messages submitted so far. Partial batches from each producer thread are queued,
+  /// then all batches are taken from the queue in push order and appended to @p batches . Producers
+  /// for threads which have exited are released.
+  ///
+  /// Only one thread may call @c collect() at a time.
+  /// @param batches The collected batches are appended here.
+  void collect(std::vector<std::unique_ptr<SubmitBatch>> &batches);
+
+  /// Return batches from @c collect() for reuse once delivered. @p batches is cleared.
+  /// @param batches The batches to recycle.
+  void recycle(std::vector<std::unique_ptr<SubmitBatch>> &batches);
+
+  /// Byte count at which a producer's batch is pushed to the queue before @c collect() .
+  static constexpr size_t kBatchBytes = 64u * 1024u;
+
+private:
+  struct Producer;
+
+  /// Resolve the @c Producer for the calling thread, registering a new one on first use.
+  Producer &producer();
+
+  /// Encode a message of @p type for @p shape into the calling thread's batch.
+  int submit(SubmittedMessage::Type type, const Shape &shape);
+
+  /// Push @p batch to the lock free queue.
+  void push(std::unique_ptr<SubmitBatch> batch);
+
+  /// Take a recycled batch or allocate a new one.
+  std::unique_ptr<SubmitBatch> acquireBatch();
+
+  /// Head of the lock free stack of pushed batches (most recent first).
+  std::atomic<SubmitBatch *> _head = { nullptr };
+  /// Unique key used to find this queue's @c Producer in thread local storage.
+  uint64_t _key = 0;
+  std::mutex _producers_lock;  ///< Guards @c _producers
+  /// Producers for live threads, plus exited threads awaiting @c collect() .
+  std::vector<std::shared_ptr<Producer>> _producers;
+  std::mutex _spare_lock;  ///< Guards @c _spare_batches
+  std::vector<std::unique_ptr<SubmitBatch>> _spare_batches;
+  uint16_t _packet_buffer_size = 0;
+  bool _little_endian = false;
+};
+}  // namespace tes
+
+#endif  // TES_CORE_PRIVATE_SHAPE_SUBMIT_QUEUE_H
@@ -0,0 +1,164 @@
+//
+// author: Kazys Stepanas
+//
+#include "SharedPacketBuffer.h"
+
+#include <3escore/CoreUtil.h>
+#include <3escore/Debug.h>
+#include <3escore/PacketWriter.h>
+
+#include <3escore/shapes/Shape.h>
+
+namespace tes
+{
+void SharedPacketBuffer::reset()
+{
+  _bytes.clear();
+  _packet_offsets.clear();
+}
+
+
+bool SharedPacketBuffer::encodeCreate(const Shape &shape, PacketWriter &packet)
+{
+  reset();
+  return appendCreate(shape, packet);
+}
+
+
+bool SharedPacketBuffer::appendCreate(const Shape &shape, PacketWriter &packet)
+{
+  if (!shape.writeCreate(packet) || !packet.finalise())
+  {
+    return false;
+  }
+  append(packet);
+
+  // For complex shapes, we must also encode data messages.
+  if (shape.isComplex())
+  {
+    unsigned progress = 0;
+    int status = 0;
+    while ((status = shape.writeData(packet, progress)) >= 0)
+    {
+      if (!packet.finalise())
+      {
+        return false;
+      }
+
+      append(packet);
+
+      if (status == 0)
+      {
+        break;
+      }
+    }
+
+    if (status == -1)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool SharedPacketBuffer::encodeUpdate(const Shape &shape, PacketWriter &packet)
+{
+  reset();
+  return appendUpdate(shape, packet);
+}
+
+
+bool SharedPacketBuffer::appendUpdate(const Shape &shape, PacketWriter &packet)
+{
+  if (!shape.writeUpdate(packet) || !packet.finalise())
+  {
+    return false;
+  }
+  append(packet);
+  return true;
+}
+
+
+bool SharedPacketBuffer::encodeDestroy(const Shape &shape, PacketWriter &packet)
+{
+  reset();
+  return appendDestroy(shape, packet);
+}
+
+
+bool SharedPacketBuffer::appendDestroy(const Shape &shape, PacketWriter &packet)
+{
+  if (!shape.writeDestroy(packet) || !packet.finalise())
+  {
+    return false;
+  }
+  append(packet);
+  return true;
+}
+
+
+void SharedPacketBuffer::append(const PacketWriter &packet)
+{
+  const uint8_t *bytes = packet.data();
+  const size_t byte_count = packet.packetSize();
+  _packet_offsets.emplace_back(_bytes.size());
+  _bytes.insert(_bytes.end(), bytes, bytes + byte_count);
+}
+
+
+void SharedPacketBuffer::append(const SharedPacketBuffer &other, unsigned first_packet,
+                                unsigned packet_count)
+{
+  if (packet_count == 0)
+  {
+    return;
+  }
+  const size_t src_start = other._packet_offsets[first_packet];
+  const size_t byte_count = other.byteCount(first_packet, packet_count);
+  const size_t dst_start = _bytes.size();
+  for (unsigned i = first_packet; i < first_packet + packet_count; ++i)
+  {
+    _packet_offsets.emplace_back(dst_start + other._packet_offsets[i] - src_start);
+  }
+  _bytes.insert(_bytes.end(), other._bytes.begin() + static_cast<std::ptrdiff_t>(src_start),
+                other._bytes.begin() + static_cast<std::ptrdiff_t>(src_start + byte_count));
+}
+
+
+void SharedPacketBuffer::truncate(unsigned packet_count)
+{
+  if (packet_count < _packet_offsets.size())
+  {
+    _bytes.resize(_packet_offsets[packet_count]);
+    _packet_offsets.resize(packet_count);
+  }
+}
+
+
+size_t SharedPacketBuffer::byteCount(unsigned first_packet, unsigned packet_count) const
+{
+  TES_ASSERT(first_packet + packet_count <= _packet_offsets.size());
+  if (packet_count == 0)
+  {
+    return 0;
+  }
+  const size_t start = _packet_offsets[first_packet];
+  const unsigned end_index = first_packet + packet_count;
+  const size_t end =
+    (end_index < _packet_offsets.size()) ? _packet_offsets[end_index] : _bytes.size();
+  return end - start;
+}
+
+
+const uint8_t *SharedPacketBuffer::packet(unsigned index, unsigned &packet_size) const
+{
+  TES_ASSERT(index < _packet_offsets.size());
+  const size_t start = _packet_offsets[index];
+  const size_t end =
+    (index + 1 < _packet_offsets.size()) ? _packet_offsets[index + 1] : _bytes.size();
+  packet_size = int_cast<unsigned>(end - start);
+  return _bytes.data() + start;
+}
+}  // namespace tes
@@ -0,0 +1,121 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_PRIVATE_SHARED_PACKET_BUFFER_H
+#define TES_CORE_PRIVATE_SHARED_PACKET_BUFFER_H
+
+#include <3escore/CoreConfig.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tes
+{
+class PacketWriter;
+class Shape;
+
+/// A buffer holding a sequence of finalised packets encoded once for sending to many connections.
+///
+/// The @c TcpServer uses this to serialise a @c Shape message - including the CRC - a single time
+/// then hand the same bytes to each connection's collation/send path. The buffer is intended to be
+/// held via @c SharedPacketBufferPtr so that a connection may retain a reference beyond the
+/// immediate send call.
+///
+/// Packets are stored back to back, each complete with header, payload and CRC.
+class SharedPacketBuffer
+{
+public:
+  /// Clear all encoded packets, retaining allocated memory.
+  void reset();
+
+  /// Encode the @c Shape::writeCreate() message for @p shape followed by any data messages for
+  /// complex shapes.
+  ///
+  /// Previous content is cleared.
+  ///
+  /// @param shape The shape to encode.
+  /// @param packet Scratch packet writer used to serialise each packet.
+  /// @return True on success.
+  bool encodeCreate(const Shape &shape, PacketWriter &packet);
+
+  /// Encode the @c Shape::writeUpdate() message for @p shape. Previous content is cleared.
+  /// @param shape The shape to encode.
+  /// @param packet Scratch packet writer used to serialise each packet.
+  /// @return True on success.
+  bool encodeUpdate(const Shape &shape, PacketWriter &packet);
+
+  /// Encode the @c Shape::writeDestroy() message for @p shape. Previous content is cleared.
+  /// @param shape The shape to encode.
+  /// @param packet Scratch packet writer used to serialise each packet.
+  /// @return True on success.
+  bool encodeDestroy(const Shape &shape, PacketWriter &packet);
+
+  /// Append the @c Shape::writeCreate() message and any data messages for @p shape , retaining
+  /// previous content. On failure, partially encoded packets remain and may be removed using
+  /// @c truncate() .
+  /// @param shape The shape to encode.
+  /// @param packet Scratch packet writer used to serialise each packet.
+  /// @return True on success.
+  bool appendCreate(const Shape &shape, PacketWriter &packet);
+
+  /// Append the @c Shape::writeUpdate() message for @p shape , retaining previous content.
+  /// @param shape The shape to encode.
+  /// @param packet Scratch packet writer used to serialise each packet.
+  /// @return True on success.
+  bool appendUpdate(const Shape &shape, PacketWriter &packet);
+
+  /// Append the @c Shape::writeDestroy() message for @p shape , retaining previous content.
+  /// @param shape The shape to encode.
+  /// @param packet Scratch packet writer used to serialise each packet.
+  /// @return True on success.
+  bool appendDestroy(const Shape &shape, PacketWriter &packet);
+
+  /// Remove packets from the end of the buffer, leaving the first @p packet_count packets.
+  /// @param packet_count The number of packets to retain.
+  void truncate(unsigned packet_count);
+
+  /// Append a range of packets from @p other .
+  /// @param other The buffer to copy packets from.
+  /// @param first_packet Index of the first packet to copy from @p other .
+  /// @param packet_count Number of packets to copy.
+  void append(const SharedPacketBuffer &other, unsigned first_packet, unsigned packet_count);
+
+  /// Append the finalised content of @p packet.
+  /// @param packet The packet to append. Must be finalised.
+  void append(const PacketWriter &packet);
+
+  /// Query the number of packets in the buffer.
+  /// @return The packet count.
+  [[nodiscard]] unsigned packetCount() const
+  {
+    return static_cast<unsigned>(_packet_offsets.size());
+  }
+
+  /// Access the packet at @p index.
+  /// @param index The packet index. Must be less than @c packetCount().
+  /// @param[out] packet_size Set to the number of bytes in the packet, including the CRC.
+  /// @return A pointer to the start of the packet header.
+  [[nodiscard]] const uint8_t *packet(unsigned index, unsigned &packet_size) const;
+
+  /// Query the total number of encoded bytes across all packets.
+  /// @return The total byte count.
+  [[nodiscard]] size_t byteCount() const { return _bytes.size(); }
+
+  /// Query the number of bytes in a range of packets.
+  /// @param first_packet Index of the first packet in the range.
+  /// @param packet_count Number of packets in the range.
+  /// @return The total byte count for the packet range.
+  [[nodiscard]] size_t byteCount(unsigned first_packet, unsigned packet_count) const;
+
+private:
+  std::vector<uint8_t> _bytes;
+  std::vector<size_t> _packet_offsets;
+};
+
+/// Shared pointer type used to hand a @c SharedPacketBuffer to connections.
+using SharedPacketBufferPtr = std::shared_ptr<const SharedPacketBuffer>;
+}  // namespace tes
+
+#endif  // TES_CORE_PRIVATE_SHARED_PACKET_BUFFER_H
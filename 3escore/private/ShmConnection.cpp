@@ -0,0 +1,72 @@
+//
+// author: Kazys Stepanas
+//
+#include "ShmConnection.h"
+
+#include <3escore/SharedMemoryRing.h>
+
+namespace tes
+{
+ShmConnection::ShmConnection(std::unique_ptr<SharedMemoryRing> ring,
+                             const ServerSettings &settings,
+                             std::shared_ptr<CompressionPool> compression_pool,
+                             std::shared_ptr<ResourceCache> resource_cache)
+  : BaseConnection(settings, std::move(compression_pool), std::move(resource_cache))
+  , _ring(std::move(ring))
+{}
+
+
+ShmConnection::~ShmConnection()
+{
+  close();
+}
+
+
+void ShmConnection::close()
+{
+  drainPending();
+  const std::lock_guard<Lock> guard(_ring_lock);
+  _ring->close();
+}
+
+
+const char *ShmConnection::address() const
+{
+  return _ring->name().c_str();
+}
+
+
+uint16_t ShmConnection::port() const
+{
+  return 0;
+}
+
+
+bool ShmConnection::isConnected() const
+{
+  const std::unique_lock<Lock> guard(_ring_lock, std::try_to_lock);
+  if (!guard.owns_lock())
+  {
+    // A write is in progress and will flag any failure.
+    return !_failed;
+  }
+  return _ring->isOpen() && !_ring->readerDetached() && !_failed;
+}
+
+
+int ShmConnection::writeBytes(const uint8_t *data, int byte_count)
+{
+  if (_failed)
+  {
+    return -1;
+  }
+
+  const std::lock_guard<Lock> guard(_ring_lock);
+  const int written = _ring->write(data, static_cast<size_t>(byte_count), kWriteTimeoutMs);
+  if (written < 0)
+  {
+    _failed = true;
+  }
+  return written;
+}
+}  // namespace tes
@@ -0,0 +1,64 @@
+//
+// author: Kazys Stepanas
+//
+#ifndef TES_CORE_PRIVATE_SHM_CONNECTION_H
+#define TES_CORE_PRIVATE_SHM_CONNECTION_H
+
+#include "../Server.h"
+
+#include "BaseConnection.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace tes
+{
+class SharedMemoryRing;
+
+/// A shared memory implementation of a 3es @c Connection for viewers on the same host.
+///
+/// Writes the byte stream - collated packets included - into a @c SharedMemoryRing which the
+/// viewer reads in place. This avoids the system calls and kernel copies of a loopback TCP
+/// connection. The connection is created by the @c TcpConnectionMonitor once a viewer attaches to
+/// a ring opened via @c ConnectionMonitor::openSharedMemory() , and is lost when the viewer
+/// detaches or stops reading for @c kWriteTimeoutMs .
+class ShmConnection final : public BaseConnection
+{
+public:
+  /// Maximum time to wait for the viewer to make space in the ring before disconnecting.
+  static constexpr unsigned kWriteTimeoutMs = 5000u;
+
+  /// Create a connection writing to @p ring .
+  /// @param ring The ring to write to. Must be open for writing, with a reader attached.
+  /// @param settings Various server settings to initialise with.
+  /// @param compression_pool Optional worker pool used to finalise collated packets.
+  /// @param resource_cache Optional encoded resource cache shared by the server's connections.
+  ShmConnection(std::unique_ptr<SharedMemoryRing> ring, const ServerSettings &settings,
+                std::shared_ptr<CompressionPool> compression_pool = {},
+                std::shared_ptr<ResourceCache> resource_cache = {});
+
+  /// Destructor.
+  ~ShmConnection() final;
+
+  /// Close the ring, ending the viewer's stream.
+  void close() final;
+
+  /// Reports the shared memory object name.
+  const char *address() const final;
+  uint16_t port() const final;
+  bool isConnected() const final;
+
+protected:
+  int writeBytes(const uint8_t *data, int byte_count) final;
+
+private:
+  /// Guards @c _ring writes against @c close() unmapping the ring.
+  mutable Lock _ring_lock;
+  std::unique_ptr<SharedMemoryRing> _ring;
+  /// Set when a write fails.
+  std::atomic_bool _failed = { false };
+};
+}  // namespace tes
+
+#endif  // TES_CORE_PRIVATE_SHM_CONNECTION_H
@@ -3,15 +3,51 @@
 //
 #include "TcpConnection.h"
 
+#include "AsyncSendQueue.h"
+
+#include <3escore/CollatedPacket.h>
 #include <3escore/TcpSocket.h>
 
+#include <algorithm>
+
 namespace tes
 {
 TcpConnection::TcpConnection(std::shared_ptr<TcpSocket> client_socket,
-                             const ServerSettings &settings)
-  : BaseConnection(settings)
+                             const ServerSettings &settings,
+                             std::shared_ptr<CompressionPool> compression_pool,
+                             std::shared_ptr<ResourceCache> resource_cache)
+  : BaseConnection(settings, std::move(compression_pool), std::move(resource_cache))
   , _client(std::move(client_socket))
-{}
+  , _cork((settings.flags & SFCorkFrames) != 0)
+{
+  if (_cork)
+  {
+    _client->setCork(true);
+  }
+
+  if (settings.flags & SFAsyncSend)
+  {
+    // Ensure we can hold at least a couple of full packets.
+    const size_t max_packet_size = (settings.flags & SFExtendedPackets) ?
+                                     std::max<size_t>(settings.client_buffer_size,
+                                                      settings.extended_buffer_size) :
+                                     settings.client_buffer_size;
+    const size_t capacity =
+      std::max<size_t>(settings.async_send_buffer_size, 2u * max_packet_size);
+    _send_queue = std::make_unique<AsyncSendQueue>(
+      capacity, static_cast<SendOverflow>(settings.send_overflow),
+      [this](const uint8_t *data, int byte_count) {
+        const int wrote = _client->write(data, byte_count);
+        // The socket reports a reset connection as a zero byte write. Fail so the sender thread
+        // does not spin on a dead connection.
+        return (wrote == 0 && byte_count > 0 && !_client->isConnected()) ? -1 : wrote;
+      },
+      [this]() {
+        _client->setCork(false);
+        _client->setCork(true);
+      });
+  }
+}
 
 
 TcpConnection::~TcpConnection()
@@ -22,6 +58,14 @@ TcpConnection::~TcpConnection()
 
 void TcpConnection::close()
 {
+  drainPending();
+
+  if (_send_queue)
+  {
+    // Flush queued data before closing the socket.
+    _send_queue->stop();
+  }
+
   if (_client)
   {
     _client->close();
@@ -45,12 +89,76 @@ uint16_t TcpConnection::port() const
 
 bool TcpConnection::isConnected() const
 {
-  return _client && _client->isConnected();
+  return _client && _client->isConnected() && !(_send_queue && _send_queue->failed());
+}
+
+
+bool TcpConnection::sendQueueStats(SendQueueStats &stats) const
+{
+  if (_send_queue)
+  {
+    _send_queue->stats(stats);
+    return true;
+  }
+  return false;
 }
 
 
 int TcpConnection::writeBytes(const uint8_t *data, int byte_count)
 {
+  if (_send_queue)
+  {
+    return _send_queue->push(data, byte_count);
+  }
   return _client->write(data, byte_count);
 }
+
+
+int TcpConnection::writeSegments(const BufferSegment *segments, unsigned segment_count)
+{
+  if (_send_queue)
+  {
+    // The queue copies the data anyway.
+    return BaseConnection::writeSegments(segments, segment_count);
+  }
+  return _client->writev(segments, segment_count);
+}
+
+
+void TcpConnection::flushWrites()
+{
+  if (!_cork)
+  {
+    return;
+  }
+
+  if (_send_queue)
+  {
+    // Flush from the sender thread once the frame has been written.
+    _send_queue->flush();
+    return;
+  }
+
+  // Toggle the cork to push out the remainder of the frame.
+  _client->setCork(false);
+  _client->setCork(true);
+}
+
+
+bool TcpConnection::transientBufferSpace(size_t &free_bytes) const
+{
+  if (!_send_queue || _send_queue->overflow() != SODropTransient)
+  {
+    return false;
+  }
+
+  free_bytes = _send_queue->freeBytes();
+  return true;
+}
+
+
+void TcpConnection::recordDroppedTransient(size_t byte_count)
+{
+  _send_queue->recordDropped(byte_count);
+}
 }  // namespace tes
@@ -12,19 +12,31 @@
 
 namespace tes
 {
+class AsyncSendQueue;
 class TcpSocket;
 
 /// A TCP based implementation of a 3es @c Connection. Each @c TcpConnection represents a remote
 /// client connection.
 ///
 /// These connections are created by the @c TcpServer.
+///
+/// With @c SFAsyncSend, data are written to the socket from a dedicated thread via an
+/// @c AsyncSendQueue. Otherwise data are written on the calling thread.
+///
+/// Finalised collated packets are written with a single scatter-gather write, avoiding a copy of
+/// the collated data. With @c SFCorkFrames , the socket is corked and only flushed at the end of
+/// each frame.
 class TcpConnection final : public BaseConnection
 {
 public:
   /// Create a new connection using the given @p client_socket.
   /// @param client_socket The socket to communicate on.
   /// @param settings Various server settings to initialise with.
-  TcpConnection(std::shared_ptr<TcpSocket> client_socket, const ServerSettings &settings);
+  /// @param compression_pool Optional worker pool used to finalise collated packets.
+  /// @param resource_cache Optional encoded resource cache shared by the server's connections.
+  TcpConnection(std::shared_ptr<TcpSocket> client_socket, const ServerSettings &settings,
+                std::shared_ptr<CompressionPool> compression_pool = {},
+                std::shared_ptr<ResourceCache> resource_cache = {});
 
   /// Destructor.s
   ~TcpConnection() final;
@@ -36,11 +48,25 @@ public:
   uint16_t port() const final;
   bool isConnected() const final;
 
+  bool sendQueueStats(SendQueueStats &stats) const final;
+
 protected:
   int writeBytes(const uint8_t *data, int byte_count) final;
+  int writeSegments(const BufferSegment *segments, unsigned segment_count) final;
+
+  /// Uncork the socket to flush the frame with @c SFCorkFrames .
+  void flushWrites() final;
+
+  /// Reports the send queue space when using @c SODropTransient .
+  bool transientBufferSpace(size_t &free_bytes) const final;
+  void recordDroppedTransient(size_t byte_count) final;
 
 private:
   std::shared_ptr<TcpSocket> _client;
+  /// Send queue used with @c SFAsyncSend . Null otherwise.
+  std::unique_ptr<AsyncSendQueue> _send_queue;
+  /// Cork the socket between frames? See @c SFCorkFrames .
+  bool _cork = false;
 };
 }  // namespace tes
 
@@ -4,10 +4,13 @@
 #include "TcpConnectionMonitor.h"
 
 #include "FileConnection.h"
+#include "ShmConnection.h"
 #include "TcpConnection.h"
 #include "TcpServer.h"
 
 #include <3escore/CoreUtil.h>
+#include <3escore/Log.h>
+#include <3escore/SharedMemoryRing.h>
 #include <3escore/TcpListenSocket.h>
 #include <3escore/TcpSocket.h>
 
@@ -17,6 +20,17 @@
 
 namespace tes
 {
+namespace
+{
+/// Monitor thread wait when socket events are delivered by the @c TcpPoller . This bounds the
+/// latency for expiring connections closed locally.
+constexpr unsigned kEventWaitMs = 500;
+/// Monitor thread wait when the @c TcpPoller is not event driven, or when polling for shared
+/// memory viewers.
+constexpr unsigned kPollWaitMs = 50;
+}  // namespace
+
+
 TcpConnectionMonitor::TcpConnectionMonitor(TcpServer &server)
   : _server(server)
 {}
@@ -26,6 +40,7 @@ TcpConnectionMonitor::~TcpConnectionMonitor()
 {
   stop();
   join();
+  _poller.setListenSocket(nullptr);
   _listen.reset();
   _thread.reset();
 }
@@ -82,15 +97,11 @@ bool TcpConnectionMonitor::start(ConnectionMode mode)
     join();  // Pointer may linger after quit.
     _thread = std::make_unique<std::thread>([this]() { monitorThread(); });
     // Wait for the thread to start. We look for _running or an _error_code.
-    auto wait_start = std::chrono::steady_clock::now();
-    unsigned elapsed_ms = 0;
-    while (!_running && !_error_code && elapsed_ms <= _server.settings().async_timeout_ms)
-    {
-      std::this_thread::yield();
-      elapsed_ms = int_cast<unsigned>(std::chrono::duration_cast<std::chrono::milliseconds>(
-                                        std::chrono::steady_clock::now() - wait_start)
-                                        .count());
-    }
+    std::unique_lock<Lock> lock(_connection_lock);
+    const bool started = _connection_signal.wait_for(
+      lock, std::chrono::milliseconds(_server.settings().async_timeout_ms),
+      [this]() { return _running || _error_code; });
+    lock.unlock();
 
     // Running will be true if the thread started ok.
     if (_running)
@@ -98,7 +109,7 @@ bool TcpConnectionMonitor::start(ConnectionMode mode)
       _mode = ConnectionMode::Asynchronous;
     }
 
-    if (!_running && !_error_code && elapsed_ms >= _server.settings().async_timeout_ms)
+    if (!started)
     {
       _error_code = CETimeout;
     }
@@ -125,6 +136,7 @@ void TcpConnectionMonitor::stop()
 
   case ConnectionMode::Asynchronous:
     _quit_flag = true;
+    _poller.wake();
     break;
 
   default:
@@ -162,37 +174,34 @@ ConnectionMode TcpConnectionMonitor::mode() const
 
 int TcpConnectionMonitor::waitForConnection(unsigned timeout_ms)
 {
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
   std::unique_lock<Lock> lock(_connection_lock);
   if (!_connections.empty())
   {
     return int_cast<int>(_connections.size());
   }
-  lock.unlock();
 
-  // Wait for start.
   if (mode() == ConnectionMode::Asynchronous)
   {
-    while (!isRunning() && mode() != ConnectionMode::None)
-    {}
+    // The monitor thread signals new connections and when it stops.
+    _connection_signal.wait_until(lock, deadline,
+                                  [this]() { return !_connections.empty() || !_running; });
+    return int_cast<int>(_connections.size());
   }
+  lock.unlock();
 
-  // Update connections if required.
-  auto start_time = std::chrono::steady_clock::now();
+  // Update connections, blocking on the poller until the timeout expires.
   bool timedout = false;
   int connection_count = 0;
   while (isRunning() && !timedout && connection_count == 0)
   {
-    if (mode() == ConnectionMode::Synchronous)
-    {
-      monitorConnections();
-    }
-    else
-    {
-      std::this_thread::yield();
-    }
-    timedout = std::chrono::duration_cast<std::chrono::milliseconds>(
-                 std::chrono::steady_clock::now() - start_time)
-                 .count() >= timeout_ms;
+    const auto now = std::chrono::steady_clock::now();
+    timedout = now >= deadline;
+    const unsigned wait_ms =
+      (!timedout) ?
+        int_cast<unsigned>(std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count()) :
+        0u;
+    pollConnections(wait_ms);
     lock.lock();
     connection_count = int_cast<int>(_connections.size());
     lock.unlock();
@@ -204,56 +213,14 @@ int TcpConnectionMonitor::waitForConnection(unsigned timeout_ms)
 
 void TcpConnectionMonitor::monitorConnections()
 {
-  // Lock for connection expiry.
-  std::unique_lock<Lock> lock(_connection_lock);
-
-  // Expire lost connections.
-  for (auto iter = _connections.begin(); iter != _connections.end();)
-  {
-    auto connection = *iter;
-    if (connection->isConnected())
-    {
-      ++iter;
-    }
-    else
-    {
-      _expired.push_back(connection);
-      iter = _connections.erase(iter);
-    }
-  }
-
-  // Unlock while we check for new connections.
-  lock.unlock();
-
-  // Look for new connections.
-  if (_listen)
-  {
-    if (auto new_socket = _listen->accept(0))
-    {
-      // Options to try and reduce socket latency.
-      // Attempt to prevent periodic latency on osx.
-      new_socket->setNoDelay(true);
-      new_socket->setWriteTimeout(0);
-      new_socket->setReadTimeout(0);
-#ifdef __apple__
-      // On OSX, set send buffer size. Not sure automatic sizing is working.
-      // Remove this code if it is.
-      new_socket->setSendBufferSize(0xffff);
-#endif  // __apple__
-
-      auto new_connection = std::make_shared<TcpConnection>(new_socket, _server.settings());
-      // Lock for new connection.
-      lock.lock();
-      _connections.push_back(new_connection);
-      lock.unlock();
-    }
-  }
+  pollConnections(0);
 }
 
 
 std::shared_ptr<Connection> TcpConnectionMonitor::openFileStream(const std::string &file_path)
 {
-  auto new_connection = std::make_shared<FileConnection>(file_path, _server.settings());
+  auto new_connection = std::make_shared<FileConnection>(
+    file_path, _server.settings(), _server.compressionPool(), _server.resourceCache());
   if (!new_connection->isConnected())
   {
     return nullptr;
@@ -265,6 +232,21 @@ std::shared_ptr<Connection> TcpConnectionMonitor::openFileStream(const std::stri
 }
 
 
+bool TcpConnectionMonitor::openSharedMemory(const std::string &name)
+{
+  auto ring = std::make_unique<SharedMemoryRing>();
+  if (!ring->create(name, _server.settings().shared_memory_size))
+  {
+    return false;
+  }
+
+  const std::unique_lock<Lock> lock(_connection_lock);
+  _shm_listeners.emplace_back(std::move(ring));
+  _have_shm_listeners = true;
+  return true;
+}
+
+
 void TcpConnectionMonitor::setConnectionCallback(void (*callback)(Server &, Connection &, void *),
                                                  void *user)
 {
@@ -299,6 +281,111 @@ void TcpConnectionMonitor::commitConnections()
 }
 
 
+void TcpConnectionMonitor::pollConnections(unsigned wait_ms)
+{
+  const unsigned events = _poller.wait(wait_ms);
+
+  // Lock for connection expiry.
+  std::unique_lock<Lock> lock(_connection_lock);
+
+  // Expire lost connections. Sockets watched by an event driven poller report the liveness flag
+  // set by the poller rather than querying the socket.
+  for (auto iter = _connections.begin(); iter != _connections.end();)
+  {
+    auto connection = *iter;
+    if (connection->isConnected())
+    {
+      ++iter;
+    }
+    else
+    {
+      _expired.push_back(connection);
+      iter = _connections.erase(iter);
+    }
+  }
+
+  // Unlock while we check for new connections.
+  lock.unlock();
+
+  if (_have_shm_listeners)
+  {
+    acceptSharedMemory();
+  }
+
+  if (!_listen || !(events & TcpPoller::PEConnection))
+  {
+    return;
+  }
+
+  // Accept all pending connections.
+  while (auto new_socket = _listen->accept(0))
+  {
+    // Options to try and reduce socket latency.
+    // Attempt to prevent periodic latency on osx.
+    // This remains set with SFCorkFrames. The cork holds back partial segments within a frame
+    // while no delay ensures the end of the frame is sent as soon as the socket is uncorked.
+    new_socket->setNoDelay(true);
+    new_socket->setWriteTimeout(0);
+    new_socket->setReadTimeout(0);
+#ifdef __apple__
+    // On OSX, set send buffer size. Not sure automatic sizing is working.
+    // Remove this code if it is.
+    new_socket->setSendBufferSize(0xffff);
+#endif  // __apple__
+
+    _poller.watch(new_socket);
+
+    auto new_connection = std::make_shared<TcpConnection>(
+      new_socket, _server.settings(), _server.compressionPool(), _server.resourceCache());
+    // Lock for new connection.
+    lock.lock();
+    _connections.push_back(new_connection);
+    lock.unlock();
+    _connection_signal.notify_all();
+  }
+}
+
+
+void TcpConnectionMonitor::acceptSharedMemory()
+{
+  std::unique_lock<Lock> lock(_connection_lock);
+  bool accepted = false;
+  for (auto iter = _shm_listeners.begin(); iter != _shm_listeners.end();)
+  {
+    if (!(*iter)->readerAttached())
+    {
+      ++iter;
+      continue;
+    }
+
+    // Release the name then listen for the next viewer on a new ring.
+    std::unique_ptr<SharedMemoryRing> attached = std::move(*iter);
+    attached->unlink();
+    *iter = std::make_unique<SharedMemoryRing>();
+    if ((*iter)->create(attached->name(), _server.settings().shared_memory_size))
+    {
+      ++iter;
+    }
+    else
+    {
+      log::error("Failed to recreate shared memory ", attached->name());
+      iter = _shm_listeners.erase(iter);
+    }
+
+    _connections.emplace_back(std::make_shared<ShmConnection>(
+      std::move(attached), _server.settings(), _server.compressionPool(), _server.resourceCache()));
+    accepted = true;
+  }
+  _have_shm_listeners = !_shm_listeners.empty();
+  lock.unlock();
+
+  if (accepted)
+  {
+    _connection_signal.notify_all();
+  }
+}
+
+
 bool TcpConnectionMonitor::listen()
 {
   if (_listen)
@@ -318,13 +405,14 @@ bool TcpConnectionMonitor::listen()
 
   _listen_port = (listening) ? _listen->port() : 0;
 
-  return listening;
+  return listening && _poller.setListenSocket(_listen.get());
 }
 
 
 void TcpConnectionMonitor::stopListening()
 {
   _listen_port = 0;
+  _poller.setListenSocket(nullptr);
 
   // Close all connections.
   for (const auto &con : _connections)
@@ -333,27 +421,40 @@ void TcpConnectionMonitor::stopListening()
   }
 
   _listen.reset();
+
+  // Stop listening for shared memory viewers. The listeners are shared with openSharedMemory().
+  const std::unique_lock<Lock> lock(_connection_lock);
+  _shm_listeners.clear();
+  _have_shm_listeners = false;
 }
 
 
 void TcpConnectionMonitor::monitorThread()
 {
+  std::unique_lock<Lock> lock(_connection_lock);
   if (!listen())
   {
     _error_code = CEListenFailure;
+    lock.unlock();
+    _connection_signal.notify_all();
     stopListening();
     return;
   }
   _running = true;
+  lock.unlock();
+  _connection_signal.notify_all();
 
-  const unsigned sleep_ms = 50;
+  // Sleep on the poller between connection events. Shared memory viewers can only be polled.
   while (!_quit_flag)
   {
-    monitorConnections();
-    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
+    const bool event_driven = _poller.eventDriven() && !_have_shm_listeners;
+    pollConnections(event_driven ? kEventWaitMs : kPollWaitMs);
   }
 
+  lock.lock();
   _running = false;
+  lock.unlock();
+  _connection_signal.notify_all();
   stopListening();
   _mode = ConnectionMode::None;
 }
@@ -7,8 +7,11 @@
 #include <3escore/CoreConfig.h>
 
 #include <3escore/ConnectionMonitor.h>
+#include <3escore/TcpPoller.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
@@ -16,11 +19,17 @@
 namespace tes
 {
 class BaseConnection;
+class SharedMemoryRing;
 class TcpServer;
 class TcpListenSocket;
 
 /// Implements a @c ConnectionMonitor using the TCP protocol. Intended only for use with a @c
 /// TcpServer.
+///
+/// New connections and disconnections are detected using a @c TcpPoller . Where the poller is
+/// event driven, the asynchronous monitor thread sleeps until a connection event occurs and
+/// connection liveness checks do not query the sockets. Threads blocked in
+/// @c waitForConnection() are signalled as connections arrive.
 class TcpConnectionMonitor final : public ConnectionMonitor
 {
 public:
@@ -101,7 +110,7 @@ public:
   /// effects neither in the @c Server.
   ///
   /// This is either called on the main thread for synchronous operation,
-  /// or internally in asynchronous mode.
+  /// or internally in asynchronous mode. Does not block.
   void monitorConnections() final;
 
   /// Opens a @c Connection object which serialises directly to the local file system.
@@ -113,6 +122,8 @@ public:
   /// @return A pointer to a @c Connection object which represents the file stream.
   std::shared_ptr<Connection> openFileStream(const std::string &file_path) final;
 
+  bool openSharedMemory(const std::string &name) final;
+
   /// Sets the callback invoked for each new connection.
   ///
   /// This is invoked from @p commitConnections() for each new connection.
@@ -151,22 +162,36 @@ public:
   void commitConnections() final;
 
 private:
+  /// Implements @c monitorConnections() , first waiting up to @p wait_ms for a connection event.
+  /// @param wait_ms Time to wait for connection events (milliseconds).
+  void pollConnections(unsigned wait_ms);
+  /// Create connections for viewers attached to the @c _shm_listeners , replacing each attached
+  /// ring with a new one for the next viewer.
+  void acceptSharedMemory();
   bool listen();
   void stopListening();
   void monitorThread();
 
   TcpServer &_server;
   std::unique_ptr<TcpListenSocket> _listen;
+  TcpPoller _poller;
   std::function<void(Server &, Connection &)> _on_new_connection;
   ConnectionMode _mode = ConnectionMode::None;  ///< Current execution mode.
-  std::vector<std::shared_ptr<Connection>> _connections;
-  std::vector<std::shared_ptr<Connection>> _expired;
+  std::vector<std::shared_ptr<BaseConnection>> _connections;
+  std::vector<std::shared_ptr<BaseConnection>> _expired;
   std::atomic_int _error_code = { 0 };
   std::atomic_uint16_t _listen_port = { 0 };
   std::atomic_bool _running = { false };
   std::atomic_bool _quit_flag = { false };
   mutable Lock _connection_lock;
+  /// Signalled with @c _connection_lock on new connections and when the monitor thread starts or
+  /// stops.
+  std::condition_variable _connection_signal;
   std::unique_ptr<std::thread> _thread;
+  /// Rings awaiting a viewer. See @c openSharedMemory() . Guarded by @c _connection_lock .
+  std::vector<std::unique_ptr<SharedMemoryRing>> _shm_listeners;
+  /// Set while there are @c _shm_listeners , which must be polled for viewers.
+  std::atomic_bool _have_shm_listeners = { false };
 };
 }  // namespace tes
 
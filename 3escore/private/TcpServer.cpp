@@ -3,11 +3,20 @@
 //
 #include "TcpServer.h"
 
+#include "CompressionPool.h"
+#include "ResourceCache.h"
+#include "SceneStateCache.h"
+#include "ShapeSubmitQueue.h"
+#include "SharedPacketBuffer.h"
 #include "TcpConnection.h"
 #include "TcpConnectionMonitor.h"
 
+#include <3escore/CoreUtil.h>
+#include <3escore/Messages.h>
 #include <3escore/PacketWriter.h>
 
+#include <3escore/shapes/Shape.h>
+
 #include <algorithm>
 #include <mutex>
 
@@ -26,6 +35,28 @@ TcpServer::TcpServer(const ServerSettings &settings, const ServerInfoMessage *se
   , _active(true)
 {
   _monitor = std::make_shared<TcpConnectionMonitor>(*this);
+  if (settings.compression_threads && (settings.flags & SFCollate))
+  {
+    _compression_pool = std::make_shared<CompressionPool>(settings.compression_threads);
+  }
+  _encode_buffer.resize(settings.client_buffer_size);
+  _encode_packet = std::make_unique<PacketWriter>(_encode_buffer.data(),
+                                                  int_cast<uint16_t>(_encode_buffer.size()));
+  _encode_packet->setLittleEndian((settings.flags & SFLittleEndian) != 0);
+  if (settings.flags & SFResourceCache)
+  {
+    _resource_cache = std::make_shared<ResourceCache>(settings.resource_cache_limit);
+  }
+  if (settings.flags & SFRetainState)
+  {
+    _state_cache =
+      std::make_unique<SceneStateCache>(settings.retained_state_limit, _resource_cache);
+  }
+  if (settings.flags & SFMultiProducer)
+  {
+    _submit_queue = std::make_unique<ShapeSubmitQueue>(settings.client_buffer_size,
+                                                       (settings.flags & SFLittleEndian) != 0);
+  }
 
   if (server_info)
   {
@@ -35,6 +66,16 @@ TcpServer::TcpServer(const ServerSettings &settings, const ServerInfoMessage *se
   {
     initDefaultServerInfo(&_server_info);
   }
+
+  if ((settings.flags & SFCompressionDictionary) && (settings.flags & SFCompress))
+  {
+    _server_info.flags |= SIFCompressionDictionary;
+  }
+
+  if (settings.flags & SFLittleEndian)
+  {
+    _server_info.flags |= SIFLittleEndian;
+  }
 }
 
 
@@ -99,12 +140,35 @@ int TcpServer::create(const Shape &shape)
     return 0;
   }
 
+  if (_submit_queue)
+  {
+    // Deferred until updateFrame(). Retained state requires submission without connections.
+    return (_connection_count || _state_cache) ? _submit_queue->create(shape) : 0;
+  }
+
   const std::lock_guard<Lock> guard(_lock);
+  if (_connections.empty() && !_state_cache)
+  {
+    return 0;
+  }
+
+  // Encode once, then share the packets with all connections.
+  auto encoded = acquireEncodeBuffer();
+  if (!encoded->encodeCreate(shape, *_encode_packet))
+  {
+    return -1;
+  }
+
+  if (_state_cache)
+  {
+    retainCreate(shape, *encoded);
+  }
+
   int transferred = 0;
   bool error = false;
   for (const auto &con : _connections)
   {
-    const int txc = con->create(shape);
+    const int txc = con->create(shape, encoded);
     if (txc >= 0)
     {
       transferred += txc;
@@ -126,12 +190,35 @@ int TcpServer::destroy(const Shape &shape)
     return 0;
   }
 
+  if (_submit_queue)
+  {
+    // Deferred until updateFrame(). Retained state requires submission without connections.
+    return (_connection_count || _state_cache) ? _submit_queue->destroy(shape) : 0;
+  }
+
   const std::lock_guard<Lock> guard(_lock);
+  if (_connections.empty() && !_state_cache)
+  {
+    return 0;
+  }
+
+  // Encode once, then share the packets with all connections.
+  auto encoded = acquireEncodeBuffer();
+  if (!encoded->encodeDestroy(shape, *_encode_packet))
+  {
+    return -1;
+  }
+
+  if (_state_cache)
+  {
+    _state_cache->destroy(shape.routingId(), shape.id());
+  }
+
   int transferred = 0;
   bool error = false;
   for (const auto &con : _connections)
   {
-    const int txc = con->destroy(shape);
+    const int txc = con->destroy(shape, encoded);
     if (txc >= 0)
     {
       transferred += txc;
@@ -153,12 +240,36 @@ int TcpServer::update(const Shape &shape)
     return 0;
   }
 
+  if (_submit_queue)
+  {
+    // Deferred until updateFrame(). Retained state requires submission without connections.
+    return (_connection_count || _state_cache) ? _submit_queue->update(shape) : 0;
+  }
+
   const std::lock_guard<Lock> guard(_lock);
+  if (_connections.empty() && !_state_cache)
+  {
+    return 0;
+  }
+
+  // Encode once, then share the packets with all connections.
+  auto encoded = acquireEncodeBuffer();
+  if (!encoded->encodeUpdate(shape, *_encode_packet))
+  {
+    return -1;
+  }
+
+  if (_state_cache)
+  {
+    _state_cache->update(shape.routingId(), shape.id(), shape.flags(), *encoded, 0,
+                         encoded->packetCount());
+  }
+
   int transferred = 0;
   bool error = false;
   for (const auto &con : _connections)
   {
-    const int txc = con->update(shape);
+    const int txc = con->update(encoded);
     if (txc >= 0)
     {
       transferred += txc;
@@ -183,6 +294,12 @@ int TcpServer::updateFrame(float dt, bool flush)
   std::unique_lock<Lock> guard(_lock);
   int transferred = 0;
   bool error = false;
+  if (_submit_queue)
+  {
+    // Deliver shape messages submitted since the last frame before ending the frame.
+    error = !deliverSubmitted(transferred);
+  }
+
   for (const auto &con : _connections)
   {
     const int txc = con->updateFrame(dt, flush);
@@ -256,6 +373,11 @@ unsigned TcpServer::referenceResource(const ResourcePtr &resource)
   }
 
   const std::lock_guard<Lock> guard(_lock);
+  if (_state_cache)
+  {
+    _state_cache->referenceResource(resource);
+  }
+
   unsigned last_count = 0;
   for (const auto &con : _connections)
   {
@@ -273,6 +395,11 @@ unsigned TcpServer::releaseResource(const ResourcePtr &resource)
   }
 
   const std::lock_guard<Lock> guard(_lock);
+  if (_state_cache)
+  {
+    _state_cache->releaseResource(resource);
+  }
+
   unsigned last_count = 0;
   for (const auto &con : _connections)
   {
@@ -282,6 +409,23 @@ unsigned TcpServer::releaseResource(const ResourcePtr &resource)
 }
 
 
+bool TcpServer::setResourcePriority(const ResourcePtr &resource, int priority)
+{
+  if (!_active)
+  {
+    return false;
+  }
+
+  const std::lock_guard<Lock> guard(_lock);
+  bool set = false;
+  for (const auto &con : _connections)
+  {
+    set = con->setResourcePriority(resource, priority) || set;
+  }
+  return set;
+}
+
+
 int TcpServer::send(const PacketWriter &packet, bool allow_collation)
 {
   return send(packet.data(), packet.packetSize(), allow_collation);
@@ -334,6 +478,29 @@ int TcpServer::send(const uint8_t *data, int byte_count, bool allow_collation)
 }
 
 
+bool TcpServer::retainedStateStats(RetainedStateStats &stats) const
+{
+  const std::lock_guard<Lock> guard(_lock);
+  if (_state_cache)
+  {
+    _state_cache->stats(stats);
+    return true;
+  }
+  return false;
+}
+
+
+bool TcpServer::resourceCacheStats(ResourceCacheStats &stats) const
+{
+  if (_resource_cache)
+  {
+    _resource_cache->stats(stats);
+    return true;
+  }
+  return false;
+}
+
+
 std::shared_ptr<ConnectionMonitor> TcpServer::connectionMonitor()
 {
   return _monitor;
@@ -369,7 +536,7 @@ std::shared_ptr<const Connection> TcpServer::connection(unsigned index) const
 }
 
 
-void TcpServer::updateConnections(const std::vector<std::shared_ptr<Connection>> &connections,
+void TcpServer::updateConnections(const std::vector<std::shared_ptr<BaseConnection>> &connections,
                                   const std::function<void(Server &, Connection &)> &callback)
 {
   if (!_active)
@@ -378,7 +545,7 @@ void TcpServer::updateConnections(const std::vector<std::shared_ptr<Connection>>
   }
 
   const std::lock_guard<Lock> guard(_lock);
-  std::vector<std::shared_ptr<Connection>> new_connections;
+  std::vector<std::shared_ptr<BaseConnection>> new_connections;
 
   if (!connections.empty())
   {
@@ -404,16 +571,111 @@ void TcpServer::updateConnections(const std::vector<std::shared_ptr<Connection>>
 
   _connections.clear();
   std::for_each(connections.begin(), connections.end(),
-                [this](const std::shared_ptr<Connection> &con) { _connections.push_back(con); });
+                [this](const std::shared_ptr<BaseConnection> &con) {
+                  _connections.push_back(con);
+                });
+  _connection_count = static_cast<unsigned>(_connections.size());
 
   // Send server info to new connections.
   for (const auto &con : new_connections)
   {
     con->sendServerInfo(_server_info);
+    if (_state_cache)
+    {
+      // Bring the late joiner up to date before the callback adds any new state.
+      _state_cache->snapshot(*con);
+    }
     if (callback)
     {
       (callback)(*this, *con);
     }
   }
 }
+
+
+std::shared_ptr<SharedPacketBuffer> TcpServer::acquireEncodeBuffer()
+{
+  // Connections may retain the buffer beyond the send call. Only reuse it when we hold the sole
+  // reference.
+  if (!_encoded || _encoded.use_count() > 1)
+  {
+    _encoded = std::make_shared<SharedPacketBuffer>();
+  }
+  return _encoded;
+}
+
+
+bool TcpServer::deliverSubmitted(int &transferred)
+{
+  bool ok = true;
+  _submit_queue->collect(_submitted);
+  for (const auto &batch : _submitted)
+  {
+    for (const auto &message : batch->messages)
+    {
+      if (_state_cache)
+      {
+        retainSubmitted(*batch, message);
+      }
+
+      for (const auto &con : _connections)
+      {
+        const int txc = con->submit(*batch, message);
+        if (txc >= 0)
+        {
+          transferred += txc;
+        }
+        else
+        {
+          ok = false;
+        }
+      }
+    }
+  }
+  _submit_queue->recycle(_submitted);
+  return ok;
+}
+
+
+void TcpServer::retainCreate(const Shape &shape, const SharedPacketBuffer &encoded)
+{
+  if (shape.isTransient())
+  {
+    return;
+  }
+
+  _resource_buffer.clear();
+  if (!shape.skipResources())
+  {
+    shape.enumerateResources(_resource_buffer);
+  }
+  _state_cache->create(shape.routingId(), shape.id(), encoded, 0, encoded.packetCount(),
+                       _resource_buffer.data(), _resource_buffer.size());
+  // clear buffer to avoid holding references.
+  _resource_buffer.clear();
+}
+
+
+void TcpServer::retainSubmitted(const SubmitBatch &batch, const SubmittedMessage &message)
+{
+  switch (message.type)
+  {
+  case SubmittedMessage::Create:
+    if (!message.transient)
+    {
+      _state_cache->create(message.routing_id, message.shape_id, batch.packets,
+                           message.first_packet, message.packet_count,
+                           batch.resources.data() + message.first_resource,
+                           message.resource_count);
+    }
+    break;
+  case SubmittedMessage::Update:
+    _state_cache->update(message.routing_id, message.shape_id, message.shape_flags,
+                         batch.packets, message.first_packet, message.packet_count);
+    break;
+  case SubmittedMessage::Destroy:
+    _state_cache->destroy(message.routing_id, message.shape_id);
+    break;
+  }
+}
 }  // namespace tes
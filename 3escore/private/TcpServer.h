@@ -11,12 +11,21 @@
 
 #include <atomic>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <vector>
 
 namespace tes
 {
 class BaseConnection;
+class CompressionPool;
+class PacketWriter;
+class ResourceCache;
+class ShapeSubmitQueue;
+class SceneStateCache;
+class SharedPacketBuffer;
+struct SubmitBatch;
+struct SubmittedMessage;
 class TcpConnectionMonitor;
 class TcpListenSocket;
 class TcpServer;
@@ -32,6 +41,14 @@ public:
 
   const ServerSettings &settings() const { return _settings; }
 
+  /// Access the worker pool used to finalise collated packets for connections.
+  /// @return The compression pool, or null when @c ServerSettings::compression_threads is zero.
+  const std::shared_ptr<CompressionPool> &compressionPool() const { return _compression_pool; }
+
+  /// Access the encoded resource cache shared by connections.
+  /// @return The resource cache, or null without @c SFResourceCache .
+  const std::shared_ptr<ResourceCache> &resourceCache() const { return _resource_cache; }
+
   unsigned flags() const final;
 
   /// Close all connections and stop listening for new connections.
@@ -73,6 +90,12 @@ public:
   /// @return The count from the last connection.
   unsigned releaseResource(const ResourcePtr &resource) final;
 
+  /// Override
+  /// @param resource The resource to prioritise.
+  /// @param priority The priority value.
+  /// @return True if any connection is awaiting transfer of @p resource .
+  bool setResourcePriority(const ResourcePtr &resource, int priority) final;
+
   /// Ignored. Controlled by this class.
   /// @param info Ignored.
   /// @return False.
@@ -82,6 +105,9 @@ public:
   int send(const CollatedPacket &collated) final;
   int send(const uint8_t *data, int byte_count, bool allow_collation) final;
 
+  bool retainedStateStats(RetainedStateStats &stats) const final;
+  bool resourceCacheStats(ResourceCacheStats &stats) const final;
+
   std::shared_ptr<ConnectionMonitor> connectionMonitor() final;
   unsigned connectionCount() const final;
   std::shared_ptr<Connection> connection(unsigned index) final;
@@ -89,13 +115,61 @@ public:
 
   /// Updates the internal connections list to the given one.
   /// Intended only for use by the @c ConnectionMonitor.
-  void updateConnections(const std::vector<std::shared_ptr<Connection>> &connections,
+  void updateConnections(const std::vector<std::shared_ptr<BaseConnection>> &connections,
                          const std::function<void(Server &, Connection &)> &callback);
 
 private:
+  /// Acquire a @c SharedPacketBuffer to encode the next shape message into.
+  ///
+  /// Reuses the previous buffer unless a connection still holds a reference to it.
+  ///
+  /// Note: the @c _lock must be locked before calling this function.
+  /// @return A buffer ready for encoding.
+  std::shared_ptr<SharedPacketBuffer> acquireEncodeBuffer();
+
+  /// Deliver messages from the @c _submit_queue to all connections.
+  ///
+  /// Note: the @c _lock must be locked before calling this function.
+  /// @param[in,out] transferred Incremented by the number of bytes written.
+  /// @return True on success, false if any connection failed.
+  bool deliverSubmitted(int &transferred);
+
+  /// Retain the create message for @p shape in the @c _state_cache .
+  ///
+  /// Note: the @c _lock must be locked before calling this function.
+  /// @param shape The shape being created.
+  /// @param encoded The encoded create message for @p shape .
+  void retainCreate(const Shape &shape, const SharedPacketBuffer &encoded);
+
+  /// Retain a message from the @c _submit_queue in the @c _state_cache .
+  ///
+  /// Note: the @c _lock must be locked before calling this function.
+  /// @param batch The batch containing @p message .
+  /// @param message The submitted message.
+  void retainSubmitted(const SubmitBatch &batch, const SubmittedMessage &message);
+
   mutable Lock _lock;
-  std::vector<std::shared_ptr<Connection>> _connections;
+  std::vector<std::shared_ptr<BaseConnection>> _connections;
+  /// Scratch buffer for @c _encode_packet .
+  std::vector<uint8_t> _encode_buffer;
+  /// Packet writer used to encode shape messages once for all connections.
+  std::unique_ptr<PacketWriter> _encode_packet;
+  /// The last buffer shape messages were encoded into. See @c acquireEncodeBuffer() .
+  std::shared_ptr<SharedPacketBuffer> _encoded;
   std::shared_ptr<TcpConnectionMonitor> _monitor;
+  std::shared_ptr<CompressionPool> _compression_pool;
+  /// Encoded resource cache shared by connections with @c SFResourceCache .
+  std::shared_ptr<ResourceCache> _resource_cache;
+  /// Concurrent shape message submission for @c SFMultiProducer .
+  std::unique_ptr<ShapeSubmitQueue> _submit_queue;
+  /// Batches collected from the @c _submit_queue . Retained to reuse the allocation.
+  std::vector<std::unique_ptr<SubmitBatch>> _submitted;
+  /// Retained scene state for late joining connections with @c SFRetainState .
+  std::unique_ptr<SceneStateCache> _state_cache;
+  /// Buffer used when calling @c Shape::enumerateResources() . Use is transient.
+  std::vector<Connection::ResourcePtr> _resource_buffer;
+  /// Number of @c _connections , readable without the @c _lock .
+  std::atomic_uint _connection_count = { 0 };
   ServerSettings _settings;
   ServerInfoMessage _server_info;
   std::atomic_bool _active;
@@ -10,8 +10,12 @@
 #include <QTcpServer>
 #include <QTcpSocket>
 
+#include <atomic>
+
 namespace tes
 {
+class TcpListenSocket;
+
 struct TcpSocketDetail
 {
   std::unique_ptr<QTcpSocket> socket;
@@ -24,6 +28,12 @@ struct TcpListenSocketDetail
 {
   QTcpServer listen_socket;
 };
+
+struct TcpPollerDetail
+{
+  const TcpListenSocket *listen_socket = nullptr;
+  std::atomic_bool woken = { false };
+};
 }  // namespace tes
 
 #endif  // TES_CORE_QT_TCP_DETAIL_H
@@ -0,0 +1,94 @@
+//
+// author: Kazys Stepanas
+//
+#include <3escore/TcpPoller.h>
+
+#include <3escore/TcpListenSocket.h>
+#include <3escore/TcpSocket.h>
+
+#include "TcpDetail.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace tes;
+
+namespace
+{
+/// Longest sleep in @c TcpPoller::wait() before checking for @c TcpPoller::wake() .
+constexpr unsigned kSliceMs = 50;
+}  // namespace
+
+
+TcpPoller::TcpPoller()
+  : _detail(std::make_unique<TcpPollerDetail>())
+{}
+
+
+TcpPoller::~TcpPoller() = default;
+
+
+bool TcpPoller::eventDriven() const
+{
+  return false;
+}
+
+
+bool TcpPoller::setListenSocket(const TcpListenSocket *socket)
+{
+  if (socket && !socket->isListening())
+  {
+    return false;
+  }
+  _detail->listen_socket = socket;
+  return true;
+}
+
+
+bool TcpPoller::watch(const std::shared_ptr<TcpSocket> &socket)
+{
+  // QTcpSocket tracks its own state.
+  (void)socket;
+  return false;
+}
+
+
+size_t TcpPoller::watchCount() const
+{
+  return 0;
+}
+
+
+unsigned TcpPoller::wait(unsigned timeout_ms)
+{
+  // Sleep then report a possible connection. TcpListenSocket::accept() resolves whether there is
+  // one.
+  const auto start_time = std::chrono::steady_clock::now();
+  unsigned elapsed_ms = 0;
+  while (elapsed_ms < timeout_ms)
+  {
+    if (_detail->woken.exchange(false))
+    {
+      return PEWake;
+    }
+    const unsigned slice_ms = std::min(timeout_ms - elapsed_ms, kSliceMs);
+    std::this_thread::sleep_for(std::chrono::milliseconds(slice_ms));
+    elapsed_ms = static_cast<unsigned>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                         std::chrono::steady_clock::now() - start_time)
+                                         .count());
+  }
+
+  if (_detail->woken.exchange(false))
+  {
+    return PEWake;
+  }
+
+  return (_detail->listen_socket) ? PEConnection : PENone;
+}
+
+
+void TcpPoller::wake()
+{
+  _detail->woken = true;
+}
@@ -85,6 +85,19 @@ bool TcpSocket::noDelay() const
 }
 
 
+void TcpSocket::setCork(bool cork)
+{
+  // Not supported.
+  (void)cork;
+}
+
+
+bool TcpSocket::cork() const
+{
+  return false;
+}
+
+
 void TcpSocket::setReadTimeout(unsigned timeout_ms)
 {
   _detail->read_timeout = timeout_ms;
@@ -182,6 +195,25 @@ int TcpSocket::readAvailable(char *buffer, int bufferLength) const
 }
 
 
+bool TcpSocket::waitReadable(unsigned timeout_ms) const
+{
+  if (!_detail->socket)
+  {
+    return false;
+  }
+
+  // Report a closed socket as readable to match the native implementation: readAvailable()
+  // fails without blocking.
+  if (_detail->socket->bytesAvailable() > 0 || !isConnected())
+  {
+    return true;
+  }
+
+  const int timeout = (timeout_ms != IndefiniteTimeout) ? static_cast<int>(timeout_ms) : -1;
+  return _detail->socket->waitForReadyRead(timeout) || !isConnected();
+}
+
+
 int TcpSocket::write(const char *buffer, int bufferLength) const
 {
   if (!_detail->socket)
@@ -215,6 +247,23 @@ int TcpSocket::write(const char *buffer, int bufferLength) const
 }
 
 
+int TcpSocket::writev(const BufferSegment *segments, unsigned segment_count) const
+{
+  // QTcpSocket buffers writes internally so write each segment in turn.
+  int total_written = 0;
+  for (unsigned i = 0; i < segment_count; ++i)
+  {
+    const int wrote = write(segments[i].data, static_cast<int>(segments[i].byte_count));
+    if (wrote < 0)
+    {
+      return -1;
+    }
+    total_written += wrote;
+  }
+  return total_written;
+}
+
+
 uint16_t TcpSocket::port() const
 {
   return _detail->socket ? _detail->socket->localPort() : 0;
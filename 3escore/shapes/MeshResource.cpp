@@ -270,6 +270,16 @@ int MeshResource::transfer(PacketWriter &packet, unsigned byte_limit,
 }
 
 
+uint64_t MeshResource::estimateTransferSize() const
+{
+  const auto stream_bytes = [](const DataBuffer &stream) {
+    return static_cast<uint64_t>(stream.addressableCount()) * stream.primitiveTypeSize();
+  };
+  return stream_bytes(vertices()) + stream_bytes(indices()) + stream_bytes(normals()) +
+         stream_bytes(colours()) + stream_bytes(uvs());
+}
+
+
 bool MeshResource::readCreate(PacketReader &packet)
 {
   MeshCreateMessage msg;
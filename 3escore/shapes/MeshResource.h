@@ -146,6 +146,10 @@ public:
   int transfer(PacketWriter &packet, unsigned byte_limit,
                TransferProgress &progress) const override;
 
+  /// Estimate the transfer size from the byte size of each data stream.
+  /// @return The approximate number of data bytes to transfer.
+  [[nodiscard]] uint64_t estimateTransferSize() const override;
+
   bool readCreate(PacketReader &packet) override;
 
   // Must peek the mesh_id before calling this method. Mesh id must match this object.
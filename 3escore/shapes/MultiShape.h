@@ -14,6 +14,7 @@
 #include <3escore/V3Arg.h>
 
 #include <algorithm>
+#include <utility>
 
 namespace tes
 {
@@ -3,6 +3,7 @@ list(APPEND PUBLIC_HEADERS
   # General headers
   AssertRange.h
   Bounds.h
+  BufferSegment.h
   CollatedPacket.h
   CollatedPacketDecoder.h
   Colour.h
@@ -18,6 +19,7 @@ list(APPEND PUBLIC_HEADERS
   Feature.h
   IntArg.h
   Log.h
+  MappedFile.h
   Maths.h
   MathsManip.h
   MathsStream.h
@@ -47,8 +49,11 @@ list(APPEND PUBLIC_HEADERS
   ServerApi.h
   ServerApiMinimal.h
   ServerUtil.h
+  SharedMemoryReader.h
+  SharedMemoryRing.h
   StreamUtil.h
   TcpListenSocket.h
+  TcpPoller.h
   TcpSocket.h
   Throw.h
   Timer.h
@@ -112,6 +117,7 @@ list(APPEND SOURCES
   Exception.cpp
   Feature.cpp
   Log.cpp
+  MappedFile.cpp
   MathsManip.cpp
   Matrix3.cpp
   Matrix4.cpp
@@ -130,6 +136,8 @@ list(APPEND SOURCES
   Rotation.cpp
   ServerApi.cpp
   ServerApiOff.cpp
+  SharedMemoryReader.cpp
+  SharedMemoryRing.cpp
   StreamUtil.cpp
   Throw.cpp
   Timer.cpp
@@ -170,12 +178,32 @@ list(APPEND SOURCES
 )
 
 list(APPEND PRIVATE_SOURCES
+  private/AsyncSendQueue.cpp
+  private/AsyncSendQueue.h
   private/BaseConnection.cpp
   private/BaseConnection.h
+  private/BufferedFileWriter.cpp
+  private/BufferedFileWriter.h
+  private/CollatedPacketCodec.cpp
+  private/CollatedPacketCodec.h
   private/CollatedPacketZip.cpp
   private/CollatedPacketZip.h
+  private/CompressionPool.cpp
+  private/CompressionPool.h
   private/FileConnection.cpp
   private/FileConnection.h
+  private/ResourceCache.cpp
+  private/ResourceCache.h
+  private/ResourceScheduler.cpp
+  private/ResourceScheduler.h
+  private/SceneStateCache.cpp
+  private/SceneStateCache.h
+  private/ShapeSubmitQueue.cpp
+  private/ShapeSubmitQueue.h
+  private/SharedPacketBuffer.cpp
+  private/SharedPacketBuffer.h
+  private/ShmConnection.cpp
+  private/ShmConnection.h
   private/TcpConnection.cpp
   private/TcpConnection.h
   private/TcpConnectionMonitor.cpp
@@ -203,6 +231,7 @@ if(TES_SOCKETS STREQUAL "custom")
   list(APPEND PRIVATE_SOURCES
     tcp/TcpBase.cpp
     tcp/TcpListenSocket.cpp
+    tcp/TcpPoller.cpp
     tcp/TcpSocket.cpp
   )
 elseif(TES_SOCKETS STREQUAL "Qt")
@@ -212,6 +241,7 @@ elseif(TES_SOCKETS STREQUAL "Qt")
 
   list(APPEND PRIVATE_SOURCES
     qt/TcpListenSocket.cpp
+    qt/TcpPoller.cpp
     qt/TcpSocket.cpp
   )
 endif()
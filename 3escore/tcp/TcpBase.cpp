@@ -496,6 +496,37 @@ bool noDelay(int socket)
 }
 
 
+void setCork(int socket, bool cork)
+{
+#if defined(TCP_CORK)
+  IntVal opt_val = (cork) ? 1 : 0;
+  ::setsockopt(socket, IPPROTO_TCP, TCP_CORK, reinterpret_cast<char *>(&opt_val), sizeof(opt_val));
+#elif defined(TCP_NOPUSH)
+  IntVal opt_val = (cork) ? 1 : 0;
+  ::setsockopt(socket, IPPROTO_TCP, TCP_NOPUSH, reinterpret_cast<char *>(&opt_val),
+               sizeof(opt_val));
+#else   // TCP_CORK
+  TES_UNUSED(socket);
+  TES_UNUSED(cork);
+#endif  // TCP_CORK
+}
+
+bool cork(int socket)
+{
+  IntVal opt_val = 0;
+#if defined(TCP_CORK)
+  socklen_t len = sizeof(opt_val);
+  ::getsockopt(socket, IPPROTO_TCP, TCP_CORK, reinterpret_cast<char *>(&opt_val), &len);
+#elif defined(TCP_NOPUSH)
+  socklen_t len = sizeof(opt_val);
+  ::getsockopt(socket, IPPROTO_TCP, TCP_NOPUSH, reinterpret_cast<char *>(&opt_val), &len);
+#else   // TCP_CORK
+  TES_UNUSED(socket);
+#endif  // TCP_CORK
+  return opt_val != 0;
+}
+
+
 bool checkSend(int socket, int ret)
 {
   TES_UNUSED(socket);
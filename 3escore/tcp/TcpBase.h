@@ -38,6 +38,10 @@ void TES_CORE_API setNoDelay(int socket, bool no_delay);
 
 bool TES_CORE_API noDelay(int socket);
 
+void TES_CORE_API setCork(int socket, bool cork);
+
+bool TES_CORE_API cork(int socket);
+
 bool TES_CORE_API checkSend(int socket, int ret);
 
 bool TES_CORE_API checkRecv(int socket, int ret);
@@ -17,14 +17,25 @@ using socklen_t = int;  // NOLINT(readability-identifier-naming)
 #include <sys/time.h>
 #endif
 
+#include <atomic>
 #include <cstring>
+#include <memory>
+#include <unordered_map>
 
 namespace tes
 {
+class TcpSocket;
+
 struct TcpSocketDetail
 {
-  int socket = -1;
+  /// The socket descriptor or -1. Atomic as a @c TcpPoller checks for local closure from the
+  /// monitor thread.
+  std::atomic_int socket = { -1 };
   sockaddr_in address = {};
+  /// Set while liveness is tracked by a @c TcpPoller .
+  std::atomic_bool watched = { false };
+  /// Set by a @c TcpPoller on disconnection, or when a write finds the peer has disconnected.
+  std::atomic_bool hangup = { false };
 };
 
 struct TcpListenSocketDetail
@@ -32,6 +43,20 @@ struct TcpListenSocketDetail
   int listen_socket = -1;
   struct sockaddr_in address = {};
 };
+
+struct TcpPollerDetail
+{
+  /// The epoll descriptor, or -1 where unsupported.
+  int epoll = -1;
+  /// Event descriptor used to wake @c epoll_wait() .
+  int wake_event = -1;
+  /// The listen socket descriptor or -1.
+  int listen_socket = -1;
+  /// Wake flag used when @c epoll is unsupported.
+  std::atomic_bool woken = { false };
+  /// Watched sockets.
+  std::unordered_map<const TcpSocket *, std::shared_ptr<TcpSocket>> sockets;
+};
 }  // namespace tes
 
 #endif  // TES_CORE_TCP_TCP_DETAIL_H
@@ -0,0 +1,276 @@
+//
+// author: Kazys Stepanas
+//
+#include <3escore/TcpPoller.h>
+
+#include <3escore/TcpListenSocket.h>
+#include <3escore/TcpSocket.h>
+
+#include "TcpBase.h"
+#include "TcpDetail.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <limits>
+#include <thread>
+
+#ifdef __linux__
+#define TES_TCP_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif  // __linux__
+
+namespace tes
+{
+namespace
+{
+#ifdef TES_TCP_EPOLL
+constexpr int kMaxEvents = 32;
+#endif  // TES_TCP_EPOLL
+/// Longest single @c select() call in the fallback @c TcpPoller::wait() before checking for
+/// @c TcpPoller::wake() .
+constexpr unsigned kFallbackSliceMs = 50;
+}  // namespace
+
+
+TcpPoller::TcpPoller()
+  : _detail(std::make_unique<TcpPollerDetail>())
+{
+#ifdef TES_TCP_EPOLL
+  _detail->epoll = ::epoll_create1(EPOLL_CLOEXEC);
+  if (_detail->epoll != -1)
+  {
+    _detail->wake_event = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = &_detail->wake_event;
+    if (_detail->wake_event == -1 ||
+        ::epoll_ctl(_detail->epoll, EPOLL_CTL_ADD, _detail->wake_event, &event) != 0)
+    {
+      // Fall back to polling.
+      if (_detail->wake_event != -1)
+      {
+        ::close(_detail->wake_event);
+        _detail->wake_event = -1;
+      }
+      ::close(_detail->epoll);
+      _detail->epoll = -1;
+    }
+  }
+#endif  // TES_TCP_EPOLL
+}
+
+
+TcpPoller::~TcpPoller()
+{
+  // Remaining sockets revert to polling.
+  for (auto &[key, socket] : _detail->sockets)
+  {
+    socket->_detail->watched = false;
+  }
+  _detail->sockets.clear();
+
+#ifdef TES_TCP_EPOLL
+  if (_detail->wake_event != -1)
+  {
+    ::close(_detail->wake_event);
+  }
+  if (_detail->epoll != -1)
+  {
+    ::close(_detail->epoll);
+  }
+#endif  // TES_TCP_EPOLL
+}
+
+
+bool TcpPoller::eventDriven() const
+{
+  return _detail->epoll != -1;
+}
+
+
+bool TcpPoller::setListenSocket(const TcpListenSocket *socket)
+{
+  const int listen_socket = (socket) ? socket->_detail->listen_socket : -1;
+  if (socket && listen_socket == -1)
+  {
+    return false;
+  }
+
+#ifdef TES_TCP_EPOLL
+  if (_detail->epoll != -1)
+  {
+    if (_detail->listen_socket != -1)
+    {
+      // May fail if the socket has already been closed, which implicitly removes it.
+      ::epoll_ctl(_detail->epoll, EPOLL_CTL_DEL, _detail->listen_socket, nullptr);
+    }
+
+    if (listen_socket != -1)
+    {
+      epoll_event event = {};
+      event.events = EPOLLIN;
+      event.data.ptr = &_detail->listen_socket;
+      if (::epoll_ctl(_detail->epoll, EPOLL_CTL_ADD, listen_socket, &event) != 0)
+      {
+        _detail->listen_socket = -1;
+        return false;
+      }
+    }
+  }
+#endif  // TES_TCP_EPOLL
+
+  _detail->listen_socket = listen_socket;
+  return true;
+}
+
+
+bool TcpPoller::watch(const std::shared_ptr<TcpSocket> &socket)
+{
+  if (!socket || socket->_detail->socket == -1 || _detail->epoll == -1)
+  {
+    return false;
+  }
+
+#ifdef TES_TCP_EPOLL
+  // Only watch for disconnection. Any data sent by the peer is left for the socket owner. The
+  // registration is one shot so we never need to remove it: the socket owner may close the
+  // descriptor at any time - which removes it from the epoll set - and the descriptor number may
+  // then be reused.
+  epoll_event event = {};
+  event.events = EPOLLRDHUP | EPOLLONESHOT;
+  event.data.ptr = socket.get();
+  if (::epoll_ctl(_detail->epoll, EPOLL_CTL_ADD, socket->_detail->socket, &event) != 0)
+  {
+    return false;
+  }
+
+  socket->_detail->hangup = false;
+  socket->_detail->watched = true;
+  _detail->sockets[socket.get()] = socket;
+  return true;
+#else   // TES_TCP_EPOLL
+  return false;
+#endif  // TES_TCP_EPOLL
+}
+
+
+size_t TcpPoller::watchCount() const
+{
+  return _detail->sockets.size();
+}
+
+
+unsigned TcpPoller::wait(unsigned timeout_ms)
+{
+  // Release sockets closed locally. Closing a socket implicitly removes it from the epoll set.
+  for (auto iter = _detail->sockets.begin(); iter != _detail->sockets.end();)
+  {
+    if (iter->second->_detail->socket == -1)
+    {
+      iter->second->_detail->watched = false;
+      iter = _detail->sockets.erase(iter);
+    }
+    else
+    {
+      ++iter;
+    }
+  }
+
+  unsigned events = PENone;
+
+#ifdef TES_TCP_EPOLL
+  if (_detail->epoll != -1)
+  {
+    std::array<epoll_event, kMaxEvents> epoll_events = {};
+    const int timeout = static_cast<int>(
+      std::min<unsigned>(timeout_ms, static_cast<unsigned>(std::numeric_limits<int>::max())));
+    const int event_count = ::epoll_wait(_detail->epoll, epoll_events.data(), kMaxEvents, timeout);
+
+    for (int i = 0; i < event_count; ++i)
+    {
+      void *target = epoll_events[i].data.ptr;
+      if (target == &_detail->listen_socket)
+      {
+        events |= PEConnection;
+      }
+      else if (target == &_detail->wake_event)
+      {
+        uint64_t wake_count = 0;
+        while (::read(_detail->wake_event, &wake_count, sizeof(wake_count)) > 0)
+        {
+        }
+        events |= PEWake;
+      }
+      else
+      {
+        auto iter = _detail->sockets.find(static_cast<const TcpSocket *>(target));
+        if (iter != _detail->sockets.end())
+        {
+          // The one shot registration is now disabled and is released when the owner closes the
+          // socket.
+          iter->second->_detail->hangup = true;
+          _detail->sockets.erase(iter);
+          events |= PEHangup;
+        }
+      }
+    }
+
+    return events;
+  }
+#endif  // TES_TCP_EPOLL
+
+  // Fallback: select() on the listen socket in slices, checking the wake flag between slices.
+  const auto start_time = std::chrono::steady_clock::now();
+  unsigned elapsed_ms = 0;
+  do
+  {
+    if (_detail->woken.exchange(false))
+    {
+      return events | PEWake;
+    }
+
+    const unsigned slice_ms = std::min(timeout_ms - elapsed_ms, kFallbackSliceMs);
+    if (_detail->listen_socket != -1)
+    {
+      fd_set fd_read = {};
+      FD_ZERO(&fd_read);
+      FD_SET(_detail->listen_socket, &fd_read);
+      timeval timeout = {};
+      tcpbase::timevalFromMs(timeout, slice_ms);
+      if (::select(_detail->listen_socket + 1, &fd_read, nullptr, nullptr, &timeout) > 0 &&
+          FD_ISSET(_detail->listen_socket, &fd_read))
+      {
+        return events | PEConnection;
+      }
+    }
+    else if (slice_ms)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(slice_ms));
+    }
+
+    elapsed_ms = static_cast<unsigned>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                         std::chrono::steady_clock::now() - start_time)
+                                         .count());
+  } while (elapsed_ms < timeout_ms);
+
+  return events;
+}
+
+
+void TcpPoller::wake()
+{
+#ifdef TES_TCP_EPOLL
+  if (_detail->wake_event != -1)
+  {
+    const uint64_t wake_count = 1;
+    [[maybe_unused]] const auto written =
+      ::write(_detail->wake_event, &wake_count, sizeof(wake_count));
+    return;
+  }
+#endif  // TES_TCP_EPOLL
+  _detail->woken = true;
+}
+}  // namespace tes
@@ -8,6 +8,8 @@
 #include "TcpBase.h"
 #include "TcpDetail.h"
 
+#include <algorithm>
+#include <array>
 #include <cerrno>
 #include <cstdio>
 #include <cstring>
@@ -15,6 +17,8 @@
 
 #ifdef WIN32
 #include <Ws2tcpip.h>
+#else  // WIN32
+#include <sys/uio.h>
 #endif  // WIN32
 
 namespace tes
@@ -61,6 +65,111 @@ const char *socketErrorString(int err)
 
   return "unknown";
 }
+
+
+/// Check if the last send failed because the send buffer is full.
+bool sendWouldBlock(int sent)
+{
+#ifdef WIN32
+  return sent < 0 && WSAGetLastError() == WSAEWOULDBLOCK;
+#else   // WIN32
+  return sent < 0 && errno == EWOULDBLOCK;
+#endif  // WIN32
+}
+
+
+/// Check if the last send failed because the peer has disconnected.
+bool sendDisconnected(int sent)
+{
+#ifdef WIN32
+  const int err = WSAGetLastError();
+  return sent < 0 && (err == WSAECONNRESET || err == WSAECONNABORTED);
+#else   // WIN32
+  return sent < 0 && (errno == ECONNRESET || errno == EPIPE);
+#endif  // WIN32
+}
+
+
+/// Wait briefly for @p socket to become writable after a send would block.
+/// @return A negative value on error.
+int waitForSend(int socket)
+{
+  std::this_thread::yield();
+  fd_set wfds;
+  struct timeval tv;
+  FD_ZERO(&wfds);
+  FD_SET(socket, &wfds);
+
+  tv.tv_sec = 0;
+  tv.tv_usec = 1000;
+
+  return ::select(socket + 1, nullptr, &wfds, nullptr, &tv);
+}
+
+#ifdef WIN32
+using IoVec = WSABUF;
+
+void setIoVec(IoVec &vec, const uint8_t *data, size_t byte_count)
+{
+  vec.buf = const_cast<CHAR *>(reinterpret_cast<const CHAR *>(data));
+  vec.len = static_cast<ULONG>(byte_count);
+}
+
+uint8_t *ioVecData(const IoVec &vec)
+{
+  return reinterpret_cast<uint8_t *>(vec.buf);
+}
+
+size_t ioVecSize(const IoVec &vec)
+{
+  return vec.len;
+}
+
+/// Send @p count buffers from @p vecs with a single call.
+int sendIoVecs(int socket, IoVec *vecs, unsigned count)
+{
+  DWORD sent = 0;
+  if (::WSASend(socket, vecs, count, &sent, 0, nullptr, nullptr) != 0)
+  {
+    return -1;
+  }
+  return static_cast<int>(sent);
+}
+#else   // WIN32
+using IoVec = iovec;
+
+void setIoVec(IoVec &vec, const uint8_t *data, size_t byte_count)
+{
+  vec.iov_base = const_cast<uint8_t *>(data);
+  vec.iov_len = byte_count;
+}
+
+uint8_t *ioVecData(const IoVec &vec)
+{
+  return static_cast<uint8_t *>(vec.iov_base);
+}
+
+size_t ioVecSize(const IoVec &vec)
+{
+  return vec.iov_len;
+}
+
+/// Send @p count buffers from @p vecs with a single call.
+int sendIoVecs(int socket, IoVec *vecs, unsigned count)
+{
+  msghdr msg = {};
+  msg.msg_iov = vecs;
+  msg.msg_iovlen = count;
+  int flags = 0;  // NOLINT(misc-const-correctness)
+#ifdef __linux__
+  flags = MSG_NOSIGNAL;
+#endif  // __linux__
+  return static_cast<int>(::sendmsg(socket, &msg, flags));
+}
+#endif  // WIN32
+
+/// Maximum number of buffers passed to a single scatter-gather send.
+constexpr unsigned kMaxIoVecs = 16;
 }  // namespace
 
 
@@ -88,6 +197,8 @@ bool TcpSocket::open(const char *host, uint16_t port)
   }
 
   _detail->socket = tcpbase::create();
+  _detail->watched = false;
+  _detail->hangup = false;
   _detail->address.sin_family = AF_INET;
   _detail->address.sin_port = htons(port);
 
@@ -127,11 +238,12 @@ bool TcpSocket::open(const char *host, uint16_t port)
 
 void TcpSocket::close()
 {
-  if (_detail->socket != -1)
+  // Clear the descriptor before closing it so a TcpPoller never sees a stale descriptor.
+  const int socket = _detail->socket.exchange(-1);
+  if (socket != -1)
   {
-    tcpbase::close(_detail->socket);
+    tcpbase::close(socket);
     memset(&_detail->address, 0, sizeof(_detail->address));
-    _detail->socket = -1;
   }
 }
 
@@ -143,6 +255,12 @@ bool TcpSocket::isConnected() const
     return false;
   }
 
+  if (_detail->watched)
+  {
+    // Liveness is event driven by a TcpPoller.
+    return !_detail->hangup;
+  }
+
   return tcpbase::isConnected(_detail->socket);
 }
 
@@ -159,6 +277,18 @@ bool TcpSocket::noDelay() const
 }
 
 
+void TcpSocket::setCork(bool cork)
+{
+  tcpbase::setCork(_detail->socket, cork);
+}
+
+
+bool TcpSocket::cork() const
+{
+  return tcpbase::cork(_detail->socket);
+}
+
+
 void TcpSocket::setReadTimeout(unsigned timeout_ms)
 {
   tcpbase::setReceiveTimeout(_detail->socket, timeout_ms);
@@ -292,6 +422,23 @@ int TcpSocket::readAvailable(char *buffer, int buffer_length) const
 }
 
 
+bool TcpSocket::waitReadable(unsigned timeout_ms) const
+{
+  if (_detail->socket == -1)
+  {
+    return false;
+  }
+
+  fd_set rfds;
+  struct timeval tv;
+  FD_ZERO(&rfds);
+  FD_SET(_detail->socket, &rfds);
+  tcpbase::timevalFromMs(tv, timeout_ms);
+
+  return ::select(_detail->socket + 1, &rfds, nullptr, nullptr, &tv) > 0;
+}
+
+
 int TcpSocket::write(const char *buffer, int buffer_length) const
 {
   if (_detail->socket == -1)
@@ -317,23 +464,10 @@ int TcpSocket::write(const char *buffer, int buffer_length) const
       sent = static_cast<int>(::send(_detail->socket,
                                      reinterpret_cast<const char *>(buffer) + bytes_sent,
                                      buffer_length - bytes_sent, flags));
-#ifdef WIN32
-      if (sent < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
-#else   // WIN32
-      if (sent < 0 && errno == EWOULDBLOCK)
-#endif  // WIN32
+      if (sendWouldBlock(sent))
       {
         // Send buffer full. Wait and retry.
-        std::this_thread::yield();
-        fd_set wfds;
-        struct timeval tv;
-        FD_ZERO(&wfds);
-        FD_SET(_detail->socket, &wfds);
-
-        tv.tv_sec = 0;
-        tv.tv_usec = 1000;
-
-        sent = ::select(1, nullptr, &wfds, nullptr, &tv);
+        sent = waitForSend(_detail->socket);
         retry = sent >= 0;
       }
     }
@@ -341,6 +475,11 @@ int TcpSocket::write(const char *buffer, int buffer_length) const
 
     if (sent < 0)
     {
+      if (sendDisconnected(sent))
+      {
+        // Report the disconnection ahead of any TcpPoller.
+        _detail->hangup = true;
+      }
       if (!tcpbase::checkSend(_detail->socket, sent))
       {
         return -1;
@@ -360,6 +499,83 @@ int TcpSocket::write(const char *buffer, int buffer_length) const
 }
 
 
+int TcpSocket::writev(const BufferSegment *segments, unsigned segment_count) const
+{
+  if (_detail->socket == -1)
+  {
+    return -1;
+  }
+
+  int bytes_sent = 0;
+  std::array<IoVec, kMaxIoVecs> vecs;
+  // Send up to kMaxIoVecs segments at a time. Each batch is sent in full before the next.
+  for (unsigned batch_start = 0; batch_start < segment_count; batch_start += kMaxIoVecs)
+  {
+    const unsigned batch_count = std::min(segment_count - batch_start, kMaxIoVecs);
+    unsigned vec_count = 0;
+    for (unsigned i = 0; i < batch_count; ++i)
+    {
+      const BufferSegment &segment = segments[batch_start + i];
+      if (segment.byte_count)
+      {
+        setIoVec(vecs[vec_count++], segment.data, segment.byte_count);
+      }
+    }
+
+    // Send, adjusting the vectors to skip sent bytes after a partial send.
+    IoVec *pending = vecs.data();
+    while (vec_count)
+    {
+      int sent = sendIoVecs(_detail->socket, pending, vec_count);
+      if (sendWouldBlock(sent))
+      {
+        // Send buffer full. Wait and retry.
+        sent = waitForSend(_detail->socket);
+        if (sent >= 0)
+        {
+          continue;
+        }
+      }
+
+      if (sent < 0)
+      {
+        if (sendDisconnected(sent))
+        {
+          // Report the disconnection ahead of any TcpPoller.
+          _detail->hangup = true;
+        }
+        if (!tcpbase::checkSend(_detail->socket, sent))
+        {
+          return -1;
+        }
+        return bytes_sent;
+      }
+
+      if (sent == 0)
+      {
+        return bytes_sent;
+      }
+
+      bytes_sent += sent;
+      auto remaining = static_cast<size_t>(sent);
+      while (vec_count && remaining >= ioVecSize(*pending))
+      {
+        remaining -= ioVecSize(*pending);
+        ++pending;
+        --vec_count;
+      }
+
+      if (remaining)
+      {
+        setIoVec(*pending, ioVecData(*pending) + remaining, ioVecSize(*pending) - remaining);
+      }
+    }
+  }
+
+  return bytes_sent;
+}
+
+
 uint16_t TcpSocket::port() const
 {
   return _detail->address.sin_port;
@@ -0,0 +1,159 @@
+#include "MessageDispatcher.h"
+
+#include "handler/Message.h"
+
+#include <3escore/PacketReader.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace tes::view
+{
+struct MessageDispatcher::Worker
+{
+  std::mutex lock;
+  /// Notified when messages are queued, a queue is taken for reading or reading completes.
+  std::condition_variable notify;
+  /// Messages queued for reading - a sequence of complete packets.
+  std::vector<uint8_t> queue;
+  /// Messages being read. Only accessed by the worker thread.
+  std::vector<uint8_t> reading;
+  bool busy = false;
+  bool quit = false;
+  std::thread thread;
+};
+
+
+MessageDispatcher::MessageDispatcher(unsigned worker_count)
+{
+  worker_count = std::max(worker_count, 1u);
+  _workers.reserve(worker_count);
+  for (unsigned i = 0; i < worker_count; ++i)
+  {
+    _workers.emplace_back(std::make_unique<Worker>());
+  }
+  for (auto &item : _workers)
+  {
+    item->thread = std::thread([this, &worker = *item]() { run(worker); });
+  }
+}
+
+
+MessageDispatcher::~MessageDispatcher()
+{
+  for (auto &worker : _workers)
+  {
+    {
+      const std::lock_guard guard(worker->lock);
+      worker->quit = true;
+    }
+    worker->notify.notify_all();
+  }
+  for (auto &worker : _workers)
+  {
+    worker->thread.join();
+  }
+}
+
+
+void MessageDispatcher::addHandler(const std::shared_ptr<handler::Message> &handler,
+                                   uint16_t share_with)
+{
+  Worker *worker = nullptr;
+  if (share_with != 0)
+  {
+    const auto shared = _routes.find(share_with);
+    if (shared != _routes.end())
+    {
+      worker = shared->second.worker;
+    }
+  }
+
+  if (!worker)
+  {
+    worker = _workers[_next_worker].get();
+    _next_worker = (_next_worker + 1) % workerCount();
+  }
+
+  _routes[handler->routingId()] = Route{ handler, worker };
+}
+
+
+bool MessageDispatcher::hasHandler(uint16_t routing_id) const
+{
+  return _routes.find(routing_id) != _routes.end();
+}
+
+
+bool MessageDispatcher::dispatch(const PacketReader &packet)
+{
+  const auto route = _routes.find(packet.routingId());
+  if (route == _routes.end())
+  {
+    return false;
+  }
+
+  Worker &worker = *route->second.worker;
+  const auto *bytes = reinterpret_cast<const uint8_t *>(&packet.packet());
+  const size_t byte_count = packet.packetSize();
+
+  std::unique_lock guard(worker.lock);
+  // Always allow a message into an empty queue so oversized messages cannot block.
+  worker.notify.wait(guard, [&worker, byte_count]() {
+    return worker.queue.empty() || worker.queue.size() + byte_count <= kMaxQueuedBytes;
+  });
+  worker.queue.insert(worker.queue.end(), bytes, bytes + byte_count);
+  guard.unlock();
+  worker.notify.notify_all();
+  return true;
+}
+
+
+void MessageDispatcher::sync()
+{
+  for (auto &worker : _workers)
+  {
+    std::unique_lock guard(worker->lock);
+    worker->notify.wait(guard, [&worker]() { return worker->queue.empty() && !worker->busy; });
+  }
+}
+
+
+void MessageDispatcher::run(Worker &worker)
+{
+  std::unique_lock guard(worker.lock);
+  while (true)
+  {
+    worker.notify.wait(guard, [&worker]() { return !worker.queue.empty() || worker.quit; });
+    if (worker.queue.empty())
+    {
+      // Quit with all messages read.
+      break;
+    }
+
+    std::swap(worker.queue, worker.reading);
+    worker.busy = true;
+    guard.unlock();
+    // Release any dispatch() blocked on the queue size.
+    worker.notify.notify_all();
+
+    // The routes are not modified while messages are dispatched.
+    size_t cursor = 0;
+    while (cursor < worker.reading.size())
+    {
+      PacketReader packet(reinterpret_cast<const PacketHeader *>(worker.reading.data() + cursor));
+      cursor += packet.packetSize();
+      const auto route = _routes.find(packet.routingId());
+      route->second.handler->readMessage(packet);
+    }
+    worker.reading.clear();
+
+    guard.lock();
+    worker.busy = false;
+    // Release sync().
+    worker.notify.notify_all();
+  }
+}
+}  // namespace tes::view
@@ -0,0 +1,99 @@
+#ifndef TES_VIEW_MESSAGE_DISPATCHER_H
+#define TES_VIEW_MESSAGE_DISPATCHER_H
+
+#include "3esview/ViewConfig.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace tes
+{
+class PacketReader;
+}  // namespace tes
+
+namespace tes::view
+{
+namespace handler
+{
+class Message;
+}  // namespace handler
+
+/// Dispatches messages to @c handler::Message::readMessage() on a pool of worker threads.
+///
+/// Each handler is assigned to a single worker, so messages for a handler are read in the order
+/// they are dispatched. Handlers which share state, such as mesh sets and the mesh resources they
+/// reference, may be assigned to the same worker to preserve ordering between them - see
+/// @c addHandler() . Messages for different workers are read concurrently, so decoding scales with
+/// the number of active handlers.
+///
+/// Dispatched messages are copied into the worker queues, so the caller may release the packet
+/// buffer immediately. The caller must @c sync() before any operation which requires all
+/// dispatched messages to have been read, such as @c handler::Message::endFrame() .
+///
+/// Handlers must be added before dispatching any messages. @c dispatch() and @c sync() must be
+/// called from a single thread.
+class TES_VIEWER_API MessageDispatcher
+{
+public:
+  /// Maximum number of bytes queued for a single worker before @c dispatch() blocks.
+  static constexpr size_t kMaxQueuedBytes = 64u * 1024u * 1024u;
+
+  /// Constructor.
+  /// @param worker_count The number of worker threads to start. Clamped to at least one.
+  MessageDispatcher(unsigned worker_count);
+  /// Destructor. Reads any outstanding messages then joins the worker threads.
+  ~MessageDispatcher();
+
+  MessageDispatcher(const MessageDispatcher &) = delete;
+  MessageDispatcher &operator=(const MessageDispatcher &) = delete;
+
+  /// Query the number of worker threads.
+  /// @return The worker count.
+  [[nodiscard]] unsigned workerCount() const { return static_cast<unsigned>(_workers.size()); }
+
+  /// Add a message handler, assigning it to a worker.
+  ///
+  /// Handlers are assigned to workers in turn, unless @p share_with identifies a handler which
+  /// has already been added. The handler is then assigned to the same worker as @p share_with .
+  ///
+  /// @param handler The handler to add.
+  /// @param share_with Routing ID of a handler to share a worker with. Zero for none.
+  void addHandler(const std::shared_ptr<handler::Message> &handler, uint16_t share_with = 0);
+
+  /// Check if there is a handler for @p routing_id .
+  /// @param routing_id The routing ID to check.
+  /// @return True if a handler has been added for @p routing_id .
+  [[nodiscard]] bool hasHandler(uint16_t routing_id) const;
+
+  /// Queue @p packet for the handler matching its routing ID.
+  ///
+  /// Blocks while the worker has @c kMaxQueuedBytes queued.
+  ///
+  /// @param packet The message to dispatch. The payload is read from the start.
+  /// @return True if queued, false if there is no handler for the routing ID.
+  bool dispatch(const PacketReader &packet);
+
+  /// Block until all dispatched messages have been read.
+  void sync();
+
+private:
+  struct Worker;
+
+  /// Worker thread loop, reading messages for @p worker .
+  void run(Worker &worker);
+
+  struct Route
+  {
+    std::shared_ptr<handler::Message> handler;
+    Worker *worker = nullptr;
+  };
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::unordered_map<uint16_t, Route> _routes;
+  unsigned _next_worker = 0;
+};
+}  // namespace tes::view
+
+#endif  // TES_VIEW_MESSAGE_DISPATCHER_H
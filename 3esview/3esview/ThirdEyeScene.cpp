@@ -73,6 +73,7 @@ ThirdEyeScene::ThirdEyeScene()
 ThirdEyeScene::~ThirdEyeScene()
 {
   // Need an ordered cleanup.
+  _dispatcher = nullptr;
   _messageHandlers.clear();
   _orderedMessageHandlers.clear();
   _painters.clear();
@@ -91,6 +92,7 @@ const std::unordered_map<uint32_t, std::string> ThirdEyeScene::defaultHandlerNam
     { MtCamera, "camera" },
     { MtCategory, "category" },
     { MtMaterial, "material" },
+    { MtFrameIndex, "frame index" },
     { SIdSphere, "sphere" },
     { SIdBox, "box" },
     { SIdCone, "cone" },
@@ -124,8 +126,15 @@ void ThirdEyeScene::clearActiveFboEffect()
 
 void ThirdEyeScene::reset()
 {
+  const bool main_thread = std::this_thread::get_id() == _main_thread_id;
+  if (_dispatcher && !main_thread)
+  {
+    // Messages are dispatched from this thread. Read them before resetting.
+    _dispatcher->sync();
+  }
+
   std::unique_lock lock(_render_mutex);
-  if (std::this_thread::get_id() == _main_thread_id)
+  if (main_thread)
   {
     effectReset();
   }
@@ -215,6 +224,11 @@ void ThirdEyeScene::updateToFrame(FrameNumber frame)
 {
   // Called from the data thread, not the main thread.
   // Must invoke endFrame() between prepareFrame() and draw() calls.
+  if (_dispatcher)
+  {
+    // Read the messages for this frame before ending it.
+    _dispatcher->sync();
+  }
   std::lock_guard guard(_render_mutex);
   if (frame != _render_stamp.frame_number)
   {
@@ -236,14 +250,50 @@ void ThirdEyeScene::updateServerInfo(const ServerInfoMessage &server_info)
 }
 
 
+void ThirdEyeScene::setDecodeThreads(unsigned thread_count)
+{
+  _dispatcher = nullptr;
+  if (thread_count == 0)
+  {
+    return;
+  }
+
+  // Handlers which share state must share a worker to preserve message order between them.
+  // Mesh sets reference mesh resources, while text handlers share the text painter.
+  const std::unordered_map<uint16_t, uint16_t> share_worker = {
+    { SIdMeshSet, MtMesh },
+    { SIdText3D, SIdText2D },
+  };
+
+  _dispatcher = std::make_unique<MessageDispatcher>(thread_count);
+  for (auto &handler : _orderedMessageHandlers)
+  {
+    const auto shared = share_worker.find(handler->routingId());
+    _dispatcher->addHandler(handler, (shared != share_worker.end()) ? shared->second : uint16_t(0));
+  }
+}
+
+
 void ThirdEyeScene::processMessage(PacketReader &packet)
 {
-  auto handler = _messageHandlers.find(packet.routingId());
-  if (handler != _messageHandlers.end())
+  if (_dispatcher)
   {
-    handler->second->readMessage(packet);
+    if (_dispatcher->dispatch(packet))
+    {
+      return;
+    }
   }
-  else if (_unknown_handlers.find(packet.routingId()) == _unknown_handlers.end())
+  else
+  {
+    auto handler = _messageHandlers.find(packet.routingId());
+    if (handler != _messageHandlers.end())
+    {
+      handler->second->readMessage(packet);
+      return;
+    }
+  }
+
+  if (_unknown_handlers.find(packet.routingId()) == _unknown_handlers.end())
   {
     const auto known_ids = defaultHandlerNames();
     const auto search = known_ids.find(packet.routingId());
@@ -260,6 +310,22 @@ void ThirdEyeScene::processMessage(PacketReader &packet)
 }
 
 
+void ThirdEyeScene::serialise(Connection &out)
+{
+  if (_dispatcher)
+  {
+    _dispatcher->sync();
+  }
+  // Lock out rendering as that may effect changes to the handlers.
+  std::lock_guard guard(_render_mutex);
+  ServerInfoMessage info = _server_info;
+  for (auto &handler : _orderedMessageHandlers)
+  {
+    handler->serialise(out, info);
+  }
+}
+
+
 void ThirdEyeScene::createSampleShapes()
 {
   Magnum::Matrix4 shape_transform = {};
@@ -8,6 +8,7 @@
 #include "BoundsCuller.h"
 #include "FramesPerSecondWindow.h"
 #include "FrameStamp.h"
+#include "MessageDispatcher.h"
 #include "painter/ShapeCache.h"
 
 #include <3escore/Messages.h>
@@ -33,6 +34,11 @@
 #include <unordered_set>
 #include <vector>
 
+namespace tes
+{
+class Connection;
+}  // namespace tes
+
 // TODO(KS): abstract away Magnum so it's not in any public headers.
 namespace tes::view
 {
@@ -116,16 +122,49 @@ public:
   /// @param server_info The new server info.
   void updateServerInfo(const ServerInfoMessage &server_info);
 
+  /// Set the number of threads used to read messages.
+  ///
+  /// With a non-zero @p thread_count , @c processMessage() dispatches messages to a
+  /// @c MessageDispatcher which reads messages for different handlers concurrently. Message order
+  /// is preserved for each handler. All dispatched messages are read before @c updateToFrame() ,
+  /// @c serialise() and @c reset() take effect. With zero threads, messages are read on the
+  /// calling thread.
+  ///
+  /// Must not be called while a @c DataThread is processing messages.
+  ///
+  /// @param thread_count The number of message reading threads. Zero to read on the calling
+  /// thread.
+  void setDecodeThreads(unsigned thread_count);
+
+  /// Query the number of threads used to read messages. See @c setDecodeThreads() .
+  /// @return The number of message reading threads. Zero when reading on the calling thread.
+  [[nodiscard]] unsigned decodeThreads() const
+  {
+    return (_dispatcher) ? _dispatcher->workerCount() : 0u;
+  }
+
   /// Process a message from the server. This is routed to the appropriate message handler.
   ///
   /// This function is not called for any control messages where the routing ID is @c MtControl.
   ///
   /// @note Message handling must be thread safe as this method is mostly called from a background
-  /// thread. This constraint is placed on the message handlers.
+  /// thread. This constraint is placed on the message handlers. With @c setDecodeThreads() the
+  /// message is read later, on a dispatcher thread.
   ///
   /// @param packet
   void processMessage(PacketReader &packet);
 
+  /// Serialise a snapshot of the current scene to @p out . This writes the messages required to
+  /// restore the scene state as of the last @c updateToFrame() call via @c processMessage() ,
+  /// using each handler's @c handler::Message::serialise() .
+  ///
+  /// Must be called from the data thread, between frames; i.e., after @c updateToFrame() and
+  /// before processing any messages for the following frame. Threadsafe with respect to
+  /// rendering.
+  ///
+  /// @param out The connection to write the snapshot messages to.
+  void serialise(Connection &out);
+
   void createSampleShapes();
 
 private:
@@ -149,6 +188,8 @@ private:
   std::unordered_map<uint32_t, std::shared_ptr<handler::Message>> _messageHandlers;
   /// Message handers arranged by update order..
   std::vector<std::shared_ptr<handler::Message>> _orderedMessageHandlers;
+  /// Reads messages on worker threads when enabled by @c setDecodeThreads() .
+  std::unique_ptr<MessageDispatcher> _dispatcher;
   /// List of unknown message handlers for which we've raised warnings. Cleared on @c reset().
   std::unordered_set<uint32_t> _unknown_handlers;
 
@@ -5,7 +5,10 @@
 #include "command/DefaultCommands.h"
 #include "command/Set.h"
 
+#include "data/KeyframeStore.h"
 #include "data/NetworkThread.h"
+#include "data/RewindCache.h"
+#include "data/SharedMemoryThread.h"
 #include "data/StreamThread.h"
 
 #include "painter/Arrow.h"
@@ -18,6 +21,7 @@
 #include "painter/Star.h"
 
 #include <3escore/Log.h>
+#include <3escore/PacketStreamReader.h>
 #include <3escore/Server.h>
 
 #include <Magnum/GL/Context.h>
@@ -27,7 +31,6 @@
 #include <Magnum/GL/TextureFormat.h>
 #include <Magnum/GL/Version.h>
 
-#include <fstream>
 #include <iostream>
 
 #include <cxxopts.hpp>
@@ -90,14 +93,27 @@ Viewer::~Viewer()
 bool Viewer::open(const std::filesystem::path &path)
 {
   closeOrDisconnect();
-  std::ifstream file(path.string(), std::ios::binary);
-  if (!file.is_open())
+  // Memory maps the file where supported.
+  auto stream_reader = std::make_unique<PacketStreamReader>();
+  if (!stream_reader->open(path.string()))
   {
     return false;
   }
 
-  _data_thread =
-    std::make_shared<StreamThread>(_tes, std::make_shared<std::ifstream>(std::move(file)));
+  // Keyframes support fast seeking. Playback continues without them when disabled or on failure.
+  std::shared_ptr<KeyframeStore> keyframes;
+  if (_keyframes_enabled)
+  {
+    keyframes = std::make_shared<KeyframeStore>();
+  }
+  if (keyframes && !keyframes->open(path))
+  {
+    log::warn("Unable to open keyframe file for ", path.string(), ". Seeking will be slow.");
+    keyframes = nullptr;
+  }
+
+  _data_thread = std::make_shared<StreamThread>(_tes, std::move(stream_reader),
+                                                std::move(keyframes), createRewindCache());
   _data_thread->setLooping(true);
   return true;
 }
@@ -106,7 +122,8 @@ bool Viewer::open(const std::filesystem::path &path)
 bool Viewer::connect(const std::string &host, uint16_t port, bool allow_reconnect)
 {
   closeOrDisconnect();
-  auto net_thread = std::make_shared<NetworkThread>(_tes, host, port, allow_reconnect);
+  auto net_thread =
+    std::make_shared<NetworkThread>(_tes, host, port, allow_reconnect, createRewindCache());
   _data_thread = net_thread;
   if (!allow_reconnect)
   {
@@ -126,10 +143,38 @@ bool Viewer::connect(const std::string &host, uint16_t port, bool allow_reconnec
 }
 
 
+bool Viewer::connectSharedMemory(const std::string &name, bool allow_reconnect)
+{
+  closeOrDisconnect();
+  auto shm_thread = std::make_shared<SharedMemoryThread>(_tes, name, allow_reconnect);
+  _data_thread = shm_thread;
+  if (!allow_reconnect)
+  {
+    // As for connect(), wait for the first attempt, but not forever.
+    const auto start_time = std::chrono::steady_clock::now();
+    const auto timeout = std::chrono::seconds(5);
+    while (!shm_thread->connectionAttempted() &&
+           (std::chrono::steady_clock::now() - start_time) < timeout)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return shm_thread->connected();
+  }
+  return true;
+}
+
+
 bool Viewer::closeOrDisconnect()
 {
   if (_data_thread)
   {
+    RewindCacheStats rewind_stats;
+    if (_data_thread->rewindCacheStats(rewind_stats))
+    {
+      log::info("Rewind cache hits: ", rewind_stats.hits, " misses: ", rewind_stats.misses,
+                " evictions: ", rewind_stats.evictions);
+    }
     _data_thread->stop();
     _data_thread->join();
     _data_thread = nullptr;
@@ -139,6 +184,16 @@ bool Viewer::closeOrDisconnect()
 }
 
 
+std::shared_ptr<RewindCache> Viewer::createRewindCache() const
+{
+  if (_rewind_cache_limit == 0)
+  {
+    return nullptr;
+  }
+  return std::make_shared<RewindCache>(_rewind_cache_limit);
+}
+
+
 void Viewer::setContinuousSim(bool continuous)
 {
   if (_continuous_sim != continuous)
@@ -481,6 +536,10 @@ Viewer::StartupMode Viewer::parseStartupArgs(const Arguments &arguments, Command
       ("file", "Start the UI and open this file for playback. Takes precedence over --host.", cxxopts::value(opt.filename))
       ("host", "Start the UI and open a connection to this host URL/IP. Use --port to select the port number.", cxxopts::value(opt.host))
       ("port", "The port number to use with --host", cxxopts::value(opt.port)->default_value(std::to_string(opt.port)))
+      ("shm", "Start the UI and attach to a server on this host via this shared memory name. Takes precedence over --host.", cxxopts::value(opt.shm))
+      ("rewind-mb", "Memory budget in MiB for caching frames near the paused frame to step backwards. Zero disables pausing live streams.", cxxopts::value(opt.rewind_mb)->default_value(std::to_string(opt.rewind_mb)))
+      ("no-keyframes", "Do not write a keyframe sidecar file alongside recordings during playback. Seeking will be slow.", cxxopts::value(opt.no_keyframes))
+      ("decode-threads", "Number of threads used to read messages for different handlers concurrently. Zero reads on the data thread.", cxxopts::value(opt.decode_threads)->default_value(std::to_string(opt.decode_threads)))
       ;
     // clang-format on
 
@@ -504,6 +563,11 @@ Viewer::StartupMode Viewer::parseStartupArgs(const Arguments &arguments, Command
     return StartupMode::File;
   }
 
+  if (!opt.shm.empty())
+  {
+    return StartupMode::SharedMemory;
+  }
+
   if (!opt.host.empty())
   {
     return StartupMode::Host;
@@ -517,6 +581,9 @@ bool Viewer::handleStartupArgs(const Arguments &arguments)
 {
   CommandLineOptions opt;
   const auto startup_mode = parseStartupArgs(arguments, opt);
+  setRewindCacheLimit(opt.rewind_mb * 1024u * 1024u);
+  setKeyframesEnabled(!opt.no_keyframes);
+  _tes->setDecodeThreads(opt.decode_threads);
 
   switch (startup_mode)
   {
@@ -533,9 +600,13 @@ bool Viewer::handleStartupArgs(const Arguments &arguments)
     // Extract a port number if possible.
     connect(opt.host, opt.port, true);
     break;
-  default:
+  }
+  case StartupMode::SharedMemory: {
+    connectSharedMemory(opt.shm, true);
     break;
   }
+  default:
+    break;
   }
 
   return true;
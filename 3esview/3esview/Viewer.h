@@ -4,6 +4,7 @@
 #include "3esview/ViewConfig.h"
 
 #include "camera/Fly.h"
+#include "data/RewindCache.h"
 #include "ThirdEyeScene.h"
 
 #include <filesystem>
@@ -43,8 +44,32 @@ public:
 
   bool open(const std::filesystem::path &path);
   bool connect(const std::string &host, uint16_t port, bool allow_reconnect = true);
+  /// Connect to a server on the same host via shared memory. See
+  /// @c ConnectionMonitor::openSharedMemory() .
+  /// @param name The shared memory name opened by the server.
+  /// @param allow_reconnect Allow reattaching on failure or when the server closes.
+  /// @return True on success or when reconnection is allowed.
+  bool connectSharedMemory(const std::string &name, bool allow_reconnect = true);
   bool closeOrDisconnect();
 
+  /// Set the memory budget for the @c RewindCache , used to step backwards. Applies to the next
+  /// @c open() or @c connect() .
+  /// @param byte_limit The budget in bytes. Zero disables the cache, so live streams cannot pause.
+  void setRewindCacheLimit(uint64_t byte_limit) { _rewind_cache_limit = byte_limit; }
+  /// Query the memory budget for the @c RewindCache .
+  /// @return The budget in bytes.
+  uint64_t rewindCacheLimit() const { return _rewind_cache_limit; }
+
+  /// Enable or disable the @c KeyframeStore for file playback. Applies to the next @c open() .
+  ///
+  /// Keyframes support fast seeking, but are persisted in a sidecar file next to the recording.
+  /// Disabling keyframes avoids writing the sidecar at the cost of slower seeking.
+  /// @param enable True to enable keyframes.
+  void setKeyframesEnabled(bool enable) { _keyframes_enabled = enable; }
+  /// Check if the @c KeyframeStore is enabled for file playback.
+  /// @return True when enabled.
+  bool keyframesEnabled() const { return _keyframes_enabled; }
+
   void setContinuousSim(bool continuous);
   bool continuousSim();
 
@@ -61,6 +86,10 @@ private:
     std::string filename;
     std::string host;
     uint16_t port = Viewer::defaultPort();
+    std::string shm;
+    uint64_t rewind_mb = RewindCache::kDefaultByteLimit / (1024u * 1024u);
+    unsigned decode_threads = 0;
+    bool no_keyframes = false;
   };
 
   /// Return values from @c handleStartupArgs() which indicate what how to start.
@@ -75,7 +104,9 @@ private:
     /// Start the UI and open a file.
     File,
     /// Start the UI and open a network connection.
-    Host
+    Host,
+    /// Start the UI and open a shared memory connection.
+    SharedMemory
   };
 
   void drawEvent() override;
@@ -93,6 +124,10 @@ private:
   void checkShortcuts(KeyEvent &event);
   static bool checkShortcut(const command::Shortcut &shortcut, const KeyEvent &event);
 
+  /// Create a @c RewindCache for a new data thread.
+  /// @return The cache, or null when disabled.
+  std::shared_ptr<RewindCache> createRewindCache() const;
+
   StartupMode parseStartupArgs(const Arguments &arguments, CommandLineOptions &opt);
   bool handleStartupArgs(const Arguments &arguments);
 
@@ -110,6 +145,8 @@ private:
   std::shared_ptr<ThirdEyeScene> _tes;
   std::shared_ptr<DataThread> _data_thread;
   std::shared_ptr<command::Set> _commands;
+  uint64_t _rewind_cache_limit = RewindCache::kDefaultByteLimit;
+  bool _keyframes_enabled = true;
 
   Clock::time_point _last_sim_time = Clock::now();
 
@@ -13,7 +13,7 @@ Pause::Pause()
 bool Pause::checkAdmissible(Viewer &viewer) const
 {
   auto stream = viewer.dataThread();
-  return stream != nullptr && !stream->isLiveStream();
+  return stream != nullptr && stream->canPause();
 }
 
 
@@ -13,7 +13,7 @@ SkipBackward::SkipBackward()
 bool SkipBackward::checkAdmissible(Viewer &viewer) const
 {
   auto stream = viewer.dataThread();
-  return stream != nullptr && !stream->isLiveStream() && stream->paused() && stream->currentFrame() > 0;
+  return stream != nullptr && stream->canPause() && stream->paused() && stream->currentFrame() > 0;
 }
 
 
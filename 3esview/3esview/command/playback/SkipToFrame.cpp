@@ -13,7 +13,7 @@ SkipToFrame::SkipToFrame()
 bool SkipToFrame::checkAdmissible(Viewer &viewer) const
 {
   auto stream = viewer.dataThread();
-  return stream != nullptr && !stream->isLiveStream() && stream->paused();
+  return stream != nullptr && stream->canPause() && stream->paused();
 }
 
 
@@ -13,7 +13,8 @@ StepBackward::StepBackward()
 bool StepBackward::checkAdmissible(Viewer &viewer) const
 {
   auto stream = viewer.dataThread();
-  return stream != nullptr && !stream->isLiveStream() && stream->paused() && stream->currentFrame() > 0;
+  return stream != nullptr && stream->canPause() && stream->paused() &&
+         stream->stepBackwardFrame() < stream->currentFrame();
 }
 
 
@@ -27,9 +28,10 @@ CommandResult StepBackward::invoke(Viewer &viewer, const ExecInfo &info, const A
     return { CommandResult::Code::Failed, "Invalid data thread" };
   }
   stream->pause();
-  if (stream->currentFrame() > 0)
+  const FrameNumber frame = stream->stepBackwardFrame();
+  if (frame < stream->currentFrame())
   {
-    stream->setTargetFrame(stream->currentFrame() - 1);
+    stream->setTargetFrame(frame);
   }
   return { CommandResult::Code::Ok };
 }
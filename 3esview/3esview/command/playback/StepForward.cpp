@@ -13,8 +13,8 @@ StepForward::StepForward()
 bool StepForward::checkAdmissible(Viewer &viewer) const
 {
   auto stream = viewer.dataThread();
-  return stream != nullptr && !stream->isLiveStream() && stream->paused() &&
-         stream->currentFrame() < stream->totalFrames();
+  return stream != nullptr && stream->canPause() && stream->paused() &&
+         stream->stepForwardFrame() > stream->currentFrame();
 }
 
 
@@ -28,9 +28,10 @@ CommandResult StepForward::invoke(Viewer &viewer, const ExecInfo &info, const Ar
     return { CommandResult::Code::Failed, "Invalid data thread" };
   }
   stream->pause();
-  if (stream->currentFrame() < stream->totalFrames())
+  const FrameNumber frame = stream->stepForwardFrame();
+  if (frame > stream->currentFrame())
   {
-    stream->setTargetFrame(stream->currentFrame() + 1);
+    stream->setTargetFrame(frame);
   }
   return { CommandResult::Code::Ok };
 }
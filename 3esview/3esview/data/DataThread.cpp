@@ -6,6 +6,8 @@
 #include <3escore/Messages.h>
 #include <3escore/PacketReader.h>
 
+#include <algorithm>
+
 namespace tes::view
 {
 DataThread::~DataThread() = default;
@@ -23,4 +25,62 @@ bool DataThread::processServerInfo(PacketReader &reader, ServerInfoMessage &serv
   log::error("Failed to decode server info.");
   return false;
 }
+
+
+bool DataThread::processLiveControlMessage(PacketReader &packet, ThirdEyeScene &tes,
+                                           FrameNumberAtomic &current_frame,
+                                           FrameNumber &total_frames,
+                                           ServerInfoMessage &server_info, ControlMessage &msg)
+{
+  if (!msg.read(packet))
+  {
+    log::error("Failed to decode control packet: ", packet.messageId());
+    return false;
+  }
+
+  switch (packet.messageId())
+  {
+  case CIdNull:
+    break;
+  case CIdFrame: {
+    // Frame ending.
+    const FrameNumber frame = ++current_frame;
+    tes.updateToFrame(frame);
+    total_frames = std::max(frame, total_frames);
+    break;
+  }
+  case CIdCoordinateFrame:
+    if (msg.value32 < CFCount)
+    {
+      server_info.coordinate_frame = CoordinateFrame(msg.value32);
+      tes.updateServerInfo(server_info);
+    }
+    else
+    {
+      log::error("Invalid coordinate frame value: ", msg.value32);
+    }
+    break;
+  case CIdFrameCount:
+    total_frames = msg.value32;
+    break;
+  case CIdForceFrameFlush:
+    tes.updateToFrame(current_frame);
+    break;
+  case CIdReset:
+    // This doesn't seem right any more. Need to check what the Unity viewer did with this. It may
+    // be an artifact of the main thread needing to do so much work in Unity.
+    current_frame = msg.value32;
+    tes.reset();
+    break;
+  case CIdKeyframe:
+    break;
+  case CIdEnd:
+    break;
+  default:
+    log::error("Unknown control message id: ", packet.messageId());
+    break;
+  }
+
+  return true;
+}
 }  // namespace tes::view
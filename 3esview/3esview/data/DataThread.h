@@ -7,12 +7,16 @@
 
 namespace tes
 {
+struct ControlMessage;
 class PacketReader;
 struct ServerInfoMessage;
 }  // namespace tes
 
 namespace tes::view
 {
+struct RewindCacheStats;
+class ThirdEyeScene;
+
 /// Base class TES_VIEWER_API for thread objects used as message sources.
 ///
 /// A data thread is responsible for reading incoming data, generally over a network connection or from file, decoding
@@ -28,7 +32,8 @@ public:
 
   /// Reports whether the current stream is a live connection or a replay.
   ///
-  /// Live streams do not support playback controls such as pausing and stepping.
+  /// Live streams do not support playback controls such as pausing and stepping unless
+  /// @c canPause() .
   /// @return True if this is a live stream.
   virtual bool isLiveStream() const = 0;
 
@@ -53,9 +58,35 @@ public:
   /// @return The total frame count.
   virtual FrameNumber totalFrames() const = 0;
 
+  /// Query the frame reached by stepping back from the @c currentFrame() .
+  ///
+  /// Recordings can step to the previous frame, while a paused live stream can only show the
+  /// frames it has cached.
+  /// @return The frame a step backward reaches. The @c currentFrame() if unable to step.
+  virtual FrameNumber stepBackwardFrame() const
+  {
+    const FrameNumber frame = currentFrame();
+    return (frame > 0) ? frame - 1 : frame;
+  }
+
+  /// Query the frame reached by stepping forward from the @c currentFrame() .
+  /// @return The frame a step forward reaches. The @c currentFrame() if unable to step.
+  virtual FrameNumber stepForwardFrame() const
+  {
+    const FrameNumber frame = currentFrame();
+    return (frame < totalFrames()) ? frame + 1 : frame;
+  }
+
   virtual void setLooping(bool loop) = 0;
   virtual bool looping() const = 0;
 
+  /// Check if playback can be paused, which enables stepping and skipping frames while paused.
+  ///
+  /// By default, only recorded streams can be paused. Live streams may support pausing by caching
+  /// recent frames - see @c RewindCache .
+  /// @return True if playback can be paused.
+  virtual bool canPause() const { return !isLiveStream(); }
+
   virtual bool paused() const = 0;
   /// Pause playback.
   virtual void pause() = 0;
@@ -64,6 +95,15 @@ public:
 
   virtual void join() = 0;
 
+  /// Populate the @c RewindCache statistics, if the thread has a rewind cache.
+  /// @param[out] stats The stats object to populate.
+  /// @return True if @p stats has been populated.
+  virtual bool rewindCacheStats(RewindCacheStats &stats) const
+  {
+    (void)stats;
+    return false;
+  }
+
 protected:
   /// Process a server info message and load into @p server_info.
   /// @param reader Reader containing a server info message.
@@ -71,6 +111,29 @@ protected:
   /// @return True if successfully read.
   bool processServerInfo(PacketReader &reader, ServerInfoMessage &server_info);
 
+  /// Process a control message from a live stream.
+  ///
+  /// Handles the following messages:
+  /// - @c CIdFrame increments @p current_frame , raising @p total_frames to match, then calls
+  ///   @c ThirdEyeScene::updateToFrame() .
+  /// - @c CIdCoordinateFrame updates @p server_info then calls
+  ///   @c ThirdEyeScene::updateServerInfo() .
+  /// - @c CIdFrameCount updates @p total_frames .
+  /// - @c CIdForceFrameFlush calls @c ThirdEyeScene::updateToFrame() with the @p current_frame .
+  /// - @c CIdReset sets the @p current_frame and calls @c ThirdEyeScene::reset() .
+  /// - @c CIdKeyframe and @c CIdEnd are irrelevant for a live stream.
+  ///
+  /// @param packet The control packet. The routing Id is always @c MtControl.
+  /// @param tes The scene to update.
+  /// @param[in,out] current_frame The current frame number.
+  /// @param[in,out] total_frames The total number of frames.
+  /// @param[in,out] server_info The server info.
+  /// @param[out] msg The decoded message, for further handling by the caller.
+  /// @return True if the message was decoded.
+  bool processLiveControlMessage(PacketReader &packet, ThirdEyeScene &tes,
+                                 FrameNumberAtomic &current_frame, FrameNumber &total_frames,
+                                 ServerInfoMessage &server_info, ControlMessage &msg);
+
 private:
 };
 }  // namespace tes::view
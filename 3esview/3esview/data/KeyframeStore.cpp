@@ -0,0 +1,504 @@
+#include "KeyframeStore.h"
+
+#include <3escore/CollatedPacket.h>
+#include <3escore/CollatedPacketDecoder.h>
+#include <3escore/Crc.h>
+#include <3escore/Log.h>
+#include <3escore/Messages.h>
+#include <3escore/PacketReader.h>
+#include <3escore/PacketStreamReader.h>
+#include <3escore/PacketWriter.h>
+#include <3escore/ResourcePacker.h>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace tes::view
+{
+namespace
+{
+/// Initial buffer size for a keyframe snapshot.
+constexpr unsigned kInitialSnapshotBytes = 64u * 1024u;
+
+/// A @c CollatedPacket used to capture a scene snapshot. This extends the @c CollatedPacket to
+/// pack referenced resources in full, since a snapshot must be self contained.
+class SnapshotPacket : public CollatedPacket
+{
+public:
+  SnapshotPacket()
+    : CollatedPacket(kInitialSnapshotBytes, KeyframeStore::kMaxSnapshotBytes)
+  {}
+
+  using CollatedPacket::send;
+
+  /// Check if all messages have been collated successfully.
+  /// @return True if no messages have been dropped.
+  [[nodiscard]] bool ok() const { return _ok; }
+
+  int updateTransfers(unsigned byte_limit) override
+  {
+    (void)byte_limit;
+    int transferred = 0;
+    ResourcePacker packer;
+    PacketWriter packet(_packet_buffer.data(), static_cast<uint16_t>(_packet_buffer.size()));
+    for (const auto &resource : _resources)
+    {
+      packer.transfer(resource);
+      while (packer.isValid())
+      {
+        if (!packer.nextPacket(packet, 0) || !packet.finalise() || send(packet, false) < 0)
+        {
+          _ok = false;
+          _resources.clear();
+          return -1;
+        }
+        transferred += static_cast<int>(packet.packetSize());
+      }
+    }
+    _resources.clear();
+    return transferred;
+  }
+
+  unsigned referenceResource(const ResourcePtr &resource) override
+  {
+    _resources.emplace_back(resource);
+    return 1;
+  }
+
+  int send(const uint8_t *data, int byte_count, bool allow_collation) override
+  {
+    const int sent = CollatedPacket::send(data, byte_count, allow_collation);
+    _ok = _ok && sent >= 0;
+    return sent;
+  }
+
+private:
+  std::vector<ResourcePtr> _resources;
+  std::vector<uint8_t> _packet_buffer = std::vector<uint8_t>(0xffffu);
+  bool _ok = true;
+};
+
+
+/// Read a @c ControlMessage with the given @p message_id from @p header .
+bool readControl(const PacketHeader *header, uint16_t message_id, ControlMessage &msg)
+{
+  PacketReader packet(header);
+  return packet.routingId() == MtControl && packet.messageId() == message_id && msg.read(packet);
+}
+
+
+/// Read @p buffer full from @p file at @p offset and calculate the CRC of the bytes read.
+/// @return True on success.
+bool crcRange(std::ifstream &file, uint64_t offset, std::vector<uint8_t> &buffer, uint32_t &crc)
+{
+  file.seekg(static_cast<std::streamoff>(offset));
+  file.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+  if (static_cast<size_t>(file.gcount()) != buffer.size())
+  {
+    return false;
+  }
+  crc = crc32(buffer.data(), buffer.size());
+  return true;
+}
+}  // namespace
+
+
+KeyframeStore::KeyframeStore(uint64_t interval_bytes, unsigned min_frames)
+  : _interval_bytes(interval_bytes)
+  , _min_frames(std::max(min_frames, 1u))
+{}
+
+
+KeyframeStore::~KeyframeStore()
+{
+  close();
+}
+
+
+std::filesystem::path KeyframeStore::sidecarPath(const std::filesystem::path &recording_path,
+                                                 bool temp)
+{
+  if (!temp)
+  {
+    auto path = recording_path;
+    path += ".3eskf";
+    return path;
+  }
+
+  // Disambiguate recordings with the same name using a hash of the full path.
+  std::error_code err;
+  const auto absolute_path = std::filesystem::absolute(recording_path, err);
+  std::ostringstream name;
+  name << recording_path.filename().string() << '-' << std::hex << std::setw(16)
+       << std::setfill('0') << std::hash<std::string>()((err) ? "" : absolute_path.string())
+       << ".3eskf";
+  return std::filesystem::temp_directory_path(err) / name.str();
+}
+
+
+bool KeyframeStore::identify(const std::filesystem::path &recording_path, RecordingId &id)
+{
+  id = {};
+  std::error_code err;
+  id.stream_size = std::filesystem::file_size(recording_path, err);
+  if (err)
+  {
+    return false;
+  }
+  const auto modified_time = std::filesystem::last_write_time(recording_path, err);
+  if (err)
+  {
+    return false;
+  }
+  id.modified_time = static_cast<uint64_t>(modified_time.time_since_epoch().count());
+
+  std::ifstream file(recording_path, std::ios::binary);
+  std::vector<uint8_t> buffer(
+    static_cast<size_t>(std::min<uint64_t>(id.stream_size, kIdentityHashBytes)));
+  uint32_t head_crc = 0;
+  uint32_t tail_crc = 0;
+  if (!file.is_open() || !crcRange(file, 0, buffer, head_crc) ||
+      !crcRange(file, id.stream_size - buffer.size(), buffer, tail_crc))
+  {
+    return false;
+  }
+  id.content_hash = (static_cast<uint64_t>(head_crc) << 32u) | tail_crc;
+  return true;
+}
+
+
+bool KeyframeStore::open(const std::filesystem::path &recording_path)
+{
+  RecordingId recording;
+  if (!identify(recording_path, recording))
+  {
+    return false;
+  }
+
+  return openSidecar(sidecarPath(recording_path), recording) ||
+         openSidecar(sidecarPath(recording_path, true), recording);
+}
+
+
+bool KeyframeStore::openSidecar(const std::filesystem::path &path, const RecordingId &recording)
+{
+  close();
+
+  {
+    // Ensure the file exists for in/out access.
+    std::ofstream create(path, std::ios::binary | std::ios::app);
+    if (!create.is_open())
+    {
+      return false;
+    }
+  }
+
+  _file = std::make_shared<std::fstream>(path, std::ios::in | std::ios::out | std::ios::binary);
+  if (!_file->is_open())
+  {
+    _file = nullptr;
+    return false;
+  }
+
+  _path = path;
+  _recording = recording;
+
+  if (!load())
+  {
+    // New, invalid or for a different recording.
+    if (!resetContent())
+    {
+      close();
+      return false;
+    }
+  }
+  else
+  {
+    // Discard any incomplete keyframe.
+    _file->close();
+    std::error_code err;
+    std::filesystem::resize_file(path, _file_end, err);
+    _file->open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (err || !_file->is_open())
+    {
+      close();
+      return false;
+    }
+  }
+
+  if (!_keyframes.empty())
+  {
+    _last_attempt_frame = _keyframes.back().frame;
+    _last_attempt_offset = _keyframes.back().stream_offset;
+  }
+
+  return true;
+}
+
+
+void KeyframeStore::close()
+{
+  _file = nullptr;
+  _path.clear();
+  _keyframes.clear();
+  _recording = {};
+  _file_end = 0;
+  _last_attempt_frame = 0;
+  _last_attempt_offset = 0;
+}
+
+
+bool KeyframeStore::due(FrameNumber frame, uint64_t stream_offset) const
+{
+  if (!isOpen() || frame < _last_attempt_frame + _min_frames)
+  {
+    return false;
+  }
+
+  const uint64_t last_bytes = (!_keyframes.empty()) ? _keyframes.back().byte_count : 0u;
+  return stream_offset >= _last_attempt_offset + std::max(_interval_bytes, last_bytes);
+}
+
+
+bool KeyframeStore::add(FrameNumber frame, uint64_t stream_offset,
+                        const SerialiseFunction &serialise)
+{
+  if (!isOpen() || frame <= lastFrame())
+  {
+    return false;
+  }
+
+  // Note the attempt first so failures are not retried every frame.
+  _last_attempt_frame = frame;
+  _last_attempt_offset = stream_offset;
+
+  std::vector<uint8_t> snapshot;
+  if (!capture(serialise, snapshot))
+  {
+    log::warn("Failed to capture keyframe for frame ", frame);
+    return false;
+  }
+
+  _file->clear();
+  _file->seekp(static_cast<std::streamoff>(_file_end));
+  Keyframe keyframe;
+  keyframe.frame = frame;
+  keyframe.stream_offset = stream_offset;
+  bool ok = writeControl(CIdKeyframe, 0, frame, stream_offset);
+  keyframe.file_offset = static_cast<uint64_t>(std::streamoff(_file->tellp()));
+  keyframe.byte_count = snapshot.size();
+  _file->write(reinterpret_cast<const char *>(snapshot.data()),
+               static_cast<std::streamsize>(snapshot.size()));
+  ok = writeControl(CIdEnd, 0, frame, 0) && ok;
+  _file->flush();
+
+  if (!ok || !_file->good())
+  {
+    log::error("Failed to write keyframe file: ", _path.string());
+    close();
+    return false;
+  }
+
+  _file_end = static_cast<uint64_t>(std::streamoff(_file->tellp()));
+  _keyframes.emplace_back(keyframe);
+  return true;
+}
+
+
+bool KeyframeStore::nearest(FrameNumber frame, Keyframe &keyframe) const
+{
+  // Find the first keyframe after the target, then step back.
+  const auto iter =
+    std::upper_bound(_keyframes.begin(), _keyframes.end(), frame,
+                     [](FrameNumber target, const Keyframe &item) {  //
+                       return target < item.frame;
+                     });
+  if (iter == _keyframes.begin())
+  {
+    return false;
+  }
+  keyframe = *std::prev(iter);
+  return true;
+}
+
+
+bool KeyframeStore::replay(const Keyframe &keyframe, const MessageFunction &handler)
+{
+  if (!isOpen())
+  {
+    return false;
+  }
+
+  std::vector<uint8_t> snapshot(keyframe.byte_count);
+  _file->clear();
+  _file->seekg(static_cast<std::streamoff>(keyframe.file_offset));
+  _file->read(reinterpret_cast<char *>(snapshot.data()),
+              static_cast<std::streamsize>(snapshot.size()));
+  if (static_cast<uint64_t>(_file->gcount()) != keyframe.byte_count)
+  {
+    log::error("Failed to read keyframe ", keyframe.frame, " from ", _path.string());
+    return false;
+  }
+
+  return decode(snapshot, handler);
+}
+
+
+bool KeyframeStore::capture(const SerialiseFunction &serialise, std::vector<uint8_t> &packet)
+{
+  SnapshotPacket snapshot;
+  serialise(snapshot);
+  if (!snapshot.ok() || !snapshot.finalise())
+  {
+    return false;
+  }
+
+  unsigned byte_count = 0;
+  const uint8_t *bytes = snapshot.buffer(byte_count);
+  packet.assign(bytes, bytes + byte_count);
+  return byte_count > 0;
+}
+
+
+bool KeyframeStore::decode(const std::vector<uint8_t> &packet, const MessageFunction &handler)
+{
+  if (packet.size() < sizeof(PacketHeader))
+  {
+    return false;
+  }
+
+  const auto *header = reinterpret_cast<const PacketHeader *>(packet.data());
+  PacketReader reader(header);
+  if (reader.routingId() != MtCollatedPacket || reader.packetSize() != packet.size() ||
+      !reader.checkCrc())
+  {
+    return false;
+  }
+
+  CollatedPacketDecoder decoder;
+  if (!decoder.setPacket(header))
+  {
+    return false;
+  }
+
+  while (const PacketHeader *message_header = decoder.next())
+  {
+    PacketReader message(message_header);
+    handler(message);
+  }
+  return true;
+}
+
+
+bool KeyframeStore::load()
+{
+  _keyframes.clear();
+  _file_end = 0;
+
+  PacketStreamReader reader(_file);
+  ControlMessage msg = {};
+  const PacketHeader *header = nullptr;
+  RecordingId recording;
+  for (uint64_t *field :
+       { &recording.stream_size, &recording.modified_time, &recording.content_hash })
+  {
+    header = reader.extractPacket();
+    if (!header || !readControl(header, CIdKeyframe, msg) || msg.control_flags != kFormatVersion ||
+        msg.value32 != 0)
+    {
+      return false;
+    }
+    *field = msg.value64;
+  }
+  if (recording != _recording)
+  {
+    return false;
+  }
+  _file_end = reader.position();
+
+  // Load complete keyframes. Stop on anything unexpected.
+  while ((header = reader.extractPacket()) != nullptr)
+  {
+    Keyframe keyframe;
+    if (!readControl(header, CIdKeyframe, msg) || msg.value32 <= lastFrame() ||
+        msg.value64 > _recording.stream_size)
+    {
+      break;
+    }
+    keyframe.frame = msg.value32;
+    keyframe.stream_offset = msg.value64;
+
+    header = reader.extractPacket();
+    if (!header)
+    {
+      break;
+    }
+    PacketReader snapshot(header);
+    if (snapshot.routingId() != MtCollatedPacket || !snapshot.checkCrc())
+    {
+      break;
+    }
+    keyframe.byte_count = snapshot.packetSize();
+    keyframe.file_offset = reader.position() - keyframe.byte_count;
+
+    header = reader.extractPacket();
+    if (!header || !readControl(header, CIdEnd, msg) || msg.value32 != keyframe.frame)
+    {
+      break;
+    }
+
+    _keyframes.emplace_back(keyframe);
+    _file_end = reader.position();
+  }
+
+  _file->clear();
+  return true;
+}
+
+
+bool KeyframeStore::resetContent()
+{
+  _keyframes.clear();
+  _file->close();
+  _file->open(_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!_file->is_open())
+  {
+    return false;
+  }
+
+  for (const uint64_t field :
+       { _recording.stream_size, _recording.modified_time, _recording.content_hash })
+  {
+    if (!writeControl(CIdKeyframe, kFormatVersion, 0, field))
+    {
+      return false;
+    }
+  }
+  _file->flush();
+  _file_end = static_cast<uint64_t>(std::streamoff(_file->tellp()));
+  return _file->good();
+}
+
+
+bool KeyframeStore::writeControl(uint16_t message_id, uint32_t flags, uint32_t value32,
+                                 uint64_t value64)
+{
+  std::array<uint8_t, sizeof(PacketHeader) + sizeof(ControlMessage) + sizeof(PacketWriter::CrcType)>
+    buffer = {};
+  PacketWriter packet(buffer.data(), static_cast<uint16_t>(buffer.size()), MtControl, message_id);
+  ControlMessage msg = {};
+  msg.control_flags = flags;
+  msg.value32 = value32;
+  msg.value64 = value64;
+  if (!msg.write(packet) || !packet.finalise())
+  {
+    return false;
+  }
+  _file->write(reinterpret_cast<const char *>(packet.data()),
+               static_cast<std::streamsize>(packet.packetSize()));
+  return _file->good();
+}
+}  // namespace tes::view
@@ -0,0 +1,243 @@
+#ifndef TES_VIEW_KEYFRAME_STORE_H
+#define TES_VIEW_KEYFRAME_STORE_H
+
+#include <3esview/ViewConfig.h>
+
+#include <3esview/FrameStamp.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+namespace tes
+{
+class Connection;
+class PacketReader;
+}  // namespace tes
+
+namespace tes::view
+{
+/// Stores keyframes - scene snapshots - for a recorded stream in order to support fast seeking.
+///
+/// A keyframe is a snapshot of the scene at the end of a frame, serialised as the messages
+/// required to restore that state - see @c ThirdEyeScene::serialise() - along with the stream
+/// offset immediately following the frame. Seeking restores the nearest keyframe before the
+/// target frame, then replays the recording from the keyframe's stream offset. Keyframes are
+/// captured during playback at intervals of at least @c intervalBytes() of the recording and
+/// @c minFrames() frames, so a second pass through a recording seeks quickly.
+///
+/// Keyframes are written to a sidecar file alongside the recording so they persist between
+/// sessions. The sidecar is a sequence of 3es packets:
+/// - A header of three @c CIdKeyframe @c ControlMessage packets with @c value32 zero and
+///   @c control_flags set to the format version. The @c value64 fields identify the recording -
+///   see @c RecordingId - and are, in order, the byte size, modification time and content hash.
+/// - For each keyframe:
+///   - A @c CIdKeyframe @c ControlMessage with @c value32 set to the frame number and
+///     @c value64 set to the recording offset following that frame.
+///   - The snapshot messages as a single, uncompressed collated packet.
+///   - A @c CIdEnd @c ControlMessage with @c value32 set to the frame number.
+///
+/// Loading stops at the first incomplete keyframe, so a sidecar truncated by an interrupted
+/// write remains usable. A sidecar is discarded if any part of the @c RecordingId does not match.
+///
+/// The store is not threadsafe and is intended for use by the @c StreamThread only.
+class TES_VIEWER_API KeyframeStore
+{
+public:
+  /// Default value for @c intervalBytes() .
+  static constexpr uint64_t kDefaultIntervalBytes = 16u * 1024u * 1024u;
+  /// Default value for @c minFrames() .
+  static constexpr unsigned kDefaultMinFrames = 10u;
+  /// Maximum byte size of a single keyframe snapshot. Larger scenes are not keyframed.
+  static constexpr unsigned kMaxSnapshotBytes = 1u << 30u;
+  /// Sidecar file format version.
+  static constexpr uint32_t kFormatVersion = 2u;
+  /// Number of bytes from each of the start and end of a recording included in
+  /// @c RecordingId::content_hash .
+  static constexpr unsigned kIdentityHashBytes = 64u * 1024u;
+
+  /// Identifies the recording a sidecar belongs to. See @c identify() .
+  struct RecordingId
+  {
+    /// The recording byte size.
+    uint64_t stream_size = 0;
+    /// The recording modification time, in ticks of the filesystem clock.
+    uint64_t modified_time = 0;
+    /// CRC of the first and last @c kIdentityHashBytes of the recording. The tail covers the frame
+    /// index, where present.
+    uint64_t content_hash = 0;
+
+    [[nodiscard]] bool operator==(const RecordingId &other) const
+    {
+      return stream_size == other.stream_size && modified_time == other.modified_time &&
+             content_hash == other.content_hash;
+    }
+    [[nodiscard]] bool operator!=(const RecordingId &other) const { return !operator==(other); }
+  };
+
+  /// Details of a stored keyframe.
+  struct Keyframe
+  {
+    /// The frame number the keyframe restores.
+    FrameNumber frame = 0;
+    /// Recording offset immediately following the frame. Playback resumes from here.
+    uint64_t stream_offset = 0;
+    /// Sidecar file offset of the snapshot packet.
+    uint64_t file_offset = 0;
+    /// Byte size of the snapshot packet.
+    uint64_t byte_count = 0;
+  };
+
+  /// Function used to serialise the scene into a snapshot.
+  using SerialiseFunction = std::function<void(Connection &)>;
+  /// Function called for each message when replaying a keyframe.
+  using MessageFunction = std::function<void(PacketReader &)>;
+
+  /// Constructor.
+  /// @param interval_bytes Minimum number of recording bytes between keyframes.
+  /// @param min_frames Minimum number of frames between keyframes.
+  KeyframeStore(uint64_t interval_bytes = kDefaultIntervalBytes,
+                unsigned min_frames = kDefaultMinFrames);
+  /// Destructor.
+  ~KeyframeStore();
+
+  KeyframeStore(const KeyframeStore &) = delete;
+  KeyframeStore &operator=(const KeyframeStore &) = delete;
+
+  /// Resolve the sidecar path for the recording at @p recording_path .
+  /// @param recording_path The recording file path.
+  /// @param temp True to resolve a path in the temporary directory, used when the recording
+  ///   directory is not writable.
+  /// @return The sidecar file path.
+  static std::filesystem::path sidecarPath(const std::filesystem::path &recording_path,
+                                           bool temp = false);
+
+  /// Generate the @c RecordingId for the recording at @p recording_path .
+  /// @param recording_path The recording file path.
+  /// @param[out] id Set to the recording identity.
+  /// @return True on success, false if the recording cannot be read.
+  static bool identify(const std::filesystem::path &recording_path, RecordingId &id);
+
+  /// Open the keyframe sidecar for the recording at @p recording_path , loading any existing
+  /// keyframes. The sidecar is created next to the recording, falling back to the temporary
+  /// directory. See @c sidecarPath() .
+  /// @param recording_path The recording file path.
+  /// @return True if a sidecar file is open.
+  bool open(const std::filesystem::path &recording_path);
+
+  /// Open @p path as the keyframe sidecar for the recording identified by @p recording , loading
+  /// any valid keyframes. The file is created if required. Existing content is discarded when
+  /// invalid or for a different recording.
+  /// @param path The sidecar file path.
+  /// @param recording Identifies the recording. See @c identify() .
+  /// @return True if the sidecar file is open.
+  bool openSidecar(const std::filesystem::path &path, const RecordingId &recording);
+
+  /// Close the sidecar file and clear the keyframes.
+  void close();
+
+  /// Check if the sidecar file is open.
+  /// @return True when open.
+  [[nodiscard]] bool isOpen() const { return _file != nullptr; }
+
+  /// Query the sidecar file path.
+  /// @return The sidecar path. Empty when not open.
+  [[nodiscard]] const std::filesystem::path &path() const { return _path; }
+
+  /// Query the minimum number of recording bytes between keyframes.
+  /// @return The keyframe interval in bytes.
+  [[nodiscard]] uint64_t intervalBytes() const { return _interval_bytes; }
+
+  /// Query the minimum number of frames between keyframes.
+  /// @return The keyframe interval in frames.
+  [[nodiscard]] unsigned minFrames() const { return _min_frames; }
+
+  /// Query the stored keyframes, in frame order.
+  /// @return The keyframes.
+  [[nodiscard]] const std::vector<Keyframe> &keyframes() const { return _keyframes; }
+
+  /// Query the last keyframe frame number.
+  /// @return The last keyframe's frame number, or zero when there are no keyframes.
+  [[nodiscard]] FrameNumber lastFrame() const
+  {
+    return (!_keyframes.empty()) ? _keyframes.back().frame : 0u;
+  }
+
+  /// Check if a keyframe should be captured at the end of @p frame .
+  ///
+  /// Keyframes are due at intervals of @c intervalBytes() and @c minFrames() after the last
+  /// keyframe. The byte interval is extended to the size of the last snapshot so keyframes never
+  /// dominate the sidecar size. Frames at or before the last keyframe are never due.
+  ///
+  /// @param frame The frame which has just ended.
+  /// @param stream_offset The recording offset following @p frame .
+  /// @return True if a keyframe should be added.
+  [[nodiscard]] bool due(FrameNumber frame, uint64_t stream_offset) const;
+
+  /// Capture and append a keyframe for @p frame .
+  ///
+  /// The keyframe is not added if @p frame is not after @c lastFrame() or the snapshot fails.
+  /// The sidecar is closed on a write failure.
+  ///
+  /// @param frame The frame which has just ended.
+  /// @param stream_offset The recording offset following @p frame .
+  /// @param serialise Function which serialises the scene to the given @c Connection .
+  /// @return True if the keyframe has been added.
+  bool add(FrameNumber frame, uint64_t stream_offset, const SerialiseFunction &serialise);
+
+  /// Find the nearest keyframe at or before @p frame .
+  /// @param frame The target frame.
+  /// @param[out] keyframe Set to the keyframe found.
+  /// @return True if a keyframe was found.
+  bool nearest(FrameNumber frame, Keyframe &keyframe) const;
+
+  /// Replay the snapshot messages for @p keyframe , calling @p handler for each message.
+  /// @param keyframe The keyframe to replay. Must be from @c keyframes() .
+  /// @param handler Function called for each snapshot message.
+  /// @return True on success, false if the snapshot cannot be read.
+  bool replay(const Keyframe &keyframe, const MessageFunction &handler);
+
+  /// Serialise a scene snapshot as a single, uncompressed collated packet.
+  ///
+  /// The snapshot @c Connection supports resource transfers, so resources referenced during
+  /// serialisation are packed in full on @c Connection::updateTransfers() .
+  ///
+  /// @param serialise Function which serialises the scene to the given @c Connection .
+  /// @param[out] packet Set to the collated packet bytes.
+  /// @return True on success, false if the snapshot is empty or exceeds @c kMaxSnapshotBytes .
+  static bool capture(const SerialiseFunction &serialise, std::vector<uint8_t> &packet);
+
+  /// Decode the messages in a snapshot packet from @c capture() , calling @p handler for each.
+  /// @param packet The snapshot packet.
+  /// @param handler Function called for each snapshot message.
+  /// @return True on success, false if @p packet is invalid.
+  static bool decode(const std::vector<uint8_t> &packet, const MessageFunction &handler);
+
+private:
+  /// Load keyframes from the sidecar, validating against @c _recording .
+  /// @return True if the sidecar header is valid.
+  bool load();
+  /// Reset the sidecar content, writing the header only.
+  /// @return True on success.
+  bool resetContent();
+  /// Write a control message to the sidecar at the current put position.
+  bool writeControl(uint16_t message_id, uint32_t flags, uint32_t value32, uint64_t value64);
+
+  std::shared_ptr<std::fstream> _file;
+  std::filesystem::path _path;
+  std::vector<Keyframe> _keyframes;
+  RecordingId _recording;
+  /// Sidecar offset following the last complete keyframe. New keyframes are written here.
+  uint64_t _file_end = 0;
+  uint64_t _interval_bytes = kDefaultIntervalBytes;
+  /// Frame and stream offset of the last keyframe attempt. Limits retries after failures.
+  FrameNumber _last_attempt_frame = 0;
+  uint64_t _last_attempt_offset = 0;
+  unsigned _min_frames = kDefaultMinFrames;
+};
+}  // namespace tes::view
+
+#endif  // TES_VIEW_KEYFRAME_STORE_H
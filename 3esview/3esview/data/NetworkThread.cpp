@@ -1,24 +1,43 @@
 #include "NetworkThread.h"
 
+#include "KeyframeStore.h"
+#include "RewindCache.h"
+
 #include <3esview/ThirdEyeScene.h>
 
 #include <3escore/CollatedPacketDecoder.h>
+#include <3escore/Connection.h>
 #include <3escore/Log.h>
 #include <3escore/PacketBuffer.h>
 #include <3escore/PacketReader.h>
 #include <3escore/PacketStreamReader.h>
 #include <3escore/TcpSocket.h>
 
+#include <algorithm>
 #include <cinttypes>
+#include <utility>
 #include <vector>
 
 namespace tes::view
 {
+namespace
+{
+/// Byte size of the buffer used to drain the socket on each read.
+constexpr size_t kReadBufferBytes = 256u * 1024u;
+/// Requested socket receive buffer size. The operating system may clamp this value.
+constexpr int kSocketReceiveBytes = 4 * 1024 * 1024;
+/// Maximum time to wait for data before checking for quit or playback changes.
+constexpr unsigned kReadWaitMs = 20u;
+}  // namespace
+
+
 NetworkThread::NetworkThread(std::shared_ptr<ThirdEyeScene> tes, const std::string &host,
-                             uint16_t port, bool allow_reconnect)
+                             uint16_t port, bool allow_reconnect,
+                             std::shared_ptr<RewindCache> rewind_cache)
   : _allow_reconnect(allow_reconnect)
   , _host(host)
   , _port(port)
+  , _rewind_cache(std::exchange(rewind_cache, nullptr))
 {
   _tes = std::exchange(tes, nullptr);
   _thread = std::thread([this] { run(); });
@@ -34,16 +53,64 @@ bool NetworkThread::isLiveStream() const
 }
 
 
+bool NetworkThread::rewindCacheStats(RewindCacheStats &stats) const
+{
+  if (_rewind_cache)
+  {
+    _rewind_cache->stats(stats);
+    return true;
+  }
+  return false;
+}
+
+
 void NetworkThread::setTargetFrame(FrameNumber frame)
 {
-  // Not supported.
-  (void)frame;
+  if (!_rewind_cache)
+  {
+    // Not supported.
+    return;
+  }
+  const std::lock_guard guard(_data_mutex);
+  _target_frame = frame;
 }
 
 
 FrameNumber NetworkThread::targetFrame() const
 {
-  return 0;
+  const std::lock_guard guard(_data_mutex);
+  return _target_frame.value_or(0);
+}
+
+
+FrameNumber NetworkThread::stepBackwardFrame() const
+{
+  const FrameNumber current_frame = _currentFrame;
+  FrameNumber frame = current_frame;
+  if (_rewind_cache && current_frame > 0 && _rewind_cache->nearest(current_frame - 1, frame))
+  {
+    return frame;
+  }
+  return current_frame;
+}
+
+
+FrameNumber NetworkThread::stepForwardFrame() const
+{
+  const FrameNumber current_frame = _currentFrame;
+  const FrameNumber live_frame = _live_frame;
+  if (current_frame >= live_frame)
+  {
+    return current_frame;
+  }
+
+  // Snapshots are sparse, so step to the next cached frame rather than the next frame.
+  FrameNumber frame = live_frame;
+  if (_rewind_cache && _rewind_cache->following(current_frame + 1, frame) && frame < live_frame)
+  {
+    return frame;
+  }
+  return live_frame;
 }
 
 
@@ -62,13 +129,14 @@ bool NetworkThread::looping() const
 
 void NetworkThread::pause()
 {
-  // Not supported.
+  // The display freezes at the next frame boundary.
+  _paused = _rewind_cache != nullptr;
 }
 
 
 void NetworkThread::unpause()
 {
-  // Not supported.
+  _paused = false;
 }
 
 
@@ -111,7 +179,7 @@ void NetworkThread::configureSocket(TcpSocket &socket)
   socket.setNoDelay(true);
   socket.setReadTimeout(0);
   socket.setWriteTimeout(0);
-  socket.setReadBufferSize(0xffff);
+  socket.setReadBufferSize(kSocketReceiveBytes);
   socket.setSendBufferSize(4 * 1024);
 }
 
@@ -119,110 +187,317 @@ void NetworkThread::configureSocket(TcpSocket &socket)
 void NetworkThread::runWith(TcpSocket &socket)
 {
   CollatedPacketDecoder packet_decoder;
-  bool have_server_info = false;
   // We have two buffers here -> redundant.
   // TODO(KS): change the PacketBuffer interface so we can read directly into it's buffer.
   PacketBuffer packet_buffer;
-  std::vector<uint8_t> read_buffer(2 * 1024u);
+  std::vector<uint8_t> read_buffer(kReadBufferBytes);
 
   _currentFrame = 0;
+  _live_frame = 0;
   _total_frames = 0;
+  _frozen = false;
+  _live_snapshot.clear();
+  _queued.clear();
+  if (_rewind_cache)
+  {
+    _rewind_cache->clear();
+  }
 
   // Make sure we reset from any previous connection.
   _tes->reset();
 
   while (socket.isConnected() && !_quitFlag)
   {
-    auto bytes_read = socket.readAvailable(read_buffer.data(), int(read_buffer.size()));
+    updatePlayback();
+
+    // Sleep until data arrive. The timeout bounds the latency for quitting and playback controls.
+    if (!socket.waitReadable(kReadWaitMs))
+    {
+      continue;
+    }
+
+    const auto bytes_read = socket.readAvailable(read_buffer.data(), int(read_buffer.size()));
     if (bytes_read <= 0)
     {
+      // Either no data or the connection has closed, which isConnected() detects.
       continue;
     }
 
-    packet_buffer.addBytes(read_buffer.data(), bytes_read);
+    packet_buffer.addBytes(read_buffer.data(), static_cast<size_t>(bytes_read));
 
-    if (const auto *packet_header = packet_buffer.extractPacket(read_buffer))
+    // Process every complete packet received so far, not just the first.
+    // Packets are extracted in place and remain valid until the next extraction.
+    while (const auto *packet_header = packet_buffer.extractPacket())
     {
       packet_decoder.setPacket(packet_header);
 
-      while (packet_header = packet_decoder.next())
+      while (const auto *message_header = packet_decoder.next())
       {
-        PacketReader packet(packet_header);
-        // Lock for frame control messages as these tell us to advance the frame and how long to
-        // wait.
-        switch (packet.routingId())
+        if (_frozen)
         {
-        case MtControl:
-          processControlMessage(packet);
-          break;
-        case MtServerInfo:
-          if (processServerInfo(packet, _server_info))
-          {
-            _tes->updateServerInfo(_server_info);
-          }
-          if (!have_server_info)
-          {
-            have_server_info = true;
-          }
-          break;
-        default:
-          _tes->processMessage(packet);
-          break;
+          queueMessage(message_header);
+          continue;
         }
+
+        PacketReader packet(message_header);
+        processMessage(packet);
       }
     }
   }
 }
 
-void NetworkThread::processControlMessage(PacketReader &packet)
+
+void NetworkThread::processMessage(PacketReader &packet)
 {
-  ControlMessage msg;
-  if (!msg.read(packet))
+  switch (packet.routingId())
   {
-    log::error("Failed to decode control packet: ", packet.messageId());
-    return;
+  case MtControl:
+    processControlMessage(packet);
+    break;
+  case MtServerInfo:
+    if (processServerInfo(packet, _server_info))
+    {
+      _tes->updateServerInfo(_server_info);
+    }
+    break;
+  default:
+    _tes->processMessage(packet);
+    break;
   }
+}
 
-  switch (packet.messageId())
+
+void NetworkThread::processSnapshotMessage(PacketReader &packet)
+{
+  switch (packet.routingId())
   {
-  case CIdNull:
+  case MtControl:
+    // Not expected in a snapshot.
+    break;
+  case MtServerInfo:
+    if (processServerInfo(packet, _server_info))
+    {
+      _tes->updateServerInfo(_server_info);
+    }
     break;
-  case CIdFrame: {
-    const auto current_frame = ++_currentFrame;
-    // Frame ending.
-    _tes->updateToFrame(current_frame);
-    _total_frames = std::max(current_frame, _total_frames);
+  default:
+    _tes->processMessage(packet);
     break;
   }
-  case CIdCoordinateFrame:
-    if (msg.value32 < CFCount)
+}
+
+
+void NetworkThread::onFrameEnd()
+{
+  if (!_rewind_cache)
+  {
+    return;
+  }
+
+  const auto serialise = [this](Connection &out) {
+    out.sendServerInfo(_server_info);
+    _tes->serialise(out);
+  };
+
+  // Live frames cannot be replayed, so capture periodically rather than near a cursor. The paused
+  // frame is captured separately on freeze().
+  if (!_paused && _rewind_cache->dueByTime(_currentFrame))
+  {
+    _rewind_cache->add(_currentFrame, 0, serialise);
+  }
+
+  if (_paused)
+  {
+    freeze();
+  }
+}
+
+
+void NetworkThread::updatePlayback()
+{
+  if (!_frozen)
+  {
+    return;
+  }
+
+  if (_paused && _queued.size() > kMaxQueuedBytes)
+  {
+    log::warn("Paused live stream exceeded ", kMaxQueuedBytes, " queued bytes. Resuming.");
+    _paused = false;
+  }
+
+  if (!_paused)
+  {
+    thaw();
+    return;
+  }
+
+  std::optional<FrameNumber> target_frame;
+  {
+    const std::lock_guard guard(_data_mutex);
+    target_frame = std::exchange(_target_frame, std::nullopt);
+  }
+
+  if (target_frame.has_value() && *target_frame != _currentFrame)
+  {
+    showFrame(*target_frame);
+  }
+}
+
+
+void NetworkThread::freeze()
+{
+  if (!KeyframeStore::capture(
+        [this](Connection &out) {
+          out.sendServerInfo(_server_info);
+          _tes->serialise(out);
+        },
+        _live_snapshot))
+  {
+    log::warn("Unable to capture live scene. Pause ignored.");
+    _live_snapshot.clear();
+    _paused = false;
+    return;
+  }
+
+  _frozen = true;
+}
+
+
+void NetworkThread::thaw()
+{
+  restoreLive();
+  _frozen = false;
+  _live_snapshot.clear();
+
+  // Process the queued messages. We may freeze again part way through, re-queuing the remainder.
+  const std::vector<uint8_t> queued = std::exchange(_queued, {});
+  size_t offset = 0;
+  while (offset + sizeof(PacketHeader) <= queued.size())
+  {
+    const auto *header = reinterpret_cast<const PacketHeader *>(queued.data() + offset);
+    PacketReader packet(header);
+    offset += packet.packetSize();
+    if (_frozen)
     {
-      _server_info.coordinate_frame = CoordinateFrame(msg.value32);
-      _tes->updateServerInfo(_server_info);
+      queueMessage(header);
+      continue;
     }
-    else
+    processMessage(packet);
+  }
+}
+
+
+void NetworkThread::showFrame(FrameNumber target_frame)
+{
+  if (target_frame >= _live_frame)
+  {
+    restoreLive();
+    return;
+  }
+
+  // We can't replay a live stream, so limit the target to the cached frames.
+  if (target_frame > _currentFrame)
+  {
+    // Restoring at or before the target could return the current frame, so moving forwards
+    // restores the nearest snapshot at or after the target, or the live scene.
+    FrameNumber following_frame = 0;
+    if (!_rewind_cache->following(target_frame, following_frame) ||
+        following_frame >= _live_frame)
     {
-      log::error("Invalid coordinate frame value: ", msg.value32);
+      restoreLive();
+      return;
     }
-    break;
-  case CIdFrameCount:
-    _total_frames = msg.value32;
-    break;
-  case CIdForceFrameFlush:
-    _tes->updateToFrame(_currentFrame);
+    target_frame = following_frame;
+  }
+
+  FrameNumber oldest_frame = 0;
+  if (_rewind_cache->oldest(oldest_frame))
+  {
+    target_frame = std::max(target_frame, oldest_frame);
+  }
+
+  // Reset on the first message, so a miss leaves the scene intact.
+  bool reset = false;
+  FrameNumber frame = 0;
+  uint64_t stream_offset = 0;
+  const bool restored = _rewind_cache->restore(
+    target_frame,
+    [this, &reset](PacketReader &packet) {
+      if (!reset)
+      {
+        _tes->reset();
+        reset = true;
+      }
+      processSnapshotMessage(packet);
+    },
+    frame, stream_offset);
+
+  if (!restored)
+  {
+    if (reset)
+    {
+      // Partially restored. Revert to the live scene.
+      _currentFrame = 0;
+      restoreLive();
+    }
+    return;
+  }
+
+  _currentFrame = frame;
+  _tes->updateToFrame(_currentFrame);
+}
+
+
+void NetworkThread::restoreLive()
+{
+  if (_live_snapshot.empty() || _currentFrame == _live_frame)
+  {
+    return;
+  }
+
+  _tes->reset();
+  if (!KeyframeStore::decode(_live_snapshot,
+                             [this](PacketReader &packet) { processSnapshotMessage(packet); }))
+  {
+    log::error("Failed to restore live scene for frame ", _live_frame.load());
+  }
+  _currentFrame = _live_frame.load();
+  _tes->updateToFrame(_currentFrame);
+}
+
+
+void NetworkThread::queueMessage(const PacketHeader *header)
+{
+  const PacketReader packet(header);
+  const auto *bytes = reinterpret_cast<const uint8_t *>(header);
+  _queued.insert(_queued.end(), bytes, bytes + packet.packetSize());
+}
+
+
+void NetworkThread::processControlMessage(PacketReader &packet)
+{
+  ControlMessage msg;
+  if (!processLiveControlMessage(packet, *_tes, _currentFrame, _total_frames, _server_info, msg))
+  {
+    return;
+  }
+
+  switch (packet.messageId())
+  {
+  case CIdFrame:
+    _live_frame = _currentFrame.load();
+    onFrameEnd();
     break;
   case CIdReset:
-    // This doesn't seem right any more. Need to check what the Unity viewer did with this. It may
-    // be an artifact of the main thread needing to do so much work in Unity.
-    _currentFrame = msg.value32;
-    _tes->reset();
-    break;
-  case CIdKeyframe:
-    break;
-  case CIdEnd:
+    _live_frame = msg.value32;
+    if (_rewind_cache)
+    {
+      // Cached frames no longer match the stream.
+      _rewind_cache->clear();
+    }
     break;
   default:
-    log::error("Unknown control message id: ", packet.messageId());
     break;
   }
 }
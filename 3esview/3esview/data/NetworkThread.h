@@ -18,11 +18,13 @@
 #include <mutex>
 #include <optional>
 #include <thread>
+#include <vector>
 
 namespace tes
 {
 class CollatedPacketDecoder;
 class PacketBuffer;
+struct PacketHeader;
 class PacketReader;
 class PacketStreamReader;
 class TcpSocket;
@@ -30,16 +32,27 @@ class TcpSocket;
 
 namespace tes::view
 {
+class RewindCache;
 class ThirdEyeScene;
 
 /// A @c DataThread implementation which reads and processes packets form a live network connection.
+///
+/// Playback controls are supported when a @c RewindCache is given. The cache captures a snapshot
+/// at the end of a live frame at most once per @c RewindCache::interval() . Pausing freezes the
+/// display at the next frame boundary, while the thread continues to read the socket, queuing
+/// incoming messages. While frozen, the target frame is restored from the rewind cache, limited to
+/// the cached frames. Unpausing restores the live scene and processes the queued messages. The
+/// thread unpauses automatically should the queue exceed @c kMaxQueuedBytes .
 class TES_VIEWER_API NetworkThread : public DataThread
 {
 public:
   using Clock = std::chrono::steady_clock;
 
+  /// Maximum number of bytes queued while paused before automatically unpausing.
+  static constexpr size_t kMaxQueuedBytes = 256u * 1024u * 1024u;
+
   NetworkThread(std::shared_ptr<ThirdEyeScene> tes, const std::string &host, uint16_t port,
-                bool allow_reconnect = true);
+                bool allow_reconnect = true, std::shared_ptr<RewindCache> rewind_cache = nullptr);
   ~NetworkThread() override;
 
   /// The host to which we'll be connecting.
@@ -72,12 +85,21 @@ public:
 
   /// Reports whether the current stream is a live connection or a replay.
   ///
-  /// Live streams do not support playback controls such as pausing and stepping.
+  /// Live streams only support playback controls such as pausing and stepping when
+  /// @c canPause() .
   /// @return True if this is a live stream.
   bool isLiveStream() const override;
 
+  /// Live streams may be paused when there is a rewind cache.
+  /// @return True if a @c RewindCache is available.
+  bool canPause() const override { return _rewind_cache != nullptr; }
+
+  bool rewindCacheStats(RewindCacheStats &stats) const override;
+
   /// Set the target frame to update to. This represents a frame jump.
   ///
+  /// Only effective while paused. The target is limited to the frames in the rewind cache.
+  ///
   /// Threadsafe.
   /// @param frame The frame to jump, skip or step to.
   void setTargetFrame(FrameNumber frame) override;
@@ -90,7 +112,17 @@ public:
   /// Get the current frame number.
   FrameNumber currentFrame() const override { return _currentFrame; }
 
-  FrameNumber totalFrames() const override { return _currentFrame; }
+  /// Get the latest frame received from the live stream. May be ahead of @c currentFrame() while
+  /// paused.
+  FrameNumber totalFrames() const override { return _live_frame; }
+
+  /// Steps back to the nearest cached frame before the @c currentFrame() .
+  /// @return The frame a step backward reaches. The @c currentFrame() if unable to step.
+  FrameNumber stepBackwardFrame() const override;
+
+  /// Steps forward to the nearest cached frame after the @c currentFrame() , or to the live frame.
+  /// @return The frame a step forward reaches. The @c currentFrame() if unable to step.
+  FrameNumber stepForwardFrame() const override;
 
   void setLooping(bool loop) override;
   bool looping() const override;
@@ -109,7 +141,7 @@ public:
 
   /// Check if playback is paused.
   /// @return True if playback is paused.
-  bool paused() const override { return false; }
+  bool paused() const override { return _paused; }
   /// Pause playback.
   void pause() override;
   /// Unpause and resume playback.
@@ -126,22 +158,41 @@ private:
   void configureSocket(TcpSocket &socket);
   void runWith(TcpSocket &socket);
 
-  /// Process a control packet.
-  ///
-  /// This covers end of frame events, so the return value indicates how long to delay before the
-  /// next frame.
+  /// Process a message from the live stream.
+  /// @param packet The message packet.
+  void processMessage(PacketReader &packet);
+
+  /// Process a message from a scene snapshot.
+  /// @param packet The message packet.
+  void processSnapshotMessage(PacketReader &packet);
+
+  /// Handle the end of a live frame, capturing a rewind snapshot and freezing when paused.
+  void onFrameEnd();
+
+  /// Update the paused state: restore the target frame while frozen, or thaw on unpause.
+  void updatePlayback();
+
+  /// Freeze the display, capturing the live scene so it can be restored on @c thaw() .
+  void freeze();
+
+  /// Restore the live scene and process the messages queued while frozen.
+  void thaw();
+
+  /// Show @p target_frame from the rewind cache while frozen.
+  /// @param target_frame The frame to show.
+  void showFrame(FrameNumber target_frame);
+
+  /// Restore the live scene captured on @c freeze() , if not currently displayed.
+  void restoreLive();
+
+  /// Queue a live stream message while frozen.
+  /// @param header The message packet header.
+  void queueMessage(const PacketHeader *header);
+
+  /// Process a control packet via @c processLiveControlMessage() .
   ///
-  /// Handles the following messages:
-  /// - @c CIdFrame increments @p _currentFrame and @c _total_frames if less than current, then
-  /// calls
-  ///   @c ThirdEyeScene::updateToFrame() .
-  /// - @c CIdCoordinateFrame updates @c _server_info then calls @c
-  /// ThirdEyeScene::updateServerInfo() .
-  /// - @c CIdFrameCount updates @c _total_frames.
-  /// - @c CIdForceFrameFlush calls @c ThirdEyeScene::updateToFrame() with the @p _currentFrame.
-  /// - @c CIdReset resets the @c _currentFrame and calls @c ThirdEyeScene::reset() .
-  /// - @c CIdKeyframe - irrelevant for a live stream.
-  /// - @c CIdEnd - irrelevant for a live stream.
+  /// Additionally, @c CIdFrame updates @c _live_frame then calls @c onFrameEnd() , while
+  /// @c CIdReset resets @c _live_frame and clears the rewind cache.
   ///
   /// @param packet The packet to control. The routing Id is always @c MtControl.
   void processControlMessage(PacketReader &packet);
@@ -153,15 +204,28 @@ private:
   std::atomic_bool _connected = false;
   std::atomic_bool _connection_attempted = false;
   std::atomic_bool _allow_reconnect = true;
+  std::atomic_bool _paused = false;
   FrameNumberAtomic _currentFrame = 0;
+  /// The latest frame from the live stream.
+  FrameNumberAtomic _live_frame = 0;
+  /// Requested frame while paused. Protected by @c _data_mutex .
+  std::optional<FrameNumber> _target_frame;
   /// The total number of frames in the stream, if know. Zero when unknown.
   FrameNumber _total_frames = 0;
   std::string _host;
   uint16_t _port = 0;
   /// The scene manager.
   std::shared_ptr<ThirdEyeScene> _tes;
+  /// Recent frame snapshots. Null when pausing is not supported.
+  std::shared_ptr<RewindCache> _rewind_cache;
   std::thread _thread;
   ServerInfoMessage _server_info = {};
+  /// Display frozen by a pause. Only accessed by the network thread.
+  bool _frozen = false;
+  /// Live scene snapshot captured on freezing.
+  std::vector<uint8_t> _live_snapshot;
+  /// Live stream messages queued while frozen.
+  std::vector<uint8_t> _queued;
 };
 }  // namespace tes::view
 
@@ -0,0 +1,175 @@
+#include "RewindCache.h"
+
+#include <algorithm>
+
+namespace tes::view
+{
+RewindCache::RewindCache(uint64_t byte_limit, unsigned window_frames, Clock::duration interval)
+  : _interval(interval)
+  , _window_frames(std::max(window_frames, 1u))
+{
+  _stats.byte_limit = byte_limit;
+}
+
+
+uint64_t RewindCache::byteLimit() const
+{
+  const std::lock_guard guard(_lock);
+  return _stats.byte_limit;
+}
+
+
+bool RewindCache::due(FrameNumber frame, FrameNumber cursor) const
+{
+  const std::lock_guard guard(_lock);
+  return _stats.byte_limit > 0 && frame <= cursor && cursor - frame < _window_frames &&
+         _snapshots.find(frame) == _snapshots.end();
+}
+
+
+bool RewindCache::dueByTime(FrameNumber frame) const
+{
+  const std::lock_guard guard(_lock);
+  return _stats.byte_limit > 0 &&
+         (!_last_add_time.has_value() || Clock::now() - *_last_add_time >= _interval) &&
+         _snapshots.find(frame) == _snapshots.end();
+}
+
+
+bool RewindCache::add(FrameNumber frame, uint64_t stream_offset,
+                      const KeyframeStore::SerialiseFunction &serialise)
+{
+  // Capture without the lock. The serialisation may be slow.
+  auto packet = std::make_shared<std::vector<uint8_t>>();
+  if (!KeyframeStore::capture(serialise, *packet))
+  {
+    return false;
+  }
+
+  Snapshot snapshot;
+  snapshot.frame = frame;
+  snapshot.stream_offset = stream_offset;
+  snapshot.packet = std::move(packet);
+
+  const std::lock_guard guard(_lock);
+  const uint64_t byte_count = snapshot.packet->size();
+  if (byte_count > _stats.byte_limit)
+  {
+    return false;
+  }
+
+  auto existing = _snapshots.find(frame);
+  if (existing != _snapshots.end())
+  {
+    _stats.byte_count -= existing->second.packet->size();
+    _snapshots.erase(existing);
+  }
+
+  // Evict the snapshots furthest from the new frame.
+  while (!_snapshots.empty() && _stats.byte_count + byte_count > _stats.byte_limit)
+  {
+    const FrameNumber first = _snapshots.begin()->first;
+    const FrameNumber last = _snapshots.rbegin()->first;
+    const FrameNumber first_distance = (first < frame) ? frame - first : first - frame;
+    const FrameNumber last_distance = (last < frame) ? frame - last : last - frame;
+    auto evict =
+      (first_distance >= last_distance) ? _snapshots.begin() : std::prev(_snapshots.end());
+    _stats.byte_count -= evict->second.packet->size();
+    _snapshots.erase(evict);
+    ++_stats.evictions;
+  }
+
+  _stats.byte_count += byte_count;
+  _snapshots.emplace(frame, std::move(snapshot));
+  _stats.snapshot_count = _snapshots.size();
+  _last_add_time = Clock::now();
+  return true;
+}
+
+
+bool RewindCache::nearest(FrameNumber frame, FrameNumber &snapshot_frame) const
+{
+  const std::lock_guard guard(_lock);
+  auto iter = _snapshots.upper_bound(frame);
+  if (iter == _snapshots.begin())
+  {
+    return false;
+  }
+  snapshot_frame = std::prev(iter)->first;
+  return true;
+}
+
+
+bool RewindCache::following(FrameNumber frame, FrameNumber &snapshot_frame) const
+{
+  const std::lock_guard guard(_lock);
+  auto iter = _snapshots.lower_bound(frame);
+  if (iter == _snapshots.end())
+  {
+    return false;
+  }
+  snapshot_frame = iter->first;
+  return true;
+}
+
+
+bool RewindCache::oldest(FrameNumber &snapshot_frame) const
+{
+  const std::lock_guard guard(_lock);
+  if (_snapshots.empty())
+  {
+    return false;
+  }
+  snapshot_frame = _snapshots.begin()->first;
+  return true;
+}
+
+
+bool RewindCache::restore(FrameNumber frame, const KeyframeStore::MessageFunction &handler,
+                          FrameNumber &snapshot_frame, uint64_t &stream_offset)
+{
+  Snapshot snapshot;
+  {
+    const std::lock_guard guard(_lock);
+    auto iter = _snapshots.upper_bound(frame);
+    if (iter == _snapshots.begin())
+    {
+      ++_stats.misses;
+      return false;
+    }
+    snapshot = std::prev(iter)->second;
+  }
+
+  // Decode without the lock as the handler may block on the scene.
+  const bool decoded = KeyframeStore::decode(*snapshot.packet, handler);
+
+  const std::lock_guard guard(_lock);
+  if (!decoded)
+  {
+    ++_stats.misses;
+    return false;
+  }
+
+  ++_stats.hits;
+  snapshot_frame = snapshot.frame;
+  stream_offset = snapshot.stream_offset;
+  return true;
+}
+
+
+void RewindCache::clear()
+{
+  const std::lock_guard guard(_lock);
+  _snapshots.clear();
+  _last_add_time.reset();
+  _stats.snapshot_count = 0;
+  _stats.byte_count = 0;
+}
+
+
+void RewindCache::stats(RewindCacheStats &stats) const
+{
+  const std::lock_guard guard(_lock);
+  stats = _stats;
+}
+}  // namespace tes::view
@@ -0,0 +1,174 @@
+#ifndef TES_VIEW_REWIND_CACHE_H
+#define TES_VIEW_REWIND_CACHE_H
+
+#include <3esview/ViewConfig.h>
+
+#include "KeyframeStore.h"
+
+#include <3esview/FrameStamp.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace tes::view
+{
+/// Statistics for a @c RewindCache .
+struct TES_VIEWER_API RewindCacheStats
+{
+  /// Number of lookups which found a snapshot.
+  uint64_t hits = 0;
+  /// Number of lookups which found no snapshot.
+  uint64_t misses = 0;
+  /// Number of snapshots evicted to stay within the @c byte_limit .
+  uint64_t evictions = 0;
+  /// Number of snapshots currently cached.
+  uint64_t snapshot_count = 0;
+  /// Number of bytes currently cached.
+  uint64_t byte_count = 0;
+  /// The memory budget in bytes.
+  uint64_t byte_limit = 0;
+};
+
+/// An in-memory cache of recent scene snapshots, supporting fast stepping backwards.
+///
+/// Snapshots are captured at frame boundaries - see @c KeyframeStore::capture() . Capturing
+/// serialises the whole scene, so snapshots are not captured every frame. For recordings, which
+/// can be replayed, frames are only captured within @c windowFrames() before a cursor - the paused
+/// frame or the frame being sought - see @c due() . Live streams cannot be replayed, so frames are
+/// captured at most once per @c interval() instead - see @c dueByTime() .
+///
+/// The total snapshot size is bounded by @c byteLimit() . Adding a snapshot beyond the limit
+/// evicts the cached snapshots furthest from the new frame, so the cache holds the frames nearest
+/// the playback position.
+///
+/// This complements the @c KeyframeStore , which holds sparse, persistent keyframes. Each
+/// snapshot records the stream offset following its frame, where applicable, so playback of a
+/// recording may resume from a restored snapshot. Live streams have no stream offset.
+///
+/// The cache is threadsafe.
+class TES_VIEWER_API RewindCache
+{
+public:
+  /// Default value for @c byteLimit() .
+  static constexpr uint64_t kDefaultByteLimit = 256u * 1024u * 1024u;
+  /// Default value for @c windowFrames() .
+  static constexpr unsigned kDefaultWindowFrames = 32u;
+  /// Default value for @c interval() .
+  static constexpr std::chrono::milliseconds kDefaultInterval = std::chrono::milliseconds(1000);
+
+  /// Clock used for @c interval() .
+  using Clock = std::chrono::steady_clock;
+
+  /// A cached snapshot.
+  struct Snapshot
+  {
+    /// The frame number the snapshot restores.
+    FrameNumber frame = 0;
+    /// Stream offset following the frame. Zero for live streams.
+    uint64_t stream_offset = 0;
+    /// Snapshot packet from @c KeyframeStore::capture() . Shared so a restore may decode the
+    /// packet outside the cache lock.
+    std::shared_ptr<const std::vector<uint8_t>> packet;
+  };
+
+  /// Constructor.
+  /// @param byte_limit The memory budget. Zero disables the cache.
+  /// @param window_frames Number of frames up to a cursor to capture. See @c due() .
+  /// @param interval Minimum time between snapshots for @c dueByTime() .
+  RewindCache(uint64_t byte_limit = kDefaultByteLimit,
+              unsigned window_frames = kDefaultWindowFrames,
+              Clock::duration interval = kDefaultInterval);
+
+  /// Query the memory budget.
+  /// @return The memory budget in bytes.
+  [[nodiscard]] uint64_t byteLimit() const;
+
+  /// Query the number of frames captured up to a cursor.
+  /// @return The capture window in frames.
+  [[nodiscard]] unsigned windowFrames() const { return _window_frames; }
+
+  /// Query the minimum time between snapshots for @c dueByTime() .
+  /// @return The snapshot interval.
+  [[nodiscard]] Clock::duration interval() const { return _interval; }
+
+  /// Check if a snapshot should be captured at the end of @p frame , given a @p cursor frame.
+  ///
+  /// The cursor is the frame the user is paused on, or seeking to. Snapshots are due for the
+  /// @c windowFrames() frames up to and including the cursor, so stepping back from the cursor
+  /// restores a snapshot rather than replaying the recording.
+  ///
+  /// @param frame The frame which has just ended.
+  /// @param cursor The paused or target frame.
+  /// @return True if enabled, @p frame is within the window before @p cursor and is not cached.
+  [[nodiscard]] bool due(FrameNumber frame, FrameNumber cursor) const;
+
+  /// Check if a snapshot should be captured at the end of @p frame based on the time since the
+  /// last snapshot was added. For live streams, which have no cursor until paused.
+  /// @param frame The frame which has just ended.
+  /// @return True if enabled, at least @c interval() has elapsed since the last @c add() and
+  ///   @p frame is not cached.
+  [[nodiscard]] bool dueByTime(FrameNumber frame) const;
+
+  /// Capture and add a snapshot for @p frame , evicting snapshots as required.
+  ///
+  /// @param frame The frame which has just ended.
+  /// @param stream_offset The stream offset following @p frame , or zero for a live stream.
+  /// @param serialise Function which serialises the scene.
+  /// @return True if added. False on capture failure, or if the snapshot exceeds the budget.
+  bool add(FrameNumber frame, uint64_t stream_offset,
+           const KeyframeStore::SerialiseFunction &serialise);
+
+  /// Find the nearest cached frame at or before @p frame without affecting the statistics.
+  /// @param frame The target frame.
+  /// @param[out] snapshot_frame Set to the cached frame number.
+  /// @return True if a snapshot was found.
+  bool nearest(FrameNumber frame, FrameNumber &snapshot_frame) const;
+
+  /// Find the nearest cached frame at or after @p frame without affecting the statistics. Used to
+  /// step forwards through a paused live stream, which cannot be replayed.
+  /// @param frame The target frame.
+  /// @param[out] snapshot_frame Set to the cached frame number.
+  /// @return True if a snapshot was found.
+  bool following(FrameNumber frame, FrameNumber &snapshot_frame) const;
+
+  /// Query the oldest cached frame.
+  /// @param[out] snapshot_frame Set to the oldest cached frame number.
+  /// @return True if the cache is not empty.
+  bool oldest(FrameNumber &snapshot_frame) const;
+
+  /// Restore the nearest snapshot at or before @p frame , calling @p handler for each message.
+  ///
+  /// Counts a hit or a miss.
+  ///
+  /// @param frame The target frame.
+  /// @param handler Function called for each snapshot message.
+  /// @param[out] snapshot_frame Set to the restored frame number.
+  /// @param[out] stream_offset Set to the stream offset following the restored frame.
+  /// @return True if a snapshot was restored.
+  bool restore(FrameNumber frame, const KeyframeStore::MessageFunction &handler,
+               FrameNumber &snapshot_frame, uint64_t &stream_offset);
+
+  /// Remove all snapshots. Statistics are preserved.
+  void clear();
+
+  /// Populate the cache statistics.
+  /// @param[out] stats The stats object to populate.
+  void stats(RewindCacheStats &stats) const;
+
+private:
+  mutable std::mutex _lock;
+  std::map<FrameNumber, Snapshot> _snapshots;
+  RewindCacheStats _stats;
+  /// Time of the last successful @c add() . Unset before the first @c add() or after @c clear() .
+  std::optional<Clock::time_point> _last_add_time;
+  Clock::duration _interval = kDefaultInterval;
+  unsigned _window_frames = kDefaultWindowFrames;
+};
+}  // namespace tes::view
+
+#endif  // TES_VIEW_REWIND_CACHE_H
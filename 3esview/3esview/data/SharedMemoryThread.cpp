@@ -0,0 +1,171 @@
+#include "SharedMemoryThread.h"
+
+#include <3esview/ThirdEyeScene.h>
+
+#include <3escore/CollatedPacketDecoder.h>
+#include <3escore/Log.h>
+#include <3escore/PacketReader.h>
+#include <3escore/SharedMemoryReader.h>
+#include <3escore/SharedMemoryRing.h>
+
+#include <chrono>
+#include <utility>
+
+namespace tes::view
+{
+namespace
+{
+/// Time to wait for data before checking for a quit request.
+constexpr unsigned kReadTimeoutMs = 100;
+}  // namespace
+
+
+SharedMemoryThread::SharedMemoryThread(std::shared_ptr<ThirdEyeScene> tes, const std::string &name,
+                                       bool allow_reconnect)
+  : _allow_reconnect(allow_reconnect)
+  , _name(name)
+{
+  _tes = std::exchange(tes, nullptr);
+  _thread = std::thread([this] { run(); });
+}
+
+
+SharedMemoryThread::~SharedMemoryThread() = default;
+
+
+bool SharedMemoryThread::isLiveStream() const
+{
+  return true;
+}
+
+
+void SharedMemoryThread::setTargetFrame(FrameNumber frame)
+{
+  // Not supported.
+  (void)frame;
+}
+
+
+FrameNumber SharedMemoryThread::targetFrame() const
+{
+  return 0;
+}
+
+
+void SharedMemoryThread::setLooping(bool loop)
+{
+  // Not supported.
+  (void)loop;
+}
+
+
+bool SharedMemoryThread::looping() const
+{
+  return false;
+}
+
+
+void SharedMemoryThread::pause()
+{
+  // Not supported.
+}
+
+
+void SharedMemoryThread::unpause()
+{
+  // Not supported.
+}
+
+
+void SharedMemoryThread::join()
+{
+  _quit_flag = true;
+  _allow_reconnect = false;
+  _thread.join();
+}
+
+
+void SharedMemoryThread::run()
+{
+  do
+  {
+    SharedMemoryRing ring;
+    const bool connected = ring.open(_name);
+    _connected = connected;
+    _connection_attempted = true;
+    if (!connected)
+    {
+      if (_allow_reconnect)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      }
+      continue;
+    }
+
+    runWith(ring);
+    ring.close();
+    _connected = false;
+  } while (_allow_reconnect && !_quit_flag);
+}
+
+
+void SharedMemoryThread::runWith(SharedMemoryRing &ring)
+{
+  CollatedPacketDecoder packet_decoder;
+  // Extracts packets in place from the ring, copying only packets which wrap the end of the ring.
+  SharedMemoryReader reader(ring);
+
+  _current_frame = 0;
+  _total_frames = 0;
+
+  // Make sure we reset from any previous connection.
+  _tes->reset();
+
+  while (!_quit_flag)
+  {
+    const auto *packet_header = reader.extractPacket(kReadTimeoutMs);
+    if (!packet_header)
+    {
+      if (!reader.isOk())
+      {
+        log::error("Invalid data in shared memory stream: ", _name);
+        break;
+      }
+      if (reader.isEof())
+      {
+        // The server has closed the stream and it has been fully read.
+        break;
+      }
+      continue;
+    }
+
+    packet_decoder.setPacket(packet_header);
+    while ((packet_header = packet_decoder.next()))
+    {
+      PacketReader packet(packet_header);
+      switch (packet.routingId())
+      {
+      case MtControl:
+        processControlMessage(packet);
+        break;
+      case MtServerInfo:
+        if (processServerInfo(packet, _server_info))
+        {
+          _tes->updateServerInfo(_server_info);
+        }
+        break;
+      default:
+        _tes->processMessage(packet);
+        break;
+      }
+    }
+  }
+}
+
+
+void SharedMemoryThread::processControlMessage(PacketReader &packet)
+{
+  ControlMessage msg;
+  processLiveControlMessage(packet, *_tes, _current_frame, _total_frames, _server_info, msg);
+}
+}  // namespace tes::view
@@ -0,0 +1,127 @@
+#ifndef TES_VIEW_SHARED_MEMORY_THREAD_H
+#define TES_VIEW_SHARED_MEMORY_THREAD_H
+
+#include <3esview/ViewConfig.h>
+
+#include "DataThread.h"
+
+#include <3esview/FrameStamp.h>
+
+#include <3escore/Messages.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace tes
+{
+class PacketReader;
+class SharedMemoryRing;
+}  // namespace tes
+
+namespace tes::view
+{
+class ThirdEyeScene;
+
+/// A @c DataThread implementation which reads and processes packets from a server on the same
+/// host via a @c SharedMemoryRing .
+///
+/// This is the shared memory equivalent of the @c NetworkThread . Packets are decoded in place
+/// from the shared memory ring via a @c SharedMemoryReader , avoiding the socket system calls and
+/// copies. Only packets which wrap the end of the ring are copied. The server must be listening
+/// via @c ConnectionMonitor::openSharedMemory() .
+class TES_VIEWER_API SharedMemoryThread : public DataThread
+{
+public:
+  SharedMemoryThread(std::shared_ptr<ThirdEyeScene> tes, const std::string &name,
+                     bool allow_reconnect = true);
+  ~SharedMemoryThread() override;
+
+  /// The shared memory object name to attach to.
+  /// @return The shared memory name.
+  const std::string &name() const { return _name; }
+
+  /// Is the thread allowed keep trying to attach after failing or losing the server?
+  /// @return True if reconnection is allowed.
+  bool allowReconnect() const { return _allow_reconnect; }
+
+  /// Set whether the thread is allowed try reattaching on failure or loss.
+  /// @param allow True to allow reconnection.
+  void setAllowReconnect(bool allow) { _allow_reconnect = allow; }
+
+  /// Check if attached to a server's ring.
+  /// @return True when connected.
+  bool connected() const { return _connected; }
+
+  /// Check if at least one connection has been attempted.
+  /// @return True if a connection has been attempted.
+  bool connectionAttempted() const { return _connection_attempted; }
+
+  /// Always true.
+  /// @return True
+  bool isLiveStream() const override;
+
+  /// Not supported.
+  /// @param frame Ignored.
+  void setTargetFrame(FrameNumber frame) override;
+
+  /// Always zero.
+  /// @return Zero.
+  FrameNumber targetFrame() const override;
+
+  /// Get the current frame number.
+  FrameNumber currentFrame() const override { return _current_frame; }
+
+  FrameNumber totalFrames() const override { return _current_frame; }
+
+  void setLooping(bool loop) override;
+  bool looping() const override;
+
+  /// Request the thread to quit. The thread may then be joined.
+  void stop() override
+  {
+    _quit_flag = true;
+    _allow_reconnect = false;
+  }
+
+  /// Check if a quit has been requested.
+  /// @return True when a quit has been requested.
+  bool stopping() const { return _quit_flag; }
+
+  bool paused() const override { return false; }
+  /// Not supported.
+  void pause() override;
+  /// Not supported.
+  void unpause() override;
+
+  /// Wait for this thread to finish.
+  void join() override;
+
+protected:
+  /// Thread entry point.
+  void run();
+
+private:
+  void runWith(SharedMemoryRing &ring);
+
+  /// Process a control packet. See @c processLiveControlMessage() .
+  /// @param packet The packet to control. The routing Id is always @c MtControl.
+  void processControlMessage(PacketReader &packet);
+
+  std::atomic_bool _quit_flag = false;
+  std::atomic_bool _connected = false;
+  std::atomic_bool _connection_attempted = false;
+  std::atomic_bool _allow_reconnect = true;
+  FrameNumberAtomic _current_frame = 0;
+  /// The total number of frames in the stream, if know. Zero when unknown.
+  FrameNumber _total_frames = 0;
+  std::string _name;
+  /// The scene manager.
+  std::shared_ptr<ThirdEyeScene> _tes;
+  std::thread _thread;
+  ServerInfoMessage _server_info = {};
+};
+}  // namespace tes::view
+
+#endif  // TES_VIEW_SHARED_MEMORY_THREAD_H
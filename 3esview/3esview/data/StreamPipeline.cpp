@@ -0,0 +1,342 @@
+#include "StreamPipeline.h"
+
+#include <3escore/CollatedPacketDecoder.h>
+#include <3escore/Log.h>
+#include <3escore/MappedFile.h>
+#include <3escore/Messages.h>
+#include <3escore/PacketReader.h>
+#include <3escore/PacketStreamReader.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace tes::view
+{
+struct StreamPipeline::Slot
+{
+  enum class State
+  {
+    Pending,
+    Decoding,
+    Ready
+  };
+
+  Packet packet;
+  /// The raw packet to decode, referencing the @c mapping or @c raw_copy . Cleared once decoded.
+  const PacketHeader *raw = nullptr;
+  /// Keeps the mapping referenced by the @c raw packet alive. Null when the stream is not mapped.
+  std::shared_ptr<const MappedFile> mapping;
+  /// Copy of the raw packet when the stream is not mapped. Released once decoded unless the
+  /// messages are referenced in place.
+  std::vector<uint8_t> raw_copy;
+  /// Decompressed messages.
+  std::vector<uint8_t> decoded;
+  /// Byte size of the raw packet for queue accounting.
+  size_t raw_size = 0;
+  State state = State::Pending;
+};
+
+
+const PacketHeader *StreamPipeline::Packet::next(size_t &cursor) const
+{
+  if (!messages || cursor + sizeof(PacketHeader) > message_bytes)
+  {
+    return nullptr;
+  }
+
+  const auto *header = reinterpret_cast<const PacketHeader *>(messages + cursor);
+  cursor += PacketReader(header).packetSize();
+  return header;
+}
+
+
+StreamPipeline::StreamPipeline(std::unique_ptr<PacketStreamReader> reader, unsigned worker_count,
+                               size_t queue_bytes)
+  : _reader(std::move(reader))
+  , _queue_bytes(std::max<size_t>(queue_bytes, 1u))
+  , _position(_reader->position())
+{
+  _workers.reserve(worker_count);
+  for (unsigned i = 0; i < worker_count; ++i)
+  {
+    _workers.emplace_back([this] { decodeLoop(); });
+  }
+}
+
+
+StreamPipeline::~StreamPipeline()
+{
+  stop();
+  stopReading();
+  for (auto &worker : _workers)
+  {
+    worker.join();
+  }
+}
+
+
+unsigned StreamPipeline::defaultWorkerCount()
+{
+  // Leave a core for the dispatch thread. Beyond a few workers, dispatch is the bottleneck.
+  const unsigned hardware_threads = std::thread::hardware_concurrency();
+  return std::clamp(hardware_threads, 2u, 5u) - 1u;
+}
+
+
+std::shared_ptr<const StreamPipeline::Packet> StreamPipeline::next()
+{
+  std::unique_lock lock(_lock);
+  for (;;)
+  {
+    if (_quit)
+    {
+      return nullptr;
+    }
+
+    if (_queue.empty())
+    {
+      if (_read_end)
+      {
+        return nullptr;
+      }
+      if (!_reading)
+      {
+        startReading();
+      }
+      _ready_signal.wait(lock);
+      continue;
+    }
+
+    auto slot = _queue.front();
+    switch (slot->state)
+    {
+    case Slot::State::Ready:
+      _queue.pop_front();
+      _queued_bytes -= slot->raw_size;
+      _position = slot->packet.stream_offset;
+      // Wake the read thread for the free space.
+      _space_signal.notify_one();
+      return std::shared_ptr<const Packet>(slot, &slot->packet);
+    case Slot::State::Pending:
+      // Don't wait for a worker. Decode it here. The head is always the first pending packet.
+      _pending.pop_front();
+      slot->state = Slot::State::Decoding;
+      lock.unlock();
+      decode(*slot);
+      lock.lock();
+      slot->state = Slot::State::Ready;
+      break;
+    case Slot::State::Decoding:
+    default:
+      _ready_signal.wait(lock);
+      break;
+    }
+  }
+}
+
+
+bool StreamPipeline::isEof() const
+{
+  const std::lock_guard guard(_lock);
+  return _read_end && _queue.empty();
+}
+
+
+uint64_t StreamPipeline::position() const
+{
+  const std::lock_guard guard(_lock);
+  return _position;
+}
+
+
+void StreamPipeline::seek(uint64_t offset)
+{
+  stopReading();
+  _reader->seek(static_cast<std::streamoff>(offset));
+  const std::lock_guard guard(_lock);
+  _position = _reader->position();
+}
+
+
+bool StreamPipeline::seekFrame(FrameNumber frame)
+{
+  stopReading();
+  const bool ok = _reader->seekFrame(frame);
+  const std::lock_guard guard(_lock);
+  _position = _reader->position();
+  return ok;
+}
+
+
+void StreamPipeline::stop()
+{
+  {
+    const std::lock_guard guard(_lock);
+    _quit = true;
+  }
+  _ready_signal.notify_all();
+  _pending_signal.notify_all();
+  _space_signal.notify_all();
+}
+
+
+void StreamPipeline::startReading()
+{
+  _reading = true;
+  _stop_reading = false;
+  _read_thread = std::thread([this] { readLoop(); });
+}
+
+
+void StreamPipeline::stopReading()
+{
+  {
+    const std::lock_guard guard(_lock);
+    _stop_reading = true;
+  }
+  _space_signal.notify_all();
+
+  if (_read_thread.joinable())
+  {
+    _read_thread.join();
+  }
+
+  // Workers may still be decoding discarded slots. These are released once decoded.
+  const std::lock_guard guard(_lock);
+  _queue.clear();
+  _pending.clear();
+  _queued_bytes = 0;
+  _reading = false;
+  _stop_reading = false;
+  _read_end = false;
+}
+
+
+void StreamPipeline::readLoop()
+{
+  // Packets from a mapped stream are referenced in place, holding the mapping.
+  const auto mapping = _reader->mappedFile();
+  std::unique_lock lock(_lock);
+  for (;;)
+  {
+    _space_signal.wait(lock, [this] {
+      return _quit || _stop_reading ||
+             (_queued_bytes < _queue_bytes && _queue.size() < kMaxQueuedPackets);
+    });
+
+    if (_quit || _stop_reading)
+    {
+      break;
+    }
+
+    // Read without the lock.
+    lock.unlock();
+    auto slot = std::make_shared<Slot>();
+    const PacketHeader *header = _reader->extractPacket();
+    if (header)
+    {
+      const PacketReader packet(header);
+      slot->packet.stream_offset = _reader->position();
+      slot->raw_size = packet.packetSize();
+      if (mapping)
+      {
+        slot->mapping = mapping;
+        slot->raw = header;
+      }
+      else
+      {
+        const auto *bytes = reinterpret_cast<const uint8_t *>(header);
+        slot->raw_copy.assign(bytes, bytes + slot->raw_size);
+        slot->raw = reinterpret_cast<const PacketHeader *>(slot->raw_copy.data());
+      }
+
+      if (packet.routingId() != MtCollatedPacket)
+      {
+        // Nothing to decode. Pass through.
+        slot->packet.messages = reinterpret_cast<const uint8_t *>(slot->raw);
+        slot->packet.message_bytes = slot->raw_size;
+        slot->raw = nullptr;
+        slot->state = Slot::State::Ready;
+      }
+    }
+    lock.lock();
+
+    if (!header)
+    {
+      _read_end = true;
+      _ready_signal.notify_one();
+      break;
+    }
+
+    if (!_stop_reading)
+    {
+      _queued_bytes += slot->raw_size;
+      if (slot->state == Slot::State::Pending)
+      {
+        _pending.emplace_back(slot);
+        _pending_signal.notify_one();
+      }
+      _queue.emplace_back(std::move(slot));
+      // next() only waits on an empty queue or the head packet.
+      if (_queue.size() == 1)
+      {
+        _ready_signal.notify_one();
+      }
+    }
+  }
+}
+
+
+void StreamPipeline::decodeLoop()
+{
+  std::unique_lock lock(_lock);
+  for (;;)
+  {
+    _pending_signal.wait(lock, [this] { return _quit || !_pending.empty(); });
+
+    if (_quit)
+    {
+      break;
+    }
+
+    auto slot = std::move(_pending.front());
+    _pending.pop_front();
+    slot->state = Slot::State::Decoding;
+    lock.unlock();
+    decode(*slot);
+    lock.lock();
+    slot->state = Slot::State::Ready;
+    // next() only waits on the head packet.
+    if (!_queue.empty() && _queue.front() == slot)
+    {
+      _ready_signal.notify_one();
+    }
+  }
+}
+
+
+void StreamPipeline::decode(Slot &slot)
+{
+  CollatedPacketDecoder decoder;
+  if (!decoder.setPacket(slot.raw))
+  {
+    // Drop the packet. Passing it through would dispatch the collated packet as a message.
+    log::error("Failed to decode collated packet at stream offset ",
+               slot.packet.stream_offset - slot.raw_size);
+  }
+  else if (!decoder.decodeAll(slot.decoded, slot.packet.messages, slot.packet.message_bytes))
+  {
+    // Keep the valid messages preceding the failure.
+    log::error("Invalid collated packet content at stream offset ",
+               slot.packet.stream_offset - slot.raw_size);
+  }
+
+  slot.raw = nullptr;
+  if (slot.packet.messages == nullptr || !slot.decoded.empty())
+  {
+    // The messages do not reference the raw packet.
+    slot.raw_copy = std::vector<uint8_t>();
+    slot.mapping = nullptr;
+  }
+}
+}  // namespace tes::view
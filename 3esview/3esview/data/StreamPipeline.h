@@ -0,0 +1,163 @@
+#ifndef TES_VIEW_STREAM_PIPELINE_H
+#define TES_VIEW_STREAM_PIPELINE_H
+
+#include <3esview/ViewConfig.h>
+
+#include <3esview/FrameStamp.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tes
+{
+struct PacketHeader;
+class PacketStreamReader;
+}  // namespace tes
+
+namespace tes::view
+{
+/// Reads and decodes packets from a @c PacketStreamReader in pipelined stages for the
+/// @c StreamThread .
+///
+/// - A read thread extracts packets ahead of playback into a bounded queue.
+/// - Worker threads decode - inflate - collated packets from the queue in parallel.
+/// - @c next() yields the decoded packets in stream order, decoding the head packet itself rather
+///   than waiting when no worker has started on it.
+///
+/// Packets are referenced in place when the stream is memory mapped - see
+/// @c PacketStreamReader::isMapped() - so only compressed collated packets are copied, as they are
+/// decompressed. Otherwise, each packet is copied from the reader once. Collated packets which
+/// cannot be decoded are dropped.
+///
+/// The queue is bounded by @c queueBytes() of packet data and @c kMaxQueuedPackets packets. Seeking
+/// stops the read thread and discards the queue. Reading restarts on the next call to @c next() .
+///
+/// Only @c stop() is threadsafe. Other functions must be called from a single thread.
+class TES_VIEWER_API StreamPipeline
+{
+public:
+  /// Default value for @c queueBytes() .
+  static constexpr size_t kDefaultQueueBytes = 64u * 1024u * 1024u;
+  /// Maximum number of packets to read ahead.
+  static constexpr size_t kMaxQueuedPackets = 256u;
+
+  /// A decoded packet.
+  struct Packet
+  {
+    /// The first decoded message, with the messages back to back. A collated packet yields the
+    /// messages it contains, while other packets are passed through. The messages remain valid
+    /// for the lifetime of the packet. Null when the packet has been dropped.
+    const uint8_t *messages = nullptr;
+    /// Byte size of the @c messages .
+    size_t message_bytes = 0;
+    /// Stream offset following the packet.
+    uint64_t stream_offset = 0;
+
+    /// Iterate the @c messages .
+    /// @param[in,out] cursor The byte offset of the message to return, advanced to the next
+    ///   message. Start with zero.
+    /// @return The message at @p cursor , or null when done.
+    const PacketHeader *next(size_t &cursor) const;
+  };
+
+  /// Constructor.
+  /// @param reader The stream reader. Must not be null.
+  /// @param worker_count Number of decoding threads. Zero decodes on the @c next() caller only.
+  /// @param queue_bytes Maximum number of packet bytes to read ahead.
+  StreamPipeline(std::unique_ptr<PacketStreamReader> reader,
+                 unsigned worker_count = defaultWorkerCount(),
+                 size_t queue_bytes = kDefaultQueueBytes);
+  /// Destructor. Stops and joins the pipeline threads.
+  ~StreamPipeline();
+
+  StreamPipeline(const StreamPipeline &) = delete;
+  StreamPipeline &operator=(const StreamPipeline &) = delete;
+
+  /// Query the default number of decoding threads for this machine.
+  /// @return The default worker count.
+  [[nodiscard]] static unsigned defaultWorkerCount();
+
+  /// Query the maximum number of packet bytes read ahead.
+  /// @return The read ahead limit in bytes.
+  [[nodiscard]] size_t queueBytes() const { return _queue_bytes; }
+
+  /// Get the next decoded packet in stream order, starting the read thread as required. Blocks
+  /// until the packet is available.
+  /// @return The next packet, or null at the end of the stream or once stopped.
+  std::shared_ptr<const Packet> next();
+
+  /// Check if all packets have been read from the stream and returned by @c next() .
+  /// @return True at the end of the stream.
+  [[nodiscard]] bool isEof() const;
+
+  /// Query the stream offset following the last packet returned by @c next() . This is where
+  /// playback resumes after a seek to this position.
+  /// @return The stream offset of the next packet.
+  [[nodiscard]] uint64_t position() const;
+
+  /// Seek to the given stream offset, discarding the read ahead packets.
+  /// @param offset The stream byte offset to seek to.
+  void seek(uint64_t offset);
+
+  /// Seek to the end of @p frame using the reader's frame index, discarding the read ahead packets.
+  /// See @c PacketStreamReader::seekFrame() .
+  /// @param frame The frame number to seek to.
+  /// @return True on success.
+  bool seekFrame(FrameNumber frame);
+
+  /// Stop the pipeline, releasing any thread blocked in @c next() . Threadsafe.
+  void stop();
+
+private:
+  /// A queued packet.
+  struct Slot;
+
+  /// Start the read thread. Requires the @c _lock .
+  void startReading();
+  /// Stop the read thread and discard the queue.
+  void stopReading();
+
+  /// Read thread entry point.
+  void readLoop();
+  /// Decode thread entry point.
+  void decodeLoop();
+  /// Decode the raw packet in @p slot into its @c Packet::messages . The packet is dropped if it
+  /// cannot be decoded.
+  static void decode(Slot &slot);
+
+  std::unique_ptr<PacketStreamReader> _reader;
+  mutable std::mutex _lock;
+  /// Signals @c next() when the queue becomes non empty, the head packet is decoded or reading
+  /// ends.
+  std::condition_variable _ready_signal;
+  /// Signals the workers when a packet is queued for decoding.
+  std::condition_variable _pending_signal;
+  /// Signals the read thread when queue space is freed or reading is to stop.
+  std::condition_variable _space_signal;
+  /// Packets in stream order.
+  std::deque<std::shared_ptr<Slot>> _queue;
+  /// Packets in @c _queue yet to be claimed for decoding, in stream order.
+  std::deque<std::shared_ptr<Slot>> _pending;
+  /// Raw packet bytes in @c _queue .
+  size_t _queued_bytes = 0;
+  size_t _queue_bytes = kDefaultQueueBytes;
+  /// Stream offset following the last packet from @c next() .
+  uint64_t _position = 0;
+  std::thread _read_thread;
+  std::vector<std::thread> _workers;
+  /// True while the read thread is running.
+  bool _reading = false;
+  /// Set to stop the read thread.
+  bool _stop_reading = false;
+  /// Set once the read thread reaches the end of the stream.
+  bool _read_end = false;
+  bool _quit = false;
+};
+}  // namespace tes::view
+
+#endif  // TES_VIEW_STREAM_PIPELINE_H
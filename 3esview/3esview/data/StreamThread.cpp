@@ -1,8 +1,12 @@
 #include "StreamThread.h"
 
+#include "KeyframeStore.h"
+#include "RewindCache.h"
+#include "StreamPipeline.h"
+
 #include <3esview/ThirdEyeScene.h>
 
-#include <3escore/CollatedPacketDecoder.h>
+#include <3escore/Connection.h>
 #include <3escore/Log.h>
 #include <3escore/PacketReader.h>
 #include <3escore/PacketStreamReader.h>
@@ -12,10 +16,30 @@
 
 namespace tes::view
 {
-StreamThread::StreamThread(std::shared_ptr<ThirdEyeScene> tes, std::shared_ptr<std::istream> stream)
-  : _stream_reader(std::make_unique<PacketStreamReader>(std::exchange(stream, nullptr)))
+StreamThread::StreamThread(std::shared_ptr<ThirdEyeScene> tes, std::shared_ptr<std::istream> stream,
+                           std::shared_ptr<KeyframeStore> keyframes,
+                           std::shared_ptr<RewindCache> rewind_cache)
+  : StreamThread(std::move(tes),
+                 std::make_unique<PacketStreamReader>(std::exchange(stream, nullptr)),
+                 std::move(keyframes), std::move(rewind_cache))
+{}
+
+
+StreamThread::StreamThread(std::shared_ptr<ThirdEyeScene> tes,
+                           std::unique_ptr<PacketStreamReader> stream_reader,
+                           std::shared_ptr<KeyframeStore> keyframes,
+                           std::shared_ptr<RewindCache> rewind_cache)
+  : _keyframes(std::exchange(keyframes, nullptr))
+  , _rewind_cache(std::exchange(rewind_cache, nullptr))
   , _tes(std::exchange(tes, nullptr))
 {
+  // Take the frame count from the frame index when available. Otherwise we rely on the
+  // CIdFrameCount message.
+  if (stream_reader->loadFrameIndex())
+  {
+    _total_frames = stream_reader->indexedFrameCount();
+  }
+  _pipeline = std::make_unique<StreamPipeline>(std::move(stream_reader));
   _thread = std::thread([this] { run(); });
 }
 
@@ -32,15 +56,10 @@ bool StreamThread::isLiveStream() const
 void StreamThread::setTargetFrame(FrameNumber frame)
 {
   {
+    // The data thread resolves the target frame - see checkTargetFrameState() - seeking back or
+    // restoring a keyframe as required.
     std::scoped_lock guard(_data_mutex);
     _target_frame = frame;
-    if (_target_frame < _currentFrame)
-    {
-      // Reset and seek back.
-      _tes->reset();
-      _stream_reader->seek(0);
-      _currentFrame = 0;
-    }
   }
   // Ensure the thread wakes up to step the frame.
   // Note we have unlocked the mutex before the notify call.
@@ -86,6 +105,8 @@ void StreamThread::join()
 {
   _quitFlag = true;
   unpause();
+  // Release the thread should it be waiting on the pipeline.
+  _pipeline->stop();
   _thread.join();
 }
 
@@ -98,7 +119,6 @@ void StreamThread::run()
   std::istream::pos_type last_keyframe_position = 0;
   bool at_frame_boundary = false;
   bool have_server_info = false;
-  CollatedPacketDecoder packer_decoder;
 
   while (!_quitFlag)
   {
@@ -116,6 +136,8 @@ void StreamThread::run()
       skipBack(target_frame);
       break;
     case TargetFrameState::Ahead:  // Catch up.
+      // Jump to a keyframe if we have one well ahead of the current frame.
+      restoreKeyframe(target_frame, true);
       _catchingUp = true;
       break;
     case TargetFrameState::Reached:  // Result normal playback.
@@ -129,7 +151,7 @@ void StreamThread::run()
       continue;
     }
 
-    if (_stream_reader->isEof())
+    if (_pipeline->isEof())
     {
       if (_looping)
       {
@@ -139,19 +161,21 @@ void StreamThread::run()
     }
 
     at_frame_boundary = false;  // Tracks when we reach a frame boundary.
-    while (!_quitFlag && !at_frame_boundary && _stream_reader->isOk() && !_stream_reader->isEof())
+    while (!_quitFlag && !at_frame_boundary && !_pipeline->isEof())
     {
-      auto packet_header = _stream_reader->extractPacket();
-      if (packet_header)
+      // The pipeline handles collated packets, yielding the decoded messages.
+      const auto decoded = _pipeline->next();
+      if (decoded)
       {
-        // Handle collated packets by wrapping the header.
-        // This is fine for normal packets too.
-        packer_decoder.setPacket(packet_header);
-
+        // Keyframes may only be captured when the packet ends with the frame. The stream must
+        // resume from the next packet on restoring the keyframe.
+        bool frame_ended = false;
+        size_t cursor = 0;
         // Iterate packets while we decode. These do not need to be released.
-        while (auto *header = packer_decoder.next())
+        while (auto *header = decoded->next(cursor))
         {
           PacketReader packet(header);
+          frame_ended = packet.routingId() == MtControl && packet.messageId() == CIdFrame;
           // Lock for frame control messages as these tell us to advance the frame and how long to
           // wait.
           switch (packet.routingId())
@@ -171,37 +195,196 @@ void StreamThread::run()
               next_frame_start = Clock::now();
             }
             break;
+          case MtFrameIndex:
+            // Trailing frame index. Loaded on construction.
+            break;
           default:
             _tes->processMessage(packet);
             break;
           }
         }
+
+        if (frame_ended)
+        {
+          captureSnapshots(decoded->stream_offset);
+        }
       }
     }
   }
 }
 
 
-void StreamThread::skipBack(FrameNumber targetFrame)
+bool StreamThread::rewindCacheStats(RewindCacheStats &stats) const
 {
-  // Simple implementation until we get keyframes.
-  setTargetFrame(targetFrame);
+  if (_rewind_cache)
+  {
+    _rewind_cache->stats(stats);
+    return true;
+  }
+  return false;
 }
 
 
-bool StreamThread::blockOnPause()
+void StreamThread::skipBack(FrameNumber target_frame)
 {
-  if (_paused && targetFrame() == 0)
+  // Prefer the in-memory rewind cache unless there is a closer keyframe.
+  FrameNumber cached_frame = 0;
+  KeyframeStore::Keyframe keyframe;
+  const bool have_keyframe = _keyframes && _keyframes->nearest(target_frame, keyframe);
+  const bool prefer_cache =
+    _rewind_cache &&
+    (!have_keyframe || !_rewind_cache->nearest(target_frame, cached_frame) ||
+     cached_frame >= keyframe.frame);
+  if (prefer_cache && restoreCached(target_frame))
   {
-    std::unique_lock lock(_data_mutex);
-    // Wait for unpause.
-    _notify.wait(lock, [this] {
-      if (!_paused || targetFrame() != 0)
+    return;
+  }
+
+  if (!restoreKeyframe(target_frame))
+  {
+    // No keyframe. Reset and replay from the start.
+    _tes->reset();
+    _pipeline->seekFrame(0);
+    _currentFrame = 0;
+  }
+}
+
+
+bool StreamThread::restoreKeyframe(FrameNumber target_frame, bool skip_forward)
+{
+  KeyframeStore::Keyframe keyframe;
+  if (!_keyframes || !_keyframes->nearest(target_frame, keyframe))
+  {
+    return false;
+  }
+
+  // Only skip forward when restoring is cheaper than reading on to the keyframe.
+  if (skip_forward && (keyframe.frame <= _currentFrame ||
+                       keyframe.stream_offset <
+                         _pipeline->position() + _keyframes->intervalBytes()))
+  {
+    return false;
+  }
+
+  _tes->reset();
+  const bool restored = _keyframes->replay(
+    keyframe, [this](PacketReader &packet) { processSnapshotMessage(packet); });
+
+  if (!restored)
+  {
+    log::error("Failed to restore keyframe for frame ", keyframe.frame);
+    _tes->reset();
+    // Restore the stream state so the caller can fall back to replaying the stream.
+    _pipeline->seekFrame(0);
+    _currentFrame = 0;
+    return false;
+  }
+
+  _pipeline->seek(keyframe.stream_offset);
+  _currentFrame = keyframe.frame;
+  _tes->updateToFrame(_currentFrame);
+  return true;
+}
+
+
+bool StreamThread::restoreCached(FrameNumber target_frame)
+{
+  // Reset on the first message, so a miss leaves the scene intact.
+  bool reset = false;
+  FrameNumber frame = 0;
+  uint64_t stream_offset = 0;
+  const bool restored = _rewind_cache->restore(
+    target_frame,
+    [this, &reset](PacketReader &packet) {
+      if (!reset)
       {
-        return true;
+        _tes->reset();
+        reset = true;
       }
-      return false;
-    });
+      processSnapshotMessage(packet);
+    },
+    frame, stream_offset);
+
+  if (!restored)
+  {
+    if (reset)
+    {
+      // Partially restored. The caller must fall back to a keyframe or the stream start.
+      _tes->reset();
+    }
+    return false;
+  }
+
+  _pipeline->seek(stream_offset);
+  _currentFrame = frame;
+  _tes->updateToFrame(_currentFrame);
+  return true;
+}
+
+
+void StreamThread::processSnapshotMessage(PacketReader &packet)
+{
+  switch (packet.routingId())
+  {
+  case MtControl:
+    // Not expected in a snapshot.
+    break;
+  case MtServerInfo:
+    if (processServerInfo(packet, _server_info))
+    {
+      _tes->updateServerInfo(_server_info);
+    }
+    break;
+  default:
+    _tes->processMessage(packet);
+    break;
+  }
+}
+
+
+void StreamThread::captureSnapshots(uint64_t stream_offset)
+{
+  const auto serialise = [this](Connection &out) {
+    out.sendServerInfo(_server_info);
+    _tes->serialise(out);
+  };
+
+  if (_keyframes && _keyframes->due(_currentFrame, stream_offset))
+  {
+    _keyframes->add(_currentFrame, stream_offset, serialise);
+  }
+
+  if (!_rewind_cache)
+  {
+    return;
+  }
+
+  // Only cache frames near the cursor - the target frame or the paused frame - so normal playback
+  // and seeking do not serialise the scene every frame.
+  std::optional<FrameNumber> cursor;
+  {
+    const std::lock_guard guard(_data_mutex);
+    cursor = _target_frame;
+  }
+  if (!cursor.has_value() && _paused)
+  {
+    cursor = _currentFrame.load();
+  }
+
+  if (cursor.has_value() && _rewind_cache->due(_currentFrame, *cursor))
+  {
+    _rewind_cache->add(_currentFrame, stream_offset, serialise);
+  }
+}
+
+
+bool StreamThread::blockOnPause()
+{
+  std::unique_lock lock(_data_mutex);
+  if (_paused && !_target_frame.has_value())
+  {
+    // Wait for unpause or a target frame.
+    _notify.wait(lock, [this] { return !_paused || _target_frame.has_value(); });
     return true;
   }
   return false;
@@ -251,8 +434,7 @@ StreamThread::Clock::duration StreamThread::processControlMessage(PacketReader &
     _tes->reset();
     break;
   case CIdKeyframe:
-    // NYI
-    log::warn("Keyframe control message handling not implemented.");
+    // Keyframes are read from the KeyframeStore rather than the stream.
     break;
   case CIdEnd:
     log::warn("End control message handling not implemented.");
@@ -286,7 +468,7 @@ StreamThread::TargetFrameState StreamThread::checkTargetFrameState(FrameNumber &
 
   if (target_frame > current_frame)
   {
-    return TargetFrameState::Behind;
+    return TargetFrameState::Ahead;
   }
 
   _target_frame.reset();
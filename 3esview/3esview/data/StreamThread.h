@@ -29,15 +29,43 @@ class PacketStreamReader;
 
 namespace tes::view
 {
+class KeyframeStore;
+class RewindCache;
+class StreamPipeline;
 class ThirdEyeScene;
 
 /// A @c DataThread implementation which reads and processes packets form a file.
+///
+/// Packets are read ahead and decompressed on other threads by a @c StreamPipeline , while this
+/// thread dispatches the messages to the @c ThirdEyeScene in order.
+///
+/// Seeking is supported by restoring the nearest snapshot from a @c RewindCache or keyframe from a
+/// @c KeyframeStore - when given - then replaying the stream up to the target frame. Keyframes are
+/// captured during playback, while snapshots are only captured near the paused or target frame -
+/// see @c RewindCache::due() . Without either, seeking back replays the stream from the start.
 class TES_VIEWER_API StreamThread : public DataThread
 {
 public:
   using Clock = std::chrono::steady_clock;
 
-  StreamThread(std::shared_ptr<ThirdEyeScene> tes, std::shared_ptr<std::istream> stream);
+  /// Constructor.
+  /// @param tes The scene manager.
+  /// @param stream The recorded stream to read.
+  /// @param keyframes Optional keyframe store for @p stream , used to seek and capture keyframes.
+  /// @param rewind_cache Optional in-memory snapshot cache supporting fast stepping backwards.
+  StreamThread(std::shared_ptr<ThirdEyeScene> tes, std::shared_ptr<std::istream> stream,
+               std::shared_ptr<KeyframeStore> keyframes = nullptr,
+               std::shared_ptr<RewindCache> rewind_cache = nullptr);
+  /// Constructor reading from a prepared @c PacketStreamReader , such as a memory mapped file from
+  /// @c PacketStreamReader::open() .
+  /// @param tes The scene manager.
+  /// @param stream_reader The recorded stream reader. Must not be null.
+  /// @param keyframes Optional keyframe store for the stream, used to seek and capture keyframes.
+  /// @param rewind_cache Optional in-memory snapshot cache supporting fast stepping backwards.
+  StreamThread(std::shared_ptr<ThirdEyeScene> tes,
+               std::unique_ptr<PacketStreamReader> stream_reader,
+               std::shared_ptr<KeyframeStore> keyframes = nullptr,
+               std::shared_ptr<RewindCache> rewind_cache = nullptr);
   ~StreamThread();
 
   /// Reports whether the current stream is a live connection or a replay.
@@ -91,13 +119,42 @@ public:
   /// Wait for this thread to finish.
   void join() override;
 
+  bool rewindCacheStats(RewindCacheStats &stats) const override;
+
 protected:
   /// Thread entry point.
   void run();
 
-  void skipBack(FrameNumber targetFrame);
+  /// Skip back to @p target_frame . This restores the nearest cached snapshot or keyframe before
+  /// @p target_frame or resets to the stream start, leaving @p target_frame to be caught up.
+  /// @param target_frame The frame to skip back to.
+  void skipBack(FrameNumber target_frame);
 
 private:
+  /// Restore the nearest keyframe at or before @p target_frame , seeking the stream to follow the
+  /// keyframe.
+  ///
+  /// @param target_frame The frame to restore towards.
+  /// @param skip_forward True when skipping forward, in which case only a keyframe which is at
+  ///   least @c KeyframeStore::intervalBytes() ahead of the current stream position is restored.
+  /// @return True if a keyframe has been restored.
+  bool restoreKeyframe(FrameNumber target_frame, bool skip_forward = false);
+
+  /// Restore the nearest @c RewindCache snapshot at or before @p target_frame , seeking the stream
+  /// to follow the snapshot.
+  /// @param target_frame The frame to restore towards.
+  /// @return True if a snapshot has been restored.
+  bool restoreCached(FrameNumber target_frame);
+
+  /// Process a message from a keyframe or cached snapshot.
+  /// @param packet The snapshot message.
+  void processSnapshotMessage(PacketReader &packet);
+
+  /// Capture a keyframe and a @c RewindCache snapshot for the current frame as due. Must be called
+  /// at a frame boundary, immediately after the packet containing the @c CIdFrame message.
+  /// @param stream_offset The stream offset following that packet.
+  void captureSnapshots(uint64_t stream_offset);
+
   /// Block if paused until unpaused.
   /// @return True if we were paused and had to wait.
   bool blockOnPause();
@@ -114,7 +171,7 @@ private:
   /// - @c CIdFrameCount updates @c _total_frames.
   /// - @c CIdForceFrameFlush calls @c ThirdEyeScene::updateToFrame() with the @p _currentFrame.
   /// - @c CIdReset resets the @c _currentFrame and calls @c ThirdEyeScene::reset() .
-  /// - @c CIdKeyframe - NYI
+  /// - @c CIdKeyframe is ignored; keyframes are only expected in a @c KeyframeStore .
   /// - @c CIdEnd - NYI
   ///
   /// @param packet The packet to control. The routing Id is always @c MtControl.
@@ -161,7 +218,12 @@ private:
   FrameNumberAtomic _currentFrame = 0;
   /// The total number of frames in the stream, if know. Zero when unknown.
   FrameNumber _total_frames = 0;
-  std::unique_ptr<PacketStreamReader> _stream_reader;
+  /// Reads and decodes the stream.
+  std::unique_ptr<StreamPipeline> _pipeline;
+  /// Keyframes for seeking. May be null.
+  std::shared_ptr<KeyframeStore> _keyframes;
+  /// Recent frame snapshots for stepping back. May be null.
+  std::shared_ptr<RewindCache> _rewind_cache;
   /// The scene manager.
   std::shared_ptr<ThirdEyeScene> _tes;
   std::thread _thread;
@@ -10,6 +10,7 @@ list(APPEND PUBLIC_HEADERS
   Magnum.h
   MagnumColour.h
   MagnumV3.h
+  MessageDispatcher.h
   ThirdEyeScene.h
   ViewableWindow.h
   Viewer.h
@@ -34,7 +35,11 @@ list(APPEND PUBLIC_HEADERS
   command/playback/StepForward.h
   command/playback/Stop.h
   data/DataThread.h
+  data/KeyframeStore.h
   data/NetworkThread.h
+  data/RewindCache.h
+  data/SharedMemoryThread.h
+  data/StreamPipeline.h
   data/StreamThread.h
   handler/Camera.h
   handler/Category.h
@@ -78,6 +83,7 @@ list(APPEND SOURCES
   FboEffect.cpp
   FramesPerSecondWindow.cpp
   FrameStamp.cpp
+  MessageDispatcher.cpp
   ThirdEyeScene.cpp
   Viewer.cpp
   camera/Camera.cpp
@@ -101,7 +107,11 @@ list(APPEND SOURCES
   command/playback/StepForward.cpp
   command/playback/Stop.cpp
   data/DataThread.cpp
+  data/KeyframeStore.cpp
   data/NetworkThread.cpp
+  data/RewindCache.cpp
+  data/SharedMemoryThread.cpp
+  data/StreamPipeline.cpp
   data/StreamThread.cpp
   handler/Camera.cpp
   handler/Category.cpp
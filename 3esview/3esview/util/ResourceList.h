@@ -534,6 +534,8 @@ typename ResourceList<T>::ResourceRef ResourceList<T>::allocate()
 template <typename T>
 typename ResourceList<T>::ResourceRef ResourceList<T>::at(Id id)
 {
+  // Lock for the bounds check as allocate() may grow the container on another thread.
+  std::unique_lock<decltype(_lock)> guard(_lock);
   if (id < _items.size() && _items[id].next_free == kAllocatedResource)
   {
     return ResourceRef(id, this);
@@ -545,6 +547,7 @@ typename ResourceList<T>::ResourceRef ResourceList<T>::at(Id id)
 template <typename T>
 typename ResourceList<T>::ResourceConstRef ResourceList<T>::at(Id id) const
 {
+  std::unique_lock<decltype(_lock)> guard(_lock);
   if (id < _items.size() && _items[id].next_free == kAllocatedResource)
   {
     return ResourceConstRef(id, this);
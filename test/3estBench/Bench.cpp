@@ -0,0 +1,442 @@
+//
+// author: Kazys Stepanas
+//
+#include <3escore/CollatedPacket.h>
+#include <3escore/ConnectionMonitor.h>
+#include <3escore/Crc.h>
+#include <3escore/Meta.h>
+#include <3escore/PacketHeader.h>
+#include <3escore/PacketReader.h>
+#include <3escore/PacketWriter.h>
+#include <3escore/Server.h>
+#include <3escore/shapes/Shapes.h>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Micro benchmarks for core 3es operations. Each benchmark compares a reference implementation
+// against the library implementation and reports the relative throughput.
+
+using namespace tes;
+
+namespace
+{
+using TimingClock = std::chrono::steady_clock;
+
+/// Sink for results to prevent the optimiser discarding benchmark work.
+volatile unsigned g_sink = 0;
+
+/// Time @p func over @p repeats iterations, returning the best time of several runs.
+template <typename Func>
+double bestSeconds(Func &&func, unsigned repeats, unsigned runs = 5)
+{
+  double best = 0;
+  for (unsigned run = 0; run < runs; ++run)
+  {
+    const auto start = TimingClock::now();
+    for (unsigned i = 0; i < repeats; ++i)
+    {
+      func();
+    }
+    const double elapsed =
+      std::chrono::duration<double>(TimingClock::now() - start).count();
+    best = (run == 0 || elapsed < best) ? elapsed : best;
+  }
+  return best;
+}
+
+
+void report(const std::string &label, double seconds, double bytes)
+{
+  std::cout << "  " << std::left << std::setw(32) << label << std::right << std::fixed
+            << std::setprecision(3) << std::setw(10) << seconds * 1e3 << "ms" << std::setw(10)
+            << std::setprecision(1) << (bytes / seconds) / (1024.0 * 1024.0) << " MiB/s"
+            << std::endl;
+}
+
+
+/// Byte at a time CRC16 - the algorithm used before slicing-by-8.
+class ReferenceCrc16
+{
+public:
+  ReferenceCrc16()
+  {
+    for (unsigned dividend = 0; dividend < _table.size(); ++dividend)
+    {
+      auto remainder = static_cast<uint16_t>(dividend << 8u);
+      for (unsigned bit = 0; bit < 8; ++bit)
+      {
+        remainder = (remainder & 0x8000u) ? static_cast<uint16_t>((remainder << 1u) ^ 0x1021u) :
+                                            static_cast<uint16_t>(remainder << 1u);
+      }
+      _table[dividend] = remainder;
+    }
+  }
+
+  uint16_t operator()(const uint8_t *message, size_t byte_count) const
+  {
+    uint16_t remainder = 0xFFFFu;
+    for (size_t i = 0; i < byte_count; ++i)
+    {
+      const auto data = static_cast<uint8_t>(message[i] ^ (remainder >> 8u));
+      remainder = static_cast<uint16_t>(_table[data] ^ (remainder << 8u));
+    }
+    return remainder;
+  }
+
+private:
+  std::array<uint16_t, 256> _table = {};
+};
+
+
+void benchCrc()
+{
+  std::cout << "crc16: byte at a time vs slicing-by-8" << std::endl;
+  const ReferenceCrc16 reference;
+  for (const size_t size : { size_t(64), size_t(1024), size_t(0xffe0u) })
+  {
+    std::vector<uint8_t> message(size);
+    for (size_t i = 0; i < message.size(); ++i)
+    {
+      message[i] = static_cast<uint8_t>(i * 131u + 17u);
+    }
+
+    if (reference(message.data(), message.size()) != crc16(message.data(), message.size()))
+    {
+      std::cerr << "CRC mismatch" << std::endl;
+      return;
+    }
+
+    const auto repeats = static_cast<unsigned>(std::max<size_t>(1u, (64u << 20u) / size));
+    const double total_bytes = double(size) * repeats;
+    const double reference_time = bestSeconds(
+      [&]() { g_sink = g_sink + reference(message.data(), message.size()); }, repeats);
+    const double sliced_time =
+      bestSeconds([&]() { g_sink = g_sink + crc16(message.data(), message.size()); }, repeats);
+
+    std::cout << " " << size << " byte messages" << std::endl;
+    report("byte at a time", reference_time, total_bytes);
+    report("slicing-by-8", sliced_time, total_bytes);
+    std::cout << "  speedup: " << std::setprecision(2) << reference_time / sliced_time << "x"
+              << std::endl;
+  }
+}
+
+
+/// Collate sphere create messages in the same way as @c BaseConnection , optionally eliding the
+/// nested packet CRCs.
+double collateSpheres(bool elide_nested_crc, unsigned shape_count, unsigned repeats,
+                      double &total_bytes)
+{
+  CollatedPacket collated(false);
+  collated.setElideNestedCrc(elide_nested_crc);
+  std::vector<uint8_t> buffer(0xffe0u);
+  total_bytes = 0;
+
+  const double seconds = bestSeconds(
+    [&]() {
+      collated.reset();
+      for (unsigned i = 0; i < shape_count; ++i)
+      {
+        PacketWriter packet(buffer.data(), static_cast<uint16_t>(buffer.size()));
+        const auto fi = static_cast<float>(i);
+        Sphere(Id(i + 1), Spherical(Vector3f(fi, 2.0f * fi, -fi), 0.5f)).writeCreate(packet);
+        if (elide_nested_crc)
+        {
+          packet.packet().flags |= PFNoCrc;
+        }
+        packet.finalise();
+        if (collated.add(packet) < 0)
+        {
+          collated.finalise();
+          collated.reset();
+          collated.add(packet);
+        }
+      }
+      collated.finalise();
+      unsigned byte_count = 0;
+      g_sink = g_sink + *collated.buffer(byte_count);
+    },
+    repeats);
+
+  // Count bytes for a single pass.
+  collated.reset();
+  for (unsigned i = 0; i < shape_count; ++i)
+  {
+    PacketWriter packet(buffer.data(), static_cast<uint16_t>(buffer.size()));
+    Sphere(Id(i + 1)).writeCreate(packet);
+    packet.finalise();
+    total_bytes += packet.packetSize();
+  }
+  total_bytes *= repeats;
+
+  return seconds;
+}
+
+
+void benchNestedCrc()
+{
+  std::cout << "collation: nested CRC vs SFNestedNoCrc" << std::endl;
+  const unsigned shape_count = 1000;
+  const unsigned repeats = 200;
+  double total_bytes = 0;
+  const double crc_time = collateSpheres(false, shape_count, repeats, total_bytes);
+  const double no_crc_time = collateSpheres(true, shape_count, repeats, total_bytes);
+  report("nested CRC", crc_time, total_bytes);
+  report("nested PFNoCrc", no_crc_time, total_bytes);
+  std::cout << "  speedup: " << std::setprecision(2) << crc_time / no_crc_time << "x"
+            << std::endl;
+}
+
+
+void benchEndian()
+{
+  std::cout << "payload arrays: network byte order vs PFLittleEndian" << std::endl;
+  const unsigned repeats = 2000;
+  std::vector<float> vertices(0xff00u / sizeof(float) - 16u);
+  for (size_t i = 0; i < vertices.size(); ++i)
+  {
+    vertices[i] = static_cast<float>(i) * 0.25f;
+  }
+  std::vector<float> read_vertices(vertices.size());
+  std::vector<uint8_t> buffer(0xffe0u);
+  const double total_bytes = double(vertices.size() * sizeof(float)) * repeats;
+
+  for (const bool little_endian : { false, true })
+  {
+    PacketWriter writer(buffer.data(), static_cast<uint16_t>(buffer.size()));
+    writer.setLittleEndian(little_endian);
+    const double write_time = bestSeconds(
+      [&]() {
+        writer.reset(MtMesh, 0);
+        writer.writeArray(vertices.data(), vertices.size());
+        g_sink = g_sink + writer.payloadSize();
+      },
+      repeats);
+    const double read_time = bestSeconds(
+      [&]() {
+        PacketReader reader(&writer.packet());
+        reader.readArray(read_vertices);
+        g_sink = g_sink + static_cast<unsigned>(read_vertices.back());
+      },
+      repeats);
+
+    const std::string label = (little_endian) ? "little endian" : "network order";
+    report(label + " write", write_time, total_bytes);
+    report(label + " read", read_time, total_bytes);
+  }
+}
+
+
+void benchFinalise()
+{
+  std::cout << "uncompressed collated packet: contiguous buffer() vs in place segments()"
+            << std::endl;
+  const unsigned repeats = 2000;
+  CollatedPacket collated(false);
+
+  // Prepare a full collated packet worth of sphere create messages.
+  std::vector<uint8_t> packets;
+  std::vector<uint8_t> buffer(0xffe0u);
+  for (unsigned i = 0; packets.size() + 2 * sizeof(PacketHeader) < collated.availableBytes(); ++i)
+  {
+    PacketWriter packet(buffer.data(), static_cast<uint16_t>(buffer.size()));
+    Sphere(Id(i + 1)).writeCreate(packet);
+    packet.finalise();
+    if (packets.size() + packet.packetSize() >= collated.availableBytes())
+    {
+      break;
+    }
+    packets.insert(packets.end(), packet.data(), packet.data() + packet.packetSize());
+  }
+  const double total_bytes = double(packets.size()) * repeats;
+
+  // Time finalisation only. The packet must be repopulated after each reset().
+  std::array<double, 2> times = { 0, 0 };
+  for (const bool contiguous : { true, false })
+  {
+    double seconds = 0;
+    for (unsigned r = 0; r < repeats; ++r)
+    {
+      collated.reset();
+      collated.add(packets.data(), static_cast<uint16_t>(packets.size()));
+
+      const auto start = TimingClock::now();
+      collated.finalise();
+      if (contiguous)
+      {
+        unsigned byte_count = 0;
+        g_sink = g_sink + *collated.buffer(byte_count);
+      }
+      else
+      {
+        std::array<BufferSegment, CollatedPacket::kMaxSegments> segments;
+        g_sink = g_sink + collated.segments(segments);
+      }
+      seconds += std::chrono::duration<double>(TimingClock::now() - start).count();
+    }
+    times[(contiguous) ? 0 : 1] = seconds;
+  }
+
+  report("contiguous", times[0], total_bytes);
+  report("segments", times[1], total_bytes);
+  std::cout << "  speedup: " << std::setprecision(2) << times[0] / times[1] << "x" << std::endl;
+}
+
+
+/// Submit sphere create, update and destroy messages from @p thread_count threads, ending with a
+/// frame update. Returns the elapsed seconds.
+double submitShapes(unsigned server_flags, unsigned thread_count, unsigned shapes_per_thread)
+{
+  const char *file_name = "bench-submit.3es";
+  auto server = Server::create(ServerSettings(server_flags));
+  server->connectionMonitor()->openFileStream(file_name);
+  server->connectionMonitor()->commitConnections();
+
+  const auto start = TimingClock::now();
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_count; ++t)
+  {
+    threads.emplace_back([&server, t, shapes_per_thread]() {
+      for (unsigned i = 0; i < shapes_per_thread; ++i)
+      {
+        const auto fi = static_cast<float>(i);
+        Sphere sphere(Id(1 + t * shapes_per_thread + i), Spherical(Vector3f(fi, 0, 0), 0.5f));
+        server->create(sphere);
+        sphere.setPosition(Vector3f(fi, 1.0f, 0));
+        server->update(sphere);
+        server->destroy(sphere);
+      }
+    });
+  }
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+  server->updateFrame(0.0f, true);
+  const double elapsed = std::chrono::duration<double>(TimingClock::now() - start).count();
+
+  server->close();
+  server.reset();
+  std::remove(file_name);
+  return elapsed;
+}
+
+
+void benchSubmit()
+{
+  std::cout << "shape submission from multiple threads: server lock vs SFMultiProducer"
+            << std::endl;
+  const unsigned total_shapes = 120000;
+  for (const unsigned thread_count : { 1u, 2u, 4u, 8u })
+  {
+    const unsigned shapes_per_thread = total_shapes / thread_count;
+    // Three messages per shape.
+    const double messages = 3.0 * shapes_per_thread * thread_count;
+    double locked_time = 0;
+    double multi_time = 0;
+    for (unsigned run = 0; run < 3; ++run)
+    {
+      const double locked = submitShapes(SFDefault, thread_count, shapes_per_thread);
+      const double multi =
+        submitShapes(SFDefault | SFMultiProducer, thread_count, shapes_per_thread);
+      locked_time = (run == 0 || locked < locked_time) ? locked : locked_time;
+      multi_time = (run == 0 || multi < multi_time) ? multi : multi_time;
+    }
+
+    std::cout << " " << thread_count << " thread(s)" << std::endl;
+    std::cout << "  " << std::left << std::setw(32) << "server lock" << std::right << std::fixed
+              << std::setprecision(3) << std::setw(10) << locked_time * 1e3 << "ms"
+              << std::setw(10) << std::setprecision(0) << messages / locked_time << " msg/s"
+              << std::endl;
+    std::cout << "  " << std::left << std::setw(32) << "multi-producer" << std::right
+              << std::fixed << std::setprecision(3) << std::setw(10) << multi_time * 1e3 << "ms"
+              << std::setw(10) << std::setprecision(0) << messages / multi_time << " msg/s"
+              << std::endl;
+    std::cout << "  speedup: " << std::setprecision(2) << locked_time / multi_time << "x"
+              << std::endl;
+  }
+}
+
+
+struct Benchmark
+{
+  const char *name;
+  const char *description;
+  std::function<void()> run;
+};
+
+
+const std::vector<Benchmark> &benchmarks()
+{
+  static const std::vector<Benchmark> benchmarks = {
+    { "crc", "CRC16 calculation throughput", benchCrc },
+    { "nestedcrc", "Collation with and without nested packet CRCs", benchNestedCrc },
+    { "endian", "Payload array read/write by byte order", benchEndian },
+    { "submit", "Multi-threaded shape submission contention", benchSubmit },
+    { "finalise", "Collated packet finalisation with and without copying", benchFinalise },
+  };
+  return benchmarks;
+}
+
+
+void showUsage(const char *exe)
+{
+  std::cout << "Usage:\n";
+  std::cout << exe << " [benchmarks]\n";
+  std::cout << "\nRuns all benchmarks when none are specified. Valid benchmarks:\n";
+  for (const auto &benchmark : benchmarks())
+  {
+    std::cout << "  " << std::left << std::setw(12) << benchmark.name << benchmark.description
+              << "\n";
+  }
+  std::cout.flush();
+}
+}  // namespace
+
+
+int main(int argc, char **argv)
+{
+  std::vector<const Benchmark *> selected;
+  for (int i = 1; i < argc; ++i)
+  {
+    bool found = false;
+    for (const auto &benchmark : benchmarks())
+    {
+      if (std::strcmp(argv[i], benchmark.name) == 0)
+      {
+        selected.emplace_back(&benchmark);
+        found = true;
+      }
+    }
+
+    if (!found)
+    {
+      showUsage(argv[0]);
+      return (std::strcmp(argv[i], "help") == 0) ? 0 : 1;
+    }
+  }
+
+  if (selected.empty())
+  {
+    for (const auto &benchmark : benchmarks())
+    {
+      selected.emplace_back(&benchmark);
+    }
+  }
+
+  for (const auto *benchmark : selected)
+  {
+    benchmark->run();
+  }
+
+  return 0;
+}
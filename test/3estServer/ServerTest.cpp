@@ -618,9 +618,23 @@ void showUsage(int argc, char **argv)
   {
     std::cout << "  compress: write collated and compressed packets\n";
   }
+  if (tes::checkFeature(tes::TFeatureCompressionLz4))
+  {
+    std::cout << "  lz4: compress using LZ4 (implies compress)\n";
+  }
+  if (tes::checkFeature(tes::TFeatureCompressionZstd))
+  {
+    std::cout << "  zstd: compress using Zstandard (implies compress)\n";
+  }
+  std::cout << "  cork: cork TCP connections between frames\n";
+  std::cout << "  extended: transfer resources in extended packets (over 64KiB)\n";
   std::cout << "  file: Save a file stream to 'server-test.3es'\n";
+  std::cout << "  filebuffer: write the file stream from a background thread (with file)\n";
+  std::cout << "  littleendian: write little endian packet payloads\n";
   std::cout << "  noaxes: Don't create axis arrow objects\n";
   std::cout << "  nomove: don't move objects (keep stationary)\n";
+  std::cout << "  resourcecache: share encoded resources across connections\n";
+  std::cout << "  shm: Accept same host viewers via shared memory '3es-server-test'\n";
   std::cout << "  wire: Show wireframe shapes, not slide for relevant objects\n";
   std::cout << "\nValid shapes:\n";
   std::cout << "\tall: show all shapes\n";
@@ -661,11 +675,40 @@ int main(int argc, char **argv_non_const)
   tes::initDefaultServerInfo(&info);
   info.coordinate_frame = tes::XYZ;
   unsigned server_flags = tes::SFDefaultNoCompression;
-  if (haveOption("compress", argc, argv))
+  tes::ServerSettings settings(server_flags);
+  if (haveOption("lz4", argc, argv))
+  {
+    settings.compression_codec = tes::CCLz4;
+  }
+  else if (haveOption("zstd", argc, argv))
+  {
+    settings.compression_codec = tes::CCZstd;
+  }
+  if (haveOption("littleendian", argc, argv))
+  {
+    settings.flags |= tes::SFLittleEndian;
+  }
+  if (haveOption("cork", argc, argv))
+  {
+    settings.flags |= tes::SFCorkFrames;
+  }
+  if (haveOption("extended", argc, argv))
   {
-    server_flags |= tes::SFCompress;
+    settings.flags |= tes::SFExtendedPackets;
   }
-  auto server = tes::Server::create(tes::ServerSettings(server_flags), &info);
+  if (haveOption("resourcecache", argc, argv))
+  {
+    settings.flags |= tes::SFResourceCache;
+  }
+  if (haveOption("filebuffer", argc, argv))
+  {
+    settings.flags |= tes::SFBufferedFileWrite;
+  }
+  if (haveOption("compress", argc, argv) || settings.compression_codec != tes::CCDeflate)
+  {
+    settings.flags |= tes::SFCompress;
+  }
+  auto server = tes::Server::create(settings, &info);
 
   std::vector<std::shared_ptr<tes::Shape>> shapes;
   std::vector<std::shared_ptr<ShapeMover>> movers;
@@ -720,6 +763,15 @@ int main(int argc, char **argv_non_const)
     server->connectionMonitor()->openFileStream("server-test.3es");
   }
 
+  if (haveOption("shm", argc, argv))
+  {
+    // Accept viewers via shared memory.
+    if (!server->connectionMonitor()->openSharedMemory("3es-server-test"))
+    {
+      std::cerr << "Failed to open shared memory." << std::endl;
+    }
+  }
+
   // Register shapes with server.
   for (auto &shape : shapes)
   {
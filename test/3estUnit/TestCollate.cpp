@@ -8,6 +8,7 @@
 #include <3escore/CollatedPacketDecoder.h>
 #include <3escore/ConnectionMonitor.h>
 #include <3escore/CoordinateFrame.h>
+#include <3escore/Feature.h>
 #include <3escore/Maths.h>
 #include <3escore/MathsStream.h>
 #include <3escore/Messages.h>
@@ -25,6 +26,8 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <iostream>
 #include <thread>
@@ -33,10 +36,16 @@
 
 namespace tes
 {
-void collationTest(bool compress, CollatedPacketDecoder *decoderOverride = nullptr)
+void collationTest(bool compress, CollatedPacketDecoder *decoderOverride = nullptr,
+                   bool dictionary = false, uint16_t codec = CCDeflate)
 {
   // Allocate an excessively large packet (not for network transfer).
   CollatedPacket encoder(compress);
+  if (codec != CCDeflate)
+  {
+    ASSERT_TRUE(encoder.setCompressionCodec(codec));
+  }
+  encoder.setCompressionDictionary(dictionary);
   CollatedPacketDecoder localDecoder;
   CollatedPacketDecoder &decoder = (decoderOverride) ? *decoderOverride : localDecoder;
 
@@ -63,6 +72,15 @@ void collationTest(bool compress, CollatedPacketDecoder *decoderOverride = nullp
   unsigned byteCount = 0;
   const PacketHeader *encoded = reinterpret_cast<const PacketHeader *>(encoder.buffer(byteCount));
 
+  if (encoder.compressionEnabled())
+  {
+    PacketReader collatedReader(encoded);
+    CollatedPacketMessage msg;
+    ASSERT_TRUE(msg.read(collatedReader));
+    EXPECT_NE(msg.flags & CPFCompress, 0u);
+    EXPECT_EQ(msg.codec, codec);
+  }
+
   // Decode the packet into a new mesh.
   MeshShape readMesh;
   ASSERT_TRUE(decoder.setPacket(encoded));
@@ -179,6 +197,171 @@ TEST(Collate, Compressed)
   collationTest(true);
 }
 
+TEST(Collate, CompressedDictionary)
+{
+  collationTest(true, nullptr, true);
+}
+
+TEST(Collate, DictionaryChecksum)
+{
+  if (!checkFeature(TFeatureCompression))
+  {
+    GTEST_SKIP() << "Compression not available";
+  }
+
+  // The preset dictionary is not transmitted so must never change. The zlib stream header carries
+  // the dictionary's Adler-32 checksum, which we pin here.
+  const uint32_t expected_dictionary_id = 0x49c3846cu;
+
+  CollatedPacket encoder(true);
+  encoder.setCompressionDictionary(true);
+  ASSERT_GT(encoder.create(Sphere(Id(1u), Spherical(Vector3f(1.2f, 2.3f, 3.4f), 1.26f))), 0);
+  ASSERT_TRUE(encoder.finalise());
+
+  unsigned byteCount = 0;
+  const PacketHeader *encoded = reinterpret_cast<const PacketHeader *>(encoder.buffer(byteCount));
+  PacketReader reader(encoded);
+  CollatedPacketMessage msg;
+  ASSERT_TRUE(msg.read(reader));
+  ASSERT_NE(msg.flags & CPFCompressDictionary, 0u);
+
+  // Zlib header: CMF, FLG with FDICT set, then the big endian DICTID.
+  const uint8_t *zlib_header = reader.payload() + reader.tell();
+  ASSERT_NE(zlib_header[1] & 0x20u, 0u);
+  const uint32_t dictionary_id = (uint32_t(zlib_header[2]) << 24u) |
+                                 (uint32_t(zlib_header[3]) << 16u) |
+                                 (uint32_t(zlib_header[4]) << 8u) | uint32_t(zlib_header[5]);
+  EXPECT_EQ(dictionary_id, expected_dictionary_id);
+}
+
+TEST(Collate, CompressedLz4)
+{
+  if (!checkFeature(TFeatureCompressionLz4))
+  {
+    GTEST_SKIP() << "LZ4 not available";
+  }
+  collationTest(true, nullptr, false, CCLz4);
+}
+
+TEST(Collate, CompressedZstd)
+{
+  if (!checkFeature(TFeatureCompressionZstd))
+  {
+    GTEST_SKIP() << "Zstandard not available";
+  }
+  collationTest(true, nullptr, false, CCZstd);
+}
+
+TEST(Collate, CodecAvailability)
+{
+  EXPECT_EQ(CollatedPacket::compressionCodecAvailable(CCDeflate),
+            checkFeature(TFeatureCompression));
+  EXPECT_EQ(CollatedPacket::compressionCodecAvailable(CCLz4),
+            checkFeature(TFeatureCompressionLz4));
+  EXPECT_EQ(CollatedPacket::compressionCodecAvailable(CCZstd),
+            checkFeature(TFeatureCompressionZstd));
+  EXPECT_FALSE(CollatedPacket::compressionCodecAvailable(CCCount));
+
+  // Unavailable codecs are rejected.
+  CollatedPacket encoder(true);
+  EXPECT_FALSE(encoder.setCompressionCodec(CCCount));
+  EXPECT_EQ(encoder.compressionCodec(), CCDefault);
+}
+
+TEST(Collate, CompressedReuse)
+{
+  // Reuse the same encoder and decoder, toggling the dictionary. Small packets should compress
+  // better with the dictionary.
+  CollatedPacket encoder(true);
+  CollatedPacketDecoder decoder;
+  unsigned compressedBytes[2] = {};
+  const unsigned shapeCount = 8;
+
+  for (unsigned pass = 0; pass < 4; ++pass)
+  {
+    const bool dictionary = (pass % 2) != 0;
+    encoder.reset();
+    encoder.setCompressionDictionary(dictionary);
+
+    for (unsigned i = 0; i < shapeCount; ++i)
+    {
+      const float fi = float(i);
+      ASSERT_GT(encoder.create(Sphere(Id(i + 1), Spherical(Vector3f(fi, 2.0f * fi, -fi), 0.5f))),
+                0);
+    }
+    ASSERT_TRUE(encoder.finalise());
+
+    unsigned byteCount = 0;
+    const auto *encoded = reinterpret_cast<const PacketHeader *>(encoder.buffer(byteCount));
+    compressedBytes[dictionary] = byteCount;
+
+    // Check the flags.
+    PacketReader collatedReader(encoded);
+    CollatedPacketMessage msg;
+    ASSERT_TRUE(msg.read(collatedReader));
+    EXPECT_NE(msg.flags & CPFCompress, 0u);
+    EXPECT_EQ((msg.flags & CPFCompressDictionary) != 0, dictionary);
+
+    ASSERT_TRUE(decoder.setPacket(encoded));
+    unsigned decodedCount = 0;
+    while (const PacketHeader *packet = decoder.next())
+    {
+      PacketReader reader(packet);
+      EXPECT_EQ(reader.routingId(), SIdSphere);
+      EXPECT_EQ(reader.messageId(), OIdCreate);
+      ++decodedCount;
+    }
+    EXPECT_EQ(decodedCount, shapeCount);
+    EXPECT_EQ(decoder.decodedBytes(), decoder.targetBytes());
+  }
+
+  EXPECT_LT(compressedBytes[1], compressedBytes[0]);
+}
+
+TEST(Collate, ElideNestedCrc)
+{
+  CollatedPacket encoder(false);
+  CollatedPacketDecoder decoder;
+  const unsigned shapeCount = 8;
+  unsigned collatedBytes[2] = {};
+
+  for (unsigned pass = 0; pass < 2; ++pass)
+  {
+    const bool elide = pass != 0;
+    encoder.reset();
+    encoder.setElideNestedCrc(elide);
+
+    std::vector<uint8_t> buffer(1024);
+    for (unsigned i = 0; i < shapeCount; ++i)
+    {
+      PacketWriter writer(buffer.data(), uint16_t(buffer.size()));
+      const float fi = float(i);
+      ASSERT_TRUE(Sphere(Id(i + 1), Spherical(Vector3f(fi, 2.0f * fi, -fi), 0.5f))
+                    .writeCreate(writer));
+      ASSERT_TRUE(writer.finalise());
+      ASSERT_EQ(encoder.add(writer), int(writer.packetSize()));
+    }
+    collatedBytes[pass] = encoder.collatedBytes();
+    ASSERT_TRUE(encoder.finalise());
+
+    unsigned byteCount = 0;
+    const auto *encoded = reinterpret_cast<const PacketHeader *>(encoder.buffer(byteCount));
+    ASSERT_TRUE(decoder.setPacket(encoded));
+    unsigned decodedCount = 0;
+    while (const PacketHeader *packet = decoder.next())
+    {
+      PacketReader reader(packet);
+      EXPECT_EQ((reader.flags() & PFNoCrc) != 0, elide);
+      EXPECT_TRUE(reader.checkCrc());
+      EXPECT_EQ(reader.routingId(), SIdSphere);
+      ++decodedCount;
+    }
+    EXPECT_EQ(decodedCount, shapeCount);
+  }
+
+  EXPECT_EQ(collatedBytes[0] - collatedBytes[1], shapeCount * sizeof(PacketWriter::CrcType));
+}
+
 TEST(Collate, Reuse)
 {
   CollatedPacketDecoder decoder;
@@ -191,4 +374,194 @@ TEST(Collate, DecodeSinglePacket)
 {
   singlePacketTest();
 }
+
+TEST(Collate, DecodeAll)
+{
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeLowResSphere(vertices, indices, nullptr);
+  const MeshShape mesh(DtTriangles, Id(42u, 1), DataBuffer(vertices), DataBuffer(indices));
+
+  std::vector<uint16_t> codecs = { CCDeflate };
+  if (checkFeature(TFeatureCompressionLz4))
+  {
+    codecs.emplace_back(CCLz4);
+  }
+  if (checkFeature(TFeatureCompressionZstd))
+  {
+    codecs.emplace_back(CCZstd);
+  }
+
+  for (const bool compress : { false, true })
+  {
+    for (const uint16_t codec : codecs)
+    {
+      CollatedPacket encoder(compress);
+      ASSERT_TRUE(encoder.setCompressionCodec(codec) || !compress);
+      ASSERT_GT(encoder.create(mesh), 0);
+      ASSERT_TRUE(encoder.finalise());
+      unsigned byte_count = 0;
+      const auto *encoded = reinterpret_cast<const PacketHeader *>(encoder.buffer(byte_count));
+
+      // Reference messages via next().
+      CollatedPacketDecoder decoder;
+      std::vector<uint8_t> expected;
+      ASSERT_TRUE(decoder.setPacket(encoded));
+      while (const PacketHeader *header = decoder.next())
+      {
+        const auto *bytes = reinterpret_cast<const uint8_t *>(header);
+        expected.insert(expected.end(), bytes, bytes + PacketReader(header).packetSize());
+      }
+      ASSERT_FALSE(expected.empty());
+
+      std::vector<uint8_t> buffer;
+      const uint8_t *messages = nullptr;
+      size_t message_bytes = 0;
+      ASSERT_TRUE(decoder.setPacket(encoded));
+      ASSERT_TRUE(decoder.decodeAll(buffer, messages, message_bytes));
+      EXPECT_FALSE(decoder.decoding());
+      EXPECT_EQ(decoder.next(), nullptr);
+      ASSERT_EQ(message_bytes, expected.size());
+      EXPECT_TRUE(std::equal(expected.begin(), expected.end(), messages));
+
+      const auto *encoded_bytes = reinterpret_cast<const uint8_t *>(encoded);
+      const bool in_place = messages >= encoded_bytes && messages < encoded_bytes + byte_count;
+      EXPECT_EQ(in_place, !encoder.compressionEnabled());
+
+      if (in_place)
+      {
+        // Break the last message marker. The valid messages before it are still given.
+        size_t last_offset = 0;
+        for (size_t offset = 0; offset < expected.size();)
+        {
+          last_offset = offset;
+          const auto *header = reinterpret_cast<const PacketHeader *>(expected.data() + offset);
+          offset += PacketReader(header).packetSize();
+        }
+        ASSERT_GT(last_offset, 0u);
+        std::vector<uint8_t> corrupt(encoded_bytes, encoded_bytes + byte_count);
+        corrupt[static_cast<size_t>(messages - encoded_bytes) + last_offset] ^= 0xffu;
+        ASSERT_TRUE(decoder.setPacket(reinterpret_cast<const PacketHeader *>(corrupt.data())));
+        EXPECT_FALSE(decoder.decodeAll(buffer, messages, message_bytes));
+        EXPECT_EQ(message_bytes, last_offset);
+      }
+    }
+  }
+
+  // Other packets are passed through in place.
+  std::vector<uint8_t> packet_buffer(256);
+  PacketWriter writer(packet_buffer.data(), static_cast<uint16_t>(packet_buffer.size()));
+  ControlMessage control = {};
+  writer.reset(MtControl, CIdEnd);
+  ASSERT_TRUE(control.write(writer));
+  ASSERT_TRUE(writer.finalise());
+  CollatedPacketDecoder decoder(&writer.packet());
+  std::vector<uint8_t> buffer;
+  const uint8_t *messages = nullptr;
+  size_t message_bytes = 0;
+  ASSERT_TRUE(decoder.decodeAll(buffer, messages, message_bytes));
+  EXPECT_EQ(messages, packet_buffer.data());
+  EXPECT_EQ(message_bytes, writer.packetSize());
+  EXPECT_FALSE(decoder.decodeAll(buffer, messages, message_bytes));
+  EXPECT_EQ(message_bytes, 0u);
+}
+
+
+TEST(Collate, ServerInfo)
+{
+  ServerInfoMessage info;
+  initDefaultServerInfo(&info);
+  info.time_unit = 250u;
+  info.coordinate_frame = ZYX;
+
+  CollatedPacket encoder(false);
+  ASSERT_TRUE(encoder.sendServerInfo(info));
+  ASSERT_TRUE(encoder.finalise());
+
+  unsigned byteCount = 0;
+  const uint8_t *bytes = encoder.buffer(byteCount);
+  CollatedPacketDecoder decoder;
+  ASSERT_TRUE(decoder.setPacket(reinterpret_cast<const PacketHeader *>(bytes)));
+  unsigned infoCount = 0;
+  while (const PacketHeader *header = decoder.next())
+  {
+    PacketReader reader(header);
+    ASSERT_EQ(reader.routingId(), MtServerInfo);
+    ServerInfoMessage readInfo = {};
+    ASSERT_TRUE(readInfo.read(reader));
+    EXPECT_EQ(readInfo.time_unit, info.time_unit);
+    EXPECT_EQ(readInfo.coordinate_frame, info.coordinate_frame);
+    ++infoCount;
+  }
+  EXPECT_EQ(infoCount, 1u);
+}
+
+TEST(Collate, Segments)
+{
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeLowResSphere(vertices, indices, nullptr);
+  MeshShape mesh(DtTriangles, Id(42u), DataBuffer(vertices), DataBuffer(indices));
+
+  for (const bool compress : { false, true })
+  {
+    CollatedPacket encoder(compress);
+    ASSERT_GT(encoder.create(mesh), 0);
+    ASSERT_TRUE(encoder.finalise());
+
+    // Uncompressed packets are finalised in place as header, collated data and CRC segments.
+    std::array<BufferSegment, CollatedPacket::kMaxSegments> segments;
+    const unsigned segmentCount = encoder.segments(segments);
+    EXPECT_EQ(segmentCount, (encoder.compressionEnabled()) ? 1u : 3u);
+    std::vector<uint8_t> gathered;
+    for (unsigned i = 0; i < segmentCount; ++i)
+    {
+      gathered.insert(gathered.end(), segments[i].data, segments[i].data + segments[i].byte_count);
+    }
+
+    // The contiguous buffer must match.
+    unsigned byteCount = 0;
+    const uint8_t *bytes = encoder.buffer(byteCount);
+    ASSERT_EQ(gathered.size(), byteCount);
+    EXPECT_TRUE(std::equal(gathered.begin(), gathered.end(), bytes));
+    EXPECT_EQ(encoder.segments(segments), 1u);
+
+    PacketReader reader(reinterpret_cast<const PacketHeader *>(bytes));
+    EXPECT_TRUE(reader.checkCrc());
+
+    // Send via a scatter-gather socket write and validate the received packet.
+    TcpListenSocket listen;
+    const uint16_t basePort = 33600u;
+    uint16_t port = basePort;
+    while (!listen.listen(port) && port < basePort + 20u)
+    {
+      ++port;
+    }
+    ASSERT_TRUE(listen.isListening());
+    TcpSocket client;
+    ASSERT_TRUE(client.open("127.0.0.1", listen.port()));
+    auto server = listen.accept(1000);
+    ASSERT_NE(server, nullptr);
+
+    EXPECT_EQ(server->writev(segments.data(), encoder.segments(segments)), int(byteCount));
+    std::vector<uint8_t> received(byteCount);
+    client.setReadTimeout(1000);
+    ASSERT_EQ(client.read(received.data(), int(received.size())), int(byteCount));
+    EXPECT_TRUE(std::equal(received.begin(), received.end(), bytes));
+
+    // Corking must not hold data back once uncorked.
+    server->setCork(true);
+    encoder.reset();
+    ASSERT_GT(encoder.create(mesh), 0);
+    ASSERT_TRUE(encoder.finalise());
+    const unsigned corkedSegmentCount = encoder.segments(segments);
+    const int corkedBytes = server->writev(segments.data(), corkedSegmentCount);
+    EXPECT_GT(corkedBytes, 0);
+    server->setCork(false);
+    received.resize(corkedBytes);
+    ASSERT_EQ(client.read(received.data(), corkedBytes), corkedBytes);
+    PacketReader corkedReader(reinterpret_cast<const PacketHeader *>(received.data()));
+    EXPECT_TRUE(corkedReader.checkCrc());
+  }
+}
 }  // namespace tes
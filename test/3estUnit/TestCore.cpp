@@ -3,14 +3,34 @@
 //
 #include "TestCommon.h"
 
+#include <3escore/CollatedPacket.h>
+#include <3escore/CollatedPacketDecoder.h>
+#include <3escore/Crc.h>
+#include <3escore/Endian.h>
 #include <3escore/IntArg.h>
+#include <3escore/PacketBuffer.h>
+#include <3escore/PacketReader.h>
+#include <3escore/PacketStreamReader.h>
+#include <3escore/PacketWriter.h>
 #include <3escore/Ptr.h>
+#include <3escore/SharedMemoryReader.h>
+#include <3escore/SharedMemoryRing.h>
+#include <3escore/TcpListenSocket.h>
+#include <3escore/TcpPoller.h>
+#include <3escore/TcpSocket.h>
 #include <3escore/V3Arg.h>
 #include <3escore/shapes/SimpleMesh.h>
 
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <cinttypes>
 #include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -216,4 +236,554 @@ TEST(Core, PtrAssign)
   testPtrCast<const Resource>(mesh);
   testImplicitArgConvert<const Resource>(mesh, mesh);
 }
+
+/// Bit at a time reference CRC calculation.
+template <typename CRC>
+CRC referenceCrc(const uint8_t *message, size_t byte_count, CRC initial_remainder,
+                 CRC final_xor_value, CRC polynomial)
+{
+  const unsigned width = 8u * sizeof(CRC);
+  const auto top_bit = static_cast<CRC>(1u << (width - 1u));
+  CRC remainder = initial_remainder;
+  for (size_t i = 0; i < byte_count; ++i)
+  {
+    remainder = static_cast<CRC>(remainder ^ (message[i] << (width - 8u)));
+    for (unsigned bit = 0; bit < 8; ++bit)
+    {
+      remainder = (remainder & top_bit) ? static_cast<CRC>((remainder << 1u) ^ polynomial) :
+                                          static_cast<CRC>(remainder << 1u);
+    }
+  }
+  return static_cast<CRC>(remainder ^ final_xor_value);
+}
+
+TEST(Core, Crc)
+{
+  // Standard check values for "123456789": CRC-16/CCITT-FALSE and CRC-32/BZIP2 (unreflected).
+  const std::string check = "123456789";
+  const auto *check_bytes = reinterpret_cast<const uint8_t *>(check.data());
+  EXPECT_EQ(crc16(check_bytes, check.size()), 0x29B1u);
+  EXPECT_EQ(crc32(check_bytes, check.size()), 0xFC891918u);
+
+  // Validate all lengths and alignments against a bitwise calculation.
+  std::vector<uint8_t> message(256 + 8);
+  for (size_t i = 0; i < message.size(); ++i)
+  {
+    message[i] = static_cast<uint8_t>((i * 31u + 7u) ^ (i >> 3u));
+  }
+
+  for (size_t offset = 0; offset < 8; ++offset)
+  {
+    for (size_t length = 0; length + offset <= message.size(); ++length)
+    {
+      const uint8_t *bytes = message.data() + offset;
+      ASSERT_EQ(crc8(bytes, length),
+                referenceCrc<uint8_t>(bytes, length, 0xFFu, 0u, 0x21u))
+        << "offset " << offset << " length " << length;
+      ASSERT_EQ(crc16(bytes, length),
+                referenceCrc<uint16_t>(bytes, length, 0xFFFFu, 0u, 0x1021u))
+        << "offset " << offset << " length " << length;
+      ASSERT_EQ(crc32(bytes, length),
+                referenceCrc<uint32_t>(bytes, length, 0xFFFFFFFFu, 0xFFFFFFFFu, 0x04C11DB7u))
+        << "offset " << offset << " length " << length;
+    }
+  }
+
+  // Continue the CRC across split buffers.
+  for (size_t split = 0; split <= message.size(); ++split)
+  {
+    const uint8_t *bytes = message.data();
+    ASSERT_EQ(crc16(bytes + split, message.size() - split, crc16(bytes, split)),
+              crc16(bytes, message.size()))
+      << "split " << split;
+    ASSERT_EQ(crc32(bytes + split, message.size() - split, crc32(bytes, split)),
+              crc32(bytes, message.size()))
+      << "split " << split;
+  }
+}
+
+TEST(Core, PacketEndian)
+{
+  const uint32_t value = 0x01020304u;
+  const std::vector<uint16_t> array = { 0x0102u, 0x0304u, 0x0506u };
+
+  for (const bool little_endian : { false, true })
+  {
+    std::vector<uint8_t> buffer(256);
+    PacketWriter writer(buffer.data(), uint16_t(buffer.size()), MtControl, 0);
+    writer.setLittleEndian(little_endian);
+    EXPECT_EQ((writer.flags() & PFLittleEndian) != 0, little_endian);
+    // Byte order persists through reset.
+    writer.reset(MtControl, 1);
+    EXPECT_EQ((writer.flags() & PFLittleEndian) != 0, little_endian);
+
+    ASSERT_EQ(writer.writeElement(value), sizeof(value));
+    ASSERT_EQ(writer.writeArray(array.data(), array.size()), array.size());
+    ASSERT_TRUE(writer.finalise());
+
+    // Validate the payload byte order.
+    const uint8_t *payload = writer.payload();
+    EXPECT_EQ(payload[0], (little_endian) ? 0x04u : 0x01u);
+    EXPECT_EQ(payload[3], (little_endian) ? 0x01u : 0x04u);
+    EXPECT_EQ(payload[4], (little_endian) ? 0x02u : 0x01u);
+
+    // Header fields remain in network byte order.
+    PacketReader reader(reinterpret_cast<const PacketHeader *>(buffer.data()));
+    EXPECT_EQ(reader.marker(), kPacketMarker);
+    EXPECT_EQ(reader.messageId(), 1u);
+    EXPECT_TRUE(reader.checkCrc());
+
+    uint32_t read_value = 0;
+    std::vector<uint16_t> read_array(array.size());
+    EXPECT_EQ(reader.readElement(read_value), sizeof(read_value));
+    EXPECT_EQ(reader.readArray(read_array), read_array.size());
+    EXPECT_EQ(read_value, value);
+    EXPECT_EQ(read_array, array);
+  }
+}
+
+TEST(Core, PacketExtended)
+{
+  // Payload larger than the 16-bit limit.
+  std::vector<uint32_t> values(40000u);
+  for (size_t i = 0; i < values.size(); ++i)
+  {
+    values[i] = static_cast<uint32_t>(i * 7u + 3u);
+  }
+  const uint32_t payload_bytes = static_cast<uint32_t>(values.size() * sizeof(values[0]));
+
+  std::vector<uint8_t> buffer(256u * 1024u);
+  PacketWriter writer(buffer.data(), static_cast<uint32_t>(buffer.size()), MtMesh, 3);
+  // Limited to 16-bits without the extended flag.
+  EXPECT_LE(writer.maxPayloadSize(), kPacketMaxPayloadSize);
+  EXPECT_LT(writer.writeArray(values.data(), values.size()), values.size());
+
+  writer.setExtended(true);
+  EXPECT_TRUE(writer.extended());
+  EXPECT_EQ(writer.payloadSize(), 0u);
+  EXPECT_GT(writer.maxPayloadSize(), payload_bytes);
+  ASSERT_EQ(writer.writeArray(values.data(), values.size()), values.size());
+  ASSERT_TRUE(writer.finalise());
+  EXPECT_EQ(writer.payloadSize(), payload_bytes);
+  EXPECT_EQ(writer.packetSize(), sizeof(PacketHeader) + kPacketExtendedSizeBytes + payload_bytes +
+                                   sizeof(PacketWriter::CrcType));
+  std::vector<uint8_t> packet_bytes(writer.data(), writer.data() + writer.packetSize());
+  // The extended flag persists through reset.
+  writer.reset(MtMesh, 4);
+  EXPECT_TRUE(writer.extended());
+  EXPECT_EQ(writer.payloadSize(), 0u);
+
+  const auto validate = [&values, payload_bytes](const PacketHeader *header) {
+    PacketReader reader(header);
+    EXPECT_TRUE(reader.extended());
+    EXPECT_EQ(reader.routingId(), MtMesh);
+    EXPECT_EQ(reader.messageId(), 3u);
+    EXPECT_EQ(reader.payloadSize(), payload_bytes);
+    EXPECT_TRUE(reader.checkCrc());
+    std::vector<uint32_t> read_values(values.size());
+    EXPECT_EQ(reader.readArray(read_values), read_values.size());
+    EXPECT_EQ(read_values, values);
+  };
+
+  validate(reinterpret_cast<const PacketHeader *>(packet_bytes.data()));
+
+  // A small packet to follow the extended packet.
+  std::vector<uint8_t> small_buffer(256);
+  PacketWriter small_writer(small_buffer.data(), static_cast<uint32_t>(small_buffer.size()),
+                            MtControl, CIdFrame);
+  small_writer.writeElement(uint32_t(42u));
+  ASSERT_TRUE(small_writer.finalise());
+  EXPECT_FALSE(small_writer.extended());
+  std::vector<uint8_t> stream_bytes = packet_bytes;
+  stream_bytes.insert(stream_bytes.end(), small_writer.data(),
+                      small_writer.data() + small_writer.packetSize());
+
+  // Extract via PacketBuffer in small chunks.
+  {
+    PacketBuffer packet_buffer;
+    std::vector<uint8_t> extracted;
+    unsigned extracted_count = 0;
+    for (size_t offset = 0; offset < stream_bytes.size(); offset += 4000u)
+    {
+      packet_buffer.addBytes(stream_bytes.data() + offset,
+                             std::min<size_t>(4000u, stream_bytes.size() - offset));
+      while (const PacketHeader *header = packet_buffer.extractPacket(extracted))
+      {
+        if (extracted_count++ == 0)
+        {
+          validate(header);
+        }
+        else
+        {
+          EXPECT_EQ(PacketReader(header).routingId(), MtControl);
+        }
+      }
+    }
+    EXPECT_EQ(extracted_count, 2u);
+  }
+
+  // Extract via PacketStreamReader.
+  {
+    // Include leading junk to skip.
+    auto stream = std::make_shared<std::stringstream>(
+      std::string("junk") + std::string(stream_bytes.begin(), stream_bytes.end()));
+    PacketStreamReader stream_reader(stream);
+    const PacketHeader *header = stream_reader.extractPacket();
+    ASSERT_NE(header, nullptr);
+    validate(header);
+    header = stream_reader.extractPacket();
+    ASSERT_NE(header, nullptr);
+    EXPECT_EQ(PacketReader(header).routingId(), MtControl);
+  }
+
+  // Collate beyond the 16-bit limit. The collated packet is itself extended.
+  {
+    CollatedPacket collated(16u * 1024u, 1024u * 1024u);
+    ASSERT_EQ(collated.add(packet_bytes.data(), static_cast<unsigned>(packet_bytes.size())),
+              static_cast<int>(packet_bytes.size()));
+    ASSERT_GT(collated.add(small_writer), 0);
+    ASSERT_TRUE(collated.finalise());
+    unsigned collated_bytes = 0;
+    const uint8_t *collated_data = collated.buffer(collated_bytes);
+    const auto *collated_header = reinterpret_cast<const PacketHeader *>(collated_data);
+    PacketReader collated_reader(collated_header);
+    EXPECT_TRUE(collated_reader.extended());
+    EXPECT_EQ(collated_reader.packetSize(), collated_bytes);
+    EXPECT_TRUE(collated_reader.checkCrc());
+
+    CollatedPacketDecoder decoder(collated_header);
+    const PacketHeader *header = decoder.next();
+    ASSERT_NE(header, nullptr);
+    validate(header);
+    header = decoder.next();
+    ASSERT_NE(header, nullptr);
+    EXPECT_EQ(PacketReader(header).routingId(), MtControl);
+    EXPECT_EQ(decoder.next(), nullptr);
+  }
+
+  // A small extended packet nested in a compressed collated packet.
+  {
+    CollatedPacket collated(true);
+    PacketWriter small_extended(small_buffer.data(), static_cast<uint32_t>(small_buffer.size()),
+                                MtMesh, 3);
+    small_extended.setExtended(true);
+    small_extended.writeArray(values.data(), 32u);
+    ASSERT_TRUE(small_extended.finalise());
+    for (int i = 0; i < 8; ++i)
+    {
+      ASSERT_GT(collated.add(small_extended), 0);
+    }
+    ASSERT_TRUE(collated.finalise());
+    unsigned collated_bytes = 0;
+    const auto *collated_header =
+      reinterpret_cast<const PacketHeader *>(collated.buffer(collated_bytes));
+    EXPECT_FALSE(PacketReader(collated_header).extended());
+
+    CollatedPacketDecoder decoder(collated_header);
+    unsigned decoded_count = 0;
+    while (const PacketHeader *header = decoder.next())
+    {
+      PacketReader reader(header);
+      EXPECT_TRUE(reader.extended());
+      EXPECT_EQ(reader.payloadSize(), 32u * sizeof(uint32_t));
+      EXPECT_TRUE(reader.checkCrc());
+      ++decoded_count;
+    }
+    EXPECT_EQ(decoded_count, 8u);
+  }
+}
+
+
+TEST(Core, EndianSwapArray)
+{
+  // Cover the vector kernels, their scalar tails and the generic element path with unaligned
+  // pointers.
+  for (const size_t element_size : { size_t(1), size_t(2), size_t(3), size_t(4), size_t(8),
+                                     size_t(16) })
+  {
+    for (const size_t element_count : { size_t(0), size_t(1), size_t(7), size_t(33), size_t(257) })
+    {
+      std::vector<uint8_t> source(element_size * element_count + 1);
+      for (size_t i = 0; i < source.size(); ++i)
+      {
+        source[i] = static_cast<uint8_t>(i * 13u + 5u);
+      }
+
+      std::vector<uint8_t> expected(source.begin() + 1, source.end());
+      for (size_t i = 0; i < element_count; ++i)
+      {
+        std::reverse(expected.begin() + i * element_size,
+                     expected.begin() + (i + 1) * element_size);
+      }
+
+      std::vector<uint8_t> copied(expected.size() + 1);
+      endianSwapCopy(copied.data() + 1, source.data() + 1, element_size, element_count);
+      EXPECT_TRUE(std::equal(expected.begin(), expected.end(), copied.begin() + 1))
+        << "copy: size " << element_size << " count " << element_count;
+
+      endianSwapArray(source.data() + 1, element_size, element_count);
+      EXPECT_TRUE(std::equal(expected.begin(), expected.end(), source.begin() + 1))
+        << "in place: size " << element_size << " count " << element_count;
+    }
+  }
+}
+
+TEST(Core, TcpPoller)
+{
+  TcpListenSocket listen;
+  const uint16_t basePort = 33620u;
+  uint16_t port = basePort;
+  while (!listen.listen(port) && port < basePort + 20u)
+  {
+    ++port;
+  }
+  ASSERT_TRUE(listen.isListening());
+
+  TcpPoller poller;
+  ASSERT_TRUE(poller.setListenSocket(&listen));
+
+  // Wake from another thread.
+  std::thread waker([&poller]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    poller.wake();
+  });
+  const auto wakeStart = std::chrono::steady_clock::now();
+  EXPECT_TRUE(poller.wait(5000u) & TcpPoller::PEWake);
+  EXPECT_LT(std::chrono::steady_clock::now() - wakeStart, std::chrono::seconds(2));
+  waker.join();
+
+  // Connection event.
+  TcpSocket client;
+  ASSERT_TRUE(client.open("127.0.0.1", listen.port()));
+  EXPECT_TRUE(poller.wait(2000u) & TcpPoller::PEConnection);
+  auto server = listen.accept(1000);
+  ASSERT_NE(server, nullptr);
+
+  if (!poller.eventDriven())
+  {
+    GTEST_SKIP() << "TcpPoller is not event driven on this platform";
+  }
+
+  // Disconnection event.
+  EXPECT_TRUE(poller.watch(server));
+  EXPECT_EQ(poller.watchCount(), 1u);
+  EXPECT_EQ(poller.wait(0), unsigned(TcpPoller::PENone));
+  EXPECT_TRUE(server->isConnected());
+
+  client.close();
+  EXPECT_TRUE(poller.wait(2000u) & TcpPoller::PEHangup);
+  EXPECT_FALSE(server->isConnected());
+  EXPECT_EQ(poller.watchCount(), 0u);
+
+  // Locally closed sockets are released.
+  TcpSocket client2;
+  ASSERT_TRUE(client2.open("127.0.0.1", listen.port()));
+  auto server2 = listen.accept(1000);
+  ASSERT_NE(server2, nullptr);
+  EXPECT_TRUE(poller.watch(server2));
+  server2->close();
+  poller.wait(0);
+  EXPECT_EQ(poller.watchCount(), 0u);
+  EXPECT_FALSE(server2->isConnected());
+
+  EXPECT_TRUE(poller.setListenSocket(nullptr));
+}
+
+TEST(Core, TcpWaitReadable)
+{
+  TcpListenSocket listen;
+  const uint16_t basePort = 33640u;
+  uint16_t port = basePort;
+  while (!listen.listen(port) && port < basePort + 20u)
+  {
+    ++port;
+  }
+  ASSERT_TRUE(listen.isListening());
+
+  TcpSocket client;
+  ASSERT_TRUE(client.open("127.0.0.1", listen.port()));
+  auto server = listen.accept(1000);
+  ASSERT_NE(server, nullptr);
+
+  // Nothing to read.
+  EXPECT_FALSE(client.waitReadable(0));
+  const auto waitStart = std::chrono::steady_clock::now();
+  EXPECT_FALSE(client.waitReadable(20u));
+  EXPECT_GE(std::chrono::steady_clock::now() - waitStart, std::chrono::milliseconds(15));
+
+  // Data arriving from another thread releases the wait.
+  const std::array<uint8_t, 4> data = { 1, 2, 3, 4 };
+  std::thread writer([&server, &data]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(server->write(data.data(), int(data.size())), int(data.size()));
+  });
+  EXPECT_TRUE(client.waitReadable(5000u));
+  writer.join();
+
+  std::array<uint8_t, 8> read_buffer = {};
+  EXPECT_EQ(client.readAvailable(read_buffer.data(), int(read_buffer.size())), int(data.size()));
+  EXPECT_FALSE(client.waitReadable(0));
+
+  // Closing the connection reports readable so the reader can detect it.
+  server->close();
+  EXPECT_TRUE(client.waitReadable(2000u));
+  EXPECT_FALSE(client.isConnected());
+}
+
+TEST(Core, SharedMemoryRing)
+{
+  if (!SharedMemoryRing::supported())
+  {
+    GTEST_SKIP() << "Shared memory is not supported on this platform";
+  }
+
+  const std::string name =
+    "3es-test-ring-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+  // Small capacity to exercise wrapping and a full ring.
+  const size_t capacity = 1000u;
+
+  SharedMemoryRing writer;
+  ASSERT_TRUE(writer.create(name, capacity));
+  EXPECT_TRUE(writer.isWriter());
+  EXPECT_EQ(writer.capacity(), capacity);
+  EXPECT_FALSE(writer.readerAttached());
+
+  // The name is exclusive.
+  SharedMemoryRing duplicate;
+  EXPECT_FALSE(duplicate.create(name, capacity));
+
+  SharedMemoryRing reader;
+  ASSERT_TRUE(reader.open(name));
+  EXPECT_FALSE(reader.isWriter());
+  EXPECT_TRUE(writer.readerAttached());
+
+  // Only one reader.
+  SharedMemoryRing second_reader;
+  EXPECT_FALSE(second_reader.open(name));
+
+  // Nothing to read yet.
+  const uint8_t *data = nullptr;
+  EXPECT_EQ(reader.acquireRead(data, 0), 0u);
+
+  // Stream more than the capacity through the ring from another thread.
+  std::vector<uint8_t> source(capacity * 37u + 13u);
+  for (size_t i = 0; i < source.size(); ++i)
+  {
+    source[i] = static_cast<uint8_t>(i * 7u + i / 251u);
+  }
+
+  std::thread producer([&writer, &source]() {
+    const size_t chunk = 333u;
+    for (size_t offset = 0; offset < source.size(); offset += chunk)
+    {
+      const size_t count = std::min(chunk, source.size() - offset);
+      EXPECT_EQ(writer.write(source.data() + offset, count, 5000u), int(count));
+    }
+    writer.close();
+  });
+
+  std::vector<uint8_t> received;
+  std::vector<uint8_t> buffer(256u);
+  size_t read_count = 0;
+  while ((read_count = reader.read(buffer.data(), buffer.size(), 5000u)) > 0)
+  {
+    received.insert(received.end(), buffer.begin(),
+                    buffer.begin() + static_cast<std::ptrdiff_t>(read_count));
+  }
+  producer.join();
+
+  EXPECT_TRUE(reader.writerClosed());
+  EXPECT_EQ(received, source);
+  reader.close();
+
+  // Writes fail once the reader detaches, or time out while the ring is full.
+  SharedMemoryRing writer2;
+  ASSERT_TRUE(writer2.create(name, capacity));
+  SharedMemoryRing reader2;
+  ASSERT_TRUE(reader2.open(name));
+  EXPECT_EQ(writer2.write(source.data(), capacity, 0), int(capacity));
+  EXPECT_EQ(writer2.write(source.data(), 1u, 10u), -1);
+  reader2.close();
+  EXPECT_TRUE(writer2.readerDetached());
+  EXPECT_EQ(writer2.write(source.data(), 1u, 1000u), -1);
+}
+
+TEST(Core, SharedMemoryReader)
+{
+  if (!SharedMemoryRing::supported())
+  {
+    GTEST_SKIP() << "Shared memory is not supported on this platform";
+  }
+
+  const auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+  const std::string name = "3es-test-reader-" + std::to_string(now);
+  // Small capacity so packets wrap the end of the ring, and some exceed the capacity.
+  const size_t capacity = 1000u;
+
+  SharedMemoryRing writer;
+  ASSERT_TRUE(writer.create(name, capacity));
+  SharedMemoryRing reader_ring;
+  ASSERT_TRUE(reader_ring.open(name));
+
+  // Packets with a range of payload sizes. The payload is the packet number repeated.
+  const uint16_t packet_count = 200u;
+  const auto payload_count = [](uint16_t packet_number) -> size_t {
+    return (packet_number % 50u == 49u) ? 1500u : 1u + (packet_number * 37u) % 300u;
+  };
+
+  uint64_t total_bytes = 0;
+  std::thread producer([&]() {
+    std::vector<uint8_t> buffer(0xffffu);
+    for (uint16_t i = 0; i < packet_count; ++i)
+    {
+      PacketWriter packet(buffer.data(), static_cast<uint32_t>(buffer.size()), MtControl, i);
+      for (size_t j = 0; j < payload_count(i); ++j)
+      {
+        packet.writeElement(i);
+      }
+      ASSERT_TRUE(packet.finalise());
+      total_bytes += packet.packetSize();
+      ASSERT_EQ(writer.write(packet.data(), packet.packetSize(), 5000u), int(packet.packetSize()));
+    }
+    writer.close();
+  });
+
+  SharedMemoryReader reader(reader_ring);
+  uint16_t next_number = 0;
+  while (const PacketHeader *header = reader.extractPacket(5000u))
+  {
+    PacketReader packet(header);
+    EXPECT_TRUE(packet.checkCrc());
+    EXPECT_EQ(packet.messageId(), next_number);
+    ASSERT_EQ(packet.payloadSize(), payload_count(next_number) * sizeof(next_number));
+    uint16_t value = 0;
+    bool values_ok = true;
+    for (size_t j = 0; j < payload_count(next_number); ++j)
+    {
+      packet.readElement(value);
+      values_ok = values_ok && value == next_number;
+    }
+    EXPECT_TRUE(values_ok);
+    ++next_number;
+  }
+  producer.join();
+
+  EXPECT_TRUE(reader.isOk());
+  EXPECT_TRUE(reader.isEof());
+  EXPECT_EQ(next_number, packet_count);
+  // Only wrapped and oversized packets are copied.
+  EXPECT_GT(reader.copiedBytes(), 0u);
+  EXPECT_LT(reader.copiedBytes(), total_bytes / 2);
+
+  // Data without a packet marker end reading.
+  SharedMemoryRing writer2;
+  ASSERT_TRUE(writer2.create(name, capacity));
+  SharedMemoryRing reader_ring2;
+  ASSERT_TRUE(reader_ring2.open(name));
+  const std::vector<uint8_t> garbage(64u, 0xabu);
+  EXPECT_EQ(writer2.write(garbage.data(), garbage.size(), 0), int(garbage.size()));
+  SharedMemoryReader reader2(reader_ring2);
+  EXPECT_EQ(reader2.extractPacket(0), nullptr);
+  EXPECT_FALSE(reader2.isOk());
+}
 }  // namespace tes
@@ -15,6 +15,7 @@
 #include <3escore/PacketWriter.h>
 #include <3escore/Server.h>
 #include <3escore/ServerUtil.h>
+#include <3escore/SharedMemoryRing.h>
 #include <3escore/shapes/PointCloud.h>
 #include <3escore/shapes/Shapes.h>
 #include <3escore/shapes/SimpleMesh.h>
@@ -22,9 +23,12 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -237,14 +241,14 @@ void validateClient(TcpSocket &socket, const T &referenceShape, const ServerInfo
 
 template <class T>
 void testShape(const T &shape, ServerInfoMessage *infoOut = nullptr,
-               const char *saveFilePath = nullptr)
+               const char *saveFilePath = nullptr,
+               unsigned serverFlags = SFDefault | SFCollateAndCompress)
 {
   // Initialise server.
   ServerInfoMessage info;
   initDefaultServerInfo(&info);
   info.coordinate_frame = XYZ;
 
-  unsigned serverFlags = SFDefault | SFCollateAndCompress;
   ServerSettings serverSettings(serverFlags);
   serverSettings.port_range = 1000;
   auto server = Server::create(serverSettings, &info);
@@ -614,4 +618,1239 @@ TEST(Shapes, FileStream)
   testShape(shape, &serverInfo, fileName);
   validateFileStream(fileName, shape, serverInfo);
 }
+
+TEST(Shapes, AsyncSend)
+{
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeHiResSphere(vertices, indices, nullptr);
+
+  PointCloud cloud(42);
+  cloud.addPoints(vertices.data(), unsigned(vertices.size()));
+
+  // Send from the connection's send thread.
+  testShape(MeshSet(&cloud, Id(42u)), nullptr, nullptr,
+            SFDefault | SFCollateAndCompress | SFAsyncSend);
+  testShape(Sphere(Id(), Spherical(Vector3f(1.2f, 2.3f, 3.4f), 1.26f)), nullptr, nullptr,
+            SFDefault | SFAsyncSend);
+}
+
+TEST(Shapes, CorkFrames)
+{
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeHiResSphere(vertices, indices, nullptr);
+
+  PointCloud cloud(42);
+  cloud.addPoints(vertices.data(), unsigned(vertices.size()));
+
+  // Frames must still arrive promptly with the socket corked, including from the send thread.
+  testShape(MeshSet(&cloud, Id(42u)), nullptr, nullptr, SFDefault | SFCorkFrames);
+  testShape(MeshSet(&cloud, Id(42u)), nullptr, nullptr,
+            SFDefault | SFCollateAndCompress | SFCorkFrames | SFAsyncSend);
+  testShape(Sphere(Id(), Spherical(Vector3f(1.2f, 2.3f, 3.4f), 1.26f)), nullptr, nullptr,
+            SFDefault | SFCorkFrames);
+}
+
+TEST(Shapes, ConnectionExpiry)
+{
+  // Connections are detected and expired by the connection monitor in both modes.
+  for (const auto mode : { ConnectionMode::Asynchronous, ConnectionMode::Synchronous })
+  {
+    ServerInfoMessage info;
+    initDefaultServerInfo(&info);
+    ServerSettings serverSettings(SFDefault);
+    serverSettings.port_range = 1000;
+    auto server = Server::create(serverSettings, &info);
+    ASSERT_TRUE(server->connectionMonitor()->start(mode));
+
+    TcpSocket client;
+    ASSERT_TRUE(client.open("127.0.0.1", server->connectionMonitor()->port()));
+    ASSERT_GT(server->connectionMonitor()->waitForConnection(5000U), 0);
+    server->connectionMonitor()->commitConnections();
+    EXPECT_EQ(server->connectionCount(), 1u);
+
+    client.close();
+    const auto expiryStart = std::chrono::steady_clock::now();
+    while (server->connectionCount() > 0 &&
+           std::chrono::steady_clock::now() - expiryStart < std::chrono::seconds(5))
+    {
+      if (mode == ConnectionMode::Synchronous)
+      {
+        server->connectionMonitor()->monitorConnections();
+      }
+      server->connectionMonitor()->commitConnections();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(server->connectionCount(), 0u);
+
+    server->close();
+    server->connectionMonitor()->stop();
+    server->connectionMonitor()->join();
+  }
+}
+
+namespace
+{
+/// Send transient shapes to a client which never reads until @p done returns true or we time out.
+/// The small send queue overflows once the socket buffers are full.
+/// @return The final send queue statistics for the connection.
+SendQueueStats overflowSendQueue(SendOverflow overflow,
+                                 const std::function<bool(const Connection &)> &done)
+{
+  ServerInfoMessage info;
+  initDefaultServerInfo(&info);
+  ServerSettings serverSettings(SFDefault | SFAsyncSend);
+  serverSettings.port_range = 1000;
+  serverSettings.async_send_buffer_size = 64u * 1024u;
+  serverSettings.send_overflow = overflow;
+  auto server = Server::create(serverSettings, &info);
+  EXPECT_TRUE(server->connectionMonitor()->start(ConnectionMode::Synchronous));
+
+  TcpSocket client;
+  EXPECT_TRUE(client.open("127.0.0.1", server->connectionMonitor()->port()));
+  client.setReadBufferSize(4 * 1024);
+  EXPECT_GT(server->connectionMonitor()->waitForConnection(5000U), 0);
+  server->connectionMonitor()->commitConnections();
+  EXPECT_EQ(server->connectionCount(), 1u);
+  auto connection = server->connection(0);
+
+  SendQueueStats stats;
+  if (!connection)
+  {
+    return stats;
+  }
+
+  EXPECT_TRUE(connection->sendQueueStats(stats));
+  EXPECT_EQ(stats.capacity, 2u * serverSettings.client_buffer_size);
+  EXPECT_EQ(stats.dropped_bytes, 0u);
+
+  // Wait for the sender thread to write before flooding the queue, so sent_bytes does not depend
+  // on how quickly the sender is scheduled.
+  connection->create(Sphere(Id(), Spherical(Vector3f(1.2f, 2.3f, 3.4f), 1.26f)));
+  const auto send_start = std::chrono::steady_clock::now();
+  while (connection->sendQueueStats(stats) && stats.sent_bytes == 0 &&
+         std::chrono::steady_clock::now() - send_start < std::chrono::seconds(5))
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_GT(stats.sent_bytes, 0u);
+
+  const auto start = std::chrono::steady_clock::now();
+  while (!done(*connection) &&
+         std::chrono::steady_clock::now() - start < std::chrono::seconds(10))
+  {
+    for (int i = 0; i < 1000; ++i)
+    {
+      connection->create(Sphere(Id(), Spherical(Vector3f(1.2f, 2.3f, 3.4f), 1.26f)));
+    }
+  }
+
+  connection->sendQueueStats(stats);
+
+  // Closing the client fails any blocked writes so the server may close.
+  client.close();
+  server->close();
+  server->connectionMonitor()->stop();
+  server->connectionMonitor()->join();
+  return stats;
+}
+}  // namespace
+
+TEST(Shapes, AsyncSendDropTransient)
+{
+  bool connected = true;
+  const auto dropped = [&connected](const Connection &c) {
+    SendQueueStats current;
+    c.sendQueueStats(current);
+    connected = c.isConnected();
+    return current.dropped_bytes > 0 || !connected;
+  };
+  const SendQueueStats stats = overflowSendQueue(SODropTransient, dropped);
+
+  // Transient shapes are dropped while the connection remains open.
+  EXPECT_TRUE(connected);
+  EXPECT_GT(stats.dropped_bytes, 0u);
+  EXPECT_GT(stats.sent_bytes, 0u);
+  EXPECT_GT(stats.peak_queued_bytes, 0u);
+  EXPECT_LE(stats.peak_queued_bytes, stats.capacity);
+  EXPECT_LE(stats.queued_bytes, stats.capacity);
+}
+
+TEST(Shapes, AsyncSendDisconnect)
+{
+  const SendQueueStats stats =
+    overflowSendQueue(SODisconnect, [](const Connection &c) { return !c.isConnected(); });
+
+  // The connection fails on overflow, counting the data it could not queue.
+  EXPECT_GT(stats.dropped_bytes, 0u);
+  EXPECT_GT(stats.sent_bytes, 0u);
+  EXPECT_GT(stats.peak_queued_bytes, 0u);
+  EXPECT_LE(stats.peak_queued_bytes, stats.capacity);
+}
+
+TEST(Shapes, NestedNoCrc)
+{
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeHiResSphere(vertices, indices, nullptr);
+
+  PointCloud cloud(42);
+  cloud.addPoints(vertices.data(), unsigned(vertices.size()));
+
+  // Nested packets rely on the collated packet CRC.
+  testShape(MeshSet(&cloud, Id(42u)), nullptr, nullptr,
+            SFDefault | SFCollateAndCompress | SFNestedNoCrc);
+  testShape(Sphere(Id(), Spherical(Vector3f(1.2f, 2.3f, 3.4f), 1.26f)), nullptr, nullptr,
+            SFDefault | SFNestedNoCrc);
+}
+
+TEST(Shapes, LittleEndian)
+{
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeHiResSphere(vertices, indices, nullptr);
+
+  PointCloud cloud(42);
+  cloud.addPoints(vertices.data(), unsigned(vertices.size()));
+
+  // Payloads are written in little endian and must decode the same.
+  testShape(MeshSet(&cloud, Id(42u)), nullptr, nullptr,
+            SFDefault | SFCollateAndCompress | SFLittleEndian);
+  testShape(Sphere(Id(), Spherical(Vector3f(1.2f, 2.3f, 3.4f), 1.26f)), nullptr, nullptr,
+            SFDefault | SFLittleEndian);
+}
+
+TEST(Shapes, ExtendedPackets)
+{
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeHiResSphere(vertices, indices, nullptr);
+
+  // Enough points to exceed the 16-bit packet size in a single transfer.
+  PointCloud cloud(42);
+  while (cloud.vertexCount() * sizeof(Vector3f) <= 0xffffu)
+  {
+    cloud.addPoints(vertices.data(), unsigned(vertices.size()));
+  }
+
+  // Resource transfers use extended packets, which are too large to collate.
+  testShape(MeshSet(&cloud, Id(42u)), nullptr, nullptr, SFDefault | SFExtendedPackets);
+  testShape(MeshSet(&cloud, Id(42u)), nullptr, nullptr,
+            SFDefault | SFCollateAndCompress | SFExtendedPackets | SFAsyncSend);
+  testShape(MeshSet(&cloud, Id(42u)), nullptr, nullptr, SFExtendedPackets);
+}
+
+TEST(Shapes, SharedMemory)
+{
+  if (!SharedMemoryRing::supported())
+  {
+    GTEST_SKIP() << "Shared memory is not supported on this platform";
+  }
+
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeHiResSphere(vertices, indices, nullptr);
+
+  PointCloud cloud(42);
+  cloud.addPoints(vertices.data(), unsigned(vertices.size()));
+  const MeshSet shape(&cloud, Id(42u));
+
+  ServerInfoMessage info;
+  initDefaultServerInfo(&info);
+  info.coordinate_frame = XYZ;
+
+  ServerSettings serverSettings(SFDefault | SFCollateAndCompress);
+  serverSettings.port_range = 1000;
+  // Smaller than the stream to exercise a full ring.
+  serverSettings.shared_memory_size = 64u * 1024u;
+  auto server = Server::create(serverSettings, &info);
+
+  const std::string name =
+    "3es-test-shm-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+  ASSERT_TRUE(server->connectionMonitor()->openSharedMemory(name));
+  // The name is in use.
+  EXPECT_FALSE(server->connectionMonitor()->openSharedMemory(name));
+  ASSERT_TRUE(server->connectionMonitor()->start(tes::ConnectionMode::Asynchronous));
+
+  SharedMemoryRing client;
+  ASSERT_TRUE(client.open(name));
+
+  if (server->connectionMonitor()->waitForConnection(5000U) > 0)
+  {
+    server->connectionMonitor()->commitConnections();
+  }
+  ASSERT_EQ(server->connectionCount(), 1u);
+
+  // A new ring is listening for the next viewer.
+  SharedMemoryRing next_client;
+  EXPECT_TRUE(next_client.open(name));
+  next_client.close();
+
+  std::thread sendThread([server, &shape]() {
+    server->create(shape);
+    server->updateTransfers(0);
+    server->updateFrame(0.0f, true);
+
+    ControlMessage ctrlMsg;
+    memset(&ctrlMsg, 0, sizeof(ctrlMsg));
+    sendMessage(*server, MtControl, CIdEnd, ctrlMsg, false);
+  });
+
+  const DataReadFunc ringRead = [&client](uint8_t *buffer, int bufferLength) {
+    return int(client.read(buffer, size_t(bufferLength), 100u));
+  };
+  validateDataRead(ringRead, shape, info);
+
+  client.close();
+  sendThread.join();
+
+  server->close();
+  server->connectionMonitor()->stop();
+  server->connectionMonitor()->join();
+}
+
+TEST(Shapes, CompressionThreads)
+{
+  // Validate collated packets finalised by the compression workers are written in order.
+  const char *fileName = "cloud-stream-compression-threads.3es";
+
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeHiResSphere(vertices, indices, nullptr);
+
+  PointCloud cloud(42);
+  cloud.addPoints(vertices.data(), unsigned(vertices.size()));
+  const MeshSet shape(&cloud, Id(42u));
+
+  ServerInfoMessage serverInfo;
+  initDefaultServerInfo(&serverInfo);
+  serverInfo.coordinate_frame = XYZ;
+
+  ServerSettings serverSettings(SFDefault | SFCollateAndCompress);
+  serverSettings.compression_threads = 2;
+  auto server = Server::create(serverSettings, &serverInfo);
+
+  ASSERT_NE(server->connectionMonitor()->openFileStream(fileName), nullptr);
+  server->connectionMonitor()->commitConnections();
+
+  server->create(shape);
+  server->updateTransfers(0);
+  server->updateFrame(0.0f, true);
+  ControlMessage ctrlMsg;
+  memset(&ctrlMsg, 0, sizeof(ctrlMsg));
+  sendMessage(*server, MtControl, CIdEnd, ctrlMsg, false);
+
+  server->close();
+  server.reset();
+
+  validateFileStream(fileName, shape, serverInfo);
+}
+
+TEST(Shapes, CompressionThreadsClose)
+{
+  // Close and destroy connections while the compression workers are still finalising their
+  // packets. The workers must be done with each connection before close() returns. Many short
+  // sessions give the final job of each connection many chances to race the close.
+  const char *fileNames[] = { "compression-close-a.3es", "compression-close-b.3es",
+                              "compression-close-c.3es" };
+  const unsigned iterations = 200;
+  const unsigned frameCount = 1;
+  const unsigned spheresPerFrame = 1000;
+
+  ServerInfoMessage serverInfo;
+  initDefaultServerInfo(&serverInfo);
+
+  ServerSettings serverSettings(SFDefault | SFCollateAndCompress);
+  serverSettings.compression_threads = 4;
+  auto server = Server::create(serverSettings, &serverInfo);
+
+  for (unsigned i = 0; i < iterations; ++i)
+  {
+    std::vector<std::shared_ptr<Connection>> connections;
+    for (const char *fileName : fileNames)
+    {
+      connections.emplace_back(server->connectionMonitor()->openFileStream(fileName));
+      ASSERT_NE(connections.back(), nullptr);
+    }
+    server->connectionMonitor()->commitConnections();
+
+    for (unsigned frame = 0; frame < frameCount; ++frame)
+    {
+      for (unsigned s = 0; s < spheresPerFrame; ++s)
+      {
+        server->create(Sphere(Id(), Spherical(Vector3f(float(s), float(frame), 0), 1.0f)));
+      }
+      server->updateFrame(0.1f, true);
+    }
+
+    // Release the connections immediately after closing.
+    for (const auto &connection : connections)
+    {
+      connection->close();
+    }
+    server->connectionMonitor()->monitorConnections();
+    server->connectionMonitor()->commitConnections();
+    EXPECT_EQ(server->connectionCount(), 0u);
+    connections.clear();
+  }
+
+  server->close();
+  server.reset();
+}
+
+TEST(Shapes, FileStreamFanOut)
+{
+  // Validate shapes are correctly shared across multiple connections. The server encodes each
+  // shape message once and each connection should see the same byte stream.
+  const char *fileNames[] = { "cloud-stream-a.3es", "cloud-stream-b.3es" };
+
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeHiResSphere(vertices, indices, nullptr);
+
+  PointCloud cloud(42);
+  cloud.addPoints(vertices.data(), unsigned(vertices.size()));
+  const MeshSet shape(&cloud, Id(42u));
+
+  ServerInfoMessage serverInfo;
+  initDefaultServerInfo(&serverInfo);
+  serverInfo.coordinate_frame = XYZ;
+
+  // Also exercise dictionary compression.
+  ServerSettings serverSettings(SFDefault | SFCollateAndCompress | SFCompressionDictionary);
+  auto server = Server::create(serverSettings, &serverInfo);
+
+  for (const char *fileName : fileNames)
+  {
+    ASSERT_NE(server->connectionMonitor()->openFileStream(fileName), nullptr);
+  }
+  server->connectionMonitor()->commitConnections();
+  EXPECT_EQ(server->connectionCount(), 2u);
+
+  server->create(shape);
+  server->updateTransfers(0);
+  server->updateFrame(0.0f, true);
+  ControlMessage ctrlMsg;
+  memset(&ctrlMsg, 0, sizeof(ctrlMsg));
+  sendMessage(*server, MtControl, CIdEnd, ctrlMsg, false);
+
+  server->close();
+  server.reset();
+
+  std::vector<std::vector<char>> fileContent;
+  for (const char *fileName : fileNames)
+  {
+    validateFileStream(fileName, shape, serverInfo);
+    std::ifstream inFile(fileName, std::ios::binary);
+    fileContent.emplace_back(std::istreambuf_iterator<char>(inFile),
+                             std::istreambuf_iterator<char>());
+  }
+
+  EXPECT_FALSE(fileContent[0].empty());
+  EXPECT_EQ(fileContent[0], fileContent[1]);
+}
+
+TEST(Shapes, BufferedFileWrite)
+{
+  // Validate a file stream written from the background writer thread. Use small blocks so the
+  // buffer limit is reached and the writer must recycle blocks.
+  const char *fileName = "cloud-stream-buffered.3es";
+
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeHiResSphere(vertices, indices, nullptr);
+
+  PointCloud cloud(42);
+  cloud.addPoints(vertices.data(), unsigned(vertices.size()));
+  const MeshSet shape(&cloud, Id(42u));
+
+  ServerInfoMessage serverInfo;
+  initDefaultServerInfo(&serverInfo);
+  serverInfo.coordinate_frame = XYZ;
+
+  ServerSettings serverSettings(SFDefault | SFCollateAndCompress | SFBufferedFileWrite);
+  serverSettings.file_block_size = 4096u;
+  serverSettings.file_buffer_limit = 4u * serverSettings.file_block_size;
+  auto server = Server::create(serverSettings, &serverInfo);
+
+  auto connection = server->connectionMonitor()->openFileStream(fileName);
+  ASSERT_NE(connection, nullptr);
+  server->connectionMonitor()->commitConnections();
+
+  server->create(shape);
+  server->updateTransfers(0);
+  server->updateFrame(0.0f, true);
+  ControlMessage ctrlMsg;
+  memset(&ctrlMsg, 0, sizeof(ctrlMsg));
+  sendMessage(*server, MtControl, CIdEnd, ctrlMsg, false);
+
+  server->close();
+
+  FileWriteStats stats;
+  ASSERT_TRUE(connection->fileWriteStats(stats));
+  EXPECT_EQ(stats.pending_bytes, 0u);
+  EXPECT_EQ(stats.dropped_bytes, 0u);
+  EXPECT_EQ(stats.buffer_limit, serverSettings.file_buffer_limit);
+  EXPECT_GT(stats.block_count, 4u);
+  EXPECT_GT(stats.written_bytes, stats.buffer_limit);
+  EXPECT_LE(stats.peak_pending_bytes, stats.buffer_limit);
+  EXPECT_GE(stats.total_flush_us, stats.max_flush_us);
+
+  connection.reset();
+  server.reset();
+
+  validateFileStream(fileName, shape, serverInfo);
+}
+
+TEST(Shapes, ResourceCache)
+{
+  // Validate resources are encoded once and replayed to each connection from the server's cache.
+  const char *fileNames[] = { "cloud-cache-a.3es", "cloud-cache-b.3es" };
+
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeHiResSphere(vertices, indices, nullptr);
+
+  PointCloud cloud(42);
+  cloud.addPoints(vertices.data(), unsigned(vertices.size()));
+  const MeshSet shape(&cloud, Id(42u));
+
+  ServerInfoMessage serverInfo;
+  initDefaultServerInfo(&serverInfo);
+  serverInfo.coordinate_frame = XYZ;
+
+  ServerSettings serverSettings(SFDefault | SFResourceCache);
+  auto server = Server::create(serverSettings, &serverInfo);
+
+  for (const char *fileName : fileNames)
+  {
+    ASSERT_NE(server->connectionMonitor()->openFileStream(fileName), nullptr);
+  }
+  server->connectionMonitor()->commitConnections();
+  EXPECT_EQ(server->connectionCount(), 2u);
+
+  server->create(shape);
+  server->updateTransfers(0);
+  server->updateFrame(0.0f, true);
+
+  ResourceCacheStats stats;
+  ASSERT_TRUE(server->resourceCacheStats(stats));
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.uncached, 0u);
+  EXPECT_EQ(stats.resource_count, 1u);
+  EXPECT_GT(stats.byte_count, 0u);
+  EXPECT_LE(stats.byte_count, stats.byte_limit);
+
+  ControlMessage ctrlMsg;
+  memset(&ctrlMsg, 0, sizeof(ctrlMsg));
+  sendMessage(*server, MtControl, CIdEnd, ctrlMsg, false);
+
+  server->close();
+  server.reset();
+
+  std::vector<std::vector<char>> fileContent;
+  for (const char *fileName : fileNames)
+  {
+    validateFileStream(fileName, shape, serverInfo);
+    std::ifstream inFile(fileName, std::ios::binary);
+    fileContent.emplace_back(std::istreambuf_iterator<char>(inFile),
+                             std::istreambuf_iterator<char>());
+  }
+
+  EXPECT_FALSE(fileContent[0].empty());
+  EXPECT_EQ(fileContent[0], fileContent[1]);
+
+  // Releasing the last reference evicts the entry. Resources larger than the limit bypass the
+  // cache.
+  serverSettings.resource_cache_limit = 1024u;
+  server = Server::create(serverSettings, &serverInfo);
+  ASSERT_NE(server->connectionMonitor()->openFileStream(fileNames[0]), nullptr);
+  server->connectionMonitor()->commitConnections();
+  auto small_mesh = std::make_shared<SimpleMesh>(1u, 8u, 12u);
+  auto large_mesh = std::make_shared<SimpleMesh>(2u, 1000u, 1500u);
+  server->referenceResource(small_mesh);
+  server->referenceResource(large_mesh);
+  server->updateTransfers(0);
+  ASSERT_TRUE(server->resourceCacheStats(stats));
+  EXPECT_EQ(stats.resource_count, 1u);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.uncached, 1u);
+  EXPECT_LE(stats.byte_count, stats.byte_limit);
+
+  server->releaseResource(small_mesh);
+  server->releaseResource(large_mesh);
+  ASSERT_TRUE(server->resourceCacheStats(stats));
+  EXPECT_EQ(stats.resource_count, 0u);
+  EXPECT_EQ(stats.byte_count, 0u);
+  server->close();
+
+  // Resources are recorded incrementally, respecting the transfer byte limit, and a resource which
+  // did not fit is reconsidered once space is freed. First measure a mesh to size the cache.
+  const auto mesh_a = std::make_shared<SimpleMesh>(3u, 1000u, 1500u);
+  const auto mesh_b = std::make_shared<SimpleMesh>(4u, 1000u, 1500u);
+  serverSettings.resource_cache_limit = ServerSettings().resource_cache_limit;
+  server = Server::create(serverSettings, &serverInfo);
+  ASSERT_NE(server->connectionMonitor()->openFileStream(fileNames[0]), nullptr);
+  server->connectionMonitor()->commitConnections();
+  server->referenceResource(mesh_a);
+  server->updateTransfers(0);
+  ASSERT_TRUE(server->resourceCacheStats(stats));
+  const uint64_t mesh_bytes = stats.byte_count;
+  ASSERT_GT(mesh_bytes, 0u);
+  server->close();
+
+  serverSettings.resource_cache_limit = mesh_bytes + mesh_bytes / 2;
+  // Transfer one at a time so mesh_a is recorded first.
+  serverSettings.transfer_concurrency = 1;
+  server = Server::create(serverSettings, &serverInfo);
+  ASSERT_NE(server->connectionMonitor()->openFileStream(fileNames[0]), nullptr);
+  server->connectionMonitor()->commitConnections();
+  server->referenceResource(mesh_a);
+  server->referenceResource(mesh_b);
+  const unsigned byte_limit = 1024u;
+  int calls = 0;
+  while (server->updateTransfers(byte_limit) > 0)
+  {
+    ++calls;
+  }
+  EXPECT_GT(calls, 2);
+  ASSERT_TRUE(server->resourceCacheStats(stats));
+  EXPECT_EQ(stats.resource_count, 1u);
+  EXPECT_GE(stats.byte_count, mesh_bytes);
+  EXPECT_LE(stats.byte_count, stats.byte_limit);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.uncached, 1u);
+
+  // Evict mesh_a. A new connection records mesh_b, still referenced by the first connection.
+  server->releaseResource(mesh_a);
+  ASSERT_NE(server->connectionMonitor()->openFileStream(fileNames[1]), nullptr);
+  server->connectionMonitor()->commitConnections();
+  server->referenceResource(mesh_b);
+  server->updateTransfers(0);
+  ASSERT_TRUE(server->resourceCacheStats(stats));
+  EXPECT_EQ(stats.resource_count, 1u);
+  EXPECT_EQ(stats.misses, 2u);
+  server->close();
+
+  // The cache is disabled without SFResourceCache.
+  auto plainServer = Server::create(ServerSettings(SFDefault), &serverInfo);
+  EXPECT_FALSE(plainServer->resourceCacheStats(stats));
+}
+
+TEST(Shapes, MultiProducer)
+{
+  // Submit shapes from multiple threads and validate the per thread message order in the stream.
+  const char *fileName = "multi-producer.3es";
+  const unsigned threadCount = 4;
+  const unsigned waveCount = 2;
+  const unsigned shapesPerThread = 500;
+  const uint32_t idStride = 10000;
+
+  PointCloud cloud(42);
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeHiResSphere(vertices, indices, nullptr);
+  cloud.addPoints(vertices.data(), unsigned(vertices.size()));
+
+  ServerInfoMessage serverInfo;
+  initDefaultServerInfo(&serverInfo);
+  ServerSettings serverSettings(SFDefault | SFMultiProducer);
+  auto server = Server::create(serverSettings, &serverInfo);
+  ASSERT_NE(server->connectionMonitor()->openFileStream(fileName), nullptr);
+  server->connectionMonitor()->commitConnections();
+
+  // Submit from two waves of threads. Producers for the first wave are released on the frame
+  // update and must not affect the second wave.
+  for (unsigned wave = 0; wave < waveCount; ++wave)
+  {
+    std::vector<std::thread> threads;
+    for (unsigned t = wave * threadCount; t < (wave + 1) * threadCount; ++t)
+    {
+      threads.emplace_back([&server, &cloud, t, shapesPerThread, idStride]() {
+        if (t == 0)
+        {
+          EXPECT_GT(server->create(MeshSet(&cloud, Id(1u))), 0);
+        }
+        for (unsigned i = 0; i < shapesPerThread; ++i)
+        {
+          const uint32_t id = 1 + t * idStride + i;
+          Sphere sphere(Id(id), Spherical(Vector3f(float(i), float(t), 0), 0.5f));
+          EXPECT_GT(server->create(sphere), 0);
+          sphere.setPosition(Vector3f(float(i), float(t), 1.0f));
+          EXPECT_GT(server->update(sphere), 0);
+          if (i % 2 == 0)
+          {
+            EXPECT_GT(server->destroy(sphere), 0);
+          }
+        }
+      });
+    }
+
+    for (auto &thread : threads)
+    {
+      thread.join();
+    }
+
+    // Nothing is delivered until the frame update. Resources transfer after delivery.
+    server->updateFrame(0.0f, true);
+    server->updateTransfers(0);
+  }
+  server->updateFrame(0.0f, true);
+  ControlMessage ctrlMsg;
+  memset(&ctrlMsg, 0, sizeof(ctrlMsg));
+  sendMessage(*server, MtControl, CIdEnd, ctrlMsg, false);
+  server->close();
+  server.reset();
+
+  // Read back the stream in odd sized chunks.
+  std::ifstream inFile(fileName, std::ios::binary);
+  ASSERT_TRUE(inFile.is_open());
+  std::vector<uint8_t> decodeBuffer(0xffffu);
+  std::array<char, 1021> readBuffer = {};
+  PacketBuffer packetBuffer;
+  CollatedPacketDecoder decoder;
+  std::unordered_map<uint32_t, std::vector<uint16_t>> shapeMessages;
+  std::vector<uint32_t> lastCreated(waveCount * threadCount, 0);
+  bool meshSetCreated = false;
+  bool meshReceived = false;
+  bool endMsgReceived = false;
+
+  const auto nextPacket = [&]() -> const PacketHeader * {
+    const PacketHeader *packet = packetBuffer.extractPacket(decodeBuffer);
+    while (!packet && inFile)
+    {
+      inFile.read(readBuffer.data(), std::streamsize(readBuffer.size()));
+      packetBuffer.addBytes(reinterpret_cast<const uint8_t *>(readBuffer.data()),
+                            size_t(inFile.gcount()));
+      packet = packetBuffer.extractPacket(decodeBuffer);
+    }
+    return packet;
+  };
+
+  while (const PacketHeader *primaryPacket = nextPacket())
+  {
+    decoder.setPacket(primaryPacket);
+    while (const PacketHeader *packetHeader = decoder.next())
+    {
+      PacketReader reader(packetHeader);
+      uint32_t shapeId = 0;
+      switch (reader.routingId())
+      {
+      case SIdSphere:
+        reader.peek(reinterpret_cast<uint8_t *>(&shapeId), sizeof(shapeId));
+        shapeMessages[shapeId].emplace_back(reader.messageId());
+        if (reader.messageId() == OIdCreate)
+        {
+          // Creates from each thread must arrive in submission order.
+          const unsigned thread = (shapeId - 1) / idStride;
+          ASSERT_LT(thread, waveCount * threadCount);
+          EXPECT_GT(shapeId, lastCreated[thread]);
+          lastCreated[thread] = shapeId;
+        }
+        break;
+      case SIdMeshSet:
+        meshSetCreated = meshSetCreated || reader.messageId() == OIdCreate;
+        break;
+      case MtMesh:
+        meshReceived = true;
+        break;
+      case MtControl:
+        endMsgReceived = endMsgReceived || reader.messageId() == CIdEnd;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  EXPECT_TRUE(endMsgReceived);
+  EXPECT_TRUE(meshSetCreated);
+  EXPECT_TRUE(meshReceived);
+  EXPECT_EQ(shapeMessages.size(), waveCount * threadCount * shapesPerThread);
+  for (const auto &[shapeId, messages] : shapeMessages)
+  {
+    const unsigned index = (shapeId - 1) % idStride;
+    const std::vector<uint16_t> expected =
+      (index % 2 == 0) ? std::vector<uint16_t>{ OIdCreate, OIdUpdate, OIdDestroy } :
+                         std::vector<uint16_t>{ OIdCreate, OIdUpdate };
+    EXPECT_EQ(messages, expected) << "shape " << shapeId;
+  }
+}
+
+void testRetainState(unsigned flags)
+{
+  // Create shapes before any connection exists, then validate a late joining connection receives
+  // the retained state.
+  const char *fileName = (flags & SFMultiProducer) ? "retain-state-mp.3es" : "retain-state.3es";
+  const uint32_t shapeCount = 30;
+
+  PointCloud cloud(42);
+  std::vector<Vector3f> vertices;
+  std::vector<unsigned> indices;
+  makeHiResSphere(vertices, indices, nullptr);
+  cloud.addPoints(vertices.data(), unsigned(vertices.size()));
+
+  ServerInfoMessage serverInfo;
+  initDefaultServerInfo(&serverInfo);
+  ServerSettings serverSettings(flags | SFRetainState);
+  auto server = Server::create(serverSettings, &serverInfo);
+
+  // Without connections, the return value is the transferred byte count (zero) or the submitted
+  // byte count with SFMultiProducer. Only check for errors.
+
+  EXPECT_GE(server->create(MeshSet(&cloud, Id(1u))), 0);
+  for (uint32_t id = 1; id <= shapeCount; ++id)
+  {
+    Sphere sphere(Id(id), Spherical(Vector3f(float(id), 0, 0), 0.5f));
+    EXPECT_GE(server->create(sphere), 0);
+    // Full updates replace earlier updates.
+    sphere.setPosition(Vector3f(float(id), 1.0f, 0));
+    EXPECT_GE(server->update(sphere), 0);
+    sphere.setPosition(Vector3f(float(id), 2.0f, 0));
+    EXPECT_GE(server->update(sphere), 0);
+    if (id % 3 == 0)
+    {
+      // Partial updates follow the last full update.
+      sphere.setColour(Colour(255, 0, 0));
+      sphere.setFlags(UFUpdateMode | UFColour);
+      EXPECT_GE(server->update(sphere), 0);
+    }
+    if (id % 2 == 0)
+    {
+      sphere.setFlags(0);
+      EXPECT_GE(server->destroy(sphere), 0);
+    }
+    // Transient shapes are not retained.
+    server->create(Sphere());
+  }
+  server->updateFrame(0.0f, true);
+
+  RetainedStateStats stats;
+  ASSERT_TRUE(server->retainedStateStats(stats));
+  EXPECT_EQ(stats.shape_count, 1 + shapeCount / 2);
+  EXPECT_EQ(stats.resource_count, 1u);
+  EXPECT_EQ(stats.dropped_shapes, 0u);
+  EXPECT_GT(stats.byte_count, 0u);
+  EXPECT_EQ(stats.snapshot_count, 0u);
+
+  // Late joiner.
+  ASSERT_NE(server->connectionMonitor()->openFileStream(fileName), nullptr);
+  server->connectionMonitor()->commitConnections();
+  server->updateTransfers(0);
+  server->updateFrame(0.0f, true);
+
+  ASSERT_TRUE(server->retainedStateStats(stats));
+  EXPECT_EQ(stats.snapshot_count, 1u);
+  EXPECT_GT(stats.snapshot_bytes, 0u);
+
+  ControlMessage ctrlMsg;
+  memset(&ctrlMsg, 0, sizeof(ctrlMsg));
+  sendMessage(*server, MtControl, CIdEnd, ctrlMsg, false);
+  server->close();
+  server.reset();
+
+  // Read back the stream.
+  std::ifstream inFile(fileName, std::ios::binary);
+  ASSERT_TRUE(inFile.is_open());
+  const std::vector<uint8_t> fileContent((std::istreambuf_iterator<char>(inFile)),
+                                         std::istreambuf_iterator<char>());
+  std::vector<uint8_t> decodeBuffer(0xffffu);
+  PacketBuffer packetBuffer;
+  CollatedPacketDecoder decoder;
+  std::map<uint32_t, std::vector<uint16_t>> shapeMessages;
+  bool meshSetCreated = false;
+  bool meshReceived = false;
+  bool endMsgReceived = false;
+
+  packetBuffer.addBytes(fileContent.data(), fileContent.size());
+  while (const PacketHeader *primaryPacket = packetBuffer.extractPacket(decodeBuffer))
+  {
+    decoder.setPacket(primaryPacket);
+    while (const PacketHeader *packetHeader = decoder.next())
+    {
+      PacketReader reader(packetHeader);
+      uint32_t shapeId = 0;
+      switch (reader.routingId())
+      {
+      case SIdSphere:
+        reader.peek(reinterpret_cast<uint8_t *>(&shapeId), sizeof(shapeId));
+        shapeMessages[shapeId].emplace_back(reader.messageId());
+        break;
+      case SIdMeshSet:
+        meshSetCreated = meshSetCreated || reader.messageId() == OIdCreate;
+        break;
+      case MtMesh:
+        meshReceived = true;
+        break;
+      case MtControl:
+        endMsgReceived = endMsgReceived || reader.messageId() == CIdEnd;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  EXPECT_TRUE(endMsgReceived);
+  EXPECT_TRUE(meshSetCreated);
+  EXPECT_TRUE(meshReceived);
+  EXPECT_EQ(shapeMessages.size(), shapeCount / 2);
+  for (const auto &[shapeId, messages] : shapeMessages)
+  {
+    EXPECT_EQ(shapeId % 2, 1u) << "shape " << shapeId;
+    const std::vector<uint16_t> expected =
+      (shapeId % 3 == 0) ? std::vector<uint16_t>{ OIdCreate, OIdUpdate, OIdUpdate } :
+                           std::vector<uint16_t>{ OIdCreate, OIdUpdate };
+    EXPECT_EQ(messages, expected) << "shape " << shapeId;
+  }
+}
+
+TEST(Shapes, RetainState)
+{
+  testRetainState(SFDefault);
+}
+
+TEST(Shapes, RetainStateMultiProducer)
+{
+  testRetainState(SFDefault | SFMultiProducer);
+}
+
+TEST(Shapes, RetainStateLimit)
+{
+  ServerInfoMessage serverInfo;
+  initDefaultServerInfo(&serverInfo);
+  ServerSettings serverSettings(SFDefault | SFRetainState);
+  serverSettings.retained_state_limit = 1024u;
+  auto server = Server::create(serverSettings, &serverInfo);
+
+  for (uint32_t id = 1; id <= 100; ++id)
+  {
+    server->create(Sphere(Id(id)));
+  }
+
+  RetainedStateStats stats;
+  ASSERT_TRUE(server->retainedStateStats(stats));
+  EXPECT_GT(stats.shape_count, 0u);
+  EXPECT_LT(stats.shape_count, 100u);
+  EXPECT_EQ(stats.shape_count + stats.dropped_shapes, 100u);
+  EXPECT_LE(stats.byte_count, stats.byte_limit);
+  EXPECT_LE(stats.peak_byte_count, stats.byte_limit);
+
+  // Retained state is disabled without SFRetainState.
+  auto plainServer = Server::create(ServerSettings(SFDefault), &serverInfo);
+  EXPECT_FALSE(plainServer->retainedStateStats(stats));
+}
+
+TEST(Shapes, RetainStatePartialUpdates)
+{
+  // A shape which keeps moving via partial updates must not grow until evicted. Partial updates
+  // are coalesced by attribute set.
+  const char *fileName = "retain-state-partial.3es";
+  const unsigned updateCount = 1000;
+
+  ServerInfoMessage serverInfo;
+  initDefaultServerInfo(&serverInfo);
+  ServerSettings serverSettings(SFDefault | SFRetainState);
+  serverSettings.retained_state_limit = 1024u;
+  auto server = Server::create(serverSettings, &serverInfo);
+
+  Sphere sphere(Id(1u), Spherical(Vector3f(0.0f), 0.5f));
+  server->create(sphere);
+  for (unsigned i = 1; i <= updateCount; ++i)
+  {
+    if (i % 10 == 0)
+    {
+      sphere.setColour(Colour(i % 256u, 0, 0));
+      sphere.setFlags(UFUpdateMode | UFColour);
+      server->update(sphere);
+    }
+    sphere.setPosition(Vector3f(float(i), 0, 0));
+    sphere.setFlags(UFUpdateMode | UFPosition);
+    server->update(sphere);
+  }
+  // Moving and colouring supersedes moving or colouring alone.
+  sphere.setPosition(Vector3f(float(updateCount + 1), 0, 0));
+  sphere.setFlags(UFUpdateMode | UFPosition | UFColour);
+  server->update(sphere);
+  sphere.setPosition(Vector3f(float(updateCount + 2), 0, 0));
+  sphere.setFlags(UFUpdateMode | UFPosition);
+  server->update(sphere);
+
+  RetainedStateStats stats;
+  ASSERT_TRUE(server->retainedStateStats(stats));
+  EXPECT_EQ(stats.shape_count, 1u);
+  EXPECT_EQ(stats.dropped_shapes, 0u);
+  EXPECT_LE(stats.peak_byte_count, stats.byte_limit);
+
+  // Late joiner.
+  ASSERT_NE(server->connectionMonitor()->openFileStream(fileName), nullptr);
+  server->connectionMonitor()->commitConnections();
+  server->updateFrame(0.0f, true);
+  server->close();
+  server.reset();
+
+  std::ifstream inFile(fileName, std::ios::binary);
+  ASSERT_TRUE(inFile.is_open());
+  const std::vector<uint8_t> fileContent((std::istreambuf_iterator<char>(inFile)),
+                                         std::istreambuf_iterator<char>());
+  std::vector<uint8_t> decodeBuffer(0xffffu);
+  PacketBuffer packetBuffer;
+  CollatedPacketDecoder decoder;
+  std::vector<uint16_t> updateFlags;
+  float position = 0;
+
+  packetBuffer.addBytes(fileContent.data(), fileContent.size());
+  while (const PacketHeader *primaryPacket = packetBuffer.extractPacket(decodeBuffer))
+  {
+    decoder.setPacket(primaryPacket);
+    while (const PacketHeader *packetHeader = decoder.next())
+    {
+      PacketReader reader(packetHeader);
+      if (reader.routingId() == SIdSphere && reader.messageId() == OIdUpdate)
+      {
+        UpdateMessage msg = {};
+        ObjectAttributesd attributes = {};
+        ASSERT_TRUE(msg.read(reader, attributes));
+        updateFlags.emplace_back(msg.flags & (UFUpdateMode | UFPosRotScaleColour));
+        if (msg.flags & UFPosition)
+        {
+          position = float(attributes.position[0]);
+        }
+      }
+    }
+  }
+
+  const std::vector<uint16_t> expected = { uint16_t(UFUpdateMode | UFPosition | UFColour),
+                                           uint16_t(UFUpdateMode | UFPosition) };
+  EXPECT_EQ(updateFlags, expected);
+  EXPECT_EQ(position, float(updateCount + 2));
+}
+
+namespace
+{
+/// Find the @c ResourceTransferProgress for @p resource_key in @p transfers .
+const ResourceTransferProgress *findTransfer(const std::vector<ResourceTransferProgress> &transfers,
+                                             uint64_t resource_key)
+{
+  for (const auto &transfer : transfers)
+  {
+    if (transfer.resource_key == resource_key)
+    {
+      return &transfer;
+    }
+  }
+  return nullptr;
+}
+}  // namespace
+
+TEST(Shapes, ResourceTransferSchedule)
+{
+  const char *fileName = "resource-schedule.3es";
+  ServerInfoMessage serverInfo;
+  initDefaultServerInfo(&serverInfo);
+  ServerSettings serverSettings(SFDefault);
+  serverSettings.transfer_concurrency = 2;
+  auto server = Server::create(serverSettings, &serverInfo);
+  ASSERT_NE(server->connectionMonitor()->openFileStream(fileName), nullptr);
+  server->connectionMonitor()->commitConnections();
+  ASSERT_EQ(server->connectionCount(), 1u);
+  auto connection = server->connection(0);
+
+  // A large mesh queued ahead of several small meshes.
+  auto large = std::make_shared<SimpleMesh>(1u, 200000u, 300000u);
+  std::vector<std::shared_ptr<SimpleMesh>> small;
+  for (uint32_t id = 2; id < 6; ++id)
+  {
+    small.emplace_back(std::make_shared<SimpleMesh>(id, 8u, 12u));
+  }
+  EXPECT_GT(large->estimateTransferSize(), small.front()->estimateTransferSize());
+
+  server->referenceResource(large);
+  for (const auto &mesh : small)
+  {
+    server->referenceResource(mesh);
+  }
+
+  std::vector<ResourceTransferProgress> transfers;
+  ASSERT_TRUE(connection->resourceTransfers(transfers));
+  ASSERT_EQ(transfers.size(), 5u);
+  // Nothing started, smallest first.
+  EXPECT_FALSE(transfers.front().active);
+  EXPECT_EQ(transfers.back().resource_key, large->uniqueKey());
+
+  // Raising the large mesh priority starts it first.
+  EXPECT_TRUE(server->setResourcePriority(large, 1));
+  ASSERT_TRUE(connection->resourceTransfers(transfers));
+  EXPECT_EQ(transfers.front().resource_key, large->uniqueKey());
+  EXPECT_EQ(transfers.front().priority, 1);
+
+  const unsigned byte_limit = 16u * 1024u;
+  EXPECT_GT(server->updateTransfers(byte_limit), 0);
+  ASSERT_TRUE(connection->resourceTransfers(transfers));
+  const ResourceTransferProgress *large_progress = findTransfer(transfers, large->uniqueKey());
+  ASSERT_NE(large_progress, nullptr);
+  EXPECT_TRUE(large_progress->active);
+  EXPECT_GT(large_progress->bytes_sent, 0u);
+  for (const auto &mesh : small)
+  {
+    const ResourceTransferProgress *progress = findTransfer(transfers, mesh->uniqueKey());
+    ASSERT_NE(progress, nullptr);
+    EXPECT_EQ(progress->bytes_sent, 0u);
+  }
+
+  // At equal priority, the small meshes are interleaved with the large mesh and complete first.
+  EXPECT_TRUE(server->setResourcePriority(large, 0));
+  for (int i = 0; i < 8; ++i)
+  {
+    server->updateTransfers(byte_limit);
+  }
+  ASSERT_TRUE(connection->resourceTransfers(transfers));
+  ASSERT_EQ(transfers.size(), 1u);
+  EXPECT_EQ(transfers.front().resource_key, large->uniqueKey());
+  EXPECT_TRUE(transfers.front().active);
+  EXPECT_LT(transfers.front().bytes_sent, transfers.front().estimated_bytes);
+
+  // No byte limit completes the transfer.
+  server->updateTransfers(0);
+  ASSERT_TRUE(connection->resourceTransfers(transfers));
+  EXPECT_TRUE(transfers.empty());
+  EXPECT_FALSE(server->setResourcePriority(large, 1));
+
+  server->close();
+}
+
+TEST(Shapes, ResourceTransferFairness)
+{
+  const char *fileName = "resource-fairness.3es";
+  ServerInfoMessage serverInfo;
+  initDefaultServerInfo(&serverInfo);
+  ServerSettings serverSettings(SFDefault);
+  serverSettings.transfer_concurrency = 1;
+  auto server = Server::create(serverSettings, &serverInfo);
+  ASSERT_NE(server->connectionMonitor()->openFileStream(fileName), nullptr);
+  server->connectionMonitor()->commitConnections();
+  auto connection = server->connection(0);
+
+  // Meshes of the same size class are pending in queue order.
+  std::vector<std::shared_ptr<SimpleMesh>> meshes;
+  for (uint32_t id = 1; id <= 40; ++id)
+  {
+    meshes.emplace_back(std::make_shared<SimpleMesh>(id, 20000u, 30000u));
+    server->referenceResource(meshes.back());
+  }
+
+  std::vector<ResourceTransferProgress> transfers;
+  ASSERT_TRUE(connection->resourceTransfers(transfers));
+  ASSERT_EQ(transfers.size(), meshes.size());
+  for (size_t i = 0; i < meshes.size(); ++i)
+  {
+    EXPECT_EQ(transfers[i].resource_key, meshes[i]->uniqueKey());
+  }
+
+  // Referencing the last mesh again moves it ahead a bounded distance, once only.
+  const auto index_of = [&transfers](uint64_t resource_key) {
+    for (size_t i = 0; i < transfers.size(); ++i)
+    {
+      if (transfers[i].resource_key == resource_key)
+      {
+        return i;
+      }
+    }
+    return transfers.size();
+  };
+  for (int i = 0; i < 3; ++i)
+  {
+    server->referenceResource(meshes.back());
+  }
+  ASSERT_TRUE(connection->resourceTransfers(transfers));
+  EXPECT_EQ(transfers.front().resource_key, meshes.front()->uniqueKey());
+  EXPECT_LT(index_of(meshes.back()->uniqueKey()), meshes.size() - 1);
+  EXPECT_GT(index_of(meshes.back()->uniqueKey()), meshes.size() / 2);
+
+  // Higher priorities preempt active transfers only up to twice the concurrency limit.
+  const unsigned byte_limit = 1024u;
+  server->updateTransfers(byte_limit);
+  EXPECT_TRUE(server->setResourcePriority(meshes[1], 1));
+  server->updateTransfers(byte_limit);
+  EXPECT_TRUE(server->setResourcePriority(meshes[2], 2));
+  server->updateTransfers(byte_limit);
+  ASSERT_TRUE(connection->resourceTransfers(transfers));
+  const auto active_count =
+    std::count_if(transfers.begin(), transfers.end(),
+                  [](const ResourceTransferProgress &transfer) { return transfer.active; });
+  EXPECT_EQ(active_count, 2);
+  const ResourceTransferProgress *progress = findTransfer(transfers, meshes[2]->uniqueKey());
+  ASSERT_NE(progress, nullptr);
+  EXPECT_FALSE(progress->active);
+
+  server->close();
+}
+
+TEST(Shapes, ResourceTransferByteLimit)
+{
+  const char *fileName = "resource-byte-limit.3es";
+  ServerInfoMessage serverInfo;
+  initDefaultServerInfo(&serverInfo);
+  auto server = Server::create(ServerSettings(SFDefault), &serverInfo);
+  ASSERT_NE(server->connectionMonitor()->openFileStream(fileName), nullptr);
+  server->connectionMonitor()->commitConnections();
+  auto connection = server->connection(0);
+
+  auto mesh = std::make_shared<SimpleMesh>(1u, 1000u, 1500u);
+  server->referenceResource(mesh);
+
+  // A small byte limit must not truncate the transfer. Each call sends at least one packet.
+  const unsigned byte_limit = 1024u;
+  std::vector<ResourceTransferProgress> transfers;
+  ResourceTransferProgress last_progress;
+  unsigned calls = 0;
+  ASSERT_TRUE(connection->resourceTransfers(transfers));
+  while (!transfers.empty() && calls < 10000u)
+  {
+    last_progress = transfers.front();
+    EXPECT_GT(server->updateTransfers(byte_limit), 0);
+    ++calls;
+    ASSERT_TRUE(connection->resourceTransfers(transfers));
+  }
+
+  EXPECT_TRUE(transfers.empty());
+  EXPECT_GT(calls, 1u);
+  EXPECT_GE(last_progress.bytes_sent + 2u * byte_limit, last_progress.estimated_bytes);
+
+  server->close();
+}
+
+TEST(Shapes, ResourceTransferTimeBudget)
+{
+  const char *fileName = "resource-time-budget.3es";
+  ServerInfoMessage serverInfo;
+  initDefaultServerInfo(&serverInfo);
+  ServerSettings serverSettings(SFDefault);
+  // Any packet exhausts the budget.
+  serverSettings.transfer_time_budget_us = 1;
+  auto server = Server::create(serverSettings, &serverInfo);
+  ASSERT_NE(server->connectionMonitor()->openFileStream(fileName), nullptr);
+  server->connectionMonitor()->commitConnections();
+  auto connection = server->connection(0);
+
+  auto mesh = std::make_shared<SimpleMesh>(1u, 200000u, 300000u);
+  server->referenceResource(mesh);
+
+  // Each call makes progress, but a zero byte limit no longer transfers everything at once.
+  std::vector<ResourceTransferProgress> transfers;
+  unsigned calls = 0;
+  do
+  {
+    EXPECT_GT(server->updateTransfers(0), 0);
+    ++calls;
+    ASSERT_TRUE(connection->resourceTransfers(transfers));
+  } while (!transfers.empty() && calls < 10000u);
+
+  EXPECT_TRUE(transfers.empty());
+  EXPECT_GT(calls, 1u);
+
+  server->close();
+}
 }  // namespace tes
@@ -4,20 +4,33 @@
 
 #include "TestCommon.h"
 
+#include <3escore/CollatedPacketDecoder.h>
+#include <3escore/Connection.h>
+#include <3escore/ConnectionMonitor.h>
 #include <3escore/CoordinateFrame.h>
 #include <3escore/CoreUtil.h>
+#include <3escore/MappedFile.h>
 #include <3escore/Messages.h>
 #include <3escore/PacketBuffer.h>
 #include <3escore/PacketReader.h>
 #include <3escore/PacketStreamReader.h>
+#include <3escore/PacketWriter.h>
+#include <3escore/Server.h>
 #include <3escore/StreamUtil.h>
+#include <3escore/shapes/Sphere.h>
 
 #include <gtest/gtest.h>
 
 #include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iterator>
 #include <memory>
 #include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace tes
 {
@@ -82,7 +95,7 @@ TEST(Stream, Util)
   std::stringstream &stream = *stream_ptr;
 
   const uint32_t expect_frame_count = 42u;
-  ServerInfoMessage expected_info = { 101, 202, ZYX, { 0u } };
+  ServerInfoMessage expected_info = { 101, 202, ZYX, 0u, { 0u } };
 
   // First write some rubbish to the stream in order to set prime it. We'll include writing
   // part of the packet marker at the start, but not complete the packet.
@@ -199,4 +212,356 @@ TEST(Stream, PacketBuffer)
   EXPECT_EQ(restored_info.coordinate_frame, expected_server_info.coordinate_frame);
   EXPECT_EQ(final_frame_count, expected_frame_count);
 }
+
+
+TEST(Stream, PacketBufferRing)
+{
+  // Build a stream of packets of varying size, with junk between some packets.
+  std::vector<uint8_t> stream_bytes = { 'j', 'u', 'n', 'k' };
+  std::vector<uint8_t> packet_bytes(256u);
+  const unsigned packet_count = 200u;
+  for (unsigned i = 0; i < packet_count; ++i)
+  {
+    PacketWriter writer(packet_bytes.data(), static_cast<uint16_t>(packet_bytes.size()),
+                        MtControl, static_cast<uint16_t>(i));
+    for (unsigned j = 0; j < i % 23u; ++j)
+    {
+      writer.writeElement(i);
+    }
+    ASSERT_TRUE(writer.finalise());
+    stream_bytes.insert(stream_bytes.end(), writer.data(), writer.data() + writer.packetSize());
+    if (i % 7u == 3u)
+    {
+      stream_bytes.insert(stream_bytes.end(), { 0xffu, 0x00u, 0x7fu });
+    }
+  }
+
+  const auto validate = [](const PacketHeader *header, unsigned expected_id) {
+    PacketReader reader(header);
+    EXPECT_EQ(reader.routingId(), MtControl);
+    EXPECT_EQ(reader.messageId(), expected_id);
+    EXPECT_TRUE(reader.checkCrc());
+    for (unsigned j = 0; j < expected_id % 23u; ++j)
+    {
+      unsigned value = 0;
+      EXPECT_EQ(reader.readElement(value), sizeof(value));
+      EXPECT_EQ(value, expected_id);
+    }
+  };
+
+  // Use a small capacity and odd sized reads to exercise wrapping and markers split across reads.
+  for (const size_t chunk_size : { size_t(1u), size_t(7u), size_t(50u), size_t(4096u) })
+  {
+    PacketBuffer packet_buffer(64u);
+    unsigned extracted_count = 0;
+    for (size_t offset = 0; offset < stream_bytes.size(); offset += chunk_size)
+    {
+      const size_t byte_count = std::min(chunk_size, stream_bytes.size() - offset);
+      const int accepted = packet_buffer.addBytes(stream_bytes.data() + offset, byte_count);
+      if (offset == 0 && byte_count >= 8u)
+      {
+        // Junk rejected.
+        EXPECT_EQ(accepted, 4);
+      }
+
+      while (const PacketHeader *header = packet_buffer.extractPacket())
+      {
+        validate(header, extracted_count++);
+      }
+    }
+
+    EXPECT_EQ(extracted_count, packet_count) << "chunk size " << chunk_size;
+    if (chunk_size < 256u)
+    {
+      // The ring buffer is reused rather than growing with the stream.
+      EXPECT_LE(packet_buffer.capacity(), 512u) << "chunk size " << chunk_size;
+    }
+  }
+}
+
+
+/// Scan the packets in @p buffer , recording the offset following each packet which contains a
+/// @c CIdFrame message, stopping at the frame index.
+std::vector<uint64_t> scanFrameOffsets(const std::vector<uint8_t> &buffer)
+{
+  std::vector<uint64_t> frame_offsets;
+  CollatedPacketDecoder decoder;
+  size_t offset = 0;
+  while (offset + sizeof(PacketHeader) <= buffer.size())
+  {
+    const auto *header = reinterpret_cast<const PacketHeader *>(buffer.data() + offset);
+    const PacketReader packet(header);
+    if (packet.routingId() == MtFrameIndex)
+    {
+      break;
+    }
+
+    offset += packet.packetSize();
+    decoder.setPacket(header);
+    while (const PacketHeader *decoded = decoder.next())
+    {
+      const PacketReader message(decoded);
+      if (message.routingId() == MtControl && message.messageId() == CIdFrame)
+      {
+        frame_offsets.emplace_back(offset);
+      }
+    }
+  }
+  return frame_offsets;
+}
+
+
+TEST(Stream, FrameIndex)
+{
+  const char *file_name = "frame-index.3es";
+  const unsigned frame_count = 20;
+
+  // Validate frame offsets, including with ordered writes from the compression workers and the
+  // buffered file writer.
+  for (const unsigned flags : { 0u, unsigned(SFCollateAndCompress | SFBufferedFileWrite) })
+  {
+    ServerInfoMessage server_info;
+    initDefaultServerInfo(&server_info);
+    ServerSettings settings(SFDefault | flags);
+    settings.compression_threads = (flags) ? 2 : 0;
+    auto server = Server::create(settings, &server_info);
+    ASSERT_NE(server->connectionMonitor()->openFileStream(file_name), nullptr);
+    server->connectionMonitor()->commitConnections();
+
+    for (unsigned i = 0; i < frame_count; ++i)
+    {
+      server->create(Sphere(Id(), Spherical(Vector3f(float(i), 0, 0), 1.0f)));
+      server->updateFrame(0.1f, true);
+    }
+
+    server->close();
+    server.reset();
+
+    // The index must match the frame boundaries found by scanning the stream.
+    auto file = std::make_shared<std::ifstream>(file_name, std::ios::binary);
+    ASSERT_TRUE(file->is_open());
+    const std::vector<uint8_t> content((std::istreambuf_iterator<char>(*file)),
+                                       std::istreambuf_iterator<char>());
+    file->clear();
+    file->seekg(0);
+
+    std::vector<uint64_t> frame_offsets;
+    ASSERT_TRUE(streamutil::readFrameIndex(*file, frame_offsets));
+    EXPECT_EQ(file->tellg(), 0);
+    EXPECT_EQ(frame_offsets, scanFrameOffsets(content));
+    ASSERT_EQ(frame_offsets.size(), frame_count);
+
+    // Seek via the reader and count the remaining frames.
+    PacketStreamReader reader(file);
+    ASSERT_TRUE(reader.loadFrameIndex());
+    EXPECT_EQ(reader.indexedFrameCount(), frame_count);
+    for (const uint32_t frame : { 0u, 1u, 7u, frame_count })
+    {
+      ASSERT_TRUE(reader.seekFrame(frame));
+      EXPECT_EQ(reader.position(), (frame) ? frame_offsets[frame - 1] : 0u);
+      unsigned remaining_frames = 0;
+      CollatedPacketDecoder decoder;
+      while (const PacketHeader *header = reader.extractPacket())
+      {
+        const unsigned previous_frames = remaining_frames;
+        decoder.setPacket(header);
+        while (const PacketHeader *decoded = decoder.next())
+        {
+          const PacketReader message(decoded);
+          remaining_frames += message.routingId() == MtControl && message.messageId() == CIdFrame;
+        }
+        // The reader position after a frame must match the index.
+        if (remaining_frames != previous_frames)
+        {
+          EXPECT_EQ(reader.position(), frame_offsets[frame + remaining_frames - 1]);
+        }
+      }
+      EXPECT_EQ(remaining_frames, frame_count - frame);
+    }
+    EXPECT_FALSE(reader.seekFrame(frame_count + 1));
+  }
+
+  // Streams without an index remain readable, but can only seek to the start.
+  auto stream = std::make_shared<std::stringstream>();
+  ServerInfoMessage server_info;
+  initDefaultServerInfo(&server_info);
+  streamutil::initialiseStream(*stream, &server_info);
+  ASSERT_TRUE(streamutil::finaliseStream(*stream, 0, &server_info));
+
+  PacketStreamReader reader(stream);
+  EXPECT_FALSE(reader.loadFrameIndex());
+  EXPECT_FALSE(reader.hasFrameIndex());
+  EXPECT_FALSE(reader.seekFrame(1));
+  EXPECT_TRUE(reader.seekFrame(0));
+  ServerInfoMessage read_info;
+  uint32_t read_frame_count = 0;
+  stream->clear();
+  stream->seekg(0);
+  EXPECT_TRUE(readStreamInfo(stream, read_info, read_frame_count));
+}
+
+
+/// Extract all packets from @p reader as byte vectors, along with the reader position after each.
+std::vector<std::pair<std::vector<uint8_t>, uint64_t>> extractAll(PacketStreamReader &reader)
+{
+  std::vector<std::pair<std::vector<uint8_t>, uint64_t>> packets;
+  while (const PacketHeader *header = reader.extractPacket())
+  {
+    const auto *bytes = reinterpret_cast<const uint8_t *>(header);
+    packets.emplace_back(std::vector<uint8_t>(bytes, bytes + PacketReader(header).packetSize()),
+                         reader.position());
+  }
+  return packets;
+}
+
+
+TEST(Stream, MappedReader)
+{
+  const char *file_name = "mapped-reader.3es";
+  const unsigned frame_count = 20;
+
+  {
+    ServerInfoMessage server_info;
+    initDefaultServerInfo(&server_info);
+    auto server = Server::create(ServerSettings(SFDefault), &server_info);
+    ASSERT_NE(server->connectionMonitor()->openFileStream(file_name), nullptr);
+    server->connectionMonitor()->commitConnections();
+    for (unsigned i = 0; i < frame_count; ++i)
+    {
+      server->create(Sphere(Id(), Spherical(Vector3f(float(i), 0, 0), 1.0f)));
+      server->updateFrame(0.1f, true);
+    }
+    server->close();
+  }
+
+  // Reference packets via a regular file stream.
+  PacketStreamReader stream_reader(std::make_shared<std::ifstream>(file_name, std::ios::binary));
+  EXPECT_FALSE(stream_reader.isMapped());
+  const auto expected = extractAll(stream_reader);
+  EXPECT_TRUE(stream_reader.isEof());
+  ASSERT_GT(expected.size(), frame_count);
+
+  // Read via open(), which maps the file where supported.
+  PacketStreamReader reader;
+  ASSERT_TRUE(reader.open(file_name));
+  EXPECT_EQ(reader.isMapped(), MappedFile::supported());
+  EXPECT_FALSE(reader.isEof());
+  ASSERT_TRUE(reader.loadFrameIndex());
+  EXPECT_EQ(reader.indexedFrameCount(), frame_count);
+  EXPECT_EQ(extractAll(reader), expected);
+  EXPECT_TRUE(reader.isOk());
+  EXPECT_TRUE(reader.isEof());
+
+  // Seeking to a frame matches the stream reader.
+  ASSERT_TRUE(reader.seekFrame(frame_count / 2));
+  ASSERT_TRUE(stream_reader.loadFrameIndex());
+  ASSERT_TRUE(stream_reader.seekFrame(frame_count / 2));
+  EXPECT_EQ(extractAll(reader), extractAll(stream_reader));
+
+  // Read with junk between packets, including partial markers, and a truncated packet at the end.
+  // Use a small chunk size relative to the junk to cover markers split across reads.
+  const auto packet_marker = networkEndianSwapValue(kPacketMarker);
+  std::array<char, sizeof(packet_marker)> marker_bytes = {};
+  std::memcpy(marker_bytes.data(), &packet_marker, sizeof(packet_marker));
+  std::string junk_content = "junk";
+  for (const auto &[packet, position] : expected)
+  {
+    junk_content.append(marker_bytes.data(), marker_bytes.size() - 1);
+    junk_content.append(std::string(1500, 'x'));
+    junk_content.append(packet.begin(), packet.end());
+  }
+  junk_content.append(expected.front().first.begin(), expected.front().first.end() - 1);
+
+  PacketStreamReader junk_reader(std::make_shared<std::stringstream>(junk_content));
+  const auto junk_packets = extractAll(junk_reader);
+  ASSERT_EQ(junk_packets.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i)
+  {
+    EXPECT_EQ(junk_packets[i].first, expected[i].first);
+  }
+  EXPECT_TRUE(junk_reader.isEof());
+  EXPECT_EQ(junk_reader.position(), junk_content.size());
+
+  std::filesystem::remove(file_name);
+}
+
+
+TEST(Stream, CorruptExtendedSize)
+{
+  // A corrupt PFExtended header claiming a huge payload must be skipped, not buffered.
+  const char *file_name = "corrupt-extended.3es";
+  PacketHeader corrupt = {};
+  corrupt.marker = networkEndianSwapValue(kPacketMarker);
+  corrupt.version_major = networkEndianSwapValue(kPacketVersionMajor);
+  corrupt.version_minor = networkEndianSwapValue(kPacketVersionMinor);
+  corrupt.routing_id = networkEndianSwapValue(uint16_t(MtControl));
+  corrupt.payload_offset = kPacketExtendedSizeBytes;
+  corrupt.flags = PFExtended;
+  const uint32_t corrupt_size = networkEndianSwapValue(uint32_t(0xf0000000u));
+
+  std::vector<uint8_t> stream_bytes(sizeof(corrupt) + sizeof(corrupt_size));
+  std::memcpy(stream_bytes.data(), &corrupt, sizeof(corrupt));
+  std::memcpy(stream_bytes.data() + sizeof(corrupt), &corrupt_size, sizeof(corrupt_size));
+
+  const unsigned packet_count = 3;
+  std::vector<uint8_t> packet_bytes(256u);
+  for (unsigned i = 0; i < packet_count; ++i)
+  {
+    PacketWriter writer(packet_bytes.data(), static_cast<uint16_t>(packet_bytes.size()),
+                        MtControl, static_cast<uint16_t>(i + 1));
+    writer.writeElement(i);
+    ASSERT_TRUE(writer.finalise());
+    stream_bytes.insert(stream_bytes.end(), writer.data(), writer.data() + writer.packetSize());
+  }
+
+  const auto validate = [packet_count](const std::vector<uint16_t> &message_ids) {
+    ASSERT_EQ(message_ids.size(), packet_count);
+    for (unsigned i = 0; i < packet_count; ++i)
+    {
+      EXPECT_EQ(message_ids[i], i + 1);
+    }
+  };
+
+  // Network style buffering.
+  PacketBuffer packet_buffer;
+  EXPECT_EQ(packet_buffer.maxExtendedPayloadSize(), kPacketDefaultMaxExtendedPayloadSize);
+  std::vector<uint16_t> message_ids;
+  packet_buffer.addBytes(stream_bytes);
+  while (const PacketHeader *header = packet_buffer.extractPacket())
+  {
+    message_ids.emplace_back(PacketReader(header).messageId());
+  }
+  validate(message_ids);
+  EXPECT_LT(packet_buffer.capacity(), 4096u);
+
+  // Buffered stream reading.
+  PacketStreamReader stream_reader(std::make_shared<std::stringstream>(
+    std::string(stream_bytes.begin(), stream_bytes.end())));
+  message_ids.clear();
+  for (const auto &[packet, position] : extractAll(stream_reader))
+  {
+    message_ids.emplace_back(PacketReader(reinterpret_cast<const PacketHeader *>(packet.data()))
+                               .messageId());
+  }
+  validate(message_ids);
+  EXPECT_TRUE(stream_reader.isEof());
+
+  // Memory mapped reading.
+  {
+    std::ofstream out(file_name, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(stream_bytes.data()),
+              std::streamsize(stream_bytes.size()));
+  }
+  PacketStreamReader mapped_reader;
+  ASSERT_TRUE(mapped_reader.open(file_name));
+  message_ids.clear();
+  for (const auto &[packet, position] : extractAll(mapped_reader))
+  {
+    message_ids.emplace_back(PacketReader(reinterpret_cast<const PacketHeader *>(packet.data()))
+                               .messageId());
+  }
+  validate(message_ids);
+
+  std::filesystem::remove(file_name);
+}
 }  // namespace tes
@@ -0,0 +1,214 @@
+//
+// author: Kazys Stepanas
+//
+
+#include "3estViewer/TestViewerConfig.h"
+
+#include <3esview/data/KeyframeStore.h>
+
+#include <3escore/Connection.h>
+#include <3escore/Messages.h>
+#include <3escore/PacketReader.h>
+#include <3escore/shapes/Sphere.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace tes::view
+{
+namespace
+{
+/// Write a fake recording of @p byte_count random bytes. The keyframe store does not parse the
+/// recording.
+void writeRecording(const std::filesystem::path &path, size_t byte_count, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> dist(0, 255);
+  std::vector<char> bytes(byte_count);
+  for (auto &byte : bytes)
+  {
+    byte = static_cast<char>(dist(rng));
+  }
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+
+/// Serialise a single sphere with the frame number as its ID.
+KeyframeStore::SerialiseFunction sphereSnapshot(FrameNumber frame)
+{
+  return [frame](Connection &connection) {
+    connection.create(Sphere(Id(frame), Spherical(Vector3f(0.0f), 1.0f)));
+  };
+}
+
+
+/// Replay @p keyframe and return the ID of the sphere it creates, or zero on failure.
+uint32_t replaySphereId(KeyframeStore &store, const KeyframeStore::Keyframe &keyframe)
+{
+  uint32_t id = 0;
+  const bool ok = store.replay(keyframe, [&id](PacketReader &packet) {
+    CreateMessage msg = {};
+    ObjectAttributesd attributes = {};
+    if (packet.routingId() == SIdSphere && packet.messageId() == OIdCreate &&
+        msg.read(packet, attributes))
+    {
+      id = msg.id;
+    }
+  });
+  return (ok) ? id : 0u;
+}
+
+
+/// Test files written to the temporary directory, removed on destruction.
+struct TestFiles
+{
+  std::filesystem::path recording;
+  std::filesystem::path sidecar;
+
+  TestFiles(const std::string &name)
+    : recording(std::filesystem::temp_directory_path() / (name + ".3es"))
+    , sidecar(KeyframeStore::sidecarPath(recording))
+  {
+    remove();
+  }
+
+  ~TestFiles() { remove(); }
+
+  void remove() const
+  {
+    std::error_code err;
+    std::filesystem::remove(recording, err);
+    std::filesystem::remove(sidecar, err);
+  }
+};
+}  // namespace
+
+
+TEST(Keyframes, SaveLoad)
+{
+  const TestFiles files("tes-keyframes-save-load");
+  writeRecording(files.recording, 256u * 1024u, 1u);
+
+  KeyframeStore::RecordingId recording;
+  ASSERT_TRUE(KeyframeStore::identify(files.recording, recording));
+  EXPECT_EQ(recording.stream_size, 256u * 1024u);
+
+  const std::vector<FrameNumber> frames = { 10u, 20u, 30u };
+  {
+    KeyframeStore store(0u, 1u);
+    ASSERT_TRUE(store.openSidecar(files.sidecar, recording));
+    EXPECT_TRUE(store.keyframes().empty());
+    uint64_t stream_offset = 0;
+    for (const auto frame : frames)
+    {
+      stream_offset += 1000u;
+      EXPECT_TRUE(store.due(frame, stream_offset));
+      EXPECT_TRUE(store.add(frame, stream_offset, sphereSnapshot(frame)));
+    }
+    // Keyframes must advance.
+    EXPECT_FALSE(store.add(frames.back(), stream_offset, sphereSnapshot(frames.back())));
+  }
+
+  // Reload.
+  KeyframeStore store(0u, 1u);
+  ASSERT_TRUE(store.openSidecar(files.sidecar, recording));
+  ASSERT_EQ(store.keyframes().size(), frames.size());
+  for (size_t i = 0; i < frames.size(); ++i)
+  {
+    const auto &keyframe = store.keyframes()[i];
+    EXPECT_EQ(keyframe.frame, frames[i]);
+    EXPECT_EQ(keyframe.stream_offset, (i + 1) * 1000u);
+    EXPECT_EQ(replaySphereId(store, keyframe), frames[i]);
+  }
+
+  KeyframeStore::Keyframe keyframe;
+  EXPECT_FALSE(store.nearest(frames.front() - 1, keyframe));
+  ASSERT_TRUE(store.nearest(frames[1] + 5, keyframe));
+  EXPECT_EQ(keyframe.frame, frames[1]);
+
+  // Truncating the sidecar drops the incomplete keyframe only.
+  store.close();
+  std::filesystem::resize_file(files.sidecar, std::filesystem::file_size(files.sidecar) - 4u);
+  ASSERT_TRUE(store.openSidecar(files.sidecar, recording));
+  ASSERT_EQ(store.keyframes().size(), frames.size() - 1);
+  EXPECT_EQ(store.lastFrame(), frames[frames.size() - 2]);
+  EXPECT_TRUE(store.add(frames.back(), 3000u, sphereSnapshot(frames.back())));
+}
+
+
+TEST(Keyframes, RecordingMismatch)
+{
+  const TestFiles files("tes-keyframes-mismatch");
+  writeRecording(files.recording, 256u * 1024u, 2u);
+
+  KeyframeStore::RecordingId recording;
+  ASSERT_TRUE(KeyframeStore::identify(files.recording, recording));
+
+  const auto write_keyframe = [&files](const KeyframeStore::RecordingId &id) {
+    KeyframeStore store(0u, 1u);
+    ASSERT_TRUE(store.openSidecar(files.sidecar, id));
+    if (store.keyframes().empty())
+    {
+      ASSERT_TRUE(store.add(10u, 1000u, sphereSnapshot(10u)));
+    }
+  };
+  const auto keyframe_count = [&files](const KeyframeStore::RecordingId &id) -> size_t {
+    KeyframeStore store(0u, 1u);
+    return (store.openSidecar(files.sidecar, id)) ? store.keyframes().size() : 0u;
+  };
+
+  // Each part of the identity must match.
+  auto mismatch = recording;
+  ++mismatch.stream_size;
+  write_keyframe(recording);
+  EXPECT_EQ(keyframe_count(recording), 1u);
+  EXPECT_EQ(keyframe_count(mismatch), 0u);
+
+  mismatch = recording;
+  ++mismatch.modified_time;
+  write_keyframe(recording);
+  EXPECT_EQ(keyframe_count(mismatch), 0u);
+
+  mismatch = recording;
+  ++mismatch.content_hash;
+  write_keyframe(recording);
+  EXPECT_EQ(keyframe_count(mismatch), 0u);
+  // The mismatched sidecar has been reset for the new identity.
+  EXPECT_EQ(keyframe_count(recording), 0u);
+
+  // Rewrite the recording tail with the same size and restore the modification time.
+  write_keyframe(recording);
+  const auto modified_time = std::filesystem::last_write_time(files.recording);
+  {
+    std::fstream file(files.recording, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(-4, std::ios::end);
+    file.write("tail", 4);
+  }
+  std::filesystem::last_write_time(files.recording, modified_time);
+  ASSERT_TRUE(KeyframeStore::identify(files.recording, mismatch));
+  EXPECT_EQ(mismatch.stream_size, recording.stream_size);
+  EXPECT_EQ(mismatch.modified_time, recording.modified_time);
+  EXPECT_NE(mismatch.content_hash, recording.content_hash);
+  EXPECT_EQ(keyframe_count(mismatch), 0u);
+
+  // Touch the recording without changing the content.
+  write_keyframe(mismatch);
+  std::filesystem::last_write_time(files.recording, modified_time + std::chrono::seconds(10));
+  KeyframeStore::RecordingId touched;
+  ASSERT_TRUE(KeyframeStore::identify(files.recording, touched));
+  EXPECT_EQ(touched.content_hash, mismatch.content_hash);
+  EXPECT_NE(touched.modified_time, mismatch.modified_time);
+  EXPECT_EQ(keyframe_count(touched), 0u);
+
+  // The public open() validates the recording in place.
+  write_keyframe(touched);
+  KeyframeStore store;
+  ASSERT_TRUE(store.open(files.recording));
+  EXPECT_EQ(store.path(), files.sidecar);
+  EXPECT_EQ(store.keyframes().size(), 1u);
+}
+}  // namespace tes::view
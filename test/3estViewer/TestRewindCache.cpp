@@ -0,0 +1,238 @@
+//
+// author: Kazys Stepanas
+//
+
+#include "3estViewer/TestViewerConfig.h"
+
+#include <3esview/data/RewindCache.h>
+
+#include <3escore/Connection.h>
+#include <3escore/Messages.h>
+#include <3escore/PacketReader.h>
+#include <3escore/shapes/Sphere.h>
+
+#include <chrono>
+#include <vector>
+
+namespace tes::view
+{
+namespace
+{
+/// Serialise a single sphere with the frame number as its ID.
+KeyframeStore::SerialiseFunction sphereSnapshot(FrameNumber frame)
+{
+  return [frame](Connection &connection) {
+    connection.create(Sphere(Id(frame), Spherical(Vector3f(0.0f), 1.0f)));
+  };
+}
+
+
+/// Query the byte size of a @c sphereSnapshot() .
+uint64_t snapshotSize()
+{
+  std::vector<uint8_t> packet;
+  EXPECT_TRUE(KeyframeStore::capture(sphereSnapshot(1u), packet));
+  return packet.size();
+}
+}  // namespace
+
+
+TEST(RewindCache, Due)
+{
+  RewindCache cache(RewindCache::kDefaultByteLimit, 4u, std::chrono::hours(1));
+  EXPECT_EQ(cache.windowFrames(), 4u);
+
+  // Due within the window up to the cursor.
+  EXPECT_TRUE(cache.due(10u, 10u));
+  EXPECT_TRUE(cache.due(7u, 10u));
+  EXPECT_FALSE(cache.due(6u, 10u));
+  EXPECT_FALSE(cache.due(11u, 10u));
+
+  // Not due once cached.
+  EXPECT_TRUE(cache.dueByTime(10u));
+  ASSERT_TRUE(cache.add(10u, 0u, sphereSnapshot(10u)));
+  EXPECT_FALSE(cache.due(10u, 10u));
+  EXPECT_TRUE(cache.due(9u, 10u));
+
+  // Not due by time until the interval elapses, or the cache is cleared.
+  EXPECT_FALSE(cache.dueByTime(20u));
+  cache.clear();
+  EXPECT_TRUE(cache.dueByTime(20u));
+
+  RewindCache no_interval(RewindCache::kDefaultByteLimit, 4u, RewindCache::Clock::duration(0));
+  ASSERT_TRUE(no_interval.add(1u, 0u, sphereSnapshot(1u)));
+  EXPECT_TRUE(no_interval.dueByTime(2u));
+  EXPECT_FALSE(no_interval.dueByTime(1u));
+
+  // Never due when disabled.
+  RewindCache disabled(0u);
+  EXPECT_FALSE(disabled.due(1u, 1u));
+  EXPECT_FALSE(disabled.dueByTime(1u));
+  EXPECT_FALSE(disabled.add(1u, 0u, sphereSnapshot(1u)));
+}
+
+
+TEST(RewindCache, Eviction)
+{
+  const uint64_t snapshot_bytes = snapshotSize();
+  ASSERT_GT(snapshot_bytes, 0u);
+
+  // Room for three snapshots.
+  RewindCache cache(3u * snapshot_bytes + snapshot_bytes / 2u);
+  for (FrameNumber frame = 1; frame <= 3; ++frame)
+  {
+    ASSERT_TRUE(cache.add(frame, 0u, sphereSnapshot(frame)));
+  }
+
+  RewindCacheStats stats;
+  cache.stats(stats);
+  EXPECT_EQ(stats.snapshot_count, 3u);
+  EXPECT_EQ(stats.byte_count, 3u * snapshot_bytes);
+  EXPECT_EQ(stats.evictions, 0u);
+
+  // Evicts the snapshot furthest from the new frame.
+  FrameNumber frame = 0;
+  ASSERT_TRUE(cache.add(4u, 0u, sphereSnapshot(4u)));
+  ASSERT_TRUE(cache.oldest(frame));
+  EXPECT_EQ(frame, 2u);
+
+  ASSERT_TRUE(cache.add(0u, 0u, sphereSnapshot(0u)));
+  ASSERT_TRUE(cache.oldest(frame));
+  EXPECT_EQ(frame, 0u);
+  ASSERT_TRUE(cache.nearest(10u, frame));
+  EXPECT_EQ(frame, 3u);
+
+  cache.stats(stats);
+  EXPECT_EQ(stats.snapshot_count, 3u);
+  EXPECT_EQ(stats.byte_count, 3u * snapshot_bytes);
+  EXPECT_LE(stats.byte_count, stats.byte_limit);
+  EXPECT_EQ(stats.evictions, 2u);
+
+  // Replacing a frame does not evict.
+  ASSERT_TRUE(cache.add(3u, 0u, sphereSnapshot(3u)));
+  cache.stats(stats);
+  EXPECT_EQ(stats.snapshot_count, 3u);
+  EXPECT_EQ(stats.evictions, 2u);
+
+  // A snapshot larger than the budget is rejected without evicting.
+  RewindCache small(snapshot_bytes - 1u);
+  EXPECT_FALSE(small.add(1u, 0u, sphereSnapshot(1u)));
+  small.stats(stats);
+  EXPECT_EQ(stats.snapshot_count, 0u);
+}
+
+
+TEST(RewindCache, Lookup)
+{
+  RewindCache cache;
+  for (FrameNumber frame = 5; frame <= 15; frame += 5)
+  {
+    ASSERT_TRUE(cache.add(frame, frame * 100u, sphereSnapshot(frame)));
+  }
+
+  FrameNumber frame = 0;
+  EXPECT_FALSE(cache.nearest(4u, frame));
+  ASSERT_TRUE(cache.nearest(12u, frame));
+  EXPECT_EQ(frame, 10u);
+  ASSERT_TRUE(cache.nearest(15u, frame));
+  EXPECT_EQ(frame, 15u);
+  ASSERT_TRUE(cache.oldest(frame));
+  EXPECT_EQ(frame, 5u);
+
+  // Restore the nearest snapshot at or before the target.
+  uint32_t sphere_id = 0;
+  const auto handler = [&sphere_id](PacketReader &packet) {
+    CreateMessage msg = {};
+    ObjectAttributesd attributes = {};
+    if (packet.routingId() == SIdSphere && packet.messageId() == OIdCreate &&
+        msg.read(packet, attributes))
+    {
+      sphere_id = msg.id;
+    }
+  };
+  uint64_t stream_offset = 0;
+  ASSERT_TRUE(cache.restore(12u, handler, frame, stream_offset));
+  EXPECT_EQ(frame, 10u);
+  EXPECT_EQ(stream_offset, 1000u);
+  EXPECT_EQ(sphere_id, 10u);
+
+  sphere_id = 0;
+  EXPECT_FALSE(cache.restore(3u, handler, frame, stream_offset));
+  EXPECT_EQ(sphere_id, 0u);
+
+  RewindCacheStats stats;
+  cache.stats(stats);
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.misses, 1u);
+
+  // Clearing preserves the statistics.
+  cache.clear();
+  EXPECT_FALSE(cache.oldest(frame));
+  EXPECT_FALSE(cache.restore(12u, handler, frame, stream_offset));
+  cache.stats(stats);
+  EXPECT_EQ(stats.snapshot_count, 0u);
+  EXPECT_EQ(stats.byte_count, 0u);
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.misses, 2u);
+}
+
+
+TEST(RewindCache, LiveStepping)
+{
+  // A paused live stream steps between sparse snapshots captured by time, as per the
+  // NetworkThread. Stepping back then forward must advance rather than restore the same frame.
+  RewindCache cache;
+  const FrameNumber live_frame = 35u;
+  for (FrameNumber frame = 10; frame < live_frame; frame += 10)
+  {
+    ASSERT_TRUE(cache.add(frame, 0u, sphereSnapshot(frame)));
+  }
+
+  FrameNumber frame = 0;
+  ASSERT_TRUE(cache.following(10u, frame));
+  EXPECT_EQ(frame, 10u);
+  ASSERT_TRUE(cache.following(11u, frame));
+  EXPECT_EQ(frame, 20u);
+  EXPECT_FALSE(cache.following(31u, frame));
+
+  const auto ignore = [](PacketReader &packet) { (void)packet; };
+  const auto step_backward = [&cache, &ignore](FrameNumber current_frame) {
+    FrameNumber target = current_frame;
+    uint64_t stream_offset = 0;
+    if (current_frame > 0 && cache.nearest(current_frame - 1, target))
+    {
+      EXPECT_TRUE(cache.restore(target, ignore, target, stream_offset));
+    }
+    return target;
+  };
+  const auto step_forward = [&cache, &ignore, live_frame](FrameNumber current_frame) {
+    FrameNumber target = live_frame;
+    uint64_t stream_offset = 0;
+    if (cache.following(current_frame + 1, target) && target < live_frame)
+    {
+      EXPECT_TRUE(cache.restore(target, ignore, target, stream_offset));
+      return target;
+    }
+    return live_frame;
+  };
+
+  FrameNumber current_frame = live_frame;
+  current_frame = step_backward(current_frame);
+  EXPECT_EQ(current_frame, 30u);
+  current_frame = step_backward(current_frame);
+  EXPECT_EQ(current_frame, 20u);
+  current_frame = step_forward(current_frame);
+  EXPECT_EQ(current_frame, 30u);
+  current_frame = step_forward(current_frame);
+  EXPECT_EQ(current_frame, live_frame);
+
+  // Stepping back stops at the oldest snapshot.
+  current_frame = step_backward(step_backward(step_backward(step_backward(current_frame))));
+  EXPECT_EQ(current_frame, 10u);
+
+  RewindCacheStats stats;
+  cache.stats(stats);
+  EXPECT_EQ(stats.hits, 6u);
+  EXPECT_EQ(stats.misses, 0u);
+}
+}  // namespace tes::view
@@ -0,0 +1,277 @@
+//
+// author: Kazys Stepanas
+//
+
+#include "3estViewer/TestViewerConfig.h"
+
+#include <3esview/data/StreamPipeline.h>
+
+#include <3escore/CollatedPacket.h>
+#include <3escore/MappedFile.h>
+#include <3escore/Messages.h>
+#include <3escore/PacketReader.h>
+#include <3escore/PacketStreamReader.h>
+#include <3escore/PacketWriter.h>
+#include <3escore/shapes/Sphere.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace tes::view
+{
+namespace
+{
+/// Number of frames written by @c writeStream() .
+constexpr unsigned kFrameCount = 200u;
+/// Every nth frame includes a collated packet which cannot be decoded.
+constexpr unsigned kCorruptFrameInterval = 7u;
+
+void writePacket(std::ofstream &out, const PacketWriter &packet)
+{
+  out.write(reinterpret_cast<const char *>(packet.data()),
+            static_cast<std::streamsize>(packet.packetSize()));
+}
+
+
+/// Write a stream of @c kFrameCount frames. Each frame creates a sphere with the frame number as
+/// its ID, then ends with a @c CIdFrame message. The sphere is written as a plain, collated or
+/// compressed collated packet in turn.
+void writeStream(const std::filesystem::path &path)
+{
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  std::vector<uint8_t> buffer(0xffffu);
+  for (unsigned frame = 1; frame <= kFrameCount; ++frame)
+  {
+    const Sphere sphere(Id(frame), Spherical(Vector3f(static_cast<float>(frame)), 1.0f));
+    switch (frame % 3u)
+    {
+    case 0: {
+      PacketWriter packet(buffer.data(), static_cast<uint16_t>(buffer.size()));
+      ASSERT_TRUE(sphere.writeCreate(packet));
+      ASSERT_TRUE(packet.finalise());
+      writePacket(out, packet);
+      break;
+    }
+    default: {
+      CollatedPacket collated(frame % 3u == 2u);
+      ASSERT_GT(collated.create(sphere), 0);
+      ASSERT_TRUE(collated.finalise());
+      unsigned byte_count = 0;
+      const uint8_t *bytes = collated.buffer(byte_count);
+      out.write(reinterpret_cast<const char *>(bytes), static_cast<std::streamsize>(byte_count));
+      break;
+    }
+    }
+
+    if (frame % kCorruptFrameInterval == 0)
+    {
+      // A collated packet without a CollatedPacketMessage.
+      PacketWriter corrupt(buffer.data(), static_cast<uint16_t>(buffer.size()), MtCollatedPacket,
+                           0);
+      ASSERT_TRUE(corrupt.finalise());
+      writePacket(out, corrupt);
+    }
+
+    PacketWriter end_frame(buffer.data(), static_cast<uint16_t>(buffer.size()), MtControl,
+                           CIdFrame);
+    ControlMessage msg = {};
+    msg.value32 = 1;
+    ASSERT_TRUE(msg.write(end_frame));
+    ASSERT_TRUE(end_frame.finalise());
+    writePacket(out, end_frame);
+  }
+}
+
+
+/// Create a pipeline reading @p path .
+std::unique_ptr<StreamPipeline> createPipeline(const std::filesystem::path &path, bool mapped,
+                                               unsigned worker_count, size_t queue_bytes)
+{
+  auto reader = std::make_unique<PacketStreamReader>();
+  if (mapped)
+  {
+    if (!reader->open(path.string()) || !reader->isMapped())
+    {
+      return nullptr;
+    }
+  }
+  else
+  {
+    reader->setStream(std::make_shared<std::ifstream>(path, std::ios::binary));
+  }
+  return std::make_unique<StreamPipeline>(std::move(reader), worker_count, queue_bytes);
+}
+
+
+/// Results from @c readStream() .
+struct ReadResult
+{
+  /// Sphere IDs in the order read.
+  std::vector<uint32_t> ids;
+  /// Pipeline position following each frame, indexed by frame number.
+  std::vector<uint64_t> frame_positions = std::vector<uint64_t>(1, 0);
+  /// Number of dropped packets.
+  unsigned dropped = 0;
+  /// True if the stream offsets increase monotonically.
+  bool ordered_offsets = true;
+};
+
+
+/// Read all packets from @p pipeline .
+ReadResult readStream(StreamPipeline &pipeline)
+{
+  ReadResult result;
+  uint64_t last_offset = pipeline.position();
+  while (const auto decoded = pipeline.next())
+  {
+    result.ordered_offsets = result.ordered_offsets && decoded->stream_offset > last_offset;
+    last_offset = decoded->stream_offset;
+    result.dropped += (decoded->messages == nullptr) ? 1u : 0u;
+
+    size_t cursor = 0;
+    while (const PacketHeader *header = decoded->next(cursor))
+    {
+      PacketReader packet(header);
+      if (packet.routingId() == MtControl && packet.messageId() == CIdFrame)
+      {
+        result.frame_positions.emplace_back(pipeline.position());
+      }
+      else if (packet.routingId() == SIdSphere && packet.messageId() == OIdCreate)
+      {
+        CreateMessage msg = {};
+        ObjectAttributesd attributes = {};
+        EXPECT_TRUE(msg.read(packet, attributes));
+        result.ids.emplace_back(msg.id);
+      }
+    }
+  }
+  return result;
+}
+
+
+/// Test stream file, removed on destruction.
+struct TestStream
+{
+  std::filesystem::path path;
+
+  TestStream(const std::string &name)
+    : path(std::filesystem::temp_directory_path() / (name + ".3es"))
+  {
+    writeStream(path);
+  }
+
+  ~TestStream()
+  {
+    std::error_code err;
+    std::filesystem::remove(path, err);
+  }
+};
+}  // namespace
+
+
+TEST(StreamPipeline, Ordering)
+{
+  const TestStream stream("tes-stream-pipeline-ordering");
+  const uint64_t stream_size = std::filesystem::file_size(stream.path);
+
+  for (const bool mapped : { false, true })
+  {
+    for (const unsigned worker_count : { 0u, 1u, 4u })
+    {
+      // A small queue exercises the read ahead limit.
+      auto pipeline = createPipeline(stream.path, mapped, worker_count, 4u * 1024u);
+      if (!pipeline)
+      {
+        ASSERT_TRUE(mapped);
+        std::cout << "Memory mapping not supported" << std::endl;
+        continue;
+      }
+
+      const ReadResult result = readStream(*pipeline);
+      EXPECT_TRUE(pipeline->isEof());
+      EXPECT_EQ(pipeline->position(), stream_size);
+      EXPECT_TRUE(result.ordered_offsets);
+      EXPECT_EQ(result.dropped, kFrameCount / kCorruptFrameInterval);
+      ASSERT_EQ(result.ids.size(), kFrameCount);
+      ASSERT_EQ(result.frame_positions.size(), kFrameCount + 1u);
+      for (unsigned i = 0; i < kFrameCount; ++i)
+      {
+        EXPECT_EQ(result.ids[i], i + 1u);
+      }
+
+      // Seek back, discarding the read ahead packets, and read on in order.
+      const unsigned seek_frame = kFrameCount / 2u;
+      pipeline->seek(result.frame_positions[seek_frame]);
+      EXPECT_FALSE(pipeline->isEof());
+      EXPECT_EQ(pipeline->position(), result.frame_positions[seek_frame]);
+      const auto decoded = pipeline->next();
+      ASSERT_NE(decoded, nullptr);
+      pipeline->seek(result.frame_positions[seek_frame]);
+      const ReadResult seek_result = readStream(*pipeline);
+      ASSERT_EQ(seek_result.ids.size(), kFrameCount - seek_frame);
+      for (unsigned i = 0; i < seek_result.ids.size(); ++i)
+      {
+        EXPECT_EQ(seek_result.ids[i], seek_frame + i + 1u);
+      }
+
+      // Packets outlive seeking and the pipeline.
+      pipeline.reset();
+      size_t cursor = 0;
+      const PacketHeader *header = decoded->next(cursor);
+      ASSERT_NE(header, nullptr);
+      PacketReader packet(header);
+      EXPECT_EQ(packet.routingId(), SIdSphere);
+    }
+  }
+}
+
+
+TEST(StreamPipeline, Shutdown)
+{
+  const TestStream stream("tes-stream-pipeline-shutdown");
+
+  for (const bool mapped : { false, true })
+  {
+    // Destroy with the read thread blocked on a full queue and packets pending decode.
+    auto pipeline = createPipeline(stream.path, mapped, 2u, 1u);
+    if (!pipeline)
+    {
+      continue;
+    }
+    ASSERT_NE(pipeline->next(), nullptr);
+    pipeline.reset();
+
+    pipeline = createPipeline(stream.path, mapped, 2u, StreamPipeline::kDefaultQueueBytes);
+    ASSERT_NE(pipeline->next(), nullptr);
+    pipeline.reset();
+
+    // Stopping releases next().
+    pipeline = createPipeline(stream.path, mapped, 2u, 256u);
+    pipeline->stop();
+    EXPECT_EQ(pipeline->next(), nullptr);
+    pipeline.reset();
+
+    // Stop from another thread while reading.
+    pipeline = createPipeline(stream.path, mapped, 2u, 256u);
+    std::atomic_uint read_count = 0;
+    std::thread consumer([&pipeline, &read_count] {
+      while (pipeline->next())
+      {
+        ++read_count;
+      }
+    });
+    while (read_count == 0)
+    {
+      std::this_thread::yield();
+    }
+    pipeline->stop();
+    consumer.join();
+    EXPECT_GT(read_count, 0u);
+    pipeline.reset();
+  }
+}
+}  // namespace tes::view